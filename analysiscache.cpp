@@ -0,0 +1,57 @@
+#include "analysiscache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QSaveFile>
+
+#include "fileidentity.h"
+
+AnalysisCache::AnalysisCache(const QString& directory)
+    : dir(directory)
+{
+    QDir().mkpath(dir);
+}
+
+QString AnalysisCache::filePath(quint64 identity, const QString& kind) const
+{
+    return QString("%1/%2.%3.json").arg(dir, fileIdentityString(identity), kind);
+}
+
+bool AnalysisCache::contains(quint64 identity, const QString& kind) const
+{
+    return QFile::exists(filePath(identity, kind));
+}
+
+QJsonObject AnalysisCache::load(quint64 identity, const QString& kind) const
+{
+    QFile file(filePath(identity, kind));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QJsonObject();
+    }
+    return QJsonDocument::fromJson(file.readAll()).object();
+}
+
+void AnalysisCache::store(quint64 identity, const QString& kind, const QJsonObject& result)
+{
+    // readers never see a half written file
+    QSaveFile file(filePath(identity, kind));
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(QJsonDocument(result).toJson(QJsonDocument::Compact));
+        file.commit();
+    }
+}
+
+QString AnalysisCache::dataPath(quint64 identity, const QString& kind) const
+{
+    return QString("%1/%2.%3.bin").arg(dir, fileIdentityString(identity), kind);
+}
+
+void AnalysisCache::storeData(quint64 identity, const QString& kind, const QByteArray& data)
+{
+    QSaveFile file(dataPath(identity, kind));
+    if (file.open(QIODevice::WriteOnly)) {
+        file.write(data);
+        file.commit();
+    }
+}
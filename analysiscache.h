@@ -0,0 +1,25 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+
+// Results of background analysis, one small JSON file per source file and
+// kind of analysis, named after fileIdentity(). Safe to use from several
+// threads as long as they don't write the same entry.
+class AnalysisCache
+{
+public:
+    AnalysisCache(const QString& directory);
+
+    bool contains(quint64 identity, const QString& kind) const;
+    QJsonObject load(quint64 identity, const QString& kind) const;
+    void store(quint64 identity, const QString& kind, const QJsonObject& result);
+    // binary data that goes with a result, to be mapped by its reader
+    QString dataPath(quint64 identity, const QString& kind) const;
+    void storeData(quint64 identity, const QString& kind, const QByteArray& data);
+
+private:
+    QString dir;
+
+    QString filePath(quint64 identity, const QString& kind) const;
+};
@@ -0,0 +1,101 @@
+#include "audioscanner.h"
+
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+#include <memory>
+#include <vector>
+
+#include "analysiscache.h"
+#include "fileidentity.h"
+#include "headlessdecoder.h"
+
+AudioScanner::AudioScanner(AnalysisCache* cache, QObject* parent)
+    : BackgroundWorker(parent)
+    , cache(cache)
+{
+}
+
+AudioScanner::~AudioScanner()
+{
+    stop();
+}
+
+void AudioScanner::addSink(const QString& kind, const SinkFactory& factory)
+{
+    factories.append({ kind, factory });
+}
+
+void AudioScanner::abortCurrent()
+{
+    if (decoder) {
+        decoder->abort();
+    }
+}
+
+AudioScanner::Stats AudioScanner::stats() const
+{
+    QMutexLocker locker(&mutex);
+    return counters;
+}
+
+void AudioScanner::process(const QString& file)
+{
+    quint64 identity = fileIdentity(file);
+    if (identity == 0) {
+        return;
+    }
+    QStringList kinds;
+    std::vector<std::unique_ptr<AudioSink>> sinks;
+    for (const auto& factory : factories) {
+        if (!cache->contains(identity, factory.first)) {
+            kinds << factory.first;
+            sinks.emplace_back(factory.second());
+        }
+    }
+    if (sinks.empty() || !keepGoing()) {
+        return;
+    }
+
+    HeadlessDecoder fileDecoder;
+    {
+        QMutexLocker locker(&mutex);
+        decoder = &fileDecoder;
+    }
+    QElapsedTimer timer;
+    timer.start();
+    qint64 framesDecoded = 0;
+    bool ok = fileDecoder.decodeAudio(file, SampleRate, Channels, [&](const float* samples, qint64 frames) {
+        // blocking here blocks mpv on the FIFO, which is all pausing needs
+        if (!keepGoing()) {
+            fileDecoder.abort();
+            return;
+        }
+        for (auto& sink : sinks) {
+            sink->process(samples, frames);
+        }
+        framesDecoded += frames;
+    });
+    {
+        QMutexLocker locker(&mutex);
+        decoder = nullptr;
+        if (ok) {
+            counters.filesScanned++;
+            counters.secondsDecoded += (double)framesDecoded / SampleRate;
+            counters.secondsSpent += timer.nsecsElapsed() / 1e9;
+        }
+    }
+    if (!ok) {
+        return;
+    }
+    for (size_t i = 0; i < sinks.size(); ++i) {
+        // the data first, a stored result means both are there
+        const QByteArray data = sinks.at(i)->data();
+        if (!data.isEmpty()) {
+            cache->storeData(identity, kinds.at(i), data);
+        }
+        QJsonObject result = sinks.at(i)->result();
+        cache->store(identity, kinds.at(i), result);
+        emit analyzed(file, identity, kinds.at(i), result);
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+#include <QPair>
+
+#include <functional>
+
+#include "backgroundworker.h"
+
+class AnalysisCache;
+class HeadlessDecoder;
+
+// Something computed from a file's decoded audio in a single pass.
+class AudioSink
+{
+public:
+    virtual ~AudioSink() = default;
+    // interleaved float samples at the scanner's rate and channel count
+    virtual void process(const float* samples, qint64 frames) = 0;
+    virtual QJsonObject result() = 0;
+    // anything too large for JSON, kept next to the result
+    virtual QByteArray data() { return QByteArray(); }
+};
+
+// Decodes the audio of queued files once, on an idle priority thread, and
+// feeds it to every registered sink whose result isn't cached yet.
+class AudioScanner : public BackgroundWorker
+{
+    Q_OBJECT
+public:
+    static const int SampleRate = 48000;
+    static const int Channels = 2;
+
+    using SinkFactory = std::function<AudioSink*()>;
+
+    struct Stats {
+        int filesScanned = 0;
+        double secondsDecoded = 0;
+        double secondsSpent = 0;
+        // how much faster than playback the scanner runs
+        double speed() const { return secondsSpent > 0 ? secondsDecoded / secondsSpent : 0; }
+    };
+
+    AudioScanner(AnalysisCache* cache, QObject* parent = nullptr);
+    ~AudioScanner();
+
+    // register before start()
+    void addSink(const QString& kind, const SinkFactory& factory);
+    Stats stats() const;
+
+signals:
+    void analyzed(const QString& file, quint64 identity, const QString& kind, const QJsonObject& result);
+
+protected:
+    void process(const QString& file) override;
+    void abortCurrent() override;
+
+private:
+    AnalysisCache* cache;
+    QList<QPair<QString, SinkFactory>> factories;
+    HeadlessDecoder* decoder = nullptr;
+    Stats counters;
+};
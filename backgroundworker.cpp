@@ -0,0 +1,87 @@
+#include "backgroundworker.h"
+
+#include <QMutexLocker>
+
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define IOPRIO_CLASS_IDLE 3
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
+void setIdleIoPriority()
+{
+    // the "process" is the calling thread as far as the kernel is concerned
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT);
+}
+
+BackgroundWorker::BackgroundWorker(QObject* parent)
+    : QThread(parent)
+    , aborted(false)
+{
+}
+
+void BackgroundWorker::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        pending.clear();
+        aborted = true;
+        abortCurrent();
+        condition.wakeAll();
+    }
+    wait();
+}
+
+void BackgroundWorker::setFiles(const QStringList& files)
+{
+    QMutexLocker locker(&mutex);
+    pending = files;
+    // let the file being worked on finish unless nobody wants it anymore
+    if (!current.isEmpty() && !files.contains(current)) {
+        aborted = true;
+        abortCurrent();
+    }
+    condition.wakeAll();
+}
+
+void BackgroundWorker::setPaused(bool p)
+{
+    QMutexLocker locker(&mutex);
+    paused = p;
+    condition.wakeAll();
+}
+
+void BackgroundWorker::run()
+{
+    setIdleIoPriority();
+
+    while (true) {
+        QString file;
+        {
+            QMutexLocker locker(&mutex);
+            while (!stopping && pending.isEmpty()) {
+                condition.wait(&mutex);
+            }
+            if (stopping) {
+                return;
+            }
+            file = pending.takeFirst();
+            current = file;
+            aborted = false;
+        }
+        process(file);
+        QMutexLocker locker(&mutex);
+        current.clear();
+    }
+}
+
+bool BackgroundWorker::keepGoing()
+{
+    QMutexLocker locker(&mutex);
+    while (paused && !stopping) {
+        condition.wait(&mutex);
+    }
+    return !stopping && !aborted;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QMutex>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+
+// Puts the calling thread in the idle I/O class, its reads are only served
+// while no one else wants the disk. Threads it creates inherit the class,
+// and pool threads keep it for whatever runs on them next.
+void setIdleIoPriority();
+
+// Works through queued files one at a time on a thread of its own, started
+// with idle priority. The queue is replaced as a whole, and the file being
+// worked on is given up once it isn't in the queue anymore.
+class BackgroundWorker : public QThread
+{
+    Q_OBJECT
+public:
+    BackgroundWorker(QObject* parent = nullptr);
+
+    void setFiles(const QStringList& files);
+    void setPaused(bool paused);
+    // subclasses call it from their destructor, before their part is gone
+    void stop();
+
+protected:
+    // guards the queue, subclasses keep their counters under it too
+    mutable QMutex mutex;
+
+    void run() override;
+    virtual void process(const QString& file) = 0;
+    // the file being worked on is given up, called with the mutex held
+    virtual void abortCurrent() { }
+    // blocks while paused, false once the file is to be given up
+    bool keepGoing();
+
+private:
+    QWaitCondition condition;
+    QStringList pending;
+    QString current;
+    bool paused = false;
+    bool stopping = false;
+    std::atomic_bool aborted;
+};
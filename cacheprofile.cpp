@@ -0,0 +1,133 @@
+#include "cacheprofile.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QThread>
+#include <QtGlobal>
+
+#include <sys/statfs.h>
+
+#include "qthelper.hpp"
+
+#define MiB (1024 * 1024)
+
+QStringList cacheModeNames()
+{
+    return { "mpv Default", "Auto", "Low Memory", "Network", "Custom" };
+}
+
+static qint64 availableMemory()
+{
+    QFile meminfo("/proc/meminfo");
+    if (!meminfo.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    while (!meminfo.atEnd()) {
+        QByteArray line = meminfo.readLine();
+        if (line.startsWith("MemAvailable:")) {
+            // value is in kB
+            return line.mid(13).trimmed().split(' ').first().toLongLong() * 1024;
+        }
+    }
+    return 0;
+}
+
+static bool isNetworkPath(const QString& path)
+{
+    if (path.contains("://")) {
+        return !path.startsWith("file://");
+    }
+    struct statfs fs;
+    if (statfs(QFile::encodeName(QFileInfo(path).absolutePath()).constData(), &fs) != 0) {
+        return false;
+    }
+    switch (static_cast<unsigned long>(fs.f_type)) {
+    case 0x6969: // NFS
+    case 0x517B: // SMB
+    case 0xFF534D42: // CIFS
+    case 0xFE534D42: // SMB2
+    case 0x65735546: // FUSE (sshfs, rclone...)
+    case 0x00C36400: // Ceph
+    case 0x5346414F: // AFS
+        return true;
+    default:
+        return false;
+    }
+}
+
+CacheHints systemCacheHints(const QString& path)
+{
+    CacheHints hints;
+    hints.cores = QThread::idealThreadCount();
+    hints.availableMemory = availableMemory();
+    hints.networkSource = !path.isEmpty() && isNetworkPath(path);
+    return hints;
+}
+
+CacheProfile cacheProfileFor(CacheMode mode, const CacheHints& hints, const CacheProfile& custom)
+{
+    CacheProfile profile;
+    switch (mode) {
+    case CacheDefault:
+        break;
+    case CacheLowMemory:
+        profile.maxBytes = 32 * MiB;
+        profile.maxBackBytes = 8 * MiB;
+        break;
+    case CacheNetwork:
+        profile.cache = "yes";
+        profile.maxBytes = 512 * MiB;
+        profile.maxBackBytes = 128 * MiB;
+        profile.readaheadSecs = 60;
+        break;
+    case CacheCustom:
+        profile = custom;
+        break;
+    case CacheAuto: {
+        // Spend at most 1/16 of the available memory on the forward cache,
+        // and keep a third of that for seeking back without a reload.
+        qint64 budget = hints.availableMemory > 0 ? hints.availableMemory / 16 : 150 * MiB;
+        budget = qBound<qint64>(32 * MiB, budget, 1024 * MiB);
+
+        // The slower the source is compared to what playback consumes, the
+        // further ahead we need to read to ride out hiccups.
+        int readahead = hints.networkSource ? 30 : 5;
+        if (hints.throughput > 0 && hints.bitrate > 0) {
+            double ratio = hints.throughput / hints.bitrate;
+            if (ratio < 2) {
+                readahead = 120;
+            }
+            else if (ratio < 5) {
+                readahead = 60;
+            }
+            else if (ratio < 20) {
+                readahead = qMax(readahead, 20);
+            }
+        }
+        if (hints.stalled) {
+            readahead = qMin(readahead * 2, 300);
+        }
+        qint64 needed = hints.bitrate > 0 ? static_cast<qint64>(hints.bitrate * readahead * 1.5) : 0;
+        profile.cache = hints.networkSource || hints.stalled ? "yes" : "auto";
+        profile.maxBytes = qBound<qint64>(32 * MiB, qMax(needed, budget / 2), budget);
+        profile.maxBackBytes = budget / 3;
+        profile.readaheadSecs = readahead;
+
+        // Leave one core for the GUI, audio and demuxer threads on small
+        // boxes, and let big boxes go past libavcodec's automatic cap of 16.
+        int cores = qMax(1, hints.cores);
+        profile.decoderThreads = cores <= 4 ? qMax(1, cores - 1) : qMin(cores, 32);
+        break;
+    }
+    }
+    return profile;
+}
+
+void applyCacheProfile(mpv_handle* mpv, const CacheProfile& profile)
+{
+    mpv::qt::set_property_variant(mpv, "cache", profile.cache);
+    mpv::qt::set_property_variant(mpv, "demuxer-max-bytes", profile.maxBytes);
+    mpv::qt::set_property_variant(mpv, "demuxer-max-back-bytes", profile.maxBackBytes);
+    mpv::qt::set_property_variant(mpv, "demuxer-readahead-secs", profile.readaheadSecs);
+    mpv::qt::set_property_variant(mpv, "vd-lavc-threads", profile.decoderThreads);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+#include <mpv/client.h>
+
+enum CacheMode {
+    CacheDefault,
+    CacheAuto,
+    CacheLowMemory,
+    CacheNetwork,
+    CacheCustom,
+};
+
+struct CacheProfile {
+    QString cache = "auto";
+    qint64 maxBytes = 150 * 1024 * 1024;
+    qint64 maxBackBytes = 50 * 1024 * 1024;
+    int readaheadSecs = 1;
+    // 0 lets libavcodec pick
+    int decoderThreads = 0;
+};
+
+// What the auto mode knows about the machine and the current source.
+struct CacheHints {
+    int cores = 1;
+    qint64 availableMemory = 0;
+    // both in bytes per second, 0 when not known yet
+    double throughput = 0;
+    double bitrate = 0;
+    bool networkSource = false;
+    bool stalled = false;
+};
+
+QStringList cacheModeNames();
+CacheHints systemCacheHints(const QString& path);
+CacheProfile cacheProfileFor(CacheMode mode, const CacheHints& hints, const CacheProfile& custom);
+void applyCacheProfile(mpv_handle* mpv, const CacheProfile& profile);
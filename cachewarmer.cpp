@@ -0,0 +1,258 @@
+#include "cachewarmer.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMutexLocker>
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "backgroundworker.h"
+#include "containerindex.h"
+
+#define HEAD_BYTES (4 * 1024 * 1024)
+#define TAIL_BYTES (1024 * 1024)
+#define CHUNK_BYTES (512 * 1024)
+
+CacheWarmer::CacheWarmer(QObject* parent)
+    : QThread(parent)
+{
+}
+
+CacheWarmer::~CacheWarmer()
+{
+    stop();
+}
+
+void CacheWarmer::stop()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        pending.clear();
+        condition.wakeAll();
+    }
+    wait();
+}
+
+void CacheWarmer::setFiles(const QStringList& files)
+{
+    QMutexLocker locker(&mutex);
+    pending = files;
+    generation++;
+    condition.wakeAll();
+}
+
+void CacheWarmer::measure(const QString& file)
+{
+    QMutexLocker locker(&mutex);
+    toMeasure.append(file);
+    condition.wakeAll();
+}
+
+void CacheWarmer::setPaused(bool p)
+{
+    QMutexLocker locker(&mutex);
+    paused = p;
+    condition.wakeAll();
+}
+
+void CacheWarmer::setRate(qint64 bytesPerSecond)
+{
+    QMutexLocker locker(&mutex);
+    rate = qMax<qint64>(64 * 1024, bytesPerSecond);
+}
+
+CacheWarmer::Stats CacheWarmer::stats() const
+{
+    QMutexLocker locker(&mutex);
+    return counters;
+}
+
+void CacheWarmer::run()
+{
+    // Idle class I/O is only served when no one else wants the disk, so the
+    // playing file's reads are never queued behind ours.
+    setIdleIoPriority();
+
+    while (true) {
+        QString file;
+        bool measuring = false;
+        quint64 listGeneration;
+        {
+            QMutexLocker locker(&mutex);
+            while (!stopping && pending.isEmpty() && toMeasure.isEmpty()) {
+                condition.wait(&mutex);
+            }
+            if (stopping) {
+                return;
+            }
+            if (!toMeasure.isEmpty()) {
+                file = toMeasure.takeFirst();
+                measuring = true;
+            }
+            else {
+                file = pending.takeFirst();
+            }
+            listGeneration = generation;
+        }
+        if (measuring) {
+            measureFile(file);
+        }
+        else {
+            warm(file, listGeneration);
+        }
+    }
+}
+
+bool CacheWarmer::waitWhilePaused()
+{
+    QMutexLocker locker(&mutex);
+    while (paused && !stopping) {
+        condition.wait(&mutex);
+    }
+    return !stopping;
+}
+
+QList<CacheWarmer::Region> CacheWarmer::regions(int fd, qint64 size, bool withIndex)
+{
+    QList<Region> list;
+    list.append({ 0, qMin<qint64>(size, HEAD_BYTES) });
+    if (size > HEAD_BYTES) {
+        qint64 tail = qMax<qint64>(HEAD_BYTES, size - TAIL_BYTES);
+        list.append({ tail, size - tail });
+    }
+    Region index;
+    if (withIndex && (findMp4Index(fd, size, &index) || findMkvIndex(fd, size, &index))) {
+        list.append(index);
+    }
+    return list;
+}
+
+qint64 CacheWarmer::residentPages(int fd, const Region& region, qint64* pages)
+{
+    static const qint64 pageSize = sysconf(_SC_PAGESIZE);
+    qint64 start = region.first / pageSize * pageSize;
+    qint64 length = region.first + region.second - start;
+    *pages = 0;
+    if (length <= 0) {
+        return 0;
+    }
+    // mapping without touching doesn't fault anything in
+    void* map = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, start);
+    if (map == MAP_FAILED) {
+        return 0;
+    }
+    std::vector<unsigned char> vec((length + pageSize - 1) / pageSize);
+    qint64 resident = 0;
+    if (mincore(map, length, vec.data()) == 0) {
+        for (unsigned char page : vec) {
+            resident += page & 1;
+        }
+        *pages = vec.size();
+    }
+    munmap(map, length);
+    return resident;
+}
+
+void CacheWarmer::warm(const QString& file, quint64 listGeneration)
+{
+    int fd = open(QFile::encodeName(file).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return;
+    }
+
+    QElapsedTimer timer;
+    for (const Region& region : regions(fd, st.st_size, true)) {
+        for (qint64 offset = region.first; offset < region.first + region.second; offset += CHUNK_BYTES) {
+            if (!waitWhilePaused()) {
+                close(fd);
+                return;
+            }
+            qint64 rateNow;
+            {
+                QMutexLocker locker(&mutex);
+                // measurements are time sensitive, come back to this file later
+                if (!toMeasure.isEmpty()) {
+                    pending.prepend(file);
+                    close(fd);
+                    return;
+                }
+                // the playlist moved on, don't finish a file nobody needs; one
+                // that is still upcoming is finished here instead of again later
+                if (generation != listGeneration) {
+                    if (!pending.removeOne(file)) {
+                        close(fd);
+                        return;
+                    }
+                    listGeneration = generation;
+                }
+                rateNow = rate;
+            }
+            Region chunk(offset, qMin<qint64>(CHUNK_BYTES, region.first + region.second - offset));
+            qint64 pages;
+            qint64 resident = residentPages(fd, chunk, &pages);
+            if (pages > 0 && resident == pages) {
+                QMutexLocker locker(&mutex);
+                counters.bytesAlreadyCached += chunk.second;
+                continue;
+            }
+
+            timer.start();
+            posix_fadvise(fd, chunk.first, chunk.second, POSIX_FADV_WILLNEED);
+            readahead(fd, chunk.first, chunk.second);
+            {
+                QMutexLocker locker(&mutex);
+                counters.bytesPrefetched += chunk.second;
+            }
+            qint64 budgetUs = chunk.second * 1000000 / rateNow;
+            qint64 spentUs = timer.nsecsElapsed() / 1000;
+            if (budgetUs > spentUs) {
+                usleep(budgetUs - spentUs);
+            }
+        }
+    }
+    close(fd);
+}
+
+void CacheWarmer::measureFile(const QString& file)
+{
+    int fd = open(QFile::encodeName(file).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        // keep the kernel from reading ahead around our header reads, which
+        // would make the index look cached when it wasn't
+        posix_fadvise(fd, 0, 0, POSIX_FADV_RANDOM);
+        qint64 checked = 0;
+        qint64 resident = 0;
+        qint64 pages;
+        auto plain = regions(fd, st.st_size, false);
+        for (const Region& region : plain) {
+            resident += residentPages(fd, region, &pages);
+            checked += pages;
+        }
+        auto all = regions(fd, st.st_size, true);
+        for (int i = plain.count(); i < all.count(); ++i) {
+            resident += residentPages(fd, all.at(i), &pages);
+            checked += pages;
+        }
+        QMutexLocker locker(&mutex);
+        counters.pagesChecked += checked;
+        counters.pagesResident += resident;
+        counters.filesMeasured++;
+    }
+    close(fd);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QStringList>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+
+// Pulls the parts of upcoming playlist files that mpv reads first (head,
+// tail and the moov/Cues index) into the page cache, from a thread with
+// idle I/O priority and a byte rate limit so the playing file always wins.
+class CacheWarmer : public QThread
+{
+    Q_OBJECT
+public:
+    struct Stats {
+        qint64 bytesPrefetched = 0;
+        qint64 bytesAlreadyCached = 0;
+        qint64 pagesChecked = 0;
+        qint64 pagesResident = 0;
+        int filesMeasured = 0;
+        double hitRate() const { return pagesChecked > 0 ? (double)pagesResident / pagesChecked : 0; }
+    };
+
+    CacheWarmer(QObject* parent = nullptr);
+    ~CacheWarmer();
+
+    void setFiles(const QStringList& files);
+    // measure how much of a file mpv is about to read is already cached
+    void measure(const QString& file);
+    void setPaused(bool paused);
+    void setRate(qint64 bytesPerSecond);
+    Stats stats() const;
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    using Region = QPair<qint64, qint64>;
+
+    mutable QMutex mutex;
+    QWaitCondition condition;
+    QStringList pending;
+    // bumped by setFiles(), tells the file being warmed that the list changed
+    quint64 generation = 0;
+    QStringList toMeasure;
+    bool paused = false;
+    bool stopping = false;
+    qint64 rate = 8 * 1024 * 1024;
+    Stats counters;
+
+    QList<Region> regions(int fd, qint64 size, bool withIndex);
+    qint64 residentPages(int fd, const Region& region, qint64* pages);
+    void warm(const QString& file, quint64 listGeneration);
+    void measureFile(const QString& file);
+    bool waitWhilePaused();
+};
@@ -0,0 +1,174 @@
+#include "containerindex.h"
+
+#include <unistd.h>
+
+#include <vector>
+
+qint64 readBE(const uchar* p, int bytes)
+{
+    qint64 value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+qint64 readVint(const uchar* p, const uchar* end, int* length, bool keepMarker)
+{
+    if (p >= end || *p == 0) {
+        *length = 0;
+        return -1;
+    }
+    int len = 1;
+    uchar mask = 0x80;
+    while (!(*p & mask)) {
+        mask >>= 1;
+        len++;
+    }
+    if (p + len > end) {
+        *length = 0;
+        return -1;
+    }
+    qint64 value = keepMarker ? *p : (*p & (mask - 1));
+    for (int i = 1; i < len; ++i) {
+        value = (value << 8) | p[i];
+    }
+    *length = len;
+    return value;
+}
+
+bool findMp4Index(int fd, qint64 size, QPair<qint64, qint64>* region)
+{
+    qint64 offset = 0;
+    for (int boxes = 0; boxes < 64 && offset + 8 <= size; ++boxes) {
+        uchar header[16];
+        if (pread(fd, header, sizeof(header), offset) < 8) {
+            return false;
+        }
+        qint64 boxSize = readBE(header, 4);
+        if (boxSize == 1) {
+            boxSize = readBE(header + 8, 8);
+        }
+        else if (boxSize == 0) {
+            boxSize = size - offset;
+        }
+        if (boxSize < 8) {
+            return false;
+        }
+        if (memcmp(header + 4, "moov", 4) == 0) {
+            *region = { offset, boxSize };
+            return true;
+        }
+        offset += boxSize;
+    }
+    return false;
+}
+
+bool findMkvIndex(int fd, qint64 size, QPair<qint64, qint64>* region)
+{
+    std::vector<uchar> buffer(64 * 1024);
+    ssize_t got = pread(fd, buffer.data(), buffer.size(), 0);
+    if (got < 4 || readBE(buffer.data(), 4) != EBML_HEADER) {
+        return false;
+    }
+    const uchar* p = buffer.data();
+    const uchar* end = p + got;
+    int len;
+
+    // EBML header, then the Segment whose children are addressed relative to
+    // where its data starts
+    qint64 id = readVint(p, end, &len, true);
+    p += len;
+    qint64 elementSize = readVint(p, end, &len, false);
+    if (elementSize < 0 || elementSize > end - p - len) {
+        return false;
+    }
+    p += len + elementSize;
+    id = readVint(p, end, &len, true);
+    if (id != EBML_SEGMENT) {
+        return false;
+    }
+    p += len;
+    readVint(p, end, &len, false);
+    p += len;
+    const uchar* segmentData = p;
+
+    id = readVint(p, end, &len, true);
+    if (id != EBML_SEEKHEAD) {
+        return false;
+    }
+    p += len;
+    elementSize = readVint(p, end, &len, false);
+    if (elementSize < 0) {
+        return false;
+    }
+    p += len;
+    const uchar* seekHeadEnd = p + qMin<qint64>(elementSize, end - p);
+
+    qint64 cuesPosition = -1;
+    while (p < seekHeadEnd && cuesPosition < 0) {
+        id = readVint(p, seekHeadEnd, &len, true);
+        if (len == 0) {
+            break;
+        }
+        p += len;
+        elementSize = readVint(p, seekHeadEnd, &len, false);
+        if (len == 0) {
+            break;
+        }
+        p += len;
+        if (elementSize > seekHeadEnd - p) {
+            break;
+        }
+        if (id != EBML_SEEK) {
+            p += elementSize;
+            continue;
+        }
+        const uchar* seekEnd = p + elementSize;
+        qint64 seekId = -1;
+        qint64 seekPosition = -1;
+        while (p < seekEnd) {
+            qint64 childId = readVint(p, seekEnd, &len, true);
+            if (len == 0) {
+                break;
+            }
+            p += len;
+            qint64 childSize = readVint(p, seekEnd, &len, false);
+            if (len == 0 || childSize > 8 || childSize > seekEnd - p - len) {
+                break;
+            }
+            p += len;
+            if (childId == EBML_SEEKID) {
+                seekId = readBE(p, childSize);
+            }
+            else if (childId == EBML_SEEKPOSITION) {
+                seekPosition = readBE(p, childSize);
+            }
+            p += childSize;
+        }
+        p = seekEnd;
+        if (seekId == EBML_CUES && seekPosition >= 0) {
+            cuesPosition = (segmentData - buffer.data()) + seekPosition;
+        }
+    }
+    if (cuesPosition < 0 || cuesPosition >= size) {
+        return false;
+    }
+
+    uchar header[12];
+    got = pread(fd, header, sizeof(header), cuesPosition);
+    if (got < 5) {
+        return false;
+    }
+    id = readVint(header, header + got, &len, true);
+    if (id != EBML_CUES) {
+        return false;
+    }
+    int sizeLength;
+    elementSize = readVint(header + len, header + got, &sizeLength, false);
+    if (sizeLength == 0) {
+        return false;
+    }
+    *region = { cuesPosition, qMin(size - cuesPosition, len + sizeLength + elementSize) };
+    return true;
+}
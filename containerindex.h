@@ -0,0 +1,23 @@
+#pragma once
+
+#include <QPair>
+#include <QtGlobal>
+
+#define EBML_HEADER 0x1A45DFA3
+#define EBML_SEGMENT 0x18538067
+#define EBML_SEEKHEAD 0x114D9B74
+#define EBML_SEEK 0x4DBB
+#define EBML_SEEKID 0x53AB
+#define EBML_SEEKPOSITION 0x53AC
+#define EBML_CUES 0x1C53BB6B
+
+// Big endian unsigned integer of up to 8 bytes.
+qint64 readBE(const uchar* p, int bytes);
+// EBML variable length integer. IDs keep their length marker, sizes don't.
+// Returns -1 with length 0 when it runs past end.
+qint64 readVint(const uchar* p, const uchar* end, int* length, bool keepMarker);
+
+// Where a file keeps its own seek index, as offset and length: the moov box
+// of MP4 and the Cues of Matroska, found through the SeekHead.
+bool findMp4Index(int fd, qint64 size, QPair<qint64, qint64>* region);
+bool findMkvIndex(int fd, qint64 size, QPair<qint64, qint64>* region);
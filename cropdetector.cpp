@@ -0,0 +1,165 @@
+#include "cropdetector.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QMutexLocker>
+
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include "analysiscache.h"
+#include "fileidentity.h"
+#include "lumaplane.h"
+
+#define KIND "crop"
+#define SAMPLES 24
+// sampled between these fractions of the file, past logos and credits
+#define SAMPLE_START 0.05
+#define SAMPLE_END 0.95
+// gives up on a sample that doesn't decode within this many packets
+#define MAX_PACKETS 256
+
+CropDetector::CropDetector(AnalysisCache* cache, QObject* parent)
+    : BackgroundWorker(parent)
+    , cache(cache)
+{
+}
+
+CropDetector::~CropDetector()
+{
+    stop();
+}
+
+Letterbox CropDetector::load(quint64 identity) const
+{
+    if (identity == 0) {
+        return Letterbox();
+    }
+    QJsonObject crop = cache->load(identity, KIND);
+    return Letterbox { crop.value("left").toInt(), crop.value("top").toInt(), crop.value("right").toInt(), crop.value("bottom").toInt() };
+}
+
+CropDetector::Stats CropDetector::stats() const
+{
+    QMutexLocker locker(&mutex);
+    return counters;
+}
+
+void CropDetector::process(const QString& file)
+{
+    quint64 identity = fileIdentity(file);
+    if (identity == 0 || cache->contains(identity, KIND)) {
+        return;
+    }
+    AVFormatContext* format = nullptr;
+    if (avformat_open_input(&format, QFile::encodeName(file).constData(), nullptr, nullptr) < 0) {
+        return;
+    }
+    const AVCodec* codec = nullptr;
+    int streamIndex = -1;
+    if (avformat_find_stream_info(format, nullptr) >= 0) {
+        streamIndex = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    }
+    // cover art isn't a video, and without a duration there's nothing to spread samples over
+    if (streamIndex < 0 || (format->streams[streamIndex]->disposition & AV_DISPOSITION_ATTACHED_PIC) || format->duration <= 0) {
+        avformat_close_input(&format);
+        return;
+    }
+    for (unsigned i = 0; i < format->nb_streams; ++i) {
+        format->streams[i]->discard = (int)i == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+    AVStream* stream = format->streams[streamIndex];
+    AVCodecContext* decoder = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(decoder, stream->codecpar);
+    // a seek lands on a keyframe, the first frame out is all that's needed.
+    // Full resolution, the bars are measured in its pixels.
+    decoder->thread_count = 1;
+    decoder->skip_frame = AVDISCARD_NONREF;
+    decoder->skip_loop_filter = AVDISCARD_ALL;
+    decoder->flags2 |= AV_CODEC_FLAG2_FAST;
+    if (avcodec_open2(decoder, codec, nullptr) < 0) {
+        avcodec_free_context(&decoder);
+        avformat_close_input(&format);
+        return;
+    }
+
+    LetterboxScanner scanner;
+    std::vector<uchar> scratch;
+    QElapsedTimer timer;
+    timer.start();
+
+    // false for frames the scanner can't read
+    auto scan = [&](AVFrame* frame) {
+        int stride;
+        const uchar* luma = lumaPlane(frame, scratch, &stride);
+        if (!luma) {
+            return false;
+        }
+        scanner.process(luma, frame->width, frame->height, stride);
+        return true;
+    };
+
+    const qint64 startTime = format->start_time != AV_NOPTS_VALUE ? format->start_time : 0;
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    bool ok = true;
+    int sampled = 0;
+    for (int i = 0; ok && i < SAMPLES; ++i) {
+        const double fraction = SAMPLE_START + (SAMPLE_END - SAMPLE_START) * (i + 0.5) / SAMPLES;
+        const qint64 target = av_rescale_q(startTime + (qint64)(format->duration * fraction), AV_TIME_BASE_Q, stream->time_base);
+        if (av_seek_frame(format, streamIndex, target, AVSEEK_FLAG_BACKWARD) < 0) {
+            break;
+        }
+        avcodec_flush_buffers(decoder);
+        bool decoded = false;
+        for (int packets = 0; !decoded && packets < MAX_PACKETS && av_read_frame(format, packet) >= 0; ++packets) {
+            if (!keepGoing()) {
+                ok = false;
+                av_packet_unref(packet);
+                break;
+            }
+            if (packet->stream_index == streamIndex && avcodec_send_packet(decoder, packet) >= 0) {
+                while (!decoded && avcodec_receive_frame(decoder, frame) >= 0) {
+                    decoded = true;
+                    if (!scan(frame)) {
+                        ok = false;
+                    }
+                    av_frame_unref(frame);
+                }
+            }
+            av_packet_unref(packet);
+        }
+        if (decoded) {
+            sampled++;
+        }
+    }
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&decoder);
+    avformat_close_input(&format);
+    if (!ok || sampled == 0) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        counters.filesAnalyzed++;
+        counters.framesSampled += sampled;
+        counters.secondsSpent += timer.nsecsElapsed() / 1e9;
+    }
+    // files without bars are kept too, so they aren't sampled again
+    const Letterbox bars = scanner.bars();
+    cache->store(identity, KIND, QJsonObject {
+                                     { "left", bars.left },
+                                     { "top", bars.top },
+                                     { "right", bars.right },
+                                     { "bottom", bars.bottom },
+                                     { "frames", scanner.frames() },
+                                 });
+    emit detected(file, identity);
+}
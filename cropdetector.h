@@ -0,0 +1,38 @@
+#pragma once
+
+#include "backgroundworker.h"
+#include "letterbox.h"
+
+class AnalysisCache;
+
+// Samples frames spread across queued files on an idle priority thread and
+// finds their black bars, so the crop is known before playback starts and
+// nothing has to look at the frames while they play. Results are kept in
+// the analysis cache.
+class CropDetector : public BackgroundWorker
+{
+    Q_OBJECT
+public:
+    struct Stats {
+        int filesAnalyzed = 0;
+        int framesSampled = 0;
+        double secondsSpent = 0;
+    };
+
+    CropDetector(AnalysisCache* cache, QObject* parent = nullptr);
+    ~CropDetector();
+
+    // null when the file wasn't analyzed yet or has no bars
+    Letterbox load(quint64 identity) const;
+    Stats stats() const;
+
+signals:
+    void detected(const QString& file, quint64 identity);
+
+protected:
+    void process(const QString& file) override;
+
+private:
+    AnalysisCache* cache;
+    Stats counters;
+};
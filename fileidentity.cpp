@@ -0,0 +1,70 @@
+#include "fileidentity.h"
+
+#include <QFile>
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SAMPLE_BYTES (16 * 1024)
+
+static inline quint64 mix(quint64 h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+quint64 hash64(const void* data, size_t length, quint64 seed)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    quint64 h = seed ^ (length * 0x9e3779b97f4a7c15ULL);
+    while (length >= 8) {
+        quint64 word;
+        memcpy(&word, p, 8);
+        h = (h ^ mix(word)) * 0x9e3779b97f4a7c15ULL;
+        p += 8;
+        length -= 8;
+    }
+    quint64 tail = 0;
+    memcpy(&tail, p, length);
+    h = (h ^ mix(tail)) * 0x9e3779b97f4a7c15ULL;
+    return mix(h);
+}
+
+quint64 fileIdentity(const QString& path)
+{
+    const QByteArray name = QFile::encodeName(path);
+    quint64 h = hash64(name.constData(), name.size());
+    int fd = open(name.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return h;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0) {
+        quint64 size = st.st_size;
+        h = hash64(&size, sizeof(size), h);
+        char buffer[SAMPLE_BYTES];
+        ssize_t got = pread(fd, buffer, sizeof(buffer), 0);
+        if (got > 0) {
+            h = hash64(buffer, got, h);
+        }
+        if (st.st_size > 2 * SAMPLE_BYTES) {
+            got = pread(fd, buffer, sizeof(buffer), st.st_size - SAMPLE_BYTES);
+            if (got > 0) {
+                h = hash64(buffer, got, h);
+            }
+        }
+    }
+    close(fd);
+    return h;
+}
+
+QString fileIdentityString(quint64 identity)
+{
+    return QString("%1").arg(identity, 16, 16, QChar('0'));
+}
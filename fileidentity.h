@@ -0,0 +1,14 @@
+#pragma once
+
+#include <QString>
+
+#include <cstddef>
+#include <cstdint>
+
+// Identifies a file by path, size and a hash of its first and last bytes,
+// so renamed copies of a file don't collide and replaced files don't match.
+// Reads at most a few pages, cheap enough to call right before playback.
+quint64 fileIdentity(const QString& path);
+QString fileIdentityString(quint64 identity);
+
+quint64 hash64(const void* data, size_t length, quint64 seed = 0);
@@ -0,0 +1,234 @@
+#include "fingerprint.h"
+
+#include <QtAlgorithms>
+#include <QtMath>
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define LOW_HZ 300.0
+#define HIGH_HZ 2000.0
+// offsets need this many exact hash matches to be taken seriously
+#define MIN_VOTES 6
+// hashes that occur more often than this in one fingerprint, silence and
+// hum, don't vote
+#define MAX_OCCURRENCES 8
+// hashes averaged for the bit error rate, about a second
+#define SMOOTHING 16
+// out of 32, unrelated audio averages 16
+#define MAX_BIT_ERRORS 11
+// a louder line of dialogue doesn't end a stretch, about two seconds
+#define MAX_GAP 43
+
+Fingerprinter::Fingerprinter()
+    : window(FrameSize)
+    , cosines(FrameSize)
+    , sines(FrameSize)
+    , reversed(FrameSize)
+    , real(FrameSize)
+    , imaginary(FrameSize)
+    , power(FrameSize / 2)
+{
+    for (int i = 0; i < FrameSize; ++i) {
+        window[i] = 0.5 - 0.5 * qCos(2 * M_PI * i / FrameSize);
+        int r = 0;
+        for (int bit = 1, j = i; bit < FrameSize; bit <<= 1, j >>= 1) {
+            r = (r << 1) | (j & 1);
+        }
+        reversed[i] = r;
+    }
+    for (int half = 1; half < FrameSize; half <<= 1) {
+        for (int k = 0; k < half; ++k) {
+            cosines[half + k] = qCos(M_PI * k / half);
+            sines[half + k] = -qSin(M_PI * k / half);
+        }
+    }
+    // logarithmically spaced, like pitch
+    for (int band = 0; band <= Bands; ++band) {
+        const double hz = LOW_HZ * qPow(HIGH_HZ / LOW_HZ, (double)band / Bands);
+        bandEdges[band] = qRound(hz * FrameSize / SampleRate);
+    }
+}
+
+void Fingerprinter::process(const float* samples, qint64 count)
+{
+    pending.insert(pending.end(), samples, samples + count);
+    size_t used = 0;
+    while (pending.size() - used >= FrameSize) {
+        frame(pending.data() + used);
+        used += Hop;
+    }
+    pending.erase(pending.begin(), pending.begin() + used);
+}
+
+void Fingerprinter::frame(const float* samples)
+{
+    int i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= FrameSize; i += 4) {
+        _mm_storeu_ps(real.data() + i, _mm_mul_ps(_mm_loadu_ps(samples + i), _mm_loadu_ps(window.data() + i)));
+    }
+#endif
+    for (; i < FrameSize; ++i) {
+        real[i] = samples[i] * window[i];
+    }
+    // in place radix 2, after putting the input in bit reversed order
+    for (i = 0; i < FrameSize; ++i) {
+        imaginary[i] = 0;
+        if (reversed[i] > i) {
+            std::swap(real[i], real[reversed[i]]);
+        }
+    }
+    for (int size = 2; size <= FrameSize; size <<= 1) {
+        const int half = size / 2;
+        const float* c = cosines.data() + half;
+        const float* s = sines.data() + half;
+        for (int start = 0; start < FrameSize; start += size) {
+            float* topRe = real.data() + start;
+            float* topIm = imaginary.data() + start;
+            float* bottomRe = topRe + half;
+            float* bottomIm = topIm + half;
+            int k = 0;
+#ifdef __SSE2__
+            // four butterflies at a time from the third stage on
+            for (; k + 4 <= half; k += 4) {
+                const __m128 vc = _mm_loadu_ps(c + k);
+                const __m128 vs = _mm_loadu_ps(s + k);
+                const __m128 bre = _mm_loadu_ps(bottomRe + k);
+                const __m128 bim = _mm_loadu_ps(bottomIm + k);
+                const __m128 re = _mm_sub_ps(_mm_mul_ps(bre, vc), _mm_mul_ps(bim, vs));
+                const __m128 im = _mm_add_ps(_mm_mul_ps(bre, vs), _mm_mul_ps(bim, vc));
+                const __m128 tre = _mm_loadu_ps(topRe + k);
+                const __m128 tim = _mm_loadu_ps(topIm + k);
+                _mm_storeu_ps(bottomRe + k, _mm_sub_ps(tre, re));
+                _mm_storeu_ps(bottomIm + k, _mm_sub_ps(tim, im));
+                _mm_storeu_ps(topRe + k, _mm_add_ps(tre, re));
+                _mm_storeu_ps(topIm + k, _mm_add_ps(tim, im));
+            }
+#endif
+            for (; k < half; ++k) {
+                const float re = bottomRe[k] * c[k] - bottomIm[k] * s[k];
+                const float im = bottomRe[k] * s[k] + bottomIm[k] * c[k];
+                bottomRe[k] = topRe[k] - re;
+                bottomIm[k] = topIm[k] - im;
+                topRe[k] += re;
+                topIm[k] += im;
+            }
+        }
+    }
+    i = 0;
+#ifdef __SSE2__
+    for (; i + 4 <= FrameSize / 2; i += 4) {
+        __m128 re = _mm_loadu_ps(real.data() + i);
+        __m128 im = _mm_loadu_ps(imaginary.data() + i);
+        _mm_storeu_ps(power.data() + i, _mm_add_ps(_mm_mul_ps(re, re), _mm_mul_ps(im, im)));
+    }
+#endif
+    for (; i < FrameSize / 2; ++i) {
+        power[i] = real[i] * real[i] + imaginary[i] * imaginary[i];
+    }
+
+    float energy[Bands];
+    for (int band = 0; band < Bands; ++band) {
+        float sum = 0;
+        for (int bin = bandEdges[band]; bin < qMax(bandEdges[band] + 1, bandEdges[band + 1]); ++bin) {
+            sum += power[bin];
+        }
+        energy[band] = sum;
+    }
+    for (int band = 0; band < Bands - 1; ++band) {
+        differences[band] = energy[band] - energy[band + 1];
+    }
+    if (hasPrevious) {
+        quint32 hash = 0;
+        int band = 0;
+#ifdef __SSE2__
+        // four bits at a time, from the signs of the change
+        const __m128 zero = _mm_setzero_ps();
+        for (; band + 4 <= Bands - 1; band += 4) {
+            __m128 change = _mm_sub_ps(_mm_loadu_ps(differences + band), _mm_loadu_ps(previous + band));
+            hash |= (quint32)_mm_movemask_ps(_mm_cmpgt_ps(change, zero)) << band;
+        }
+#endif
+        for (; band < Bands - 1; ++band) {
+            if (differences[band] - previous[band] > 0) {
+                hash |= 1u << band;
+            }
+        }
+        found.push_back(hash);
+    }
+    memcpy(previous, differences, sizeof(previous));
+    hasPrevious = true;
+}
+
+FingerprintMatch matchFingerprints(const quint32* a, int countA, const quint32* b, int countB)
+{
+    FingerprintMatch match;
+    if (countA < SMOOTHING || countB < SMOOTHING) {
+        return match;
+    }
+    // every offset votes with the hashes that line up exactly at it
+    std::vector<std::pair<quint32, int>> sorted(countB);
+    for (int i = 0; i < countB; ++i) {
+        sorted[i] = { b[i], i };
+    }
+    std::sort(sorted.begin(), sorted.end());
+    std::vector<int> votes(countA + countB);
+    for (int i = 0; i < countA; ++i) {
+        auto range = std::equal_range(sorted.begin(), sorted.end(), std::make_pair(a[i], 0), [](const auto& x, const auto& y) {
+            return x.first < y.first;
+        });
+        if (range.second - range.first > MAX_OCCURRENCES) {
+            continue;
+        }
+        for (auto it = range.first; it != range.second; ++it) {
+            votes[it->second - i + countA]++;
+        }
+    }
+    const int best = std::max_element(votes.begin(), votes.end()) - votes.begin();
+    if (votes[best] < MIN_VOTES) {
+        return match;
+    }
+    const int offset = best - countA;
+
+    // the longest stretch at that offset where a second's worth of hashes
+    // stays close, short misses aside
+    const int first = qMax(0, -offset);
+    const int last = qMin(countA, countB - offset);
+    std::vector<int> errors(qMax(0, last - first));
+    for (int i = first; i < last; ++i) {
+        errors[i - first] = qPopulationCount(a[i] ^ b[i + offset]);
+    }
+    int sum = 0;
+    int runStart = -1;
+    int runEnd = -1;
+    for (int i = 0; i <= (int)errors.size(); ++i) {
+        bool close = false;
+        if (i < (int)errors.size()) {
+            sum += errors[i];
+            if (i >= SMOOTHING) {
+                sum -= errors[i - SMOOTHING];
+            }
+            close = i >= SMOOTHING - 1 && sum <= MAX_BIT_ERRORS * SMOOTHING;
+        }
+        if (close) {
+            if (runStart < 0) {
+                runStart = i - (SMOOTHING - 1);
+            }
+            runEnd = i + 1;
+        }
+        else if (runStart >= 0 && (i - runEnd > MAX_GAP || i == (int)errors.size())) {
+            if (runEnd - runStart > match.length) {
+                match.startA = first + runStart;
+                match.startB = first + runStart + offset;
+                match.length = runEnd - runStart;
+            }
+            runStart = -1;
+        }
+    }
+    return match;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <vector>
+
+// Hashes mono audio into 32 bit subfingerprints, about 21 a second. Each
+// bit is the sign of how the energy difference of two neighbouring bands
+// between 300 Hz and 2 kHz changed since the previous frame, which survives
+// re-encoding, level changes and mixing in a little dialogue.
+class Fingerprinter
+{
+public:
+    static const int SampleRate = 11025;
+    static const int Hop = 512;
+
+    Fingerprinter();
+
+    void process(const float* samples, qint64 count);
+    const std::vector<quint32>& hashes() const { return found; }
+
+private:
+    static const int FrameSize = 2048;
+    static const int Bands = 33;
+
+    std::vector<float> window;
+    // the twiddles of each FFT stage in a row, those of the stage combining
+    // halves of h at [h, 2h), so the butterflies load them four at a time
+    std::vector<float> cosines;
+    std::vector<float> sines;
+    std::vector<int> reversed;
+    // the first bin of each band and the one past the last
+    int bandEdges[Bands + 1];
+    std::vector<float> pending;
+    std::vector<float> real;
+    std::vector<float> imaginary;
+    std::vector<float> power;
+    // energy differences of neighbouring bands
+    float differences[Bands - 1];
+    float previous[Bands - 1];
+    bool hasPrevious = false;
+    std::vector<quint32> found;
+
+    void frame(const float* samples);
+};
+
+// Where two fingerprints share audio: the longest stretch that lines up at
+// the offset most exact hash matches agree on.
+struct FingerprintMatch {
+    int startA = 0;
+    int startB = 0;
+    // 0 when nothing matched
+    int length = 0;
+};
+
+FingerprintMatch matchFingerprints(const quint32* a, int countA, const quint32* b, int countB);
@@ -0,0 +1,115 @@
+#include "frameexporter.h"
+
+#include <QDir>
+#include <QImage>
+#include <QImageWriter>
+#include <QMutexLocker>
+
+#include "backgroundworker.h"
+#include "headlessdecoder.h"
+
+FrameExporter::FrameExporter(QObject* parent)
+    : QThread(parent)
+    , done(0)
+    , written(0)
+{
+    // leave a core for playback
+    int threads = qMax(1, QThread::idealThreadCount() - 1);
+    encoders.setMaxThreadCount(threads);
+    encoders.setThreadPriority(QThread::LowPriority);
+    queueSlots.release(threads * 2);
+}
+
+FrameExporter::~FrameExporter()
+{
+    cancel();
+    wait();
+}
+
+QStringList FrameExporter::formats()
+{
+    QStringList list;
+    const auto supported = QImageWriter::supportedImageFormats();
+    for (const char* format : { "png", "jpg", "webp" }) {
+        if (supported.contains(format)) {
+            list << format;
+        }
+    }
+    return list;
+}
+
+QList<double> FrameExporter::intervalTimes(double from, double to, double step)
+{
+    QList<double> times;
+    for (double t = from; step > 0 && t <= to; t += step) {
+        times << t;
+    }
+    return times;
+}
+
+bool FrameExporter::exportFrames(const Job& newJob)
+{
+    if (isRunning()) {
+        return false;
+    }
+    job = newJob;
+    cancelled = false;
+    done = 0;
+    written = 0;
+    start(QThread::IdlePriority);
+    return true;
+}
+
+void FrameExporter::cancel()
+{
+    QMutexLocker locker(&mutex);
+    cancelled = true;
+    if (decoder) {
+        decoder->abort();
+    }
+}
+
+void FrameExporter::run()
+{
+    setIdleIoPriority();
+    QDir().mkpath(job.directory);
+
+    HeadlessDecoder grabber;
+    {
+        QMutexLocker locker(&mutex);
+        if (cancelled) {
+            emit finished(0, job.directory);
+            return;
+        }
+        decoder = &grabber;
+    }
+    const int total = job.times.count();
+    const QByteArray format = job.format.toLatin1();
+    grabber.grabFrames(job.file, job.times, [&](double time, const QImage& frame) {
+        queueSlots.acquire();
+        int ms = time * 1000;
+        QString name = QString("%1-%2-%3-%4.%5.%6")
+                           .arg(job.baseName)
+                           .arg(ms / 3600000, 2, 10, QChar('0'))
+                           .arg(ms / 60000 % 60, 2, 10, QChar('0'))
+                           .arg(ms / 1000 % 60, 2, 10, QChar('0'))
+                           .arg(ms % 1000, 3, 10, QChar('0'))
+                           .arg(job.format);
+        const QString path = QDir(job.directory).filePath(name);
+        // the image still points into mpv's buffer, it's freed with the
+        // last copy once the encoder is done
+        encoders.start([=] {
+            if (frame.save(path, format.constData(), job.quality)) {
+                written++;
+            }
+            emit progress(++done, total);
+            queueSlots.release();
+        });
+    });
+    encoders.waitForDone();
+    {
+        QMutexLocker locker(&mutex);
+        decoder = nullptr;
+    }
+    emit finished(written, job.directory);
+}
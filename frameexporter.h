@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QList>
+#include <QMutex>
+#include <QSemaphore>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+#include <QThreadPool>
+
+#include <atomic>
+
+class HeadlessDecoder;
+
+// Writes frames of a file out as images. A headless mpv grabs them on an idle
+// priority thread while a low priority pool sized to the machine encodes
+// them, so neither competes with playback.
+class FrameExporter : public QThread
+{
+    Q_OBJECT
+public:
+    struct Job {
+        QString file;
+        // seconds, in order
+        QList<double> times;
+        QString directory;
+        QString baseName;
+        QString format = "png";
+        int quality = 90;
+    };
+
+    FrameExporter(QObject* parent = nullptr);
+    ~FrameExporter();
+
+    static QStringList formats();
+    static QList<double> intervalTimes(double from, double to, double step);
+
+    // false while another export is running
+    bool exportFrames(const Job& job);
+    void cancel();
+
+signals:
+    void progress(int done, int total);
+    void finished(int written, const QString& directory);
+
+protected:
+    void run() override;
+
+private:
+    Job job;
+    QMutex mutex;
+    HeadlessDecoder* decoder = nullptr;
+    bool cancelled = false;
+    QThreadPool encoders;
+    // caps grabbed frames waiting for an encoder
+    QSemaphore queueSlots;
+    std::atomic_int done;
+    std::atomic_int written;
+};
@@ -0,0 +1,111 @@
+#include "framering.h"
+
+#include <QtMath>
+
+// microseconds, rounded so the same frame reported twice maps to one key
+qint64 FrameRing::key(double time)
+{
+    return qRound64(time * 1000000);
+}
+
+qint64 FrameRing::tolerance() const
+{
+    return key(duration * 1.5);
+}
+
+void FrameRing::setLimit(qint64 bytes)
+{
+    limit = bytes;
+    while (used > limit && !frames.isEmpty()) {
+        used -= frames.last().sizeInBytes();
+        frames.erase(std::prev(frames.end()));
+    }
+}
+
+void FrameRing::setFrameDuration(double seconds)
+{
+    if (seconds > 0) {
+        duration = seconds;
+    }
+}
+
+bool FrameRing::insert(double time, const QImage& frame, double anchor)
+{
+    const qint64 k = key(time);
+    const qint64 size = frame.sizeInBytes();
+    if (frame.isNull() || size > limit) {
+        return false;
+    }
+    auto existing = frames.find(k);
+    if (existing != frames.end()) {
+        used -= existing->sizeInBytes();
+        frames.erase(existing);
+    }
+    const qint64 a = key(anchor);
+    while (used + size > limit) {
+        auto first = frames.begin();
+        auto last = std::prev(frames.end());
+        auto farthest = qAbs(first.key() - a) > qAbs(last.key() - a) ? first : last;
+        if (qAbs(farthest.key() - a) < qAbs(k - a)) {
+            return false;
+        }
+        used -= farthest->sizeInBytes();
+        frames.erase(farthest);
+    }
+    frames.insert(k, frame);
+    used += size;
+    return true;
+}
+
+bool FrameRing::contains(double time) const
+{
+    return frames.contains(key(time));
+}
+
+QImage FrameRing::frame(double time) const
+{
+    return frames.value(key(time));
+}
+
+double FrameRing::before(double time) const
+{
+    const qint64 k = key(time);
+    auto it = frames.lowerBound(k);
+    if (it == frames.begin()) {
+        return -1;
+    }
+    --it;
+    return k - it.key() <= tolerance() ? it.key() / 1e6 : -1;
+}
+
+double FrameRing::after(double time) const
+{
+    const qint64 k = key(time);
+    auto it = frames.upperBound(k);
+    if (it == frames.end()) {
+        return -1;
+    }
+    return it.key() - k <= tolerance() ? it.key() / 1e6 : -1;
+}
+
+double FrameRing::runStart(double time) const
+{
+    auto it = frames.constFind(key(time));
+    if (it == frames.constEnd()) {
+        return time;
+    }
+    while (it != frames.constBegin()) {
+        auto previous = std::prev(it);
+        if (it.key() - previous.key() > tolerance()) {
+            break;
+        }
+        it = previous;
+    }
+    return it.key() / 1e6;
+}
+
+void FrameRing::clear()
+{
+    frames.clear();
+    used = 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <QImage>
+#include <QMap>
+
+// Frames already shown, keyed by time, up to a byte limit. Frames count as
+// neighbours only when no more than one frame duration lies between them,
+// so a run never skips over frames that weren't captured.
+class FrameRing
+{
+public:
+    void setLimit(qint64 bytes);
+    qint64 memoryLimit() const { return limit; }
+    void setFrameDuration(double seconds);
+    double frameDuration() const { return duration; }
+
+    // Evicts the frames farthest from anchor to make room. Returns false
+    // when the frame itself would be the farthest.
+    bool insert(double time, const QImage& frame, double anchor);
+    bool contains(double time) const;
+    QImage frame(double time) const;
+    // the neighbouring frame, -1 when it isn't in the ring
+    double before(double time) const;
+    double after(double time) const;
+    // first frame of the run time belongs to
+    double runStart(double time) const;
+    void clear();
+
+    int count() const { return frames.count(); }
+    qint64 bytes() const { return used; }
+
+private:
+    QMap<qint64, QImage> frames;
+    qint64 limit = 0;
+    qint64 used = 0;
+    double duration = 1 / 24.0;
+
+    static qint64 key(double time);
+    qint64 tolerance() const;
+};
@@ -0,0 +1,405 @@
+#include "framestepper.h"
+
+#include <cstring>
+
+#include "mpvwidget.h"
+
+#define STEPPER_REPLY 0x5354
+#define STEPPER_TIME_REPLY 0x5355
+// how long a paused position has to stay put before prefetching
+#define SETTLE_MS 300
+#define STALL_MS 3000
+// cached frames behind the shown one that make another prefetch pointless
+#define PREFETCH_AHEAD_SECS 2.0
+
+FrameStepper::FrameStepper(MpvWidget* widget, QObject* parent)
+    : QObject(parent)
+    , widget(widget)
+    , mpv(widget->mpv)
+{
+    settleTimer.setSingleShot(true);
+    connect(&settleTimer, &QTimer::timeout, this, &FrameStepper::prefetch);
+    connect(widget, &MpvWidget::mpvEvent, this, &FrameStepper::onEvent);
+    connect(widget, &MpvWidget::frameCaptured, this, &FrameStepper::onFrameCaptured);
+    mpv_observe_property(mpv, STEPPER_REPLY, "pause", MPV_FORMAT_FLAG);
+}
+
+// the exact position, the widget only observes whole seconds
+void FrameStepper::observeTime(bool observe)
+{
+    if (!mpv || observe == observingTime) {
+        return;
+    }
+    observingTime = observe;
+    if (observe) {
+        // the current value comes right back
+        mpv_observe_property(mpv, STEPPER_TIME_REPLY, "time-pos", MPV_FORMAT_DOUBLE);
+    }
+    else {
+        mpv_unobserve_property(mpv, STEPPER_TIME_REPLY);
+    }
+}
+
+void FrameStepper::setMemoryLimit(qint64 bytes)
+{
+    ring.setLimit(bytes);
+    if (enabled == (bytes > 0)) {
+        return;
+    }
+    if (enabled) {
+        release();
+    }
+    enabled = bytes > 0;
+    if (!enabled) {
+        ring.clear();
+    }
+    setPaused(paused);
+}
+
+FrameStepper::Stats FrameStepper::stats() const
+{
+    Stats s = counters;
+    s.frames = ring.count();
+    s.bytes = ring.bytes();
+    return s;
+}
+
+void FrameStepper::command(const QVariantList& args)
+{
+    if (mpv) {
+        mpv::qt::command(mpv, args);
+    }
+}
+
+void FrameStepper::onEvent(mpv_event* event)
+{
+    switch (event->event_id) {
+    case MPV_EVENT_PROPERTY_CHANGE: {
+        if (event->reply_userdata != STEPPER_REPLY && event->reply_userdata != STEPPER_TIME_REPLY) {
+            break;
+        }
+        auto prop = (mpv_event_property*)event->data;
+        if (strcmp(prop->name, "time-pos") == 0 && prop->format == MPV_FORMAT_DOUBLE) {
+            onTime(*(double*)prop->data);
+        }
+        else if (strcmp(prop->name, "pause") == 0 && prop->format == MPV_FORMAT_FLAG) {
+            setPaused(*(int*)prop->data);
+        }
+        break;
+    }
+    case MPV_EVENT_START_FILE: {
+        // nothing cached belongs to the new file
+        settleTimer.stop();
+        state = Idle;
+        pendingSteps = 0;
+        prefetched.clear();
+        prefetchExhausted = -1;
+        ring.clear();
+        liveTime = -1;
+        heldTime = -1;
+        releaseOnRestart = false;
+        releaseOnFrame = false;
+        frameFresh = false;
+        pendingTime = -1;
+        widget->releaseFrame();
+        break;
+    }
+    case MPV_EVENT_FILE_LOADED: {
+        double fps = mpv::qt::get_property(mpv, "container-fps").toDouble();
+        if (fps > 0) {
+            ring.setFrameDuration(1 / fps);
+        }
+        break;
+    }
+    case MPV_EVENT_PLAYBACK_RESTART: {
+        if (state != Restoring) {
+            break;
+        }
+        state = Idle;
+        frameFresh = false;
+        pendingTime = -1;
+        if (releaseOnRestart) {
+            releaseOnRestart = false;
+            showLive();
+        }
+        if (pauseDeferred) {
+            pauseDeferred = false;
+            setPaused(paused);
+        }
+        runPendingSteps();
+        if (state == Idle && paused) {
+            settleTimer.start(SETTLE_MS);
+        }
+        break;
+    }
+    case MPV_EVENT_SHUTDOWN: {
+        settleTimer.stop();
+        enabled = false;
+        observingTime = false;
+        mpv = nullptr;
+        break;
+    }
+    default:;
+    }
+}
+
+void FrameStepper::setPaused(bool isPaused)
+{
+    paused = isPaused;
+    if (state == Prefetching || state == Restoring) {
+        // frame-step unpauses mpv for its one frame; the walk and the seek
+        // back finish first, PLAYBACK_RESTART catches up
+        pauseDeferred = true;
+        return;
+    }
+    if (!enabled) {
+        widget->setCaptureFrames(false);
+        observeTime(false);
+        return;
+    }
+    widget->setCaptureFrames(paused);
+    if (!paused) {
+        capturePending = false;
+        observeTime(false);
+        release();
+    }
+    else if (state == Idle) {
+        if (observingTime && liveTime >= 0) {
+            // mpv redraws the frame it stopped on, that's the first one cached
+            state = Capturing;
+            widget->update();
+        }
+        else {
+            // once its time is known
+            capturePending = true;
+            observeTime(true);
+        }
+    }
+}
+
+void FrameStepper::onFrameCaptured()
+{
+    if (state == Capturing) {
+        state = Idle;
+        ring.insert(liveTime, widget->capturedFrame(), liveTime);
+        runPendingSteps();
+        settleTimer.start(SETTLE_MS);
+        return;
+    }
+    frameFresh = true;
+    if (pendingTime >= 0) {
+        pair(pendingTime);
+    }
+}
+
+void FrameStepper::onTime(double time)
+{
+    if (state == Restoring) {
+        // still the frames walked through while prefetching
+        return;
+    }
+    if (state == Idle) {
+        liveTime = time;
+        if (capturePending) {
+            capturePending = false;
+            state = Capturing;
+            widget->update();
+            return;
+        }
+    }
+    if (!enabled || !paused) {
+        return;
+    }
+    // the new frame is rendered before mpv reports its time, but don't
+    // count on it
+    if (frameFresh) {
+        pair(time);
+    }
+    else {
+        pendingTime = time;
+    }
+}
+
+void FrameStepper::pair(double time)
+{
+    frameFresh = false;
+    pendingTime = -1;
+    const QImage& frame = widget->capturedFrame();
+    if (state == Prefetching) {
+        prefetched.append({ time, frame });
+        // a longer group of pictures than the ring holds
+        const bool full = (prefetched.count() + 1) * frame.sizeInBytes() > ring.memoryLimit();
+        if (prefetchAborted || full || time >= prefetchTarget - ring.frameDuration() / 2) {
+            finishPrefetch();
+        }
+        else {
+            settleTimer.start(STALL_MS);
+            command({ "frame-step" });
+        }
+        return;
+    }
+    if (state != Idle) {
+        return;
+    }
+    ring.insert(time, frame, time);
+    if (releaseOnFrame) {
+        releaseOnFrame = false;
+        widget->releaseFrame();
+    }
+}
+
+void FrameStepper::hold(double time)
+{
+    heldTime = time;
+    releaseOnFrame = false;
+    widget->holdFrame(ring.frame(time));
+    emit positionChanged(time);
+}
+
+void FrameStepper::showLive()
+{
+    heldTime = -1;
+    widget->releaseFrame();
+    emit positionChanged(liveTime);
+}
+
+void FrameStepper::stepForward()
+{
+    if (!enabled) {
+        command({ "frame-step" });
+        return;
+    }
+    if (state == Prefetching) {
+        // cut the walk short, the step follows once mpv is back
+        prefetchAborted = true;
+    }
+    if (state != Idle) {
+        pendingSteps++;
+        return;
+    }
+    step(true);
+}
+
+void FrameStepper::stepBackward()
+{
+    if (!enabled) {
+        command({ "frame-back-step" });
+        return;
+    }
+    if (state != Idle) {
+        pendingSteps--;
+        return;
+    }
+    step(false);
+}
+
+// true when the frame came from the ring
+bool FrameStepper::step(bool forward)
+{
+    const double current = heldTime >= 0 ? heldTime : liveTime;
+    const double next = current < 0 ? -1 : forward ? ring.after(current) : ring.before(current);
+    if (paused && next >= 0) {
+        if (qAbs(next - liveTime) < ring.frameDuration() / 2) {
+            showLive();
+        }
+        else {
+            hold(next);
+        }
+        counters.servedSteps++;
+        settleTimer.start(SETTLE_MS);
+        return true;
+    }
+    if (heldTime >= 0) {
+        // mpv steps from where it is, which isn't the frame on screen; keep
+        // showing that until the step arrives
+        command({ "seek", heldTime, "absolute+exact" });
+        liveTime = heldTime;
+        heldTime = -1;
+        releaseOnFrame = true;
+    }
+    command({ forward ? "frame-step" : "frame-back-step" });
+    counters.decodedSteps++;
+    return false;
+}
+
+void FrameStepper::runPendingSteps()
+{
+    while (pendingSteps != 0 && state == Idle) {
+        const bool forward = pendingSteps > 0;
+        pendingSteps += forward ? -1 : 1;
+        if (!step(forward)) {
+            pendingSteps = 0;
+        }
+    }
+}
+
+void FrameStepper::prefetch()
+{
+    if (state == Prefetching) {
+        // mpv never reported the frame, give up on this group of pictures
+        finishPrefetch();
+        return;
+    }
+    if (!enabled || !paused || state != Idle || liveTime < 0 || !ring.contains(liveTime)) {
+        return;
+    }
+    const double current = heldTime >= 0 ? heldTime : liveTime;
+    const double start = ring.runStart(current);
+    if (start < ring.frameDuration() || start == prefetchExhausted || current - start > PREFETCH_AHEAD_SECS) {
+        return;
+    }
+    // mpv walks through the frames before, what's on screen stays
+    releaseOnRestart = heldTime < 0;
+    if (heldTime < 0) {
+        heldTime = liveTime;
+        widget->holdFrame(ring.frame(liveTime));
+    }
+    state = Prefetching;
+    prefetchTarget = start;
+    prefetchAborted = false;
+    prefetched.clear();
+    frameFresh = false;
+    pendingTime = -1;
+    counters.prefetches++;
+    settleTimer.start(STALL_MS);
+    // keyframe seeks land on the keyframe before the target
+    command({ "seek", start - ring.frameDuration() / 2, "absolute+keyframes" });
+}
+
+void FrameStepper::finishPrefetch()
+{
+    settleTimer.stop();
+    const double anchor = heldTime >= 0 ? heldTime : liveTime;
+    bool progressed = false;
+    for (const auto& frame : std::as_const(prefetched)) {
+        if (ring.insert(frame.first, frame.second, anchor) && frame.first < prefetchTarget - ring.frameDuration() / 2) {
+            progressed = true;
+        }
+    }
+    if (!progressed) {
+        // the start of the file, or the ring is full
+        prefetchExhausted = prefetchTarget;
+    }
+    prefetched.clear();
+    state = Restoring;
+    command({ "seek", liveTime, "absolute+exact" });
+}
+
+void FrameStepper::release()
+{
+    pendingSteps = 0;
+    settleTimer.stop();
+    prefetched.clear();
+    if (state == Capturing) {
+        state = Idle;
+    }
+    if (state == Idle && heldTime < 0) {
+        return;
+    }
+    // carry on from the frame on screen
+    const double target = heldTime >= 0 ? heldTime : liveTime;
+    liveTime = target;
+    state = Restoring;
+    releaseOnRestart = true;
+    command({ "seek", target, "absolute+exact" });
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+
+#include <mpv/client.h>
+
+#include "framering.h"
+
+class MpvWidget;
+
+// Frame stepping that serves backward steps from a ring of frames captured
+// as they were rendered, instead of mpv's frame-back-step decoding from the
+// previous keyframe each time. While paused it walks the group of pictures
+// before the cached frames with the same mpv instance, holding the shown
+// frame on screen meanwhile.
+class FrameStepper : public QObject
+{
+    Q_OBJECT
+public:
+    struct Stats {
+        int frames = 0;
+        qint64 bytes = 0;
+        int servedSteps = 0;
+        int decodedSteps = 0;
+        int prefetches = 0;
+    };
+
+    FrameStepper(MpvWidget* widget, QObject* parent = nullptr);
+
+    // 0 falls back to plain mpv frame stepping
+    void setMemoryLimit(qint64 bytes);
+    void stepForward();
+    void stepBackward();
+    // hands control back to mpv at the frame on screen, before seeking or
+    // playing on
+    void release();
+    // mpv is moving the position itself, its frames aren't on screen
+    bool isBusy() const { return state != Idle; }
+    Stats stats() const;
+
+signals:
+    // a frame from the ring is on screen
+    void positionChanged(double time);
+
+private:
+    enum State {
+        Idle,
+        Capturing,
+        Prefetching,
+        Restoring,
+    };
+
+    MpvWidget* widget;
+    mpv_handle* mpv;
+    FrameRing ring;
+    QTimer settleTimer;
+    State state = Idle;
+    bool enabled = false;
+    bool paused = false;
+    double liveTime = -1;
+    double heldTime = -1;
+    // steps asked for while prefetching, negative is backwards
+    int pendingSteps = 0;
+    double prefetchTarget = -1;
+    double prefetchExhausted = -1;
+    bool prefetchAborted = false;
+    bool releaseOnRestart = false;
+    bool releaseOnFrame = false;
+    QList<QPair<double, QImage>> prefetched;
+    // a frame was rendered, or the time of one reported, and the other
+    // half hasn't arrived yet
+    bool frameFresh = false;
+    double pendingTime = -1;
+    // time-pos is only observed while paused, playback would report it for
+    // every frame
+    bool observingTime = false;
+    // paused, waiting for the time of the frame mpv stopped on
+    bool capturePending = false;
+    // pause changed while our own frame-steps and seeks were running
+    bool pauseDeferred = false;
+    Stats counters;
+
+    void onEvent(mpv_event* event);
+    void onFrameCaptured();
+    void onTime(double time);
+    void pair(double time);
+    void hold(double time);
+    void showLive();
+    bool step(bool forward);
+    void setPaused(bool paused);
+    void observeTime(bool observe);
+    void prefetch();
+    void finishPrefetch();
+    void runPendingSteps();
+    void command(const QVariantList& args);
+};
@@ -0,0 +1,265 @@
+#include "headlessdecoder.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <mpv/client.h>
+
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <poll.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "screenshot.h"
+
+#define READ_BYTES (256 * 1024)
+#define POLL_MS 50
+
+static mpv_handle* createHeadless()
+{
+    mpv_handle* mpv = mpv_create();
+    if (!mpv) {
+        return nullptr;
+    }
+    mpv_set_option_string(mpv, "config", "no");
+    mpv_set_option_string(mpv, "terminal", "no");
+    mpv_set_option_string(mpv, "load-scripts", "no");
+    mpv_set_option_string(mpv, "ytdl", "no");
+    mpv_set_option_string(mpv, "resume-playback", "no");
+    mpv_set_option_string(mpv, "sid", "no");
+    mpv_set_option_string(mpv, "audio-display", "no");
+    return mpv;
+}
+
+// false when the file ended or failed first
+static bool waitForEvent(mpv_handle* mpv, mpv_event_id id, const std::atomic_bool& aborted)
+{
+    while (!aborted) {
+        mpv_event* event = mpv_wait_event(mpv, POLL_MS / 1000.0);
+        if (event->event_id == id) {
+            return true;
+        }
+        if (event->event_id == MPV_EVENT_END_FILE || event->event_id == MPV_EVENT_SHUTDOWN) {
+            return false;
+        }
+    }
+    return false;
+}
+
+HeadlessDecoder::HeadlessDecoder()
+    : aborted(false)
+{
+    static std::atomic_int counter(0);
+    fifoPath = QDir::temp().filePath(QString("fastplayer-%1-%2.pcm").arg(getpid()).arg(counter++));
+
+    // mpv's writes fail with EPIPE instead of killing us when a decode is
+    // aborted and the reading end goes away first
+    static std::once_flag ignorePipe;
+    std::call_once(ignorePipe, [] {
+        signal(SIGPIPE, SIG_IGN);
+    });
+}
+
+HeadlessDecoder::~HeadlessDecoder()
+{
+    QFile::remove(fifoPath);
+}
+
+void HeadlessDecoder::abort()
+{
+    aborted = true;
+}
+
+bool HeadlessDecoder::decodeAudio(const QString& file, int sampleRate, int channels, const AudioCallback& callback, double start, double length)
+{
+    if (aborted) {
+        return false;
+    }
+    const QByteArray fifo = QFile::encodeName(fifoPath);
+    unlink(fifo.constData());
+    if (mkfifo(fifo.constData(), 0600) != 0) {
+        return false;
+    }
+    // non-blocking so opening doesn't wait for mpv to show up as the writer
+    int fd = open(fifo.constData(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    mpv_handle* mpv = createHeadless();
+    if (!mpv) {
+        close(fd);
+        return false;
+    }
+    mpv_set_option_string(mpv, "vid", "no");
+    mpv_set_option_string(mpv, "replaygain", "no");
+    mpv_set_option_string(mpv, "ao", "pcm");
+    mpv_set_option_string(mpv, "ao-pcm-file", fifo.constData());
+    mpv_set_option_string(mpv, "ao-pcm-waveheader", "no");
+    mpv_set_option_string(mpv, "audio-format", "float");
+    mpv_set_option_string(mpv, "audio-samplerate", QByteArray::number(sampleRate).constData());
+    mpv_set_option_string(mpv, "audio-channels", channels == 1 ? "mono" : "stereo");
+    mpv_set_option_string(mpv, "idle", "no");
+    if (start > 0) {
+        mpv_set_option_string(mpv, "start", QByteArray::number(start, 'f', 3).constData());
+    }
+    if (length > 0) {
+        mpv_set_option_string(mpv, "length", QByteArray::number(length, 'f', 3).constData());
+    }
+    if (mpv_initialize(mpv) < 0) {
+        mpv_terminate_destroy(mpv);
+        close(fd);
+        return false;
+    }
+    const QByteArray path = file.toUtf8();
+    const char* args[] = { "loadfile", path.constData(), nullptr };
+    mpv_command(mpv, args);
+
+    const int frameBytes = channels * sizeof(float);
+    std::vector<char> buffer(READ_BYTES);
+    size_t filled = 0;
+    bool ended = false;
+    bool failed = false;
+    bool writerSeen = false;
+    while (!aborted) {
+        pollfd p = { fd, POLLIN, 0 };
+        poll(&p, 1, POLL_MS);
+        ssize_t got = read(fd, buffer.data() + filled, buffer.size() - filled);
+        if (got > 0) {
+            writerSeen = true;
+            filled += got;
+            qint64 frames = filled / frameBytes;
+            if (frames > 0) {
+                callback(reinterpret_cast<const float*>(buffer.data()), frames);
+                size_t used = frames * frameBytes;
+                memmove(buffer.data(), buffer.data() + used, filled - used);
+                filled -= used;
+            }
+            continue;
+        }
+        // a FIFO also reads 0 before mpv opened it, it's only the end once
+        // data came through
+        if (got == 0 && writerSeen) {
+            break;
+        }
+        while (mpv_event* event = mpv_wait_event(mpv, 0)) {
+            if (event->event_id == MPV_EVENT_NONE) {
+                break;
+            }
+            if (event->event_id == MPV_EVENT_END_FILE) {
+                auto end = (mpv_event_end_file*)event->data;
+                failed = end->reason == MPV_END_FILE_REASON_ERROR;
+                ended = true;
+            }
+            else if (event->event_id == MPV_EVENT_SHUTDOWN) {
+                ended = true;
+            }
+        }
+        // audio output never opened, a file without audio or one mpv can't read
+        if (ended && !writerSeen) {
+            failed = true;
+            break;
+        }
+    }
+    close(fd);
+    mpv_terminate_destroy(mpv);
+    unlink(fifo.constData());
+    return !aborted && !failed && writerSeen;
+}
+
+bool HeadlessDecoder::grabFrames(const QString& file, const QList<double>& times, const FrameCallback& callback)
+{
+    if (aborted) {
+        return false;
+    }
+    mpv_handle* mpv = createHeadless();
+    if (!mpv) {
+        return false;
+    }
+    // frames still reach the null output, which is all screenshot-raw needs
+    mpv_set_option_string(mpv, "vo", "null");
+    mpv_set_option_string(mpv, "aid", "no");
+    mpv_set_option_string(mpv, "pause", "yes");
+    mpv_set_option_string(mpv, "hr-seek", "yes");
+    mpv_set_option_string(mpv, "keep-open", "always");
+    if (mpv_initialize(mpv) < 0) {
+        mpv_terminate_destroy(mpv);
+        return false;
+    }
+    const QByteArray path = file.toUtf8();
+    const char* args[] = { "loadfile", path.constData(), nullptr };
+    mpv_command(mpv, args);
+
+    // the first frame after loading
+    bool ok = waitForEvent(mpv, MPV_EVENT_PLAYBACK_RESTART, aborted);
+    for (int i = 0; ok && i < times.count(); ++i) {
+        const QByteArray time = QByteArray::number(times.at(i), 'f', 3);
+        const char* seek[] = { "seek", time.constData(), "absolute+exact", nullptr };
+        if (mpv_command(mpv, seek) < 0) {
+            continue;
+        }
+        ok = waitForEvent(mpv, MPV_EVENT_PLAYBACK_RESTART, aborted);
+        if (ok) {
+            QImage frame = grabFrame(mpv, "video");
+            if (!frame.isNull()) {
+                callback(times.at(i), frame);
+            }
+        }
+    }
+    mpv_terminate_destroy(mpv);
+    return ok && !aborted;
+}
+
+bool HeadlessDecoder::encodeSegment(const QString& file, double start, double end, const QString& output, const QString& format, const ProgressCallback& callback)
+{
+    if (aborted || end <= start) {
+        return false;
+    }
+    mpv_handle* mpv = createHeadless();
+    if (!mpv) {
+        return false;
+    }
+    const QByteArray outputPath = output.toUtf8();
+    mpv_set_option_string(mpv, "o", outputPath.constData());
+    if (!format.isEmpty()) {
+        mpv_set_option_string(mpv, "of", format.toUtf8().constData());
+    }
+    mpv_set_option_string(mpv, "start", QByteArray::number(start, 'f', 3).constData());
+    mpv_set_option_string(mpv, "end", QByteArray::number(end, 'f', 3).constData());
+    mpv_set_option_string(mpv, "idle", "no");
+    if (mpv_initialize(mpv) < 0) {
+        mpv_terminate_destroy(mpv);
+        return false;
+    }
+    const QByteArray path = file.toUtf8();
+    const char* args[] = { "loadfile", path.constData(), nullptr };
+    mpv_command(mpv, args);
+
+    bool ok = false;
+    bool ended = false;
+    while (!aborted && !ended) {
+        mpv_event* event = mpv_wait_event(mpv, POLL_MS / 1000.0);
+        if (event->event_id == MPV_EVENT_END_FILE) {
+            auto endFile = (mpv_event_end_file*)event->data;
+            ok = endFile->reason == MPV_END_FILE_REASON_EOF;
+            ended = true;
+        }
+        else if (event->event_id == MPV_EVENT_SHUTDOWN) {
+            ended = true;
+        }
+        else if (event->event_id == MPV_EVENT_NONE) {
+            double position = 0;
+            if (mpv_get_property(mpv, "time-pos", MPV_FORMAT_DOUBLE, &position) >= 0) {
+                callback((position - start) / (end - start));
+            }
+        }
+    }
+    // finishes writing the file
+    mpv_terminate_destroy(mpv);
+    return ok && !aborted;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QImage>
+#include <QList>
+#include <QString>
+
+#include <atomic>
+#include <functional>
+
+// Decodes a file with a private, windowless mpv instance as fast as the CPU
+// allows, so analysis and export never touch the playing instance. Audio
+// comes out of mpv's pcm output through a FIFO as interleaved float samples,
+// video frames through screenshot-raw after exact seeks. Encoding uses
+// mpv's encoding mode.
+class HeadlessDecoder
+{
+public:
+    using AudioCallback = std::function<void(const float* samples, qint64 frames)>;
+    using FrameCallback = std::function<void(double time, const QImage& frame)>;
+    using ProgressCallback = std::function<void(double fraction)>;
+
+    HeadlessDecoder();
+    ~HeadlessDecoder();
+
+    // Blocks until the file is decoded, or `length` seconds of it from
+    // `start` when length is positive. Returns false on errors and when
+    // abort() was called.
+    bool decodeAudio(const QString& file, int sampleRate, int channels, const AudioCallback& callback, double start = 0, double length = 0);
+    // the frame shown at each of the times, in order
+    bool grabFrames(const QString& file, const QList<double>& times, const FrameCallback& callback);
+    // re-encodes start to end of file into output, with the encoders mpv
+    // picks for the output's format; that is the muxer named by format,
+    // or the one the output's extension asks for when it is empty
+    bool encodeSegment(const QString& file, double start, double end, const QString& output, const QString& format, const ProgressCallback& callback);
+    // safe to call from any thread
+    void abort();
+
+private:
+    std::atomic_bool aborted;
+    QString fifoPath;
+};
@@ -0,0 +1,265 @@
+#include "introdetector.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QMutexLocker>
+
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include "analysiscache.h"
+#include "backgroundworker.h"
+#include "fileidentity.h"
+#include "fingerprint.h"
+#include "headlessdecoder.h"
+
+#define KIND "fingerprint"
+// how much of each end is fingerprinted
+#define HEAD_SECS 360.0
+#define TAIL_SECS 360.0
+// anything shorter isn't an episode
+#define MIN_DURATION_SECS 600.0
+// shorter matches are a shared sound, not an intro
+#define MIN_SEGMENT_SECS 15.0
+// episodes compared on either side of the file in the season's order
+#define NEIGHBOURS 3
+
+namespace {
+struct Fingerprint {
+    std::vector<quint32> head;
+    std::vector<quint32> tail;
+    double tailStart = 0;
+};
+}
+
+static bool loadFingerprint(AnalysisCache* cache, const QString& file, Fingerprint& out)
+{
+    quint64 identity = fileIdentity(file);
+    if (identity == 0) {
+        return false;
+    }
+    const QJsonObject header = cache->load(identity, KIND);
+    const int head = header.value("head").toInt();
+    const int tail = header.value("tail").toInt();
+    if (head + tail == 0) {
+        return false;
+    }
+    QFile data(cache->dataPath(identity, KIND));
+    if (!data.open(QIODevice::ReadOnly) || data.size() != (qint64)(head + tail) * 4) {
+        return false;
+    }
+    const QByteArray bytes = data.readAll();
+    const quint32* hashes = reinterpret_cast<const quint32*>(bytes.constData());
+    out.head.assign(hashes, hashes + head);
+    out.tail.assign(hashes + head, hashes + head + tail);
+    out.tailStart = header.value("tail-start").toDouble();
+    return true;
+}
+
+static double mediaDuration(const QString& file)
+{
+    AVFormatContext* format = nullptr;
+    if (avformat_open_input(&format, QFile::encodeName(file).constData(), nullptr, nullptr) < 0) {
+        return 0;
+    }
+    double duration = 0;
+    if (avformat_find_stream_info(format, nullptr) >= 0 && format->duration > 0) {
+        duration = (double)format->duration / AV_TIME_BASE;
+    }
+    avformat_close_input(&format);
+    return duration;
+}
+
+IntroDetector::IntroDetector(AnalysisCache* cache, QObject* parent)
+    : QObject(parent)
+    , cache(cache)
+{
+    // half the machine, playback and the other scanners need the rest
+    pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+    pool.setThreadPriority(QThread::IdlePriority);
+    matcher.setMaxThreadCount(1);
+}
+
+IntroDetector::~IntroDetector()
+{
+    {
+        QMutexLocker locker(&mutex);
+        stopping = true;
+        for (HeadlessDecoder* decoder : std::as_const(decoders)) {
+            decoder->abort();
+        }
+        condition.wakeAll();
+    }
+    pool.clear();
+    pool.waitForDone();
+    matcher.clear();
+    matcher.waitForDone();
+}
+
+void IntroDetector::setFiles(const QStringList& files)
+{
+    QMutexLocker locker(&mutex);
+    for (const QString& file : files) {
+        if (queued.contains(file)) {
+            continue;
+        }
+        queued.insert(file);
+        pool.start([=] {
+            fingerprint(file);
+            // queued again by the next update if its fingerprint is missing,
+            // evicted from the cache or never made it there
+            QMutexLocker locker(&mutex);
+            queued.remove(file);
+        });
+    }
+}
+
+void IntroDetector::setPaused(bool p)
+{
+    QMutexLocker locker(&mutex);
+    paused = p;
+    condition.wakeAll();
+}
+
+IntroDetector::Stats IntroDetector::stats() const
+{
+    QMutexLocker locker(&mutex);
+    return counters;
+}
+
+bool IntroDetector::waitWhilePaused()
+{
+    QMutexLocker locker(&mutex);
+    while (paused && !stopping) {
+        condition.wait(&mutex);
+    }
+    return !stopping;
+}
+
+void IntroDetector::fingerprint(const QString& file)
+{
+    // pool threads are reused, the class sticks to them
+    setIdleIoPriority();
+    quint64 identity = fileIdentity(file);
+    if (identity == 0 || cache->contains(identity, KIND) || !waitWhilePaused()) {
+        return;
+    }
+    const double duration = mediaDuration(file);
+    if (duration < MIN_DURATION_SECS) {
+        // kept without hashes, so it isn't probed on every update
+        if (duration > 0) {
+            cache->store(identity, KIND, QJsonObject { { "duration", duration } });
+        }
+        return;
+    }
+
+    HeadlessDecoder decoder;
+    {
+        QMutexLocker locker(&mutex);
+        if (stopping) {
+            return;
+        }
+        decoders.insert(&decoder);
+    }
+    auto decode = [&](double start, double length, std::vector<quint32>& hashes) {
+        Fingerprinter printer;
+        bool ok = decoder.decodeAudio(file, Fingerprinter::SampleRate, 1, [&](const float* samples, qint64 frames) {
+            if (!waitWhilePaused()) {
+                decoder.abort();
+                return;
+            }
+            printer.process(samples, frames);
+        }, start, length);
+        hashes = printer.hashes();
+        return ok;
+    };
+    const double tailStart = duration - TAIL_SECS;
+    std::vector<quint32> head;
+    std::vector<quint32> tail;
+    const bool ok = decode(0, HEAD_SECS, head) && decode(tailStart, TAIL_SECS, tail);
+    {
+        QMutexLocker locker(&mutex);
+        decoders.remove(&decoder);
+        if (ok) {
+            counters.filesFingerprinted++;
+            counters.secondsDecoded += HEAD_SECS + TAIL_SECS;
+        }
+    }
+    if (!ok) {
+        return;
+    }
+
+    QByteArray data;
+    data.append(reinterpret_cast<const char*>(head.data()), head.size() * 4);
+    data.append(reinterpret_cast<const char*>(tail.data()), tail.size() * 4);
+    cache->storeData(identity, KIND, data);
+    cache->store(identity, KIND, QJsonObject {
+                                     { "head", (int)head.size() },
+                                     { "tail", (int)tail.size() },
+                                     { "tail-start", tailStart },
+                                     { "duration", duration },
+                                 });
+    emit fingerprinted(file, identity);
+}
+
+IntroDetector::Segments IntroDetector::segments(const QString& file, const QStringList& episodes) const
+{
+    Segments found;
+    Fingerprint own;
+    const int index = episodes.indexOf(file);
+    if (index < 0 || !loadFingerprint(cache, file, own)) {
+        return found;
+    }
+    const double hashSecs = (double)Fingerprinter::Hop / Fingerprinter::SampleRate;
+    FingerprintMatch intro;
+    FingerprintMatch credits;
+    // the episodes next to it are the likeliest to share the same version
+    for (int i = qMax(0, index - NEIGHBOURS); i <= qMin(episodes.count() - 1, index + NEIGHBOURS); ++i) {
+        Fingerprint other;
+        if (i == index || !loadFingerprint(cache, episodes.at(i), other)) {
+            continue;
+        }
+        FingerprintMatch match = matchFingerprints(own.head.data(), own.head.size(), other.head.data(), other.head.size());
+        if (match.length > intro.length) {
+            intro = match;
+        }
+        match = matchFingerprints(own.tail.data(), own.tail.size(), other.tail.data(), other.tail.size());
+        if (match.length > credits.length) {
+            credits = match;
+        }
+    }
+    if (intro.length * hashSecs >= MIN_SEGMENT_SECS) {
+        found.intro = { intro.startA * hashSecs, (intro.startA + intro.length) * hashSecs };
+    }
+    if (credits.length * hashSecs >= MIN_SEGMENT_SECS) {
+        found.credits = { own.tailStart + credits.startA * hashSecs, own.tailStart + (credits.startA + credits.length) * hashSecs };
+    }
+    return found;
+}
+
+void IntroDetector::findSegments(const QString& file, const QStringList& queue, const std::function<void(const Segments&)>& done)
+{
+    matcher.start([=] {
+        const QString folder = QFileInfo(file).absolutePath();
+        done(segments(file, seasons(queue, { folder }).value(folder)));
+    });
+}
+
+QHash<QString, QStringList> IntroDetector::seasons(const QStringList& queue, const QStringList& folders)
+{
+    // one pass over the queue for all of them
+    QHash<QString, QStringList> found;
+    for (const QString& entry : queue) {
+        if (!entry.contains("://")) {
+            const QString folder = QFileInfo(entry).absolutePath();
+            if (folders.contains(folder)) {
+                found[folder] << entry;
+            }
+        }
+    }
+    return found;
+}
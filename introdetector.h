@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+#include <functional>
+
+class AnalysisCache;
+class HeadlessDecoder;
+
+// Fingerprints the audio at the start and end of episodes, several files
+// at once on idle priority threads, and finds the intro and credits an
+// episode shares with the others of its season. Fingerprints are kept in
+// the analysis cache, matching them is cheap enough to redo on every load
+// and every new fingerprint.
+class IntroDetector : public QObject
+{
+    Q_OBJECT
+public:
+    struct Segments {
+        // start and end in seconds, empty when not found
+        QPair<double, double> intro;
+        QPair<double, double> credits;
+    };
+
+    struct Stats {
+        int filesFingerprinted = 0;
+        double secondsDecoded = 0;
+    };
+
+    IntroDetector(AnalysisCache* cache, QObject* parent = nullptr);
+    ~IntroDetector();
+
+    // files already fingerprinted or on their way are skipped
+    void setFiles(const QStringList& files);
+    void setPaused(bool paused);
+    Stats stats() const;
+    // compares file with the other episodes, those without a fingerprint
+    // yet are left out
+    Segments segments(const QString& file, const QStringList& episodes) const;
+    // segments() of file and its season in queue, on a thread of the
+    // detector's own, done is called there
+    void findSegments(const QString& file, const QStringList& queue, const std::function<void(const Segments&)>& done);
+
+    // local files of queue in each of folders, in queue order
+    static QHash<QString, QStringList> seasons(const QStringList& queue, const QStringList& folders);
+
+signals:
+    void fingerprinted(const QString& file, quint64 identity);
+
+private:
+    AnalysisCache* cache;
+    QThreadPool pool;
+    // matching reads a few fingerprints, it doesn't wait for decoding
+    QThreadPool matcher;
+
+    mutable QMutex mutex;
+    QWaitCondition condition;
+    QSet<QString> queued;
+    QSet<HeadlessDecoder*> decoders;
+    bool paused = false;
+    bool stopping = false;
+    Stats counters;
+
+    void fingerprint(const QString& file);
+    bool waitWhilePaused();
+};
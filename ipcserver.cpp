@@ -0,0 +1,458 @@
+#include "ipcserver.h"
+
+#include <QDebug>
+#include <QJsonDocument>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMetaObject>
+#include <QProcess>
+
+#include "qthelper.hpp"
+
+// Stop reading from a socket while this many of its requests are still
+// waiting for mpv, so a flood of commands can't overrun the client's event
+// queue. What it sends meanwhile waits in the socket and then the kernel,
+// which holds the sender back; reading resumes as replies come back.
+#define MAX_IN_FLIGHT 256
+// Longest request line, a client going past it without a newline is dropped.
+#define MAX_LINE_BYTES (4 * 1024 * 1024)
+
+IpcServer::IpcServer(mpv_handle* mpv, QObject* parent)
+    : QObject(parent)
+    , ipc(mpv_create_client(mpv, "ipc"))
+    , server(new QLocalServer(this))
+{
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(server, &QLocalServer::newConnection, this, &IpcServer::onNewConnection);
+    if (ipc) {
+        mpv_set_wakeup_callback(ipc, IpcServer::wakeup, this);
+    }
+}
+
+IpcServer::~IpcServer()
+{
+    close();
+    if (ipc) {
+        mpv_set_wakeup_callback(ipc, nullptr, nullptr);
+        mpv_destroy(ipc);
+    }
+}
+
+bool IpcServer::listen(const QString& path)
+{
+    close();
+    if (path.isEmpty() || !ipc) {
+        return false;
+    }
+    QLocalServer::removeServer(path);
+    if (!server->listen(path)) {
+        qWarning() << "IPC server failed to listen on" << path << server->errorString();
+        return false;
+    }
+    qInfo() << "IPC server listening on" << server->fullServerName();
+    return true;
+}
+
+void IpcServer::close()
+{
+    for (auto it = observers.cbegin(); it != observers.cend(); ++it) {
+        mpv_unobserve_property(ipc, it.key());
+    }
+    observers.clear();
+    const auto sockets = clients.keys();
+    clients.clear();
+    for (auto socket : sockets) {
+        socket->disconnect(this);
+        socket->abort();
+        socket->deleteLater();
+    }
+    if (server->isListening()) {
+        server->close();
+    }
+}
+
+QString IpcServer::path() const
+{
+    return server->isListening() ? server->fullServerName() : QString();
+}
+
+void IpcServer::setHandler(Handler h)
+{
+    handler = h;
+}
+
+void IpcServer::wakeup(void* ctx)
+{
+    auto self = static_cast<IpcServer*>(ctx);
+    if (!self->wakeupPending.exchange(true)) {
+        QMetaObject::invokeMethod(self, "onMpvEvents", Qt::QueuedConnection);
+    }
+}
+
+void IpcServer::onNewConnection()
+{
+    while (server->hasPendingConnections()) {
+        auto socket = server->nextPendingConnection();
+        socket->setReadBufferSize(MAX_LINE_BYTES);
+        clients.insert(socket, Client());
+        connect(socket, &QLocalSocket::readyRead, this, &IpcServer::onReadyRead);
+        connect(socket, &QLocalSocket::disconnected, this, &IpcServer::onDisconnected);
+    }
+}
+
+void IpcServer::onDisconnected()
+{
+    auto socket = qobject_cast<QLocalSocket*>(sender());
+    if (nullptr == socket) {
+        return;
+    }
+    for (auto it = observers.begin(); it != observers.end();) {
+        if (it->socket == socket) {
+            mpv_unobserve_property(ipc, it.key());
+            it = observers.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+    clients.remove(socket);
+    socket->deleteLater();
+}
+
+void IpcServer::onReadyRead()
+{
+    auto socket = qobject_cast<QLocalSocket*>(sender());
+    if (nullptr == socket || !clients.contains(socket)) {
+        return;
+    }
+    processBuffer(socket);
+}
+
+void IpcServer::processBuffer(QLocalSocket* socket)
+{
+    // Every complete line is dispatched before returning to the event loop,
+    // so a pipelined batch costs one readyRead and one socket write. Data is
+    // only taken from the socket while the client may send more requests.
+    int start = 0;
+    int scanned = 0;
+    while (clients.contains(socket)) {
+        Client& client = clients[socket];
+        if (client.inFlight >= MAX_IN_FLIGHT) {
+            break;
+        }
+        int end = client.buffer.indexOf('\n', scanned);
+        if (end < 0) {
+            if (socket->bytesAvailable() <= 0) {
+                break;
+            }
+            client.buffer.remove(0, start);
+            start = 0;
+            if (client.buffer.size() >= MAX_LINE_BYTES) {
+                qWarning() << "IPC client sent a line longer than" << MAX_LINE_BYTES << "bytes, disconnecting";
+                client.buffer.clear();
+                socket->abort();
+                return;
+            }
+            scanned = client.buffer.size();
+            client.buffer += socket->read(MAX_LINE_BYTES - client.buffer.size());
+            continue;
+        }
+        QByteArray line = client.buffer.mid(start, end - start);
+        start = end + 1;
+        scanned = start;
+        processLine(socket, line);
+    }
+    if (clients.contains(socket)) {
+        clients[socket].buffer.remove(0, start);
+    }
+}
+
+void IpcServer::processLine(QLocalSocket* socket, const QByteArray& line)
+{
+    QByteArray trimmed = line.trimmed();
+    if (trimmed.isEmpty() || trimmed.startsWith('#')) {
+        return;
+    }
+    if (!trimmed.startsWith('{')) {
+        // input.conf style text command, no reply as in mpv
+        QJsonArray args;
+        for (const auto& arg : QProcess::splitCommand(QString::fromUtf8(trimmed))) {
+            args.append(arg);
+        }
+        if (!args.isEmpty()) {
+            processCommand(socket, args, QJsonValue::Undefined);
+        }
+        return;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(trimmed, &parseError);
+    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+        send(socket, { { "error", "invalid parameter" } });
+        return;
+    }
+    QJsonObject object = doc.object();
+    QJsonValue requestId = object.value("request_id");
+    if (requestId.isUndefined()) {
+        requestId = 0;
+    }
+    QJsonValue command = object.value("command");
+    if (!command.isArray() || command.toArray().isEmpty()) {
+        reply(socket, requestId, MPV_ERROR_INVALID_PARAMETER);
+        return;
+    }
+    processCommand(socket, command.toArray(), requestId);
+}
+
+void IpcServer::processCommand(QLocalSocket* socket, const QJsonArray& args, const QJsonValue& requestId)
+{
+    const QString name = args.at(0).toString();
+    Client& client = clients[socket];
+    quint64 id = nextId++;
+    int err = 0;
+
+    if (name == "client_name") {
+        reply(socket, requestId, 0, QString::fromUtf8(mpv_client_name(ipc)));
+    }
+    else if (name == "get_time_us") {
+        reply(socket, requestId, 0, static_cast<qint64>(mpv_get_time_us(ipc)));
+    }
+    else if (name == "get_version") {
+        reply(socket, requestId, 0, static_cast<qint64>(mpv_client_api_version()));
+    }
+    else if (name == "get_property" || name == "get_property_string") {
+        bool asString = name == "get_property_string";
+        const QByteArray property = args.at(1).toString().toUtf8();
+        requests.insert(id, { socket, requestId });
+        err = mpv_get_property_async(ipc, id, property.constData(), asString ? MPV_FORMAT_STRING : MPV_FORMAT_NODE);
+    }
+    else if (name == "set_property" || name == "set_property_string") {
+        const QByteArray property = args.at(1).toString().toUtf8();
+        QVariant value = args.at(2).toVariant();
+        if (name == "set_property_string") {
+            value = value.toString();
+        }
+        mpv::qt::node_builder node(value);
+        requests.insert(id, { socket, requestId });
+        err = mpv_set_property_async(ipc, id, property.constData(), MPV_FORMAT_NODE, node.node());
+    }
+    else if (name == "observe_property" || name == "observe_property_string") {
+        qint64 clientId = args.at(1).toInteger();
+        const QByteArray property = args.at(2).toString().toUtf8();
+        bool asString = name == "observe_property_string";
+        err = mpv_observe_property(ipc, id, property.constData(), asString ? MPV_FORMAT_STRING : MPV_FORMAT_NODE);
+        if (err >= 0) {
+            observers.insert(id, { socket, clientId });
+        }
+        reply(socket, requestId, err);
+        return;
+    }
+    else if (name == "unobserve_property") {
+        unobserve(socket, args.at(1).toInteger());
+        reply(socket, requestId, 0);
+        return;
+    }
+    else if (name == "enable_event" || name == "disable_event") {
+        bool enable = name == "enable_event";
+        const QString eventName = args.at(1).toString();
+        if (eventName == "all") {
+            client.allEventsDisabled = !enable;
+            client.disabledEvents.clear();
+        }
+        else if (enable) {
+            client.disabledEvents.remove(eventName);
+        }
+        else {
+            client.disabledEvents.insert(eventName);
+        }
+        reply(socket, requestId, 0);
+        return;
+    }
+    else if (name == "quit" || name == "quit-watch-later") {
+        // the window owns the core, it has to be the one tearing it down
+        reply(socket, requestId, 0);
+        Q_EMIT quitRequested();
+        return;
+    }
+    else if (name.startsWith("fastplayer-")) {
+        if (!handler) {
+            reply(socket, requestId, MPV_ERROR_UNSUPPORTED);
+            return;
+        }
+        QString error;
+        QJsonValue data = handler(args, error);
+        if (!error.isEmpty()) {
+            send(socket, { { "request_id", requestId }, { "error", error } });
+        }
+        else {
+            reply(socket, requestId, 0, data);
+        }
+        return;
+    }
+    else {
+        mpv::qt::node_builder node(args.toVariantList());
+        requests.insert(id, { socket, requestId });
+        err = mpv_command_node_async(ipc, id, node.node());
+    }
+
+    if (!requests.contains(id)) {
+        return;
+    }
+    if (err < 0) {
+        requests.remove(id);
+        reply(socket, requestId, err);
+    }
+    else {
+        client.inFlight++;
+    }
+}
+
+void IpcServer::unobserve(QLocalSocket* socket, qint64 clientId)
+{
+    for (auto it = observers.begin(); it != observers.end();) {
+        if (it->socket == socket && it->clientId == clientId) {
+            mpv_unobserve_property(ipc, it.key());
+            it = observers.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void IpcServer::onMpvEvents()
+{
+    wakeupPending = false;
+    while (ipc) {
+        mpv_event* event = mpv_wait_event(ipc, 0);
+        if (event->event_id == MPV_EVENT_NONE) {
+            break;
+        }
+        handleEvent(event);
+    }
+}
+
+void IpcServer::handleEvent(mpv_event* event)
+{
+    switch (event->event_id) {
+    case MPV_EVENT_GET_PROPERTY_REPLY: {
+        auto prop = static_cast<mpv_event_property*>(event->data);
+        QJsonValue data;
+        if (prop->format == MPV_FORMAT_NODE) {
+            data = QJsonValue::fromVariant(mpv::qt::node_to_variant(static_cast<mpv_node*>(prop->data)));
+        }
+        else if (prop->format == MPV_FORMAT_STRING) {
+            data = QString::fromUtf8(*static_cast<char**>(prop->data));
+        }
+        finishRequest(event->reply_userdata, event->error, data);
+        break;
+    }
+    case MPV_EVENT_SET_PROPERTY_REPLY: {
+        finishRequest(event->reply_userdata, event->error, QJsonValue::Undefined);
+        break;
+    }
+    case MPV_EVENT_COMMAND_REPLY: {
+        auto cmd = static_cast<mpv_event_command*>(event->data);
+        QJsonValue data;
+        if (event->error >= 0 && cmd->result.format != MPV_FORMAT_NONE) {
+            data = QJsonValue::fromVariant(mpv::qt::node_to_variant(&cmd->result));
+        }
+        finishRequest(event->reply_userdata, event->error, data);
+        break;
+    }
+    case MPV_EVENT_PROPERTY_CHANGE: {
+        auto it = observers.constFind(event->reply_userdata);
+        if (it == observers.cend() || !it->socket) {
+            break;
+        }
+        auto prop = static_cast<mpv_event_property*>(event->data);
+        QJsonObject object { { "event", "property-change" }, { "id", it->clientId }, { "name", QString::fromUtf8(prop->name) } };
+        if (prop->format == MPV_FORMAT_NODE) {
+            object.insert("data", QJsonValue::fromVariant(mpv::qt::node_to_variant(static_cast<mpv_node*>(prop->data))));
+        }
+        else if (prop->format == MPV_FORMAT_STRING) {
+            object.insert("data", QString::fromUtf8(*static_cast<char**>(prop->data)));
+        }
+        send(it->socket, object);
+        break;
+    }
+    case MPV_EVENT_SHUTDOWN: {
+        close();
+        mpv_destroy(ipc);
+        ipc = nullptr;
+        break;
+    }
+    case MPV_EVENT_LOG_MESSAGE:
+        break;
+    default: {
+        const QString eventName = QString::fromUtf8(mpv_event_name(event->event_id));
+        QJsonObject object { { "event", eventName } };
+        if (event->event_id == MPV_EVENT_START_FILE) {
+            auto start = static_cast<mpv_event_start_file*>(event->data);
+            object.insert("playlist_entry_id", static_cast<qint64>(start->playlist_entry_id));
+        }
+        else if (event->event_id == MPV_EVENT_END_FILE) {
+            auto end = static_cast<mpv_event_end_file*>(event->data);
+            static const char* reasons[] = { "eof", "stop", "quit", "error", "redirect" };
+            object.insert("reason", end->reason >= 0 && end->reason <= 4 ? reasons[end->reason] : "unknown");
+            object.insert("playlist_entry_id", static_cast<qint64>(end->playlist_entry_id));
+            if (end->reason == MPV_END_FILE_REASON_ERROR) {
+                object.insert("file_error", QString::fromUtf8(mpv_error_string(end->error)));
+            }
+        }
+        broadcast(eventName, object);
+    }
+    }
+}
+
+void IpcServer::finishRequest(quint64 id, int error, const QJsonValue& data)
+{
+    auto it = requests.find(id);
+    if (it == requests.end()) {
+        return;
+    }
+    Request request = *it;
+    requests.erase(it);
+    QLocalSocket* socket = request.socket;
+    if (nullptr == socket || !clients.contains(socket)) {
+        return;
+    }
+    clients[socket].inFlight--;
+    // text commands have no request id and get no reply
+    if (!request.requestId.isUndefined()) {
+        reply(socket, request.requestId, error, data);
+    }
+    // readyRead isn't repeated for data the socket already holds
+    if ((!clients[socket].buffer.isEmpty() || socket->bytesAvailable() > 0) && clients[socket].inFlight < MAX_IN_FLIGHT) {
+        processBuffer(socket);
+    }
+}
+
+void IpcServer::reply(QLocalSocket* socket, const QJsonValue& requestId, int error, const QJsonValue& data)
+{
+    if (requestId.isUndefined()) {
+        return;
+    }
+    QJsonObject object { { "request_id", requestId }, { "error", QString::fromUtf8(mpv_error_string(error)) } };
+    if (!data.isUndefined()) {
+        object.insert("data", data);
+    }
+    send(socket, object);
+}
+
+void IpcServer::send(QLocalSocket* socket, const QJsonObject& object)
+{
+    // QLocalSocket buffers writes until control returns to the event loop,
+    // so replies to a batch leave in a single write.
+    socket->write(QJsonDocument(object).toJson(QJsonDocument::Compact) + '\n');
+}
+
+void IpcServer::broadcast(const QString& eventName, const QJsonObject& object)
+{
+    for (auto it = clients.cbegin(); it != clients.cend(); ++it) {
+        if (it->allEventsDisabled || it->disabledEvents.contains(eventName)) {
+            continue;
+        }
+        send(it.key(), object);
+    }
+}
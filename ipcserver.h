@@ -0,0 +1,85 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QObject>
+#include <QPointer>
+#include <QSet>
+#include <QString>
+
+#include <atomic>
+#include <functional>
+
+#include <mpv/client.h>
+
+class QLocalServer;
+class QLocalSocket;
+
+// Local socket server speaking mpv's JSON IPC protocol.
+// Requests are dispatched through a dedicated mpv client handle with the
+// async API, so a slow property never blocks the GUI thread, and replies
+// are matched back to the socket by reply_userdata.
+// Commands starting with "fastplayer-" are handed to the handler instead,
+// quit and quit-watch-later are turned into quitRequested().
+class IpcServer : public QObject
+{
+    Q_OBJECT
+public:
+    using Handler = std::function<QJsonValue(const QJsonArray& args, QString& error)>;
+
+    IpcServer(mpv_handle* mpv, QObject* parent = nullptr);
+    ~IpcServer();
+
+    bool listen(const QString& path);
+    void close();
+    QString path() const;
+    void setHandler(Handler handler);
+
+Q_SIGNALS:
+    void quitRequested();
+
+private Q_SLOTS:
+    void onNewConnection();
+    void onReadyRead();
+    void onDisconnected();
+    void onMpvEvents();
+
+private:
+    struct Request {
+        QPointer<QLocalSocket> socket;
+        QJsonValue requestId;
+    };
+    struct Observer {
+        QPointer<QLocalSocket> socket;
+        qint64 clientId;
+    };
+    struct Client {
+        QByteArray buffer;
+        int inFlight = 0;
+        QSet<QString> disabledEvents;
+        bool allEventsDisabled = false;
+    };
+
+    mpv_handle* ipc;
+    QLocalServer* server;
+    Handler handler;
+    QHash<QLocalSocket*, Client> clients;
+    QHash<quint64, Request> requests;
+    QHash<quint64, Observer> observers;
+    quint64 nextId = 1;
+    std::atomic_bool wakeupPending { false };
+
+    static void wakeup(void* ctx);
+    void processBuffer(QLocalSocket* socket);
+    void processLine(QLocalSocket* socket, const QByteArray& line);
+    void processCommand(QLocalSocket* socket, const QJsonArray& args, const QJsonValue& requestId);
+    void handleEvent(mpv_event* event);
+    void reply(QLocalSocket* socket, const QJsonValue& requestId, int error, const QJsonValue& data = QJsonValue());
+    void send(QLocalSocket* socket, const QJsonObject& object);
+    void broadcast(const QString& eventName, const QJsonObject& object);
+    void finishRequest(quint64 id, int error, const QJsonValue& data);
+    void unobserve(QLocalSocket* socket, qint64 clientId);
+};
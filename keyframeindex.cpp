@@ -0,0 +1,789 @@
+#include "keyframeindex.h"
+
+#include <QFile>
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "containerindex.h"
+
+#define PROGRESS_BYTES (16 * 1024 * 1024)
+#define TS_PACKET 188
+#define TS_SYNC 0x47
+
+#define EBML_INFO 0x1549A966
+#define EBML_TIMECODESCALE 0x2AD7B1
+#define EBML_TRACKS 0x1654AE6B
+#define EBML_TRACKENTRY 0xAE
+#define EBML_TRACKNUMBER 0xD7
+#define EBML_TRACKTYPE 0x83
+#define EBML_CLUSTER 0x1F43B675
+#define EBML_TIMECODE 0xE7
+#define EBML_SIMPLEBLOCK 0xA3
+#define EBML_BLOCKGROUP 0xA0
+#define EBML_BLOCK 0xA1
+#define EBML_REFERENCEBLOCK 0xFB
+
+#define INDEX_MAGIC "FPKI"
+#define INDEX_VERSION 2
+
+using Entry = KeyframeIndex::Entry;
+
+// how to tell a keyframe from the start of its data
+enum Codec {
+    UnknownCodec,
+    Mpeg12,
+    Mpeg4,
+    H264,
+    Hevc,
+    // every frame is a keyframe
+    Intra,
+};
+
+// a read only mapping of the whole file, read front to back
+struct MappedFile {
+    const uchar* data = nullptr;
+    qint64 size = 0;
+
+    MappedFile(const QString& path)
+    {
+        int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if (map != MAP_FAILED) {
+                madvise(map, st.st_size, MADV_SEQUENTIAL);
+                data = static_cast<const uchar*>(map);
+                size = st.st_size;
+            }
+        }
+        close(fd);
+    }
+    ~MappedFile()
+    {
+        if (data) {
+            munmap(const_cast<uchar*>(data), size);
+        }
+    }
+};
+
+class ScanProgress
+{
+public:
+    ScanProgress(const KeyframeIndex::Progress& callback, qint64 size)
+        : callback(callback)
+        , size(size)
+    {
+    }
+    // false once the scan should stop
+    bool update(qint64 offset)
+    {
+        if (offset < next) {
+            return true;
+        }
+        next = offset + PROGRESS_BYTES;
+        return !callback || callback((double)offset / size);
+    }
+
+private:
+    const KeyframeIndex::Progress& callback;
+    qint64 size;
+    qint64 next = 0;
+};
+
+static bool startsKeyframe(const uchar* p, qint64 length, Codec codec)
+{
+    if (codec == Intra) {
+        return true;
+    }
+    for (qint64 i = 0; i + 4 < length; ++i) {
+        if (p[i] != 0 || p[i + 1] != 0 || p[i + 2] != 1) {
+            continue;
+        }
+        const uchar code = p[i + 3];
+        switch (codec) {
+        case Mpeg12:
+            // sequence header, in front of every I frame that starts a GOP
+            if (code == 0xB3) {
+                return true;
+            }
+            break;
+        case Mpeg4:
+            // the first VOP decides, packed bitstreams carry a second one
+            if (code == 0xB6) {
+                return (p[i + 4] >> 6) == 0;
+            }
+            break;
+        case H264: {
+            int type = code & 0x1F;
+            // IDR slice, or the SPS in front of a recovery point
+            if (type == 5 || type == 7) {
+                return true;
+            }
+            if (type == 1) {
+                return false;
+            }
+            break;
+        }
+        case Hevc: {
+            int type = (code >> 1) & 0x3F;
+            if ((type >= 16 && type <= 21) || type == 32) {
+                return true;
+            }
+            if (type < 16) {
+                return false;
+            }
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+// appends keeping the index in time order, PTS discontinuities and
+// reordered frames are dropped
+static void addKeyframe(QList<Entry>& entries, double time, qint64 offset)
+{
+    if (entries.isEmpty() || time > entries.last().time) {
+        entries.append({ time, offset });
+    }
+}
+
+//
+// MPEG-TS
+//
+
+static int tsPacketSize(const MappedFile& file, int* start)
+{
+    for (int packetSize : { 188, 192, 204 }) {
+        // M2TS puts a 4 byte timecode in front of each packet
+        const int offset = packetSize == 192 ? 4 : 0;
+        int synced = 0;
+        while (synced < 8 && offset + (qint64)synced * packetSize < file.size && file.data[offset + synced * packetSize] == TS_SYNC) {
+            synced++;
+        }
+        if (synced == 8) {
+            *start = offset;
+            return packetSize;
+        }
+    }
+    return 0;
+}
+
+static int parsePat(const uchar* p, int length)
+{
+    if (length < 1 || 1 + p[0] + 12 > length) {
+        return -1;
+    }
+    const uchar* s = p + 1 + p[0];
+    const uchar* end = p + length;
+    if (s[0] != 0x00) {
+        return -1;
+    }
+    const uchar* sectionEnd = qMin(end, s + 3 + (((s[1] & 0x0F) << 8) | s[2]) - 4);
+    for (const uchar* program = s + 8; program + 4 <= sectionEnd; program += 4) {
+        // program 0 points at the network information table
+        if (((program[0] << 8) | program[1]) != 0) {
+            return ((program[2] & 0x1F) << 8) | program[3];
+        }
+    }
+    return -1;
+}
+
+static int parsePmt(const uchar* p, int length, Codec* codec)
+{
+    if (length < 1 || 1 + p[0] + 12 > length) {
+        return -1;
+    }
+    const uchar* s = p + 1 + p[0];
+    const uchar* end = p + length;
+    if (s[0] != 0x02) {
+        return -1;
+    }
+    const uchar* sectionEnd = qMin(end, s + 3 + (((s[1] & 0x0F) << 8) | s[2]) - 4);
+    const uchar* stream = s + 12 + (((s[10] & 0x0F) << 8) | s[11]);
+    while (stream + 5 <= sectionEnd) {
+        const int pid = ((stream[1] & 0x1F) << 8) | stream[2];
+        switch (stream[0]) {
+        case 0x01:
+        case 0x02:
+            *codec = Mpeg12;
+            return pid;
+        case 0x10:
+            *codec = Mpeg4;
+            return pid;
+        case 0x1B:
+            *codec = H264;
+            return pid;
+        case 0x24:
+            *codec = Hevc;
+            return pid;
+        case 0xEA:
+            // VC-1, only the random access indicator tells
+            *codec = UnknownCodec;
+            return pid;
+        }
+        stream += 5 + (((stream[3] & 0x0F) << 8) | stream[4]);
+    }
+    return -1;
+}
+
+static qint64 readPts(const uchar* p)
+{
+    return ((qint64)(p[0] >> 1) & 0x07) << 30 | (qint64)p[1] << 22 | (qint64)(p[2] >> 1) << 15 | (qint64)p[3] << 7 | (p[4] >> 1);
+}
+
+static QList<Entry> scanTransportStream(const MappedFile& file, ScanProgress& progress)
+{
+    QList<Entry> entries;
+    int start = 0;
+    const int packetSize = tsPacketSize(file, &start);
+    if (packetSize == 0) {
+        return entries;
+    }
+    int pmtPid = -1;
+    int videoPid = -1;
+    Codec codec = UnknownCodec;
+    qint64 firstPts = -1;
+    qint64 lastPts = -1;
+
+    for (qint64 offset = start; offset + TS_PACKET <= file.size; offset += packetSize) {
+        if (!progress.update(offset)) {
+            return {};
+        }
+        const uchar* p = file.data + offset;
+        if (p[0] != TS_SYNC) {
+            // damaged stream, find the next byte that is followed by a sync
+            // byte one packet later
+            const uchar* resync = p + 1;
+            const uchar* end = file.data + file.size - packetSize - TS_PACKET;
+            while (resync < end && !(resync[0] == TS_SYNC && resync[packetSize] == TS_SYNC)) {
+                resync++;
+            }
+            if (resync >= end) {
+                break;
+            }
+            offset = resync - file.data - packetSize;
+            continue;
+        }
+        const bool unitStart = p[1] & 0x40;
+        const int pid = ((p[1] & 0x1F) << 8) | p[2];
+        const int adaptation = (p[3] >> 4) & 0x03;
+        int payload = 4;
+        bool randomAccess = false;
+        if (adaptation & 0x02) {
+            randomAccess = p[4] > 0 && (p[5] & 0x40);
+            payload += 1 + p[4];
+        }
+        if (!unitStart || !(adaptation & 0x01) || payload >= TS_PACKET) {
+            continue;
+        }
+        const uchar* data = p + payload;
+        const int length = TS_PACKET - payload;
+
+        if (pid == 0 && pmtPid < 0) {
+            pmtPid = parsePat(data, length);
+        }
+        else if (pid == pmtPid && videoPid < 0) {
+            videoPid = parsePmt(data, length, &codec);
+        }
+        else if (pid == videoPid && length >= 14 && data[0] == 0 && data[1] == 0 && data[2] == 1 && (data[7] & 0x80)) {
+            qint64 pts = readPts(data + 9);
+            if (firstPts < 0) {
+                firstPts = pts;
+                lastPts = pts;
+            }
+            // 33 bit PTS wrap around, every 26.5 hours
+            while (pts < lastPts - (1LL << 32)) {
+                pts += 1LL << 33;
+            }
+            lastPts = pts;
+            const int header = 9 + data[8];
+            if (randomAccess || (header < length && startsKeyframe(data + header, length - header, codec))) {
+                addKeyframe(entries, (pts - firstPts) / 90000.0, offset - start);
+            }
+        }
+    }
+    return entries;
+}
+
+//
+// AVI
+//
+
+static quint32 readLE32(const uchar* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | (quint32)p[3] << 24;
+}
+
+static Codec aviCodec(const uchar* fourcc)
+{
+    QByteArray name = QByteArray((const char*)fourcc, 4).toUpper();
+    if (name == "XVID" || name == "DIVX" || name == "DX50" || name == "FMP4" || name == "MP4V") {
+        return Mpeg4;
+    }
+    if (name == "H264" || name == "X264" || name == "AVC1") {
+        return H264;
+    }
+    if (name == "HEVC" || name == "H265") {
+        return Hevc;
+    }
+    // MJPEG, DV, HuffYUV and friends
+    return Intra;
+}
+
+struct AviStream {
+    int number = -1;
+    double frameDuration = 0;
+    Codec codec = Intra;
+    bool hasIndex = false;
+};
+
+// the first video stream of the hdrl list
+static AviStream parseAviHeader(const uchar* p, const uchar* end)
+{
+    AviStream video;
+    int number = 0;
+    while (p + 12 <= end) {
+        const quint32 size = readLE32(p + 4);
+        const uchar* data = p + 8;
+        const uchar* next = data + size + (size & 1);
+        if (memcmp(p, "LIST", 4) == 0 && memcmp(data, "strl", 4) == 0) {
+            bool isVideo = false;
+            bool hasIndex = false;
+            const uchar* listEnd = qMin(end, data + size);
+            for (const uchar* c = data + 4; c + 8 <= listEnd;) {
+                const quint32 chunkSize = readLE32(c + 4);
+                const uchar* chunk = c + 8;
+                if (chunk + chunkSize > listEnd) {
+                    break;
+                }
+                if (memcmp(c, "strh", 4) == 0 && chunkSize >= 28 && memcmp(chunk, "vids", 4) == 0) {
+                    isVideo = true;
+                    quint32 scale = readLE32(chunk + 20);
+                    quint32 rate = readLE32(chunk + 24);
+                    video.frameDuration = rate > 0 ? (double)scale / rate : 0;
+                }
+                else if (memcmp(c, "strf", 4) == 0 && isVideo && chunkSize >= 20) {
+                    video.codec = aviCodec(chunk + 16);
+                }
+                else if (memcmp(c, "indx", 4) == 0) {
+                    // OpenDML super index
+                    hasIndex = true;
+                }
+                c = chunk + chunkSize + (chunkSize & 1);
+            }
+            if (isVideo && video.number < 0) {
+                video.number = number;
+                video.hasIndex = hasIndex;
+            }
+            number++;
+        }
+        p = next;
+    }
+    return video;
+}
+
+struct AviLayout {
+    AviStream video;
+    bool hasIdx1 = false;
+    // LIST movi of the RIFF AVI and every RIFF AVIX after it
+    QList<QPair<const uchar*, const uchar*>> movies;
+};
+
+static AviLayout parseAvi(const uchar* data, qint64 size)
+{
+    AviLayout layout;
+    const uchar* end = data + size;
+    const uchar* riff = data;
+    while (riff + 12 <= end && memcmp(riff, "RIFF", 4) == 0) {
+        const quint32 riffSize = readLE32(riff + 4);
+        const uchar* riffEnd = qMin(end, riff + 8 + riffSize);
+        for (const uchar* c = riff + 12; c + 8 <= riffEnd;) {
+            const quint32 chunkSize = readLE32(c + 4);
+            const uchar* chunk = c + 8;
+            const uchar* chunkEnd = qMin(riffEnd, chunk + chunkSize);
+            // a truncated file can declare more than is left of it
+            if (memcmp(c, "LIST", 4) == 0 && chunkSize >= 4 && chunk + 4 <= chunkEnd) {
+                if (memcmp(chunk, "hdrl", 4) == 0) {
+                    layout.video = parseAviHeader(chunk + 4, chunkEnd);
+                }
+                else if (memcmp(chunk, "movi", 4) == 0) {
+                    layout.movies.append({ chunk + 4, chunkEnd });
+                }
+            }
+            else if (memcmp(c, "idx1", 4) == 0 && chunkSize > 0) {
+                layout.hasIdx1 = true;
+            }
+            c = chunk + chunkSize + (chunkSize & 1);
+        }
+        riff = riffEnd + ((riffEnd - data) & 1);
+    }
+    return layout;
+}
+
+static QList<Entry> scanAvi(const MappedFile& file, ScanProgress& progress)
+{
+    QList<Entry> entries;
+    const AviLayout layout = parseAvi(file.data, file.size);
+    const AviStream& video = layout.video;
+    if (video.number < 0 || video.frameDuration <= 0) {
+        return entries;
+    }
+    const uchar id[2] = { uchar('0' + video.number / 10), uchar('0' + video.number % 10) };
+    qint64 frame = 0;
+    for (const auto& movie : layout.movies) {
+        const uchar* end = movie.second;
+        for (const uchar* c = movie.first; c + 8 <= end;) {
+            if (!progress.update(c - file.data)) {
+                return {};
+            }
+            const quint32 size = readLE32(c + 4);
+            const uchar* chunk = c + 8;
+            if (memcmp(c, "LIST", 4) == 0) {
+                // rec lists group the chunks of one frame, walk into them
+                c = chunk + 4;
+                continue;
+            }
+            if (c[0] == id[0] && c[1] == id[1] && (c[2] == 'd' && (c[3] == 'c' || c[3] == 'b'))) {
+                // empty chunks are dropped frames, they still take their time
+                const qint64 length = qMin<qint64>(size, end - chunk);
+                if (length > 0 && startsKeyframe(chunk, length, video.codec)) {
+                    addKeyframe(entries, frame * video.frameDuration, c - file.data);
+                }
+                frame++;
+            }
+            c = chunk + size + (size & 1);
+        }
+    }
+    return entries;
+}
+
+//
+// Matroska
+//
+
+struct EbmlElement {
+    qint64 id = -1;
+    const uchar* data = nullptr;
+    // -1 for unknown sizes
+    qint64 size = -1;
+};
+
+static bool readElement(const uchar* p, const uchar* end, EbmlElement* element)
+{
+    int idLength;
+    int sizeLength;
+    element->id = readVint(p, end, &idLength, true);
+    if (idLength == 0) {
+        return false;
+    }
+    qint64 size = readVint(p + idLength, end, &sizeLength, false);
+    if (sizeLength == 0) {
+        return false;
+    }
+    element->data = p + idLength + sizeLength;
+    // all ones means unknown, as written by live muxers
+    element->size = size == (1LL << (7 * sizeLength)) - 1 ? -1 : size;
+    return true;
+}
+
+static bool fits(const EbmlElement& element, const uchar* end)
+{
+    return element.size >= 0 && element.size <= end - element.data;
+}
+
+template <typename Callback>
+static void forEachChild(const EbmlElement& parent, Callback callback)
+{
+    const uchar* end = parent.data + parent.size;
+    EbmlElement child;
+    for (const uchar* p = parent.data; p < end && readElement(p, end, &child) && fits(child, end); p = child.data + child.size) {
+        callback(child);
+    }
+}
+
+static qint64 readUnsigned(const EbmlElement& element)
+{
+    return element.size > 0 && element.size <= 8 ? readBE(element.data, element.size) : 0;
+}
+
+static QList<Entry> scanMatroska(const MappedFile& file, ScanProgress& progress)
+{
+    QList<Entry> entries;
+    const uchar* end = file.data + file.size;
+    EbmlElement header;
+    EbmlElement segment;
+    if (!readElement(file.data, end, &header) || header.id != EBML_HEADER || !fits(header, end)
+        || !readElement(header.data + header.size, end, &segment) || segment.id != EBML_SEGMENT) {
+        return entries;
+    }
+    const uchar* segmentEnd = segment.size < 0 ? end : segment.data + segment.size;
+
+    qint64 timecodeScale = 1000000;
+    qint64 videoTrack = -1;
+    qint64 clusterOffset = -1;
+    qint64 clusterTime = 0;
+    bool clusterIndexed = false;
+    // mpv starts its timeline at the first cluster, not the first video block
+    qint64 startTime = -1;
+
+    auto addBlock = [&](const EbmlElement& block, bool keyframe) {
+        int length;
+        const qint64 track = readVint(block.data, block.data + block.size, &length, false);
+        if (length == 0 || block.size < length + 3 || track != videoTrack) {
+            return;
+        }
+        const uchar* p = block.data + length;
+        const qint64 time = clusterTime + (qint16)((p[0] << 8) | p[1]);
+        // seeking lands on the cluster, one entry each is all it can use
+        if (keyframe && !clusterIndexed && clusterOffset >= 0) {
+            clusterIndexed = true;
+            addKeyframe(entries, qMax<qint64>(0, time - startTime) * timecodeScale / 1e9, clusterOffset);
+        }
+    };
+
+    const uchar* p = segment.data;
+    while (p < segmentEnd) {
+        if (!progress.update(p - file.data)) {
+            return {};
+        }
+        EbmlElement element;
+        // a cluster cut short by a truncated file is still read as far as
+        // it goes
+        if (!readElement(p, segmentEnd, &element) || (element.id != EBML_CLUSTER && !fits(element, segmentEnd))) {
+            // damaged, carry on at the next cluster
+            static const uchar clusterId[] = { 0x1F, 0x43, 0xB6, 0x75 };
+            auto next = static_cast<const uchar*>(memmem(p + 1, segmentEnd - p - 1, clusterId, sizeof(clusterId)));
+            if (!next) {
+                break;
+            }
+            p = next;
+            continue;
+        }
+        switch (element.id) {
+        case EBML_CLUSTER:
+            clusterOffset = p - file.data;
+            clusterTime = 0;
+            clusterIndexed = false;
+            // its children follow, whatever its size says
+            p = element.data;
+            continue;
+        case EBML_INFO:
+            forEachChild(element, [&](const EbmlElement& child) {
+                if (child.id == EBML_TIMECODESCALE) {
+                    timecodeScale = readUnsigned(child);
+                }
+            });
+            break;
+        case EBML_TRACKS:
+            forEachChild(element, [&](const EbmlElement& entry) {
+                if (entry.id != EBML_TRACKENTRY || videoTrack >= 0) {
+                    return;
+                }
+                qint64 number = -1;
+                qint64 type = 0;
+                forEachChild(entry, [&](const EbmlElement& child) {
+                    if (child.id == EBML_TRACKNUMBER) {
+                        number = readUnsigned(child);
+                    }
+                    else if (child.id == EBML_TRACKTYPE) {
+                        type = readUnsigned(child);
+                    }
+                });
+                if (type == 1) {
+                    videoTrack = number;
+                }
+            });
+            break;
+        case EBML_TIMECODE:
+            clusterTime = readUnsigned(element);
+            if (startTime < 0) {
+                startTime = clusterTime;
+            }
+            break;
+        case EBML_SIMPLEBLOCK:
+            if (element.size > 0) {
+                int length;
+                readVint(element.data, element.data + element.size, &length, false);
+                addBlock(element, length > 0 && element.size > length + 2 && (element.data[length + 2] & 0x80));
+            }
+            break;
+        case EBML_BLOCKGROUP: {
+            EbmlElement block;
+            bool referenced = false;
+            forEachChild(element, [&](const EbmlElement& child) {
+                if (child.id == EBML_BLOCK) {
+                    block = child;
+                }
+                else if (child.id == EBML_REFERENCEBLOCK) {
+                    referenced = true;
+                }
+            });
+            if (block.data) {
+                addBlock(block, !referenced);
+            }
+            break;
+        }
+        }
+        p = element.data + element.size;
+    }
+    if (timecodeScale <= 0) {
+        return {};
+    }
+    return entries;
+}
+
+KeyframeIndex::Container KeyframeIndex::probe(const QString& path)
+{
+    int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return None;
+    }
+    Container container = None;
+    uchar head[3 * 192] = {};
+    struct stat st;
+    if (fstat(fd, &st) == 0 && pread(fd, head, sizeof(head), 0) == sizeof(head)) {
+        QPair<qint64, qint64> cues;
+        if (readBE(head, 4) == EBML_HEADER) {
+            container = findMkvIndex(fd, st.st_size, &cues) ? None : Matroska;
+        }
+        else if (memcmp(head, "RIFF", 4) == 0 && memcmp(head + 8, "AVI ", 4) == 0) {
+            // the index is at the end, past the movi list
+            MappedFile file(path);
+            AviLayout layout = parseAvi(file.data, file.size);
+            container = layout.video.number >= 0 && !layout.hasIdx1 && !layout.video.hasIndex ? Avi : None;
+        }
+        else if ((head[0] == TS_SYNC && head[188] == TS_SYNC && head[376] == TS_SYNC)
+            || (head[4] == TS_SYNC && head[196] == TS_SYNC && head[388] == TS_SYNC)) {
+            container = TransportStream;
+        }
+    }
+    close(fd);
+    return container;
+}
+
+KeyframeIndex KeyframeIndex::build(const QString& path, Container container, const Progress& progress)
+{
+    KeyframeIndex index;
+    MappedFile file(path);
+    if (!file.data) {
+        return index;
+    }
+    ScanProgress scanProgress(progress, file.size);
+    switch (container) {
+    case TransportStream:
+        index.entries = scanTransportStream(file, scanProgress);
+        break;
+    case Avi:
+        index.entries = scanAvi(file, scanProgress);
+        break;
+    case Matroska:
+        index.entries = scanMatroska(file, scanProgress);
+        break;
+    case None:
+        break;
+    }
+    index.type = container;
+    index.size = file.size;
+    return index;
+}
+
+const KeyframeIndex::Entry* KeyframeIndex::keyframeBefore(double time) const
+{
+    auto it = std::upper_bound(entries.cbegin(), entries.cend(), time, [](double t, const Entry& entry) {
+        return t < entry.time;
+    });
+    return it == entries.cbegin() ? nullptr : &*(it - 1);
+}
+
+const KeyframeIndex::Entry* KeyframeIndex::keyframeAfter(double time) const
+{
+    auto it = std::upper_bound(entries.cbegin(), entries.cend(), time, [](double t, const Entry& entry) {
+        return t < entry.time;
+    });
+    return it == entries.cend() ? nullptr : &*it;
+}
+
+static void writeVarint(QByteArray& data, quint64 value)
+{
+    while (value >= 0x80) {
+        data.append(char(value | 0x80));
+        value >>= 7;
+    }
+    data.append(char(value));
+}
+
+static bool readVarint(const uchar*& p, const uchar* end, quint64* value)
+{
+    *value = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        const uchar byte = *p++;
+        *value |= quint64(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+QByteArray KeyframeIndex::toData() const
+{
+    QByteArray data(INDEX_MAGIC);
+    data.append(char(INDEX_VERSION));
+    data.append(char(type));
+    writeVarint(data, size);
+    writeVarint(data, entries.count());
+    // both only ever grow, in microseconds and bytes
+    qint64 lastTime = 0;
+    qint64 lastOffset = 0;
+    for (const Entry& entry : entries) {
+        const qint64 time = qRound64(entry.time * 1e6);
+        writeVarint(data, time - lastTime);
+        writeVarint(data, entry.offset - lastOffset);
+        lastTime = time;
+        lastOffset = entry.offset;
+    }
+    return data;
+}
+
+KeyframeIndex KeyframeIndex::fromData(const QByteArray& data)
+{
+    KeyframeIndex index;
+    if (!data.startsWith(INDEX_MAGIC) || data.size() < 6 || data.at(4) != INDEX_VERSION) {
+        return index;
+    }
+    const uchar* p = reinterpret_cast<const uchar*>(data.constData()) + 6;
+    const uchar* end = reinterpret_cast<const uchar*>(data.constData()) + data.size();
+    quint64 size;
+    quint64 count;
+    if (!readVarint(p, end, &size) || !readVarint(p, end, &count) || count > (quint64)(end - p)) {
+        return index;
+    }
+    index.entries.reserve(count);
+    quint64 time = 0;
+    quint64 offset = 0;
+    for (quint64 i = 0; i < count; ++i) {
+        quint64 timeDelta;
+        quint64 offsetDelta;
+        if (!readVarint(p, end, &timeDelta) || !readVarint(p, end, &offsetDelta)) {
+            return KeyframeIndex();
+        }
+        time += timeDelta;
+        offset += offsetDelta;
+        index.entries.append({ time / 1e6, (qint64)offset });
+    }
+    index.type = static_cast<Container>(data.at(5));
+    index.size = size;
+    return index;
+}
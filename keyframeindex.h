@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+
+#include <functional>
+
+// Keyframe positions of a file whose container doesn't carry a usable index
+// of its own: raw MPEG-TS, AVI without idx1 and Matroska without Cues.
+// Built by scanning the packets of the memory mapped file, without decoding
+// anything. Times are seconds on mpv's timeline: from the first video frame
+// for MPEG-TS, from the first cluster for Matroska.
+class KeyframeIndex
+{
+public:
+    enum Container {
+        None,
+        TransportStream,
+        Avi,
+        Matroska,
+    };
+
+    struct Entry {
+        double time;
+        qint64 offset;
+    };
+
+    // fraction of the file scanned, false stops the scan
+    using Progress = std::function<bool(double fraction)>;
+
+    // the kind of scan a file needs, None when mpv can seek it on its own
+    static Container probe(const QString& path);
+    // an empty index when the scan was stopped or found nothing
+    static KeyframeIndex build(const QString& path, Container container, const Progress& progress);
+
+    Container container() const { return type; }
+    bool isEmpty() const { return entries.isEmpty(); }
+    int count() const { return entries.count(); }
+    qint64 fileSize() const { return size; }
+    // mpv seeks these by byte position when asked for a percentage
+    bool seeksByBytes() const { return type == TransportStream; }
+    // the last keyframe at or before time, nullptr before the first one
+    const Entry* keyframeBefore(double time) const;
+    // the first keyframe after time, nullptr past the last one
+    const Entry* keyframeAfter(double time) const;
+
+    // delta and varint coded, a few bytes per keyframe
+    QByteArray toData() const;
+    static KeyframeIndex fromData(const QByteArray& data);
+
+private:
+    Container type = None;
+    qint64 size = 0;
+    QList<Entry> entries;
+};
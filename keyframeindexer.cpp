@@ -0,0 +1,61 @@
+#include "keyframeindexer.h"
+
+#include <QJsonObject>
+
+#include "analysiscache.h"
+#include "fileidentity.h"
+
+#define KIND "keyframes"
+
+KeyframeIndexer::KeyframeIndexer(AnalysisCache* cache, QObject* parent)
+    : BackgroundWorker(parent)
+    , cache(cache)
+{
+}
+
+KeyframeIndexer::~KeyframeIndexer()
+{
+    stop();
+}
+
+KeyframeIndex KeyframeIndexer::load(quint64 identity) const
+{
+    if (identity == 0) {
+        return KeyframeIndex();
+    }
+    const QJsonObject entry = cache->load(identity, KIND);
+    return KeyframeIndex::fromData(QByteArray::fromBase64(entry.value("data").toString().toLatin1()));
+}
+
+void KeyframeIndexer::process(const QString& file)
+{
+    quint64 identity = fileIdentity(file);
+    if (identity == 0 || cache->contains(identity, KIND)) {
+        return;
+    }
+    const KeyframeIndex::Container container = KeyframeIndex::probe(file);
+    if (container == KeyframeIndex::None) {
+        cache->store(identity, KIND, QJsonObject { { "container", container } });
+        return;
+    }
+    bool stopped = false;
+    KeyframeIndex index = KeyframeIndex::build(file, container, [&](double fraction) {
+        if (!keepGoing()) {
+            stopped = true;
+            return false;
+        }
+        emit progress(file, fraction);
+        return true;
+    });
+    if (stopped) {
+        return;
+    }
+    // an empty index records that scanning didn't help, not to try again
+    cache->store(identity, KIND,
+        QJsonObject {
+            { "container", container },
+            { "keyframes", index.count() },
+            { "data", QString::fromLatin1(index.toData().toBase64()) },
+        });
+    emit indexed(file, identity, index.count());
+}
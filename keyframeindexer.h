@@ -0,0 +1,30 @@
+#pragma once
+
+#include "backgroundworker.h"
+#include "keyframeindex.h"
+
+class AnalysisCache;
+
+// Builds keyframe indexes for queued files that need one, on a thread with
+// idle CPU and I/O priority, and keeps them in the analysis cache. Files
+// that don't need one are remembered as such, so each is probed once.
+class KeyframeIndexer : public BackgroundWorker
+{
+    Q_OBJECT
+public:
+    KeyframeIndexer(AnalysisCache* cache, QObject* parent = nullptr);
+    ~KeyframeIndexer();
+
+    // empty when there is none yet, or the file doesn't need one
+    KeyframeIndex load(quint64 identity) const;
+
+signals:
+    void progress(const QString& file, double fraction);
+    void indexed(const QString& file, quint64 identity, int keyframes);
+
+protected:
+    void process(const QString& file) override;
+
+private:
+    AnalysisCache* cache;
+};
@@ -0,0 +1,103 @@
+#include "letterbox.h"
+
+#include <QtAlgorithms>
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// above limited range black with some room for noise and compression
+#define BLACK_LEVEL 32
+// a row or column is picture once this share of its pixels is brighter
+#define PICTURE_FRACTION 32
+// frames with a picture needed before the bars are trusted
+#define MIN_FRAMES 5
+// share of frames allowed to see less of a bar, bright logos or subtitles in it
+#define OUTLIER_FRACTION 10
+
+// counts the pixels of a row brighter than black, and adds them to the
+// counts of their columns
+static int countBright(const uchar* row, int width, quint16* columns)
+{
+    int count = 0;
+    int x = 0;
+#ifdef __SSE2__
+    const __m128i level = _mm_set1_epi8((char)BLACK_LEVEL);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    for (; x + 16 <= width; x += 16) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        // saturating subtraction leaves zero for everything at or below black
+        __m128i dark = _mm_cmpeq_epi8(_mm_subs_epu8(pixels, level), zero);
+        count += 16 - qPopulationCount((quint32)_mm_movemask_epi8(dark));
+        __m128i bright = _mm_andnot_si128(dark, one);
+        __m128i* sums = reinterpret_cast<__m128i*>(columns + x);
+        _mm_storeu_si128(sums, _mm_add_epi16(_mm_loadu_si128(sums), _mm_unpacklo_epi8(bright, zero)));
+        _mm_storeu_si128(sums + 1, _mm_add_epi16(_mm_loadu_si128(sums + 1), _mm_unpackhi_epi8(bright, zero)));
+    }
+#endif
+    for (; x < width; ++x) {
+        const int bright = row[x] > BLACK_LEVEL;
+        count += bright;
+        columns[x] += bright;
+    }
+    return count;
+}
+
+void LetterboxScanner::process(const uchar* luma, int width, int height, int stride)
+{
+    if (width <= 0 || height <= 0 || height > 0xffff) {
+        return;
+    }
+    columnCounts.assign(width, 0);
+    const int rowMinimum = qMax(1, width / PICTURE_FRACTION);
+    int top = -1;
+    int bottom = -1;
+    for (int y = 0; y < height; ++y) {
+        if (countBright(luma + (qint64)y * stride, width, columnCounts.data()) >= rowMinimum) {
+            if (top < 0) {
+                top = y;
+            }
+            bottom = y;
+        }
+    }
+    // all black, a fade or the credits' gaps
+    if (top < 0) {
+        return;
+    }
+    const int columnMinimum = qMax(1, height / PICTURE_FRACTION);
+    int left = 0;
+    while (left < width && columnCounts[left] < columnMinimum) {
+        left++;
+    }
+    int right = width - 1;
+    while (right > left && columnCounts[right] < columnMinimum) {
+        right--;
+    }
+    if (left >= width) {
+        return;
+    }
+    found.append(Letterbox { left, top, width - 1 - right, height - 1 - bottom });
+}
+
+Letterbox LetterboxScanner::bars() const
+{
+    if (found.count() < MIN_FRAMES) {
+        return Letterbox();
+    }
+    // per side, the narrowest bar once the outliers are dropped, cropping
+    // too little beats cutting into the picture
+    const int index = found.count() / OUTLIER_FRACTION;
+    auto side = [&](int Letterbox::*member) {
+        QList<int> values;
+        for (const Letterbox& bars : found) {
+            values << bars.*member;
+        }
+        std::sort(values.begin(), values.end());
+        // even, so chroma stays aligned
+        return values.at(index) & ~1;
+    };
+    return Letterbox { side(&Letterbox::left), side(&Letterbox::top), side(&Letterbox::right), side(&Letterbox::bottom) };
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <QList>
+#include <QtGlobal>
+
+#include <vector>
+
+// black bars around the picture, in pixels of the decoded frame
+struct Letterbox {
+    int left = 0;
+    int top = 0;
+    int right = 0;
+    int bottom = 0;
+
+    bool isNull() const { return left == 0 && top == 0 && right == 0 && bottom == 0; }
+};
+
+// Finds the black bars of a file from 8 bit luma planes of frames sampled
+// across it. Every row and column is counted as picture once enough of its
+// pixels are brighter than black; the bars that most frames agree on win, so
+// dark scenes and subtitles burned into a bar don't move them.
+class LetterboxScanner
+{
+public:
+    void process(const uchar* luma, int width, int height, int stride);
+    // null while too few of the frames had a picture
+    Letterbox bars() const;
+    int frames() const { return found.count(); }
+
+private:
+    std::vector<quint16> columnCounts;
+    QList<Letterbox> found;
+};
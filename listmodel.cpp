@@ -1,14 +1,45 @@
 #include "listmodel.h"
 
+#include <QFileInfo>
 #include <QModelIndex>
 
-ListModel::ListModel(QObject* parent)
-    : QStandardItemModel(parent)
+#include <algorithm>
+
+#include "playliststyle.h"
+#include "playqueue.h"
+
+ListModel::ListModel(PlayQueue* queue, QObject* parent)
+    : QAbstractListModel(parent)
+    , queue(queue)
 {
 }
 
 ListModel::~ListModel() { }
 
+int ListModel::rowCount(const QModelIndex& parent) const
+{
+    return parent.isValid() ? 0 : queue->count();
+}
+
+QVariant ListModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid() || index.row() >= queue->count()) {
+        return QVariant();
+    }
+    const QString& file = queue->at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        // only the name is cut off, nothing is asked of the disk
+        return file.contains("://") ? file : QFileInfo(file).completeBaseName();
+    case Qt::ToolTipRole:
+    case DATA_PATH:
+        return file;
+    case DATA_CURRENT:
+        return index.row() == queue->current();
+    }
+    return QVariant();
+}
+
 bool ListModel::moveRows(const QModelIndex& sourceParent, int sourceRow, int count, const QModelIndex& destinationParent, int destinationChild)
 {
     int dest = destinationChild;
@@ -26,3 +57,87 @@ Qt::ItemFlags ListModel::flags(const QModelIndex& index) const
     }
     return Qt::ItemIsEnabled | Qt::ItemIsSelectable | Qt::ItemNeverHasChildren | Qt::ItemIsDragEnabled;
 }
+
+Qt::DropActions ListModel::supportedDropActions() const
+{
+    return Qt::MoveAction;
+}
+
+void ListModel::append(const QStringList& files)
+{
+    if (files.isEmpty()) {
+        return;
+    }
+    beginInsertRows(QModelIndex(), queue->count(), queue->count() + files.count() - 1);
+    queue->append(files);
+    endInsertRows();
+}
+
+void ListModel::move(const QList<int>& rows, int to)
+{
+    if (rows.isEmpty()) {
+        return;
+    }
+    if (rows.last() - rows.first() + 1 == rows.count()) {
+        // one block, false when it wouldn't go anywhere
+        if (beginMoveRows(QModelIndex(), rows.first(), rows.last(), QModelIndex(), to)) {
+            queue->move(rows, to);
+            endMoveRows();
+        }
+        return;
+    }
+    // scattered rows come together, every row in between shifts and the
+    // selection is carried along by hand
+    emit layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+    const int dest = to - int(std::lower_bound(rows.begin(), rows.end(), to) - rows.begin());
+    QList<int> moved(queue->count());
+    int next = 0;
+    int survivor = 0;
+    for (int row = 0; row < moved.count(); ++row) {
+        if (next < rows.count() && rows.at(next) == row) {
+            moved[row] = dest + next++;
+        }
+        else {
+            moved[row] = survivor < dest ? survivor : survivor + rows.count();
+            survivor++;
+        }
+    }
+    queue->move(rows, to);
+    const QModelIndexList before = persistentIndexList();
+    QModelIndexList after;
+    after.reserve(before.count());
+    for (const QModelIndex& index : before) {
+        after << this->index(moved.at(index.row()), 0);
+    }
+    changePersistentIndexList(before, after);
+    emit layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+}
+
+void ListModel::remove(const QList<int>& rows)
+{
+    // each run of rows goes on its own, from the last, so the rows views
+    // are told about always match the queue
+    int last = rows.count() - 1;
+    while (last >= 0) {
+        int first = last;
+        while (first > 0 && rows.at(first - 1) == rows.at(first) - 1) {
+            first--;
+        }
+        beginRemoveRows(QModelIndex(), rows.at(first), rows.at(last));
+        queue->remove(rows.mid(first, last - first + 1));
+        endRemoveRows();
+        last = first - 1;
+    }
+    // a removed current entry hands over to the one that took its place
+    currentMoved(-1);
+}
+
+void ListModel::currentMoved(int previous)
+{
+    for (int row : { previous, queue->current() }) {
+        if (row >= 0 && row < queue->count()) {
+            const QModelIndex changed = index(row, 0);
+            emit dataChanged(changed, changed, { DATA_CURRENT });
+        }
+    }
+}
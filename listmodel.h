@@ -1,18 +1,36 @@
 #pragma once
 
-#include <QStandardItemModel>
+#include <QAbstractListModel>
 #include <QObject>
+#include <QStringList>
 
-class ListModel : public QStandardItemModel
+class PlayQueue;
+
+// The play queue as rows, read straight from it. Edits of its rows go
+// through here so views hear which rows changed instead of a reset.
+class ListModel : public QAbstractListModel
 {
     Q_OBJECT
 public:
-    ListModel(QObject* parent = nullptr);
+    ListModel(PlayQueue* queue, QObject* parent = nullptr);
     ~ListModel();
 
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
     bool moveRows(const QModelIndex& sourceParent, int sourceRow, int count, const QModelIndex& destinationParent, int destinationChild) override;
     Qt::ItemFlags flags(const QModelIndex & index) const override;
+    Qt::DropActions supportedDropActions() const override;
+
+    // PlayQueue's edits, with the same arguments
+    void append(const QStringList& files);
+    void move(const QList<int>& rows, int to);
+    void remove(const QList<int>& rows);
+    // the current entry moved away from row `previous`, -1 for none
+    void currentMoved(int previous);
 
 signals:
     void playlistMove(int from, int to);
+
+private:
+    PlayQueue* queue;
 };
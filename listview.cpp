@@ -1,9 +1,14 @@
 #include "listview.h"
 
+#include <QDropEvent>
+#include <QMouseEvent>
+
+#include <algorithm>
+
 ListView::ListView(QWidget* parent)
     : QListView(parent)
 {
-    setSelectionMode(QAbstractItemView::SingleSelection);
+    setSelectionMode(QAbstractItemView::ExtendedSelection);
     setDragEnabled(true);
     viewport()->setAcceptDrops(true);
     setDragDropMode(QAbstractItemView::InternalMove);
@@ -12,3 +17,55 @@ ListView::ListView(QWidget* parent)
 ListView::~ListView()
 {
 }
+
+QList<int> ListView::selectedRows() const
+{
+    QList<int> rows;
+    const QModelIndexList indexes = selectionModel()->selectedRows();
+    for (const QModelIndex& index : indexes) {
+        rows << index.row();
+    }
+    std::sort(rows.begin(), rows.end());
+    return rows;
+}
+
+void ListView::dropEvent(QDropEvent* event)
+{
+    if (event->source() != this) {
+        QListView::dropEvent(event);
+        return;
+    }
+    // the whole selection moves at once instead of QListView's row by row
+    // moveRow calls, the queue is reordered through the model
+    QModelIndex index = indexAt(event->position().toPoint());
+    int to = model()->rowCount();
+    if (index.isValid()) {
+        to = dropIndicatorPosition() == QAbstractItemView::BelowItem ? index.row() + 1 : index.row();
+    }
+    const QList<int> rows = selectedRows();
+    if (!rows.isEmpty()) {
+        emit rowsDropped(rows, to);
+    }
+    // nothing for the drag source to remove
+    event->setDropAction(Qt::IgnoreAction);
+    event->accept();
+    setState(QAbstractItemView::NoState);
+    viewport()->update();
+}
+
+void ListView::mouseDoubleClickEvent(QMouseEvent* event)
+{
+    // the delegate's buttons take it as their second click before the row
+    // would be double clicked
+    QModelIndex index = indexAt(event->position().toPoint());
+    if (index.isValid()) {
+        QStyleOptionViewItem option;
+        initViewItemOption(&option);
+        option.rect = visualRect(index);
+        if (itemDelegateForIndex(index)->editorEvent(event, model(), option, index)) {
+            update(index);
+            return;
+        }
+    }
+    QListView::mouseDoubleClickEvent(event);
+}
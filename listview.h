@@ -9,5 +9,14 @@ public:
     ListView(QWidget* parent = nullptr);
     ~ListView();
 
-// protected:
+    // selected rows, in order
+    QList<int> selectedRows() const;
+
+signals:
+    // the rows were dragged in front of row `to`, one block in their order
+    void rowsDropped(const QList<int>& rows, int to);
+
+protected:
+    void dropEvent(QDropEvent* event) override;
+    void mouseDoubleClickEvent(QMouseEvent* event) override;
 };
@@ -0,0 +1,197 @@
+#include "logcapture.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#define WAIT_SECS 0.5
+
+LogCapture::LogCapture(mpv_handle* core, QObject* parent)
+    : QThread(parent)
+    , client(mpv_create_client(core, "fastplayer-log"))
+    , ring(Capacity)
+    , stopping(false)
+    , notified(false)
+{
+}
+
+LogCapture::~LogCapture()
+{
+    stop();
+    // already gone if mpv shut down first
+    if (client) {
+        mpv_destroy(client);
+    }
+}
+
+QStringList LogCapture::levelNames()
+{
+    return { "no", "fatal", "error", "warn", "info", "v", "debug", "trace" };
+}
+
+QString LogCapture::levelName(int level)
+{
+    switch (level) {
+    case MPV_LOG_LEVEL_FATAL:
+        return "fatal";
+    case MPV_LOG_LEVEL_ERROR:
+        return "error";
+    case MPV_LOG_LEVEL_WARN:
+        return "warn";
+    case MPV_LOG_LEVEL_INFO:
+        return "info";
+    case MPV_LOG_LEVEL_V:
+        return "v";
+    case MPV_LOG_LEVEL_DEBUG:
+        return "debug";
+    case MPV_LOG_LEVEL_TRACE:
+        return "trace";
+    default:
+        return "no";
+    }
+}
+
+void LogCapture::setLevel(const QString& level)
+{
+    QMutexLocker locker(&mutex);
+    if (client) {
+        mpv_request_log_messages(client, level.toUtf8().constData());
+    }
+}
+
+void LogCapture::setFile(const QString& path, qint64 maxBytes)
+{
+    QMutexLocker locker(&mutex);
+    filePath = path;
+    maxFileBytes = maxBytes;
+    fileChanged = true;
+}
+
+QList<LogCapture::Entry> LogCapture::entries(quint64 after) const
+{
+    notified = false;
+    QMutexLocker locker(&mutex);
+    const int count = (int)qMin<quint64>(size, sequence - qMin(after, sequence));
+    QList<Entry> list;
+    list.reserve(count);
+    for (int i = 0; i < count; ++i) {
+        list << ring[(head + Capacity - count + i) % Capacity];
+    }
+    return list;
+}
+
+void LogCapture::stop()
+{
+    stopping = true;
+    {
+        QMutexLocker locker(&mutex);
+        if (client) {
+            mpv_wakeup(client);
+        }
+    }
+    wait();
+}
+
+void LogCapture::run()
+{
+    if (!client) {
+        return;
+    }
+    std::vector<Entry> batch;
+    while (!stopping) {
+        // everything that piled up since the last wakeup goes in one batch
+        double timeout = WAIT_SECS;
+        while (mpv_event* event = mpv_wait_event(client, timeout)) {
+            timeout = 0;
+            if (event->event_id == MPV_EVENT_NONE) {
+                break;
+            }
+            if (event->event_id == MPV_EVENT_SHUTDOWN) {
+                // mpv_terminate_destroy() waits for every client to go
+                QMutexLocker locker(&mutex);
+                mpv_destroy(client);
+                client = nullptr;
+                stopping = true;
+                break;
+            }
+            if (event->event_id == MPV_EVENT_LOG_MESSAGE) {
+                auto message = (mpv_event_log_message*)event->data;
+                Entry entry;
+                entry.time = QDateTime::currentMSecsSinceEpoch();
+                entry.level = message->log_level;
+                entry.prefix = message->prefix;
+                entry.text = message->text;
+                if (entry.text.endsWith('\n')) {
+                    entry.text.chop(1);
+                }
+                batch.push_back(std::move(entry));
+            }
+        }
+        if (batch.empty() && !fileChanged) {
+            continue;
+        }
+        {
+            QMutexLocker locker(&mutex);
+            for (Entry& entry : batch) {
+                entry.sequence = ++sequence;
+                ring[head] = entry;
+                head = (head + 1) % Capacity;
+                size = qMin(size + 1, Capacity);
+            }
+        }
+        writeFile(batch);
+        if (!batch.empty() && !notified.exchange(true)) {
+            emit appended();
+        }
+        batch.clear();
+    }
+    file.close();
+}
+
+void LogCapture::writeFile(const std::vector<Entry>& batch)
+{
+    QString path;
+    qint64 maxBytes;
+    {
+        QMutexLocker locker(&mutex);
+        if (fileChanged) {
+            file.close();
+            fileChanged = false;
+        }
+        path = filePath;
+        maxBytes = maxFileBytes;
+    }
+    if (path.isEmpty()) {
+        return;
+    }
+    if (!file.isOpen()) {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+        file.setFileName(path);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+            return;
+        }
+    }
+    QByteArray lines;
+    for (const Entry& entry : batch) {
+        lines += QDateTime::fromMSecsSinceEpoch(entry.time).toString(Qt::ISODateWithMs).toUtf8();
+        lines += " [" + entry.prefix + "] " + levelName(entry.level).toUtf8() + ": " + entry.text + '\n';
+    }
+    file.write(lines);
+    file.flush();
+    if (maxBytes > 0 && file.size() > maxBytes) {
+        rotate();
+    }
+}
+
+void LogCapture::rotate()
+{
+    const QString path = file.fileName();
+    file.close();
+    QFile::remove(QString("%1.%2").arg(path).arg(KeepFiles));
+    for (int i = KeepFiles - 1; i > 0; --i) {
+        QFile::rename(QString("%1.%2").arg(path).arg(i), QString("%1.%2").arg(path).arg(i + 1));
+    }
+    QFile::rename(path, path + ".1");
+    // reopened by the next batch
+}
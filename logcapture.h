@@ -0,0 +1,78 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+#include <mpv/client.h>
+
+#include <atomic>
+#include <vector>
+
+// mpv's log, taken off a client handle of its own on a thread of its own so
+// messages never queue up with the player's events or block on a terminal.
+// The latest messages are kept in a ring for the viewer, and optionally
+// appended to a file that rotates once it grows past a limit.
+class LogCapture : public QThread
+{
+    Q_OBJECT
+public:
+    struct Entry {
+        // counts up from 1 over the whole session
+        quint64 sequence = 0;
+        // ms since epoch
+        qint64 time = 0;
+        // mpv_log_level
+        int level = 0;
+        QByteArray prefix;
+        QByteArray text;
+    };
+
+    static const int Capacity = 20000;
+    // rotated files kept next to the current one
+    static const int KeepFiles = 3;
+
+    LogCapture(mpv_handle* core, QObject* parent = nullptr);
+    ~LogCapture();
+
+    // mpv's level names, most severe first
+    static QStringList levelNames();
+    static QString levelName(int level);
+
+    // one of levelNames(), messages below it are never formatted by mpv
+    void setLevel(const QString& level);
+    // an empty path stops writing
+    void setFile(const QString& path, qint64 maxBytes);
+    // oldest first, only those after sequence `after` when given
+    QList<Entry> entries(quint64 after = 0) const;
+    void stop();
+
+signals:
+    // at most one queued until entries() is called
+    void appended();
+
+protected:
+    void run() override;
+
+private:
+    // destroyed by the thread once mpv shuts down, under the mutex
+    mpv_handle* client;
+    mutable QMutex mutex;
+    std::vector<Entry> ring;
+    int head = 0;
+    int size = 0;
+    quint64 sequence = 0;
+    QString filePath;
+    qint64 maxFileBytes = 0;
+    bool fileChanged = false;
+    QFile file;
+    std::atomic_bool stopping;
+    mutable std::atomic_bool notified;
+
+    void writeFile(const std::vector<Entry>& batch);
+    void rotate();
+};
@@ -0,0 +1,219 @@
+#include "loudness.h"
+
+#include <QtMath>
+
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define TAPS 12
+#define PHASES 4
+#define ABSOLUTE_GATE -70.0
+#define RELATIVE_GATE -10.0
+
+// BS.1770-4 annex 2 interpolation filter, one row per output phase
+static const float interpolation[PHASES][TAPS] = {
+    { 0.0017089843750f, 0.0109863281250f, -0.0196533203125f, 0.0332031250000f, -0.0594482421875f, 0.1373291015625f,
+        0.9721679687500f, -0.1022949218750f, 0.0476074218750f, -0.0266113281250f, 0.0148925781250f, -0.0083007812500f },
+    { -0.0291748046875f, 0.0292968750000f, -0.0517578125000f, 0.0891113281250f, -0.1665039062500f, 0.4650878906250f,
+        0.7797851562500f, -0.2003173828125f, 0.1015625000000f, -0.0582275390625f, 0.0330810546875f, -0.0189208984375f },
+    { -0.0189208984375f, 0.0330810546875f, -0.0582275390625f, 0.1015625000000f, -0.2003173828125f, 0.7797851562500f,
+        0.4650878906250f, -0.1665039062500f, 0.0891113281250f, -0.0517578125000f, 0.0292968750000f, -0.0291748046875f },
+    { -0.0083007812500f, 0.0148925781250f, -0.0266113281250f, 0.0476074218750f, -0.1022949218750f, 0.9721679687500f,
+        0.1373291015625f, -0.0594482421875f, 0.0332031250000f, -0.0196533203125f, 0.0109863281250f, 0.0017089843750f },
+};
+
+#ifdef __SSE2__
+// the same filter transposed, the four phases of each tap side by side in
+// the window's oldest to newest order
+struct PhaseColumns {
+    alignas(16) float taps[TAPS][PHASES];
+    PhaseColumns()
+    {
+        for (int t = 0; t < TAPS; ++t) {
+            for (int phase = 0; phase < PHASES; ++phase) {
+                taps[t][phase] = interpolation[phase][TAPS - 1 - t];
+            }
+        }
+    }
+};
+static const PhaseColumns phaseColumns;
+#endif
+
+static double energyToLoudness(double energy)
+{
+    return energy > 0 ? -0.691 + 10 * log10(energy) : -HUGE_VAL;
+}
+
+LoudnessMeter::LoudnessMeter(int sampleRate, int channelCount)
+    : channels(qBound(1, channelCount, LOUDNESS_MAX_CHANNELS))
+    , stepFrames(sampleRate / 10)
+{
+    // the two K-weighting stages for any sample rate, from the analog
+    // prototypes behind the 48 kHz coefficients in the standard
+    double f0 = 1681.974450955533;
+    double gain = 3.999843853973347;
+    double q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / sampleRate);
+    double vh = pow(10, gain / 20);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1 + k / q + k * k;
+    shelf = { (vh + vb * k / q + k * k) / a0, 2 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+        2 * (k * k - 1) / a0, (1 - k / q + k * k) / a0 };
+
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / sampleRate);
+    a0 = 1 + k / q + k * k;
+    highpass = { 1, -2, 1, 2 * (k * k - 1) / a0, (1 - k / q + k * k) / a0 };
+
+    // surround channels count more, LFE not at all
+    for (int c = 0; c < LOUDNESS_MAX_CHANNELS; ++c) {
+        weights[c] = 1;
+    }
+    if (channels == 6) {
+        weights[3] = 0;
+        weights[4] = 1.41;
+        weights[5] = 1.41;
+    }
+}
+
+// The filters are recursive in time, so the work is laid out across
+// channels instead: with SSE2 both K-weighting stages run on two channels per
+// register, and the four interpolation phases of a channel come out of one
+// register per tap instead of four dot products.
+void LoudnessMeter::process(const float* samples, qint64 frames)
+{
+    const int n = channels;
+#ifdef __SSE2__
+    const __m128d sb0 = _mm_set1_pd(shelf.b0), sb1 = _mm_set1_pd(shelf.b1), sb2 = _mm_set1_pd(shelf.b2);
+    const __m128d sa1 = _mm_set1_pd(shelf.a1), sa2 = _mm_set1_pd(shelf.a2);
+    const __m128d hb0 = _mm_set1_pd(highpass.b0), hb1 = _mm_set1_pd(highpass.b1), hb2 = _mm_set1_pd(highpass.b2);
+    const __m128d ha1 = _mm_set1_pd(highpass.a1), ha2 = _mm_set1_pd(highpass.a2);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    __m128 peaks = _mm_set1_ps(peak);
+#endif
+    for (qint64 i = 0; i < frames; ++i) {
+        const float* in = samples + i * n;
+
+        int c = 0;
+#ifdef __SSE2__
+        for (; c + 2 <= n; c += 2) {
+            const __m128d x = _mm_cvtps_pd(_mm_setr_ps(in[c], in[c + 1], 0, 0));
+            const __m128d s = _mm_add_pd(_mm_mul_pd(sb0, x), _mm_loadu_pd(shelfZ1 + c));
+            _mm_storeu_pd(shelfZ1 + c, _mm_add_pd(_mm_sub_pd(_mm_mul_pd(sb1, x), _mm_mul_pd(sa1, s)), _mm_loadu_pd(shelfZ2 + c)));
+            _mm_storeu_pd(shelfZ2 + c, _mm_sub_pd(_mm_mul_pd(sb2, x), _mm_mul_pd(sa2, s)));
+            const __m128d y = _mm_add_pd(_mm_mul_pd(hb0, s), _mm_loadu_pd(highpassZ1 + c));
+            _mm_storeu_pd(highpassZ1 + c, _mm_add_pd(_mm_sub_pd(_mm_mul_pd(hb1, s), _mm_mul_pd(ha1, y)), _mm_loadu_pd(highpassZ2 + c)));
+            _mm_storeu_pd(highpassZ2 + c, _mm_sub_pd(_mm_mul_pd(hb2, s), _mm_mul_pd(ha2, y)));
+            _mm_storeu_pd(stepEnergy + c, _mm_add_pd(_mm_loadu_pd(stepEnergy + c), _mm_mul_pd(y, y)));
+        }
+#endif
+        for (; c < n; ++c) {
+            const double x = in[c];
+            const double s = shelf.b0 * x + shelfZ1[c];
+            shelfZ1[c] = shelf.b1 * x - shelf.a1 * s + shelfZ2[c];
+            shelfZ2[c] = shelf.b2 * x - shelf.a2 * s;
+            const double y = highpass.b0 * s + highpassZ1[c];
+            highpassZ1[c] = highpass.b1 * s - highpass.a1 * y + highpassZ2[c];
+            highpassZ2[c] = highpass.b2 * s - highpass.a2 * y;
+            stepEnergy[c] += y * y;
+        }
+
+        historyPos = (historyPos + 1) % TAPS;
+        for (c = 0; c < n; ++c) {
+            history[c][historyPos] = in[c];
+            history[c][historyPos + TAPS] = in[c];
+            // oldest to newest, reversed against the filter order
+            const float* window = &history[c][historyPos + 1];
+#ifdef __SSE2__
+            __m128 sum = _mm_setzero_ps();
+            for (int t = 0; t < TAPS; ++t) {
+                sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(window[t]), _mm_load_ps(phaseColumns.taps[t])));
+            }
+            peaks = _mm_max_ps(peaks, _mm_andnot_ps(signMask, sum));
+#else
+            for (int phase = 0; phase < PHASES; ++phase) {
+                float sum = 0;
+                for (int t = 0; t < TAPS; ++t) {
+                    sum += window[t] * interpolation[phase][TAPS - 1 - t];
+                }
+                peak = qMax(peak, std::fabs(sum));
+            }
+#endif
+        }
+
+        if (++stepFilled == stepFrames) {
+            finishStep();
+        }
+    }
+#ifdef __SSE2__
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, peaks);
+    peak = qMax(qMax(lanes[0], lanes[1]), qMax(lanes[2], lanes[3]));
+#endif
+}
+
+void LoudnessMeter::finishStep()
+{
+    for (int c = 0; c < channels; ++c) {
+        recentSteps[stepsSeen % 4][c] = stepEnergy[c];
+        stepEnergy[c] = 0;
+    }
+    stepFilled = 0;
+    stepsSeen++;
+    if (stepsSeen < 4) {
+        return;
+    }
+    // one 400 ms block ends at every 100 ms step
+    double energy = 0;
+    for (int c = 0; c < channels; ++c) {
+        double sum = recentSteps[0][c] + recentSteps[1][c] + recentSteps[2][c] + recentSteps[3][c];
+        energy += weights[c] * sum / (4.0 * stepFrames);
+    }
+    blocks.push_back(energy);
+}
+
+double LoudnessMeter::integrated() const
+{
+    const double absoluteEnergy = pow(10, (ABSOLUTE_GATE + 0.691) / 10);
+    double sum = 0;
+    qint64 count = 0;
+    for (double energy : blocks) {
+        if (energy > absoluteEnergy) {
+            sum += energy;
+            count++;
+        }
+    }
+    if (count == 0) {
+        return ABSOLUTE_GATE;
+    }
+    const double relativeEnergy = sum / count * pow(10, RELATIVE_GATE / 10);
+    const double gate = qMax(absoluteEnergy, relativeEnergy);
+    sum = 0;
+    count = 0;
+    for (double energy : blocks) {
+        if (energy > gate) {
+            sum += energy;
+            count++;
+        }
+    }
+    return count > 0 ? energyToLoudness(sum / count) : ABSOLUTE_GATE;
+}
+
+double LoudnessMeter::truePeak() const
+{
+    return peak > 0 ? 20 * log10(peak) : -HUGE_VAL;
+}
+
+QJsonObject LoudnessMeter::result()
+{
+    double peakDb = truePeak();
+    return {
+        { "integrated", integrated() },
+        { "true-peak", std::isfinite(peakDb) ? peakDb : -144.0 },
+        { "duration", (double)(stepsSeen * stepFrames + stepFilled) / (stepFrames * 10) },
+    };
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <vector>
+
+#include "audioscanner.h"
+
+#define LOUDNESS_MAX_CHANNELS 8
+
+// Integrated loudness and true peak as defined by ITU-R BS.1770-4 and
+// EBU R128: K-weighting, 400 ms blocks with 75% overlap, an absolute gate at
+// -70 LUFS and a relative one 10 LU below the ungated mean, plus a 4x
+// oversampled peak.
+class LoudnessMeter : public AudioSink
+{
+public:
+    LoudnessMeter(int sampleRate, int channels);
+
+    void process(const float* samples, qint64 frames) override;
+    QJsonObject result() override;
+
+    // LUFS, -70 or below for silence
+    double integrated() const;
+    // dBTP
+    double truePeak() const;
+
+private:
+    struct Biquad {
+        double b0, b1, b2, a1, a2;
+    };
+
+    int channels;
+    double weights[LOUDNESS_MAX_CHANNELS];
+    Biquad shelf;
+    Biquad highpass;
+    // transposed direct form II state, per stage and channel
+    double shelfZ1[LOUDNESS_MAX_CHANNELS] = {};
+    double shelfZ2[LOUDNESS_MAX_CHANNELS] = {};
+    double highpassZ1[LOUDNESS_MAX_CHANNELS] = {};
+    double highpassZ2[LOUDNESS_MAX_CHANNELS] = {};
+
+    // energy of the current 100 ms step and the three before it
+    int stepFrames;
+    int stepFilled = 0;
+    double stepEnergy[LOUDNESS_MAX_CHANNELS] = {};
+    double recentSteps[4][LOUDNESS_MAX_CHANNELS] = {};
+    int stepsSeen = 0;
+    std::vector<double> blocks;
+
+    // the last taps of input per channel, written twice so a window is
+    // always contiguous
+    float history[LOUDNESS_MAX_CHANNELS][24] = {};
+    int historyPos = 0;
+    float peak = 0;
+
+    void finishStep();
+};
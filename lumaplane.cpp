@@ -0,0 +1,35 @@
+#include "lumaplane.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libavutil/pixdesc.h>
+}
+
+const uchar* lumaPlane(const AVFrame* frame, std::vector<uchar>& scratch, int* stride)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    if (!desc || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+        return nullptr;
+    }
+    const int depth = desc->comp[0].depth;
+    // not interleaved with chroma
+    if (desc->comp[0].plane != 0 || desc->comp[0].step != (depth > 8 ? 2 : 1)) {
+        return nullptr;
+    }
+    if (depth <= 8) {
+        *stride = frame->linesize[0];
+        return frame->data[0];
+    }
+    // P010 and friends keep the samples at the top of the 16 bits already
+    const int shift = depth - 8 + desc->comp[0].shift;
+    scratch.resize((size_t)frame->width * frame->height);
+    for (int y = 0; y < frame->height; ++y) {
+        const quint16* row = reinterpret_cast<const quint16*>(frame->data[0] + (qint64)y * frame->linesize[0]);
+        uchar* out = scratch.data() + (qint64)y * frame->width;
+        for (int x = 0; x < frame->width; ++x) {
+            out[x] = row[x] >> shift;
+        }
+    }
+    *stride = frame->width;
+    return scratch.data();
+}
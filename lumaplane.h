@@ -0,0 +1,12 @@
+#pragma once
+
+#include <QtGlobal>
+
+#include <vector>
+
+struct AVFrame;
+
+// The frame's luma at 8 bits, with its stride: the plane itself, or the top
+// 8 bits of each sample copied into scratch for deeper formats. nullptr when
+// luma doesn't have a plane of its own, RGB, paletted and hardware frames.
+const uchar* lumaPlane(const AVFrame* frame, std::vector<uchar>& scratch, int* stride);
@@ -1,4 +1,5 @@
 #include "mainwindow.h"
+#include "trace.h"
 #include <QApplication>
 #include <QCommandLineParser>
 #include <QDBusConnection>
@@ -14,6 +15,8 @@ int main(int argc, char* argv[])
     QCoreApplication::setApplicationName("fastplayer");
     QCoreApplication::setOrganizationName("fastplayer");
     bool isNew = false;
+    QString ipcServer;
+    QString tracePath = qEnvironmentVariable("FASTPLAYER_TRACE");
     QStringList files;
     QVariantList var;
     QStringList arguments(a.arguments());
@@ -26,6 +29,8 @@ int main(int argc, char* argv[])
             qInfo() << "Options:";
             qInfo() << "-h, --help\tShow this message";
             qInfo() << "-n, --new\tOpens a new instance";
+            qInfo() << "--ipc-server=<path>\tListen for JSON IPC commands on <path>";
+            qInfo() << "--trace=<path>\tWrite a Chrome trace to <path> on exit (or set FASTPLAYER_TRACE)";
             qInfo() << "";
             qInfo() << "When opening files without '--new', files are added to the running instance.";
             qInfo() << "If no file is provided, always opens a new instance.";
@@ -35,6 +40,14 @@ int main(int argc, char* argv[])
             isNew = true;
             continue;
         }
+        if (arg.startsWith("--ipc-server=")) {
+            ipcServer = arg.mid(QString("--ipc-server=").length());
+            continue;
+        }
+        if (arg.startsWith("--trace=")) {
+            tracePath = arg.mid(QString("--trace=").length());
+            continue;
+        }
         QFileInfo info(arg);
         if (info.exists()) {
             if (info.isDir()) {
@@ -66,11 +79,19 @@ int main(int argc, char* argv[])
     // Qt sets the locale in the QApplication constructor, but libmpv requires
     // the LC_NUMERIC category to be set to "C", so change it back.
     setlocale(LC_NUMERIC, "C");
+    if (!tracePath.isEmpty()) {
+        Trace::start(tracePath);
+    }
     MainWindow w;
+    if (!ipcServer.isEmpty()) {
+        w.startIpcServer(ipcServer);
+    }
     if (files.count() > 0) {
         w.loadFiles(files);
     }
     w.show();
 
-    return a.exec();
+    int status = a.exec();
+    Trace::stop();
+    return status;
 }
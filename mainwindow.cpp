@@ -1,46 +1,89 @@
+#include <algorithm>
 #include <clocale>
 #include <cmath>
+#include <memory>
 
 #include <QApplication>
 #include <QCheckBox>
+#include <QClipboard>
 #include <QColorDialog>
 #include <QDBusConnection>
 #include <QDBusConnectionInterface>
 #include <QDBusServiceWatcher>
+#include <QDialogButtonBox>
 #include <QDockWidget>
 #include <QFileDialog>
 #include <QFontComboBox>
+#include <QFontDatabase>
 #include <QFormLayout>
 #include <QGridLayout>
+#include <QHash>
+#include <QInputDialog>
 #include <QJsonDocument>
+#include <QJsonObject>
 #include <QLabel>
+#include <QLineEdit>
+#include <QListWidget>
 #include <QMenu>
 #include <QMenuBar>
+#include <QMessageBox>
 #include <QMimeData>
 #include <QMouseEvent>
 #include <QPainter>
 #include <QPixmap>
+#include <QPlainTextEdit>
+#include <QProgressDialog>
+#include <QStandardPaths>
 #include <QStatusBar>
 #include <QTabWidget>
 #include <QTextEdit>
+#include <QThreadPool>
+#include <QTimer>
+#include <QTimeEdit>
 #include <QToolTip>
 #include <QtGlobal>
 #include <QtMath>
 
 #include <QTextStream>
 
+#include "analysiscache.h"
+#include "audioscanner.h"
+#include "cachewarmer.h"
+#include "cropdetector.h"
+#include "fileidentity.h"
+#include "frameexporter.h"
+#include "keyframeindexer.h"
+#include "framestepper.h"
+#include "ipcserver.h"
 #include "listmodel.h"
 #include "listview.h"
+#include "logcapture.h"
+#include "stallwatchdog.h"
+#include "loudness.h"
 #include "mainwindow.h"
 #include "mpvwidget.h"
 #include "playliststyle.h"
+#include "progressbar.h"
+#include "resumestore.h"
+#include "scenedetector.h"
+#include "segmentexporter.h"
+#include "silence.h"
+#include "screenshot.h"
+#include "subtitlesearch.h"
+#include "trace.h"
+#include "waveform.h"
 #include "qthelper.hpp"
 
 #define MAX_VOLUME 130
 #define LOG qInfo()
+// silence kept at either end of a skip, so speech isn't clipped
+#define SILENCE_MARGIN_SECS 0.3
+#define PLAYLIST_BATCH_REPLY 1
 
 MainWindow::MainWindow(QWidget* parent)
     : QMainWindow(parent)
+    , settings(new Settings(this))
+    , config(settings->config())
     , muted(false)
     , paused(false)
     , time(0)
@@ -50,9 +93,17 @@ MainWindow::MainWindow(QWidget* parent)
     // and removed the ones i think are irrelevant (never saw/heard of them)
     , videoExt({ "webm", "mkv", "flv", "vob", "ogv", "gif", "avi", "mov", "qt", "wmv", "rm", "rmvb", "asf", "amv", "mp4", "m4v", "mp4v", "mpg", "mp2", "mpeg", "3gp", "mpts", "m2ts", "ts" })
     , supportedSubs({ "ass", "idx", "lrc", "mks", "pgs", "rt", "sbv", "scc", "smi", "srt", "ssa", "sub", "sup", "utf", "utf-8", "utf8", "vtt" })
+    , subtitleIndex(supportedSubs)
     , boundKeys({ Qt::Key_Right, Qt::Key_Left, Qt::Key_Up, Qt::Key_Down, Qt::Key_Escape, Qt::Key_Return, Qt::Key_Enter })
-    , cropH(0)
-    , cropV(0)
+    , adjustmentsQueued(false)
+    , videoWidth(0)
+    , videoHeight(0)
+    , currentIdentity(0)
+    , currentTime(0)
+    , currentAid(-1)
+    , currentSid(-1)
+    , sourceThroughput(0)
+    , cacheStalled(false)
     , eofReached(false)
 {
     setWindowTitle("fastplayer");
@@ -78,7 +129,7 @@ MainWindow::MainWindow(QWidget* parent)
     // speedSpin->setFocusPolicy(Qt::FocusPolicy::NoFocus);
     speedSpin->setRange(10, 500);
     speedSpin->setSingleStep(10);
-    speedSpin->setValue(playbackSpeed);
+    speedSpin->setValue(config.playbackSpeed);
     speedSpin->setSuffix("%");
 
     zoomSpin = new QSpinBox;
@@ -155,9 +206,14 @@ MainWindow::MainWindow(QWidget* parent)
     hueSpin->setRange(-99, 100);
     hueSpin->setValue(0);
 
-    progressBar = new QProgressBar;
+    progressBar = new ProgressBar;
     progressBar->setMouseTracking(true);
 
+    skipButton = new QPushButton;
+    skipButton->setToolTip("Jump past what the other episodes share");
+    skipButton->setFocusPolicy(Qt::FocusPolicy::NoFocus);
+    skipButton->setVisible(false);
+
     volumeButton = new QPushButton;
     volumeButton->setToolTip("Mute/Unmute (Not Saved)");
     volumeButton->setFlat(true);
@@ -198,7 +254,7 @@ MainWindow::MainWindow(QWidget* parent)
     playlistButton->setFocusPolicy(Qt::NoFocus);
     playlistButton->setIcon(QIcon::fromTheme("media-playlist-normal"));
     playlistButton->setCheckable(true);
-    playlistButton->setChecked(playlistVisible);
+    playlistButton->setChecked(config.playlistVisible);
 
     mpvWidget = new MpvWidget(this);
     mpv = mpvWidget->mpv;
@@ -235,6 +291,7 @@ MainWindow::MainWindow(QWidget* parent)
     controlLayout->addWidget(hueSpin);
     controlLayout->addSpacing(3);
     controlLayout->addWidget(progressBar);
+    controlLayout->addWidget(skipButton);
     controlLayout->addSpacing(3);
     controlLayout->addWidget(volumeButton);
     controlLayout->addWidget(volumeBar);
@@ -244,26 +301,26 @@ MainWindow::MainWindow(QWidget* parent)
     controlLayout->addWidget(configDialogButton);
     controlLayout->addWidget(playlistButton);
 
-    playButton->setVisible(showPlayPause);
-    speedSpin->setVisible(showSpeed);
-    zoomSpin->setVisible(showZoom);
-    rotationSpin->setVisible(showRotation);
-    panXSpin->setVisible(showPanX);
-    panYSpin->setVisible(showPanY);
-    cropHSpin->setVisible(showCropH);
-    cropVSpin->setVisible(showCropV);
-    brightnessSpin->setVisible(showBrightness);
-    contrastSpin->setVisible(showContrast);
-    saturationSpin->setVisible(showSaturation);
-    gammaSpin->setVisible(showGamma);
-    hueSpin->setVisible(showHue);
-    progressBar->setVisible(showProgress);
-    volumeButton->setVisible(showMute);
-    volumeBar->setVisible(showVolume);
-    audioButton->setVisible(showAudio);
-    subButton->setVisible(showSub);
-    configDialogButton->setVisible(showSettings);
-    playlistButton->setVisible(showPlaylistButton);
+    playButton->setVisible(config.showPlayPause);
+    speedSpin->setVisible(config.showSpeed);
+    zoomSpin->setVisible(config.showZoom);
+    rotationSpin->setVisible(config.showRotation);
+    panXSpin->setVisible(config.showPanX);
+    panYSpin->setVisible(config.showPanY);
+    cropHSpin->setVisible(config.showCropH);
+    cropVSpin->setVisible(config.showCropV);
+    brightnessSpin->setVisible(config.showBrightness);
+    contrastSpin->setVisible(config.showContrast);
+    saturationSpin->setVisible(config.showSaturation);
+    gammaSpin->setVisible(config.showGamma);
+    hueSpin->setVisible(config.showHue);
+    progressBar->setVisible(config.showProgress);
+    volumeButton->setVisible(config.showMute);
+    volumeBar->setVisible(config.showVolume);
+    audioButton->setVisible(config.showAudio);
+    subButton->setVisible(config.showSub);
+    configDialogButton->setVisible(config.showSettings);
+    playlistButton->setVisible(config.showPlaylistButton);
 
     // Playlist
     playlistDock = new QDockWidget("Playlist", this);
@@ -272,17 +329,19 @@ MainWindow::MainWindow(QWidget* parent)
     playlistView = new ListView;
     playlistView->setEditTriggers(QAbstractItemView::NoEditTriggers);
     playlistView->setTextElideMode(Qt::ElideRight);
-    playlistView->setSelectionMode(QListView::SingleSelection);
+    playlistView->setSelectionMode(QListView::ExtendedSelection);
+    playlistView->setContextMenuPolicy(Qt::ActionsContextMenu);
     playlistView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOn);
-    playlistStyle = new PlaylistStyle;
+    playlistStyle = new PlaylistStyle(playlistView);
+    playlistStyle->setPlayIcon(playIcon);
     playlistView->setItemDelegate(playlistStyle);
-    playlistModel = new ListModel;
+    playlistModel = new ListModel(&playQueue, playlistView);
     playlistView->setModel(playlistModel);
 
     playlistDock->setWidget(playlistView);
     playlistDock->setFeatures(QDockWidget::NoDockWidgetFeatures);
     addDockWidget(Qt::BottomDockWidgetArea, playlistDock);
-    playlistDock->setVisible(playlistVisible);
+    playlistDock->setVisible(config.playlistVisible);
 
     //
     setMouseTracking(true);
@@ -291,6 +350,116 @@ MainWindow::MainWindow(QWidget* parent)
 
     registerDBus(SERVICE_NAME);
 
+    ipcServer = new IpcServer(mpv, this);
+    ipcServer->setHandler([=](const QJsonArray& args, QString& error) {
+        return ipcCommand(args, error);
+    });
+    connect(ipcServer, &IpcServer::quitRequested, this, &QWidget::close, Qt::QueuedConnection);
+    startIpcServer(config.ipcServer);
+
+    cacheWarmer = new CacheWarmer(this);
+    cacheWarmer->setRate((qint64)config.warmCacheRate * 1024 * 1024);
+    cacheWarmer->start(QThread::LowestPriority);
+
+    stallWatchdog = new StallWatchdog(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/logs/stalls.jsonl", this);
+    stallWatchdog->setThreshold(config.stallThresholdMs);
+    // has to be scheduled while the GUI thread is busy
+    stallWatchdog->start(QThread::HighPriority);
+    // the event loop is gone after exec() returns
+    connect(qApp, &QCoreApplication::aboutToQuit, stallWatchdog, &StallWatchdog::stop);
+
+    resumeStore = new ResumeStore(this);
+    resumeStore->open(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/resume.db");
+
+    analysisCache.reset(new AnalysisCache(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/analysis"));
+    audioScanner = new AudioScanner(analysisCache.get(), this);
+    audioScanner->addSink("loudness", [] {
+        return new LoudnessMeter(AudioScanner::SampleRate, AudioScanner::Channels);
+    });
+    audioScanner->addSink("waveform", [] {
+        return new WaveformBuilder(AudioScanner::SampleRate, AudioScanner::Channels);
+    });
+    audioScanner->addSink("silence", [] {
+        return new SilenceMeter(AudioScanner::SampleRate, AudioScanner::Channels);
+    });
+    connect(audioScanner, &AudioScanner::analyzed, this, [=](const QString& file, quint64, const QString& kind, const QJsonObject& result) {
+        if (kind == "waveform" && file == currentPath) {
+            updateWaveform();
+        }
+        else if (kind == "silence" && file == currentPath) {
+            loadSilences();
+        }
+    });
+    audioScanner->start(QThread::IdlePriority);
+
+    silenceTimer = new QTimer(this);
+    silenceTimer->setSingleShot(true);
+    silenceTimer->setTimerType(Qt::PreciseTimer);
+    connect(silenceTimer, &QTimer::timeout, this, &MainWindow::skipSilence);
+
+    keyframeIndexer = new KeyframeIndexer(analysisCache.get(), this);
+    connect(keyframeIndexer, &KeyframeIndexer::progress, this, [=](const QString& file, double fraction) {
+        if (file == currentPath) {
+            progressBar->setIndexProgress(fraction);
+        }
+    });
+    connect(keyframeIndexer, &KeyframeIndexer::indexed, this, [=](const QString& file, quint64 identity, int keyframes) {
+        LOG << "indexed" << keyframes << "keyframes of" << file;
+        if (file == currentPath) {
+            keyframeIndex = keyframeIndexer->load(identity);
+            progressBar->setIndexProgress(-1);
+        }
+    });
+    keyframeIndexer->start(QThread::IdlePriority);
+
+    sceneDetector = new SceneDetector(analysisCache.get(), this);
+    connect(sceneDetector, &SceneDetector::detected, this, [=](const QString& file, quint64, const QJsonArray& cuts) {
+        LOG << "detected" << cuts.count() << "scene cuts in" << file;
+        if (file == currentPath) {
+            applySceneChapters(cuts);
+        }
+    });
+    sceneDetector->start(QThread::IdlePriority);
+
+    cropDetector = new CropDetector(analysisCache.get(), this);
+    connect(cropDetector, &CropDetector::detected, this, [=](const QString& file, quint64 identity) {
+        const Letterbox bars = cropDetector->load(identity);
+        LOG << "detected black bars" << bars.left << bars.top << bars.right << bars.bottom << "in" << file;
+        if (file == currentPath) {
+            VideoAdjustments a = adjustments;
+            applyAutoCrop(a);
+            if (a != adjustments) {
+                setAdjustments(a);
+            }
+        }
+    });
+    cropDetector->start(QThread::IdlePriority);
+
+    introDetector = new IntroDetector(analysisCache.get(), this);
+    connect(introDetector, &IntroDetector::fingerprinted, this, [=](const QString& file, quint64) {
+        LOG << "fingerprinted" << file;
+        // one more episode to compare the playing one with
+        if (!currentPath.isEmpty() && QFileInfo(file).absolutePath() == QFileInfo(currentPath).absolutePath()) {
+            updateSegments();
+        }
+    });
+
+    subtitleSearch = new SubtitleSearch(analysisCache.get(), this);
+    frameExporter = new FrameExporter(this);
+    segmentExporter = new SegmentExporter(this);
+    frameStepper = new FrameStepper(mpvWidget, this);
+    frameStepper->setMemoryLimit((qint64)config.frameCacheMiB * 1024 * 1024);
+    connect(frameStepper, &FrameStepper::positionChanged, this, [=](double position) {
+        time = position;
+        updateProgress();
+    });
+    auto searchAction = new QAction(this);
+    searchAction->setShortcut(QKeySequence::Find);
+    connect(searchAction, &QAction::triggered, this, &MainWindow::showSubtitleSearch);
+    addAction(searchAction);
+
+    connect(settings, &Settings::changed, this, &MainWindow::onSettingChanged);
+
     // if (arg != QString()) {
     //     auto url = QFileInfo::exists(arg) ? QUrl::fromLocalFile(arg) : QUrl(arg);
     //     loadFiles({ url });
@@ -298,12 +467,17 @@ MainWindow::MainWindow(QWidget* parent)
     mpvWidget->setContextMenuPolicy(Qt::CustomContextMenu);
 
     connect(mpvWidget, &MpvWidget::mpvEvent, this, &MainWindow::handle_mpv_event);
+    connect(mpvWidget, &MpvWidget::transitionMeasured, this, [=](double gapMs) {
+        double fps = mpv::qt::get_property(mpv, "container-fps").toDouble();
+        LOG << "Playlist transition gap" << gapMs << "ms" << (fps > 0 ? gapMs * fps / 1000 : 0) << "frames";
+    });
     connect(mpvWidget, &QWidget::customContextMenuRequested, this, &MainWindow::showCustomMenu);
     connect(playButton, &QPushButton::clicked, this, &MainWindow::playPauseClicked);
+    connect(skipButton, &QPushButton::clicked, this, &MainWindow::skipSegment);
     connect(speedSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, &MainWindow::updateSpeed);
     connect(zoomSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
-        double val = (double)value / 100;
-        mpv::qt::set_option_variant(mpv, "video-zoom", log2(val));
+        adjustments.zoom = value;
+        scheduleAdjustments();
     });
     connect(rotationSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
         int newValue = (360 + value) % 360;
@@ -311,59 +485,45 @@ MainWindow::MainWindow(QWidget* parent)
         if (nullptr != spin) {
             QSignalBlocker blocker(spin);
             spin->setValue(newValue);
-            mpv::qt::set_option_variant(mpv, "video-rotate", newValue);
+            adjustments.rotation = newValue;
+            scheduleAdjustments();
         }
     });
     connect(panXSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int perc) {
-        double value = (double)perc / 100;
-        mpv::qt::set_option_variant(mpv, "video-pan-x", value);
+        adjustments.panX = perc;
+        scheduleAdjustments();
     });
     connect(panYSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int perc) {
-        double value = (double)perc / 100;
-        mpv::qt::set_option_variant(mpv, "video-pan-y", value);
+        adjustments.panY = perc;
+        scheduleAdjustments();
     });
     connect(cropHSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int val) {
-        if (val == 0 && cropVSpin->value() == 0) {
-            mpv::qt::set_option_variant(mpv, "video-crop", QString());
-        }
-        QMap<QString, QVariant> params = mpv::qt::get_property(mpv, "video-params").toMap();
-        int w = params["dw"].toInt();
-        int h = params["dh"].toInt();
-        int x = qBound(0, val, w / 2);
-        int y = qBound(0, cropVSpin->value(), h / 2);
-        w = w - 2 * x;
-        h = h - 2 * y;
-        QString value = QString("%1x%2+%3+%4").arg(w).arg(h).arg(x).arg(y);
-        mpv::qt::set_option_variant(mpv, "video-crop", value);
+        adjustments.cropH = val;
+        scheduleAdjustments();
     });
     connect(cropVSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int val) {
-        if (val == 0 && cropHSpin->value() == 0) {
-            mpv::qt::set_option_variant(mpv, "video-crop", QString());
-        }
-        QMap<QString, QVariant> params = mpv::qt::get_property(mpv, "video-params").toMap();
-        int w = params["dw"].toInt();
-        int h = params["dh"].toInt();
-        int x = qBound(0, cropHSpin->value(), w / 2);
-        int y = qBound(0, val, h / 2);
-        w = w - 2 * x;
-        h = h - 2 * y;
-        QString value = QString("%1x%2+%3+%4").arg(w).arg(h).arg(x).arg(y);
-        mpv::qt::set_option_variant(mpv, "video-crop", value);
+        adjustments.cropV = val;
+        scheduleAdjustments();
     });
     connect(brightnessSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
-        mpv::qt::set_option_variant(mpv, "brightness", value);
+        adjustments.brightness = value;
+        scheduleAdjustments();
     });
     connect(contrastSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
-        mpv::qt::set_option_variant(mpv, "contrast", value);
+        adjustments.contrast = value;
+        scheduleAdjustments();
     });
     connect(saturationSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
-        mpv::qt::set_option_variant(mpv, "saturation", value);
+        adjustments.saturation = value;
+        scheduleAdjustments();
     });
     connect(gammaSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
-        mpv::qt::set_option_variant(mpv, "gamma", value);
+        adjustments.gamma = value;
+        scheduleAdjustments();
     });
     connect(hueSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
-        mpv::qt::set_option_variant(mpv, "hue", value);
+        adjustments.hue = value;
+        scheduleAdjustments();
     });
     connect(volumeButton, &QPushButton::clicked, this, [=] {
         mpv::qt::set_property_variant(mpv, "mute", !muted);
@@ -371,8 +531,7 @@ MainWindow::MainWindow(QWidget* parent)
     connect(configDialogButton, &QPushButton::clicked, this, &MainWindow::showConfigDialog);
     connect(playlistButton, &QPushButton::toggled, this, [=](bool checked) {
         playlistDock->setVisible(checked);
-        playlistVisible = checked;
-        settings.setValue("playlistVisible", checked);
+        settings->set(&Config::playlistVisible, checked);
     });
     connect(playlistView, &QListView::clicked, this, [=](const QModelIndex& index) {
         if (index.isValid()) {
@@ -381,11 +540,40 @@ MainWindow::MainWindow(QWidget* parent)
     });
     connect(playlistView, &QListView::doubleClicked, this, [=](const QModelIndex& index) {
         if (index.isValid()) {
-            mpv::qt::set_property_variant(mpv, "playlist-pos", index.row());
+            playlistPlay(index.row());
             mpv::qt::set_property_variant(mpv, "pause", false);
         }
     });
     connect(playlistModel, &ListModel::playlistMove, this, &MainWindow::playlistMove);
+    connect(playlistStyle, &PlaylistStyle::buttonClicked, this, [=](int row, int button) {
+        if (button == PlaylistStyle::UpButton) {
+            playlistMove(row, row - 1);
+        }
+        else if (button == PlaylistStyle::DownButton) {
+            playlistMove(row, row + 2);
+        }
+        else {
+            playlistRemove(row);
+        }
+    });
+    connect(playlistView, &ListView::rowsDropped, this, &MainWindow::playlistMoveRows);
+    QAction* action = new QAction(QIcon::fromTheme("go-top"), tr("Move to &Top"), playlistView);
+    connect(action, &QAction::triggered, this, [=] {
+        playlistMoveRows(playlistView->selectedRows(), 0);
+    });
+    playlistView->addAction(action);
+    action = new QAction(QIcon::fromTheme("go-bottom"), tr("Move to &Bottom"), playlistView);
+    connect(action, &QAction::triggered, this, [=] {
+        playlistMoveRows(playlistView->selectedRows(), playlistModel->rowCount());
+    });
+    playlistView->addAction(action);
+    action = new QAction(QIcon::fromTheme("list-remove"), tr("&Remove"), playlistView);
+    action->setShortcut(QKeySequence::Delete);
+    action->setShortcutContext(Qt::WidgetShortcut);
+    connect(action, &QAction::triggered, this, [=] {
+        playlistRemoveRows(playlistView->selectedRows());
+    });
+    playlistView->addAction(action);
 
     progressBar->installEventFilter(this);
     volumeBar->installEventFilter(this);
@@ -431,64 +619,247 @@ void MainWindow::registerDBus(const QString& service)
     }
 }
 
+void MainWindow::startIpcServer(const QString& path)
+{
+    if (nullptr == ipcServer) {
+        return;
+    }
+    if (path.isEmpty()) {
+        ipcServer->close();
+        return;
+    }
+    ipcServer->listen(path);
+}
+
+QJsonValue MainWindow::ipcCommand(const QJsonArray& args, QString& error)
+{
+    const QString name = args.at(0).toString();
+    if (name == "fastplayer-load") {
+        QStringList files;
+        for (int i = 1; i < args.count(); ++i) {
+            files << args.at(i).toString();
+        }
+        loadFiles(files);
+    }
+    else if (name == "fastplayer-playlist-move") {
+        const int from = args.at(1).toInt(-1);
+        const int to = args.at(2).toInt(-1);
+        if (from < 0 || from >= playQueue.count() || to < 0 || to > playQueue.count()) {
+            error = "index out of range";
+        }
+        else {
+            playlistMove(from, to);
+        }
+    }
+    else if (name == "fastplayer-playlist-remove") {
+        QList<int> rows;
+        for (int i = 1; i < args.count(); ++i) {
+            const int row = args.at(i).toInt(-1);
+            if (row < 0 || row >= playQueue.count()) {
+                error = "index out of range";
+                return QJsonValue::Undefined;
+            }
+            rows << row;
+        }
+        playlistRemoveRows(rows);
+    }
+    else if (name == "fastplayer-playlist-visible") {
+        bool visible = args.count() > 1 ? args.at(1).toBool() : !config.playlistVisible;
+        playlistButton->setChecked(visible);
+    }
+    else if (name == "fastplayer-fullscreen") {
+        bool fullscreen = args.count() > 1 ? args.at(1).toBool() : !isFullScreen();
+        if (fullscreen != isFullScreen()) {
+            toggleFullscreen();
+        }
+    }
+    else if (name == "fastplayer-minimize") {
+        showMinimized();
+    }
+    else if (name == "fastplayer-raise") {
+        if (isMinimized()) {
+            showNormal();
+        }
+        raise();
+        activateWindow();
+    }
+    else if (name == "fastplayer-window-state") {
+        QRect rect = geometry();
+        return QJsonObject {
+            { "fullscreen", isFullScreen() },
+            { "maximized", isMaximized() },
+            { "minimized", isMinimized() },
+            { "active", isActiveWindow() },
+            { "playlist-visible", config.playlistVisible },
+            { "x", rect.x() },
+            { "y", rect.y() },
+            { "width", rect.width() },
+            { "height", rect.height() },
+        };
+    }
+    else if (name == "fastplayer-stats") {
+        return stats();
+    }
+    else if (name == "fastplayer-trace") {
+        // what was traced so far, to the path given or the one tracing started with
+        const QString path = args.count() > 1 ? args.at(1).toString() : Trace::path();
+        if (!Trace::enabled()) {
+            error = "tracing is off";
+        }
+        else if (!Trace::write(path)) {
+            error = "could not write " + path;
+        }
+        else {
+            return path;
+        }
+    }
+    else if (name == "fastplayer-search-subtitles") {
+        QJsonArray matches;
+        for (const SubtitleSearch::Match& match : subtitleSearch->search(args.at(1).toString())) {
+            matches.append(QJsonObject { { "time", match.time }, { "text", match.text }, { "track", match.track } });
+        }
+        return matches;
+    }
+    else if (name == "fastplayer-quit") {
+        close();
+    }
+    else {
+        error = "unknown fastplayer command";
+    }
+    return QJsonValue::Undefined;
+}
+
 void MainWindow::configureMpv()
 {
     mpv::qt::set_property_variant(mpv, "volume", currentVolume);
-    mpv::qt::set_option_variant(mpv, "sub-font", subFont.family());
-    mpv::qt::set_option_variant(mpv, "sub-font-size", subFontSize);
-    mpv::qt::set_option_variant(mpv, "sub-border-color", subBorderColor.name(QColor::HexArgb));
-    mpv::qt::set_option_variant(mpv, "sub-border-size", subBorderSize);
-    mpv::qt::set_option_variant(mpv, "sub-color", subColor.name(QColor::HexArgb));
-    double speed = (double)playbackSpeed / 100;
+    mpv::qt::set_option_variant(mpv, "sub-font", config.subFont.family());
+    mpv::qt::set_option_variant(mpv, "sub-font-size", config.subFontSize);
+    mpv::qt::set_option_variant(mpv, "sub-border-color", config.subBorderColor.name(QColor::HexArgb));
+    mpv::qt::set_option_variant(mpv, "sub-border-size", config.subBorderSize);
+    mpv::qt::set_option_variant(mpv, "sub-color", config.subColor.name(QColor::HexArgb));
+    double speed = (double)config.playbackSpeed / 100;
     mpv::qt::set_property_variant(mpv, "speed", speed);
+    mpv::qt::set_property_variant(mpv, "prefetch-playlist", config.prefetchPlaylist);
+    if (config.cacheProfile != CacheDefault) {
+        tuneCache();
+    }
+    // per file state is applied while mpv waits, before the file is opened
+    mpv_hook_add(mpv, 0, "on_load", 50);
+    mpvWidget->mpvLog()->setLevel(config.logLevel);
+    updateLogFile();
+}
+
+void MainWindow::updateLogFile()
+{
+    QString path;
+    if (config.logToFile) {
+        path = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/logs/mpv.log";
+    }
+    mpvWidget->mpvLog()->setFile(path, (qint64)config.logFileMiB * 1024 * 1024);
+}
+
+void MainWindow::tuneCache()
+{
+    CacheHints hints = systemCacheHints(currentPath);
+    hints.throughput = sourceThroughput;
+    hints.stalled = cacheStalled;
+    double duration = mpv::qt::get_property(mpv, "duration").toDouble();
+    qint64 fileSize = mpv::qt::get_property(mpv, "file-size").toLongLong();
+    if (duration > 0 && fileSize > 0) {
+        hints.bitrate = fileSize / duration;
+    }
+    CacheProfile custom;
+    custom.cache = config.cache;
+    custom.maxBytes = (qint64)config.cacheMaxMiB * 1024 * 1024;
+    custom.maxBackBytes = (qint64)config.cacheMaxBackMiB * 1024 * 1024;
+    custom.readaheadSecs = config.cacheReadaheadSecs;
+    custom.decoderThreads = config.decoderThreads;
+    applyCacheProfile(mpv, cacheProfileFor(static_cast<CacheMode>(config.cacheProfile), hints, custom));
 }
 
 void MainWindow::loadConfig()
 {
-    seekStep = settings.value("seekStep", 10).toInt();
-    seekBarStep = settings.value("seekBarStep", 30).toInt();
-    volumeStep = settings.value("volumeStep", 5).toInt();
-    currentVolume = settings.value("volume", 70).toInt();
-    currentVolume = qBound(0, currentVolume, MAX_VOLUME);
-    subFont = settings.value("subFont", QFont("sans-serif")).value<QFont>();
-    subFontSize = settings.value("subFontSize", 55).toInt();
-    subBorderColor = settings.value("subBorderColor", QColor(Qt::black)).value<QColor>();
-    subBorderSize = settings.value("subBorderSize", 3).toInt();
-    subColor = settings.value("subColor", QColor(Qt::yellow)).value<QColor>();
-    playbackSpeed = settings.value("playbackSpeed", 100).toInt();
-
-    showPlayPause = settings.value("showPlayPause", true).toBool();
-    showSpeed = settings.value("showSpeed", true).toBool();
-    showZoom = settings.value("showZoom", true).toBool();
-    showRotation = settings.value("showRotation", true).toBool();
-    showPanX = settings.value("showPanX", false).toBool();
-    showPanY = settings.value("showPanY", false).toBool();
-    showCropH = settings.value("showCropH", true).toBool();
-    showCropV = settings.value("showCropV", true).toBool();
-
-    showBrightness = settings.value("showBrightness", true).toBool();
-    showContrast = settings.value("showContrast", true).toBool();
-    showSaturation = settings.value("showSaturation", false).toBool();
-    showGamma = settings.value("showGamma", false).toBool();
-    showHue = settings.value("showHue", false).toBool();
-
-    showProgress = settings.value("showProgress", true).toBool();
-    showMute = settings.value("showMute", true).toBool();
-    showVolume = settings.value("showVolume", true).toBool();
-    showAudio = settings.value("showAudio", true).toBool();
-    showSub = settings.value("showSub", true).toBool();
-    showSettings = settings.value("showSettings", true).toBool();
-    showPlaylistButton = settings.value("showPlaylistButton", true).toBool();
-    playlistVisible = settings.value("playlistVisible", true).toBool();
-
-    restoreState(settings.value("windowState").toByteArray());
-    restoreGeometry(settings.value("geometry").toByteArray());
+    currentVolume = qBound(0, config.volume, MAX_VOLUME);
+    restoreState(config.windowState);
+    restoreGeometry(config.geometry);
+}
+
+// settings are changed from the dialog and over IPC, anything that has to
+// reach mpv or another component right away is applied here
+void MainWindow::onSettingChanged(const QString& key)
+{
+    if (key == "subFont") {
+        mpv::qt::set_option_variant(mpv, "sub-font", config.subFont.family());
+    }
+    else if (key == "subFontSize") {
+        mpv::qt::set_option_variant(mpv, "sub-font-size", config.subFontSize);
+    }
+    else if (key == "subBorderColor") {
+        mpv::qt::set_option_variant(mpv, "sub-border-color", config.subBorderColor.name(QColor::HexArgb));
+    }
+    else if (key == "subBorderSize") {
+        mpv::qt::set_option_variant(mpv, "sub-border-size", config.subBorderSize);
+    }
+    else if (key == "subColor") {
+        mpv::qt::set_option_variant(mpv, "sub-color", config.subColor.name(QColor::HexArgb));
+    }
+    else if (key == "prefetchPlaylist") {
+        mpv::qt::set_property_variant(mpv, "prefetch-playlist", config.prefetchPlaylist);
+    }
+    else if (key == "ipcServer") {
+        startIpcServer(config.ipcServer);
+    }
+    else if (key == "warmCache") {
+        warmUpcoming();
+    }
+    else if (key == "normalizeLoudness") {
+        analyzeUpcoming();
+    }
+    else if (key == "skipSilence") {
+        loadSilences();
+        analyzeUpcoming();
+    }
+    else if (key == "silenceThreshold" || key == "silenceMinSecs") {
+        loadSilences();
+    }
+    else if (key == "showWaveform") {
+        updateWaveform();
+        analyzeUpcoming();
+    }
+    else if (key == "indexKeyframes" || key == "detectScenes" || key == "autoCrop") {
+        scanUpcoming();
+    }
+    else if (key == "detectIntros") {
+        fingerprintEpisodes();
+        updateSegments();
+    }
+    else if (key == "frameCacheMiB") {
+        frameStepper->setMemoryLimit((qint64)config.frameCacheMiB * 1024 * 1024);
+    }
+    else if (key == "logLevel") {
+        mpvWidget->mpvLog()->setLevel(config.logLevel);
+    }
+    else if (key == "logToFile" || key == "logFileMiB") {
+        updateLogFile();
+    }
+    else if (key == "stallThresholdMs") {
+        stallWatchdog->setThreshold(config.stallThresholdMs);
+    }
+    else if (key == "warmCacheRate") {
+        cacheWarmer->setRate((qint64)config.warmCacheRate * 1024 * 1024);
+    }
+    else if (key == "cacheProfile" || key == "cache" || key == "cacheMaxMiB" || key == "cacheMaxBackMiB" || key == "cacheReadaheadSecs" || key == "decoderThreads") {
+        tuneCache();
+    }
 }
 
 void MainWindow::closeEvent(QCloseEvent* event)
 {
-    settings.setValue("geometry", saveGeometry());
-    settings.setValue("windowState", saveState());
+    saveResumePosition();
+    resumeStore->close();
+    settings->set(&Config::geometry, saveGeometry());
+    settings->set(&Config::windowState, saveState());
+    settings->flush();
     QMainWindow::closeEvent(event);
 }
 
@@ -583,15 +954,36 @@ bool MainWindow::eventFilter(QObject* obj, QEvent* event)
                 else if (keyEvent->key() == Qt::Key_K || keyEvent->key() == Qt::Key_Left) {
                     seek(false);
                 }
+                else if (keyEvent->key() == Qt::Key_Period) {
+                    frameStepper->stepForward();
+                }
+                else if (keyEvent->key() == Qt::Key_Comma) {
+                    frameStepper->stepBackward();
+                }
                 else if (keyEvent->key() == Qt::Key_H || keyEvent->key() == Qt::Key_Up) {
                     stepVolume(true);
                 }
                 else if (keyEvent->key() == Qt::Key_J || keyEvent->key() == Qt::Key_Down) {
                     stepVolume(false);
                 }
+                else if (keyEvent->key() == Qt::Key_BracketLeft) {
+                    setClipPoint(false);
+                }
+                else if (keyEvent->key() == Qt::Key_BracketRight) {
+                    setClipPoint(true);
+                }
+                else if (keyEvent->key() == Qt::Key_PageDown) {
+                    seekChapter(true);
+                }
+                else if (keyEvent->key() == Qt::Key_PageUp) {
+                    seekChapter(false);
+                }
                 else if (keyEvent->key() == Qt::Key_F11) {
                     toggleFullscreen();
                 }
+                else if (keyEvent->key() == Qt::Key_I) {
+                    mpvWidget->setStatsVisible(!mpvWidget->statsVisible());
+                }
                 else if (keyEvent->key() == Qt::Key_Escape && isFullScreen()) {
                     toggleFullscreen();
                 }
@@ -636,12 +1028,617 @@ void MainWindow::dropEvent(QDropEvent* e)
     e->ignore();
 }
 
+void MainWindow::onLoadHook(quint64 hookId)
+{
+    const QString path = mpv::qt::get_property(mpv, "path").toString();
+    if (path.isEmpty() || path.contains("://")) {
+        applyLoadHook(hookId, path, 0, QStringList());
+        return;
+    }
+    // mpv waits for the hook either way, the identity's reads and the
+    // directory listing happen without holding up the GUI thread
+    QPointer<MainWindow> self(this);
+    loadHookPool.start([=] {
+        const quint64 identity = fileIdentity(path);
+        // ~MainWindow waits for the pool before subtitleIndex goes
+        if (!self) {
+            return;
+        }
+        const QStringList subFiles = subtitleIndex.lookup(path);
+        QMetaObject::invokeMethod(self.data(), [=] {
+            applyLoadHook(hookId, path, identity, subFiles);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::applyLoadHook(quint64 hookId, const QString& path, quint64 identity, const QStringList& subFiles)
+{
+    if (!mpv) {
+        return;
+    }
+    currentIdentity = identity;
+    currentTime = 0;
+    currentAid = -1;
+    currentSid = -1;
+
+    ResumeStore::Record record;
+    bool found = currentIdentity != 0 && resumeStore->lookup(currentIdentity, &record);
+    if (found && config.resumePlayback && record.position > 0) {
+        mpv::qt::set_property_variant(mpv, "file-local-options/start", QString::number(record.position));
+        if (record.aid >= 0) {
+            mpv::qt::set_property_variant(mpv, "file-local-options/aid", record.aid);
+        }
+        if (record.sid >= 0) {
+            mpv::qt::set_property_variant(mpv, "file-local-options/sid", record.sid);
+        }
+        if (record.speed > 0 && record.speed != 1) {
+            mpv::qt::set_property_variant(mpv, "file-local-options/speed", (double)record.speed);
+        }
+    }
+
+    if (!path.isEmpty() && !path.contains("://")) {
+        // subtitleIndex stands in for sub-auto, which would list the
+        // directory again for every file
+        mpv::qt::set_property_variant(mpv, "file-local-options/sub-auto", "no");
+        // loaded like mpv's own sub-auto, before track selection, so slang
+        // and a resumed sid pick from them
+        if (!subFiles.isEmpty()) {
+            mpv::qt::set_property_variant(mpv, "file-local-options/sub-files", subFiles);
+        }
+    }
+
+    if (config.normalizeLoudness && currentIdentity != 0) {
+        QJsonObject loudness = analysisCache->load(currentIdentity, "loudness");
+        if (loudness.contains("integrated")) {
+            // a static gain, keeping the true peak under -1 dBTP
+            double gain = config.loudnessTarget - loudness.value("integrated").toDouble();
+            gain = qMin(gain, -1 - loudness.value("true-peak").toDouble());
+            gain = qBound(-30.0, gain, 30.0);
+            mpv::qt::set_property_variant(mpv, "file-local-options/volume-gain", gain);
+        }
+    }
+
+    VideoAdjustments fileAdjustments = adjustments;
+    if (config.rememberVideoAdjustments) {
+        bool stored = found && (record.flags & ResumeStore::HasVideoAdjustments);
+        fileAdjustments = stored ? VideoAdjustments::unpack(record.video) : VideoAdjustments();
+    }
+    else if (fileAdjustments.cropH == autoCropH && fileAdjustments.cropV == autoCropV) {
+        // the bars of the previous file say nothing about this one
+        fileAdjustments.cropH = 0;
+        fileAdjustments.cropV = 0;
+    }
+    autoCropH = 0;
+    autoCropV = 0;
+    applyAutoCrop(fileAdjustments);
+    // Nothing is decoded yet, so changing these now costs no reconfiguration.
+    // The crop is in pixels of the old file; drop it until the new size is known.
+    QVariantMap changes = videoAdjustmentChanges(fileAdjustments, appliedAdjustments, 0, 0);
+    if (appliedAdjustments.cropH != 0 || appliedAdjustments.cropV != 0) {
+        changes.insert("video-crop", QString());
+    }
+    for (auto it = changes.cbegin(); it != changes.cend(); ++it) {
+        mpv::qt::set_property_variant(mpv, it.key(), it.value());
+    }
+    videoWidth = 0;
+    videoHeight = 0;
+    adjustments = fileAdjustments;
+    appliedAdjustments = fileAdjustments;
+    appliedAdjustments.cropH = 0;
+    appliedAdjustments.cropV = 0;
+    syncAdjustmentWidgets();
+    mpv_hook_continue(mpv, hookId);
+}
+
+void MainWindow::saveResumePosition()
+{
+    if (currentIdentity == 0) {
+        return;
+    }
+    // nothing worth resuming at the very start or end
+    bool keepPosition = config.resumePlayback && currentTime >= 10 && !(length > 0 && currentTime > length - 10);
+    // a detected crop comes back by itself
+    VideoAdjustments chosen = adjustments;
+    if (chosen.cropH == autoCropH && chosen.cropV == autoCropV) {
+        chosen.cropH = 0;
+        chosen.cropV = 0;
+    }
+    bool keepVideo = config.rememberVideoAdjustments && !chosen.isDefault();
+    if (!keepPosition && !keepVideo) {
+        resumeStore->remove(currentIdentity);
+        return;
+    }
+    ResumeStore::Record record;
+    record.key = currentIdentity;
+    if (keepPosition) {
+        record.position = currentTime;
+        record.aid = currentAid;
+        record.sid = currentSid;
+        // the core is gone when it quit by itself
+        if (mpv) {
+            record.speed = mpv::qt::get_property(mpv, "speed").toDouble();
+        }
+    }
+    if (keepVideo) {
+        record.flags |= ResumeStore::HasVideoAdjustments;
+        chosen.pack(record.video);
+    }
+    resumeStore->store(record);
+}
+
+void MainWindow::setAdjustments(const VideoAdjustments& a)
+{
+    adjustments = a;
+    syncAdjustmentWidgets();
+    scheduleAdjustments();
+}
+
+// Spin box auto repeat, presets and key presses can change several values in
+// a row; they all go out together once control returns to the event loop.
+void MainWindow::scheduleAdjustments()
+{
+    if (adjustmentsQueued) {
+        return;
+    }
+    adjustmentsQueued = true;
+    QTimer::singleShot(0, this, &MainWindow::applyAdjustments);
+}
+
+void MainWindow::applyAdjustments()
+{
+    adjustmentsQueued = false;
+    applyVideoAdjustments(mpv, videoAdjustmentChanges(adjustments, appliedAdjustments, videoWidth, videoHeight));
+    VideoAdjustments applied = adjustments;
+    if (videoWidth <= 0 || videoHeight <= 0) {
+        // the crop goes out once video-dec-params arrives
+        applied.cropH = appliedAdjustments.cropH;
+        applied.cropV = appliedAdjustments.cropV;
+    }
+    appliedAdjustments = applied;
+}
+
+void MainWindow::syncAdjustmentWidgets()
+{
+    const QList<QPair<QSpinBox*, int>> values = {
+        { zoomSpin, adjustments.zoom },
+        { rotationSpin, adjustments.rotation },
+        { panXSpin, adjustments.panX },
+        { panYSpin, adjustments.panY },
+        { cropHSpin, adjustments.cropH },
+        { cropVSpin, adjustments.cropV },
+        { brightnessSpin, adjustments.brightness },
+        { contrastSpin, adjustments.contrast },
+        { saturationSpin, adjustments.saturation },
+        { gammaSpin, adjustments.gamma },
+        { hueSpin, adjustments.hue },
+    };
+    for (const auto& value : values) {
+        QSignalBlocker blocker(value.first);
+        value.first->setValue(value.second);
+    }
+}
+
+void MainWindow::saveVideoPreset()
+{
+    bool ok;
+    QString name = QInputDialog::getText(this, "Save Video Preset", "Name:", QLineEdit::Normal, QString(), &ok).trimmed();
+    if (!ok || name.isEmpty()) {
+        return;
+    }
+    QVariantMap presets = config.videoPresets;
+    presets.insert(name, adjustments.toMap());
+    settings->set(&Config::videoPresets, presets);
+}
+
 void MainWindow::onFileLoaded()
 {
+    QString path = mpv::qt::get_property(mpv, "path").toString();
+    if (QFileInfo(path).absolutePath() != QFileInfo(currentPath).absolutePath()) {
+        // measurements belong to the previous source
+        sourceThroughput = 0;
+        cacheStalled = false;
+    }
+    currentPath = path;
+    if (config.cacheProfile == CacheAuto) {
+        tuneCache();
+    }
+    keyframeIndex = keyframeIndexer->load(currentIdentity);
+    progressBar->setIndexProgress(-1);
+    sceneChapters = false;
+    applySceneChapters(sceneDetector->load(currentIdentity));
+    updateWaveform();
+    loadSilences();
+    // none of the previous file's while this one's are matched
+    episodeSegments = IntroDetector::Segments();
+    updateSkipButton();
+    updateSegments();
+    clipStart = -1;
+    clipEnd = -1;
+    progressBar->setSelection(clipStart, clipEnd);
+    prepareNext();
+    warmUpcoming();
+    analyzeUpcoming();
+    scanUpcoming();
+}
+
+void MainWindow::warmUpcoming()
+{
+    QStringList upcoming;
+    if (config.warmCache) {
+        for (int i = playQueue.current() + 1; i < playQueue.count() && upcoming.count() < 3; ++i) {
+            if (!playQueue.at(i).contains("://")) {
+                upcoming << playQueue.at(i);
+            }
+        }
+    }
+    cacheWarmer->setFiles(upcoming);
+}
+
+void MainWindow::analyzeUpcoming()
+{
+    // what plays next first, the current file last so it's ready next time,
+    // unless its waveform or silences are wanted now. Only as many as mpv's
+    // window holds, a long queue is scanned as playback gets there.
+    QStringList files;
+    if (config.normalizeLoudness || config.showWaveform || config.skipSilence) {
+        files = upcomingLocalFiles(config.showWaveform || config.skipSilence ? 0 : 1, PlayQueue::WindowAfter + 1);
+    }
+    audioScanner->setFiles(files);
+}
+
+// up to count local files of the queue, from `first` entries past the
+// playing one on and around the end
+QStringList MainWindow::upcomingLocalFiles(int first, int count) const
+{
+    QStringList files;
+    const int current = qMax(0, playQueue.current());
+    for (int i = first; i < first + playQueue.count() && files.count() < count; ++i) {
+        const QString& file = playQueue.at((current + i) % playQueue.count());
+        if (!file.contains("://")) {
+            files << file;
+        }
+    }
+    return files;
+}
+
+void MainWindow::updateWaveform()
+{
+    QString path;
+    if (config.showWaveform && currentIdentity != 0 && analysisCache->contains(currentIdentity, "waveform")) {
+        path = analysisCache->dataPath(currentIdentity, "waveform");
+    }
+    progressBar->setWaveform(path);
+}
+
+void MainWindow::loadSilences()
+{
+    silences.clear();
+    silenceTimer->stop();
+    if (!config.skipSilence || currentIdentity == 0 || !analysisCache->contains(currentIdentity, "silence")) {
+        return;
+    }
+    QFile file(analysisCache->dataPath(currentIdentity, "silence"));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+    const auto found = SilenceMeter::find(file.readAll(), config.silenceThreshold, config.silenceMinSecs);
+    for (const auto& silence : found) {
+        const double from = silence.first + SILENCE_MARGIN_SECS;
+        const double to = silence.second - SILENCE_MARGIN_SECS;
+        if (to > from) {
+            silences.append({ from, to });
+        }
+    }
+    scheduleSilenceSkip();
+}
+
+// Arms the next skip from the precise position, so it lands on time between
+// the once a second time-pos updates. Everything it needs was worked out
+// when the file loaded.
+void MainWindow::scheduleSilenceSkip()
+{
+    silenceTimer->stop();
+    if (silences.isEmpty() || paused || frameStepper->isBusy()) {
+        return;
+    }
+    // both from observed properties: the whole second plus the time since it
+    // ticked over, which errs early, skipSilence() checks the exact position
+    const double speed = qMax(0.01, mpvWidget->playbackStats().current().speed);
+    const double now = currentTime + (secondTick.isValid() ? qMin(1.0, secondTick.elapsed() / 1000.0 * speed) : 0);
+    for (const auto& silence : silences) {
+        if (silence.second <= now) {
+            continue;
+        }
+        const double wait = qMax(0.0, silence.first - now) / speed;
+        // the next update arms anything further away
+        if (wait < 2) {
+            silenceTimer->start(qRound(wait * 1000));
+        }
+        return;
+    }
+}
+
+void MainWindow::skipSilence()
+{
+    const double now = mpv::qt::get_property(mpv, "time-pos").toDouble();
+    for (const auto& silence : silences) {
+        // a timer firing a little early still counts
+        if (silence.first <= now + 0.05 && now < silence.second) {
+            frameStepper->release();
+            mpv::qt::command(mpv, QVariantList { "seek", silence.second, "absolute" });
+            silenceSkips++;
+            silenceSkipped += silence.second - qMax(now, silence.first);
+            return;
+        }
+    }
+    scheduleSilenceSkip();
+}
+
+void MainWindow::scanUpcoming()
+{
+    // the playing file, its seeks are the ones waiting, and the next one,
+    // its crop is wanted before its first frame
+    const QStringList files = upcomingLocalFiles(0, 2);
+    keyframeIndexer->setFiles(config.indexKeyframes ? files : QStringList());
+    sceneDetector->setFiles(config.detectScenes ? files : QStringList());
+    cropDetector->setFiles(config.autoCrop ? files : QStringList());
+}
+
+void MainWindow::fingerprintEpisodes()
+{
+    const int current = playQueue.current();
+    if (!config.detectIntros || current < 0 || current >= playQueue.count()) {
+        return;
+    }
+    // every folder around the current entry with more than one file is taken
+    // for a season, the playing one first. Grouping a long queue by folder
+    // is left to the thread pool.
+    const QStringList queue = playQueue.files();
+    const int first = qMax(0, current - PlayQueue::WindowBefore);
+    const int last = qMin(queue.count(), current + PlayQueue::WindowAfter + 1);
+    QPointer<MainWindow> self(this);
+    QThreadPool::globalInstance()->start([=] {
+        QStringList folders;
+        if (!queue.at(current).contains("://")) {
+            folders << QFileInfo(queue.at(current)).absolutePath();
+        }
+        for (int i = first; i < last; ++i) {
+            const QString& entry = queue.at(i);
+            if (!entry.contains("://")) {
+                const QString folder = QFileInfo(entry).absolutePath();
+                if (!folders.contains(folder)) {
+                    folders << folder;
+                }
+            }
+        }
+        const QHash<QString, QStringList> seasons = IntroDetector::seasons(queue, folders);
+        QStringList files;
+        for (const QString& folder : std::as_const(folders)) {
+            if (seasons.value(folder).count() > 1) {
+                files << seasons.value(folder);
+            }
+        }
+        if (!self) {
+            return;
+        }
+        // files already queued are skipped, an older answer arriving late
+        // only adds nothing or a few episodes of a neighbouring season
+        QMetaObject::invokeMethod(self.data(), [=] {
+            if (config.detectIntros) {
+                introDetector->setFiles(files);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::updateSegments()
+{
+    if (!config.detectIntros || currentPath.isEmpty() || currentPath.contains("://")) {
+        episodeSegments = IntroDetector::Segments();
+        updateSkipButton();
+        return;
+    }
+    // updates asked for while matching, a burst of fingerprints or a new
+    // file, are folded into one more match once it is done
+    if (matchingSegments) {
+        segmentsOutdated = true;
+        return;
+    }
+    matchingSegments = true;
+    segmentsOutdated = false;
+    const QString file = currentPath;
+    QPointer<MainWindow> self(this);
+    introDetector->findSegments(file, playQueue.files(), [=](const IntroDetector::Segments& found) {
+        if (!self) {
+            return;
+        }
+        QMetaObject::invokeMethod(self.data(), [=] {
+            matchingSegments = false;
+            if (file == currentPath && config.detectIntros) {
+                episodeSegments = found;
+                updateSkipButton();
+            }
+            if (segmentsOutdated) {
+                updateSegments();
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MainWindow::updateSkipButton()
+{
+    // offered until the last second of the segment
+    auto within = [&](const QPair<double, double>& segment) {
+        return segment.second > segment.first && currentTime >= segment.first && currentTime < segment.second - 1;
+    };
+    if (within(episodeSegments.intro)) {
+        skipButton->setText("Skip Intro");
+        skipButton->setVisible(true);
+    }
+    else if (within(episodeSegments.credits)) {
+        skipButton->setText("Skip Credits");
+        skipButton->setVisible(true);
+    }
+    else {
+        skipButton->setVisible(false);
+    }
+}
+
+void MainWindow::skipSegment()
+{
+    frameStepper->release();
+    const auto& intro = episodeSegments.intro;
+    const auto& credits = episodeSegments.credits;
+    if (currentTime >= intro.first && currentTime < intro.second) {
+        mpv::qt::command(mpv, QVariantList { "seek", intro.second, "absolute" });
+    }
+    else if (currentTime >= credits.first && currentTime < credits.second) {
+        // after the credits comes the next episode
+        if (playQueue.current() + 1 < playQueue.count()) {
+            mpv::qt::command(mpv, QVariantList { "playlist-next" });
+        }
+        else {
+            mpv::qt::command(mpv, QVariantList { "seek", credits.second, "absolute" });
+        }
+    }
+    skipButton->setVisible(false);
+}
+
+// fills in the crop from the file's black bars, unless one was set by hand
+void MainWindow::applyAutoCrop(VideoAdjustments& a)
+{
+    if (!config.autoCrop || a.cropH != 0 || a.cropV != 0) {
+        return;
+    }
+    const Letterbox bars = cropDetector->load(currentIdentity);
+    // the crop is the same on both sides, the narrower bar decides
+    a.cropH = qMin(bars.left, bars.right);
+    a.cropV = qMin(bars.top, bars.bottom);
+    autoCropH = a.cropH;
+    autoCropV = a.cropV;
+}
+
+// files without chapters of their own get one per scene, mpv's chapter
+// seeking and the progress bar then work the same for both
+void MainWindow::applySceneChapters(const QJsonArray& cuts)
+{
+    if (cuts.isEmpty() || (!sceneChapters && !mpv::qt::get_property(mpv, "chapter-list").toList().isEmpty())) {
+        return;
+    }
+    QVariantList chapters;
+    chapters << QVariantMap { { "title", "Scene 1" }, { "time", 0.0 } };
+    for (const QJsonValue& cut : cuts) {
+        chapters << QVariantMap { { "title", QString("Scene %1").arg(chapters.count() + 1) }, { "time", cut.toDouble() } };
+    }
+    sceneChapters = true;
+    mpv::qt::set_property_variant(mpv, "chapter-list", chapters);
+}
+
+void MainWindow::seekChapter(bool forward)
+{
+    frameStepper->release();
+    QVariantList args;
+    args << QString("add") << QString("chapter") << (forward ? 1 : -1);
+    mpv::qt::command(mpv, args);
+}
+
+void MainWindow::prepareNext()
+{
+    // mpv prefetches the next entry itself, make sure it won't waste the
+    // transition on a file that disappeared since it was queued
+    int next = playQueue.current() + 1;
+    if (next <= 0 || next >= playQueue.count()) {
+        return;
+    }
+    const QString file = playQueue.at(next);
+    if (file.contains("://")) {
+        return;
+    }
+    // a stat on a slow or sleeping disk would hold up the GUI thread
+    QPointer<MainWindow> self(this);
+    QThreadPool::globalInstance()->start([=] {
+        if (QFileInfo::exists(file) || !self) {
+            return;
+        }
+        QMetaObject::invokeMethod(self.data(), [=] {
+            // the queue may have changed in the meantime
+            if (next < playQueue.count() && playQueue.at(next) == file) {
+                LOG << "Removing missing playlist entry" << file;
+                playlistRemove(next);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+QJsonObject MainWindow::stats()
+{
+    const TransitionStats& transitions = mpvWidget->transitionStats();
+    const CacheWarmer::Stats warmer = cacheWarmer->stats();
+    const AudioScanner::Stats scanner = audioScanner->stats();
+    const FrameStepper::Stats stepper = frameStepper->stats();
+    const SceneDetector::Stats scenes = sceneDetector->stats();
+    const CropDetector::Stats crops = cropDetector->stats();
+    const IntroDetector::Stats intros = introDetector->stats();
+    const StallWatchdog::Stats stalls = stallWatchdog->stats();
+    return {
+        { "playback", mpvWidget->playbackStats().toJson() },
+        { "transition", QJsonObject {
+                            { "count", transitions.count },
+                            { "last-gap-ms", transitions.lastGapMs },
+                            { "average-gap-ms", transitions.averageGapMs() },
+                            { "max-gap-ms", transitions.maxGapMs },
+                        } },
+        { "cache-warmer", QJsonObject {
+                              { "bytes-prefetched", warmer.bytesPrefetched },
+                              { "bytes-already-cached", warmer.bytesAlreadyCached },
+                              { "files-measured", warmer.filesMeasured },
+                              { "hit-rate", warmer.hitRate() },
+                          } },
+        { "audio-scanner", QJsonObject {
+                               { "files-scanned", scanner.filesScanned },
+                               { "seconds-decoded", scanner.secondsDecoded },
+                               { "speed", scanner.speed() },
+                           } },
+        { "frame-stepper", QJsonObject {
+                               { "frames", stepper.frames },
+                               { "bytes", stepper.bytes },
+                               { "served-steps", stepper.servedSteps },
+                               { "decoded-steps", stepper.decodedSteps },
+                               { "prefetches", stepper.prefetches },
+                           } },
+        { "scene-detector", QJsonObject {
+                                { "files-analyzed", scenes.filesAnalyzed },
+                                { "frames-analyzed", scenes.framesAnalyzed },
+                                { "seconds-analyzed", scenes.secondsAnalyzed },
+                                { "speed", scenes.speed() },
+                            } },
+        { "silence", QJsonObject {
+                         { "intervals", silences.count() },
+                         { "skips", silenceSkips },
+                         { "seconds-skipped", silenceSkipped },
+                     } },
+        { "intro-detector", QJsonObject {
+                                { "files-fingerprinted", intros.filesFingerprinted },
+                                { "seconds-decoded", intros.secondsDecoded },
+                            } },
+        { "crop-detector", QJsonObject {
+                               { "files-analyzed", crops.filesAnalyzed },
+                               { "frames-sampled", crops.framesSampled },
+                               { "seconds-spent", crops.secondsSpent },
+                           } },
+        { "stalls", QJsonObject {
+                        { "count", stalls.stalls },
+                        { "longest-ms", stalls.longestMs },
+                        { "total-ms", stalls.totalMs },
+                        { "last-activity", stalls.lastActivity },
+                        { "log", stallWatchdog->logPath() },
+                    } },
+    };
 }
 
 void MainWindow::updateTracks(QVariantList list)
 {
+    TRACE_SPAN("updateTracks");
 
     if (nullptr != subButton->menu()) {
         subButton->menu()->deleteLater();
@@ -655,10 +1652,20 @@ void MainWindow::updateTracks(QVariantList list)
     subButton->setMenu(subMenu);
     QAction* a;
 
+    subtitleSearch->setTracks(mpv::qt::get_property(mpv, "path").toString(), currentIdentity, list);
+
+    currentAid = -1;
+    currentSid = -1;
     for (int i = 0; i < list.count(); ++i) {
         auto map = list.at(i).toMap();
         bool selected = map.value("selected").toBool();
         int id = map.value("id").toInt();
+        if (selected && map.value("type").toString() == "audio") {
+            currentAid = id;
+        }
+        else if (selected && map.value("type").toString() == "sub") {
+            currentSid = id;
+        }
         QString lang = map.value("lang").toString();
         QString title = map.value("title").toString();
         QString text = (lang.isEmpty() ? "" : "[" + lang + "]") + (title.isEmpty() ? "" : " " + title);
@@ -695,10 +1702,21 @@ void MainWindow::updateTracks(QVariantList list)
 
 void MainWindow::onPropertyChanged(mpv_event_property* prop)
 {
+    TRACE_SPAN("onPropertyChanged", prop->name);
+    STALL_SCOPE("onPropertyChanged", prop->name);
     if (strcmp(prop->name, "time-pos") == 0) {
-        if (prop->format == MPV_FORMAT_INT64) {
+        // mpv is walking through frames behind the one on screen
+        if (prop->format == MPV_FORMAT_INT64 && !frameStepper->isBusy()) {
             time = *(int*)prop->data;
+            currentTime = time;
+            secondTick.start();
             updateProgress();
+            if (time % 5 == 0) {
+                // only lands in memory, the store writes it out on its own timer
+                saveResumePosition();
+            }
+            scheduleSilenceSkip();
+            updateSkipButton();
         }
     }
     else if (strcmp(prop->name, "track-list") == 0) {
@@ -706,10 +1724,26 @@ void MainWindow::onPropertyChanged(mpv_event_property* prop)
         QVariantList list = mpv::qt::node_to_variant(node).toList();
         updateTracks(list);
     }
-    else if (strcmp(prop->name, "playlist") == 0) {
-        mpv_node* node = (mpv_node*)prop->data;
-        QVariantList list = mpv::qt::node_to_variant(node).toList();
-        updatePlaylist(list);
+    else if (strcmp(prop->name, "chapter-list") == 0) {
+        QList<double> times;
+        if (prop->format == MPV_FORMAT_NODE) {
+            const QVariantList list = mpv::qt::node_to_variant((mpv_node*)prop->data).toList();
+            for (const QVariant& chapter : list) {
+                times << chapter.toMap().value("time").toDouble();
+            }
+        }
+        progressBar->setMarkers(times);
+    }
+    else if (strcmp(prop->name, "playlist-pos") == 0) {
+        // looked up again once mpv answered the whole batch
+        if (prop->format == MPV_FORMAT_INT64 && playlistBatch == 0) {
+            playlistPositionChanged(*(int*)prop->data);
+        }
+    }
+    else if (strcmp(prop->name, "playlist-count") == 0) {
+        if (prop->format == MPV_FORMAT_INT64 && playlistBatch == 0 && *(int*)prop->data != playQueue.windowCount()) {
+            adoptPlaylist();
+        }
     }
     else if (strcmp(prop->name, "pause") == 0) {
         // qDebug() << "pause event" << *(bool*)prop->data;
@@ -717,7 +1751,9 @@ void MainWindow::onPropertyChanged(mpv_event_property* prop)
     else if (strcmp(prop->name, "core-idle") == 0) {
         if (prop->format == MPV_FORMAT_FLAG) {
             paused = *(bool*)prop->data;
+            stallWatchdog->setIdle(paused);
             playButton->setIcon(paused ? playIcon : pauseIcon);
+            scheduleSilenceSkip();
         }
     }
     else if (strcmp(prop->name, "volume") == 0) {
@@ -726,10 +1762,45 @@ void MainWindow::onPropertyChanged(mpv_event_property* prop)
             updateVolume();
         }
     }
-    else if (strcmp(prop->name, "mute") == 0) {
-        if (prop->format == MPV_FORMAT_FLAG) {
-            muted = *(bool*)prop->data;
-            updateVolume();
+    else if (strcmp(prop->name, "mute") == 0) {
+        if (prop->format == MPV_FORMAT_FLAG) {
+            muted = *(bool*)prop->data;
+            updateVolume();
+        }
+    }
+    else if (strcmp(prop->name, "cache-speed") == 0) {
+        if (prop->format == MPV_FORMAT_INT64) {
+            // only meaningful while the demuxer is actually reading
+            double speed = *(int64_t*)prop->data;
+            if (speed > 0) {
+                sourceThroughput = sourceThroughput > 0 ? 0.8 * sourceThroughput + 0.2 * speed : speed;
+            }
+        }
+    }
+    else if (strcmp(prop->name, "paused-for-cache") == 0) {
+        if (prop->format == MPV_FORMAT_FLAG) {
+            bool stalled = *(int*)prop->data;
+            // the playing file needs the disk, get out of its way
+            cacheWarmer->setPaused(stalled);
+            audioScanner->setPaused(stalled);
+            keyframeIndexer->setPaused(stalled);
+            sceneDetector->setPaused(stalled);
+            cropDetector->setPaused(stalled);
+            introDetector->setPaused(stalled);
+            if (stalled && !cacheStalled) {
+                cacheStalled = true;
+                if (config.cacheProfile == CacheAuto) {
+                    tuneCache();
+                }
+            }
+        }
+    }
+    else if (strcmp(prop->name, "demuxer-cache-state") == 0) {
+        if (prop->format == MPV_FORMAT_NODE) {
+            updateCacheState(mpv::qt::node_to_variant((mpv_node*)prop->data).toMap());
+        }
+        else {
+            updateCacheState(QVariantMap());
         }
     }
     else if (strcmp(prop->name, "eof-reached") == 0) {
@@ -755,6 +1826,27 @@ void MainWindow::onPropertyChanged(mpv_event_property* prop)
         stream << "filename" << prop->format << prop->data << Qt::endl;
     }
 
+    else if (strcmp(prop->name, "video-dec-params") == 0) {
+        if (prop->format == MPV_FORMAT_NODE) {
+            QVariantMap params = mpv::qt::node_to_variant((mpv_node*)prop->data).toMap();
+            int w = params["w"].toInt();
+            int h = params["h"].toInt();
+            if (w != videoWidth || h != videoHeight) {
+                videoWidth = w;
+                videoHeight = h;
+                // the crop is in pixels and has to be worked out again
+                appliedAdjustments.cropH = -1;
+                appliedAdjustments.cropV = -1;
+                if (adjustments.cropH != 0 || adjustments.cropV != 0) {
+                    scheduleAdjustments();
+                }
+                else {
+                    appliedAdjustments.cropH = 0;
+                    appliedAdjustments.cropV = 0;
+                }
+            }
+        }
+    }
     else if (strcmp(prop->name, "duration") == 0) {
         if (prop->format == MPV_FORMAT_INT64) {
             length = *(int*)prop->data;
@@ -775,12 +1867,52 @@ void MainWindow::updateProgress()
     progressBar->setFormat(QString("%1/%2").arg(timeString, durationString));
 }
 
+void MainWindow::updateCacheState(const QVariantMap& state)
+{
+    QList<QPair<double, double>> ranges;
+    const auto list = state.value("seekable-ranges").toList();
+    for (const auto& range : list) {
+        auto map = range.toMap();
+        ranges.append({ map.value("start").toDouble(), map.value("end").toDouble() });
+    }
+    progressBar->setCacheRanges(ranges);
+}
+
 void MainWindow::progressClicked(int posX)
 {
     int clickedTime = (((double)posX / progressBar->width()) * length);
+    frameStepper->release();
+    if (seekIndexed(clickedTime, -1)) {
+        return;
+    }
     mpv::qt::set_property_variant(mpv, "time-pos", clickedTime);
 }
 
+// Seeks files whose container has no usable index through the keyframe
+// index instead. Lands on the keyframe before target, or the one after from
+// when that would not move forward. MPEG-TS gets a percent seek that mpv's
+// demuxer carries out as a byte seek to the keyframe's offset, Matroska and
+// AVI a keyframe seek to its exact time.
+bool MainWindow::seekIndexed(double target, double from)
+{
+    const KeyframeIndex::Entry* keyframe = keyframeIndex.keyframeBefore(target);
+    if (from >= 0 && (!keyframe || keyframe->time <= from)) {
+        keyframe = keyframeIndex.keyframeAfter(from);
+    }
+    if (!keyframe) {
+        return false;
+    }
+    QVariantList args;
+    if (keyframeIndex.seeksByBytes() && keyframeIndex.fileSize() > 0) {
+        args << QString("seek") << keyframe->offset * 100.0 / keyframeIndex.fileSize() << QString("absolute-percent+keyframes");
+    }
+    else {
+        args << QString("seek") << keyframe->time << QString("absolute+keyframes");
+    }
+    mpv::qt::command(mpv, args);
+    return true;
+}
+
 void MainWindow::showProgressTooltip(QPoint globalPos, int posX)
 {
     int tooltipTime = (((double)posX / progressBar->width()) * length);
@@ -789,7 +1921,7 @@ void MainWindow::showProgressTooltip(QPoint globalPos, int posX)
 
 void MainWindow::updateVolume()
 {
-    settings.setValue("volume", currentVolume);
+    settings->set(&Config::volume, currentVolume);
     if (currentVolume == 0 || muted) {
         volumeButton->setIcon(volumeMutedIcon);
     }
@@ -822,7 +1954,7 @@ void MainWindow::showVolumeTooltip(QPoint globalPos, int posX)
 
 void MainWindow::stepVolume(bool increase)
 {
-    currentVolume += (increase ? volumeStep : -volumeStep);
+    currentVolume += (increase ? config.volumeStep : -config.volumeStep);
     currentVolume = qBound(0, currentVolume, MAX_VOLUME);
     mpv::qt::set_property_variant(mpv, "volume", currentVolume);
     if (muted) {
@@ -830,8 +1962,10 @@ void MainWindow::stepVolume(bool increase)
     }
 }
 
-void MainWindow::updatePlaylist(QVariantList list)
+void MainWindow::updatePlaylist()
 {
+    TRACE_SPAN("updatePlaylist");
+    const QStringList& list = playQueue.files();
     int newSelection;
     QModelIndex modelIndex;
     if (selectedIndex >= 0 && selectedIndex < list.count()) {
@@ -844,72 +1978,30 @@ void MainWindow::updatePlaylist(QVariantList list)
             newSelection = list.count() - 1;
         }
     }
+    int newCount = selectedCount;
     selectedIndex = -1;
+    selectedCount = 1;
 
-    int iconHeight = fontMetrics().height() * 1;
-    QIcon upIcon = QIcon::fromTheme("go-up");
-    QIcon downIcon = QIcon::fromTheme("go-down");
-    QIcon delIcon = QIcon::fromTheme("list-remove");
+    analyzeUpcoming();
+    scanUpcoming();
+    fingerprintEpisodes();
 
-    playlistModel->clear();
-
-    for (int i = 0; i < list.count(); ++i) {
-        auto media = list.at(i).toMap();
-        QString filename = media.value("filename").toString();
-        QFileInfo info(filename);
-        QString title = info.exists() ? info.completeBaseName() : filename;
-        bool current = media.value("current").toBool();
-        auto item = new QStandardItem(QString());
-        item->setDropEnabled(false);
-        playlistModel->appendRow(item);
-        auto index = playlistModel->indexFromItem(item);
-        auto widget = new QWidget;
-        widget->setContentsMargins(0, 0, 0, 0);
-        auto box = new QHBoxLayout(widget);
-        box->setContentsMargins(0, 0, 0, 0);
-        auto iconLabel = new QLabel;
-        if (current) {
-            iconLabel->setPixmap(playIcon.pixmap(iconHeight));
-        }
-        auto titleLabel = new QLabel(title);
-        auto upButton = new QPushButton(upIcon, QString());
-        auto downButton = new QPushButton(downIcon, QString());
-        auto delButton = new QPushButton(delIcon, QString());
-        box->addWidget(iconLabel);
-        box->addWidget(titleLabel, 1);
-        box->addSpacing(5);
-        box->addWidget(upButton);
-        box->addWidget(downButton);
-        box->addSpacing(5);
-        box->addWidget(delButton);
-        box->addSpacing(5);
-        playlistView->setIndexWidget(index, widget);
-        if (i == 0) {
-            upButton->setEnabled(false);
-        }
-        else {
-            connect(upButton, &QPushButton::clicked, this, [=] {
-                playlistMove(i, i - 1);
-            });
-        }
-        if (i == list.count() - 1) {
-            downButton->setEnabled(false);
-        }
-        else {
-            connect(downButton, &QPushButton::clicked, this, [=] {
-                playlistMove(i, i + 2);
-            });
-        }
-        connect(delButton, &QPushButton::clicked, this, [=] {
-            playlistRemove(i);
-        });
-    }
     if (newSelection != -1) {
         modelIndex = playlistModel->index(newSelection, 0);
         playlistView->setCurrentIndex(modelIndex);
+        if (newCount > 1) {
+            QModelIndex last = playlistModel->index(qMin(newSelection + newCount, list.count()) - 1, 0);
+            playlistView->selectionModel()->select(QItemSelection(modelIndex, last), QItemSelectionModel::Select);
+        }
     }
 }
 
+// moves the play marker, only its two rows are repainted
+void MainWindow::updatePlaylistCurrent(int previous)
+{
+    playlistModel->currentMoved(previous);
+}
+
 void MainWindow::showConfigDialog()
 {
     auto d = new QDialog(this);
@@ -928,32 +2020,186 @@ void MainWindow::showConfigDialog()
     genTab->setLayout(genForm);
     auto seekStepSpin = new QSpinBox;
     seekStepSpin->setRange(1, 100);
-    seekStepSpin->setValue(seekStep);
+    seekStepSpin->setValue(config.seekStep);
     seekStepSpin->setSuffix("s");
     connect(seekStepSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [&](int value) {
-        seekStep = value;
-        settings.setValue("seekStep", value);
+        settings->set(&Config::seekStep, value);
     });
     auto seekBarStepSpin = new QSpinBox;
     seekBarStepSpin->setRange(1, 200);
-    seekBarStepSpin->setValue(seekBarStep);
+    seekBarStepSpin->setValue(config.seekBarStep);
     seekBarStepSpin->setSuffix("s");
     connect(seekBarStepSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [&](int value) {
-        seekBarStep = value;
-        settings.setValue("seekBarStep", value);
+        settings->set(&Config::seekBarStep, value);
     });
     auto volumeStepSpin = new QSpinBox;
     volumeStepSpin->setRange(1, 20);
-    volumeStepSpin->setValue(volumeStep);
+    volumeStepSpin->setValue(config.volumeStep);
     volumeStepSpin->setSuffix("%");
     connect(volumeStepSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [&](int value) {
-        volumeStep = value;
-        settings.setValue("volumeStep", value);
+        settings->set(&Config::volumeStep, value);
+    });
+
+    auto ipcServerEdit = new QLineEdit;
+    ipcServerEdit->setText(config.ipcServer);
+    ipcServerEdit->setPlaceholderText("Disabled");
+    ipcServerEdit->setToolTip("Path of the JSON IPC socket, compatible with mpv's input-ipc-server");
+    connect(ipcServerEdit, &QLineEdit::editingFinished, this, [=] {
+        settings->set(&Config::ipcServer, ipcServerEdit->text());
     });
 
     genForm->addRow("Seek Step", seekStepSpin);
     genForm->addRow("Seek Progress Bar Step", seekBarStepSpin);
     genForm->addRow("Volume Step", volumeStepSpin);
+    auto prefetchCheck = new QCheckBox;
+    prefetchCheck->setChecked(config.prefetchPlaylist);
+    prefetchCheck->setToolTip("Open the next playlist item ahead of time for near-gapless transitions");
+    connect(prefetchCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::prefetchPlaylist, state == Qt::Checked);
+    });
+
+    auto resumeCheck = new QCheckBox;
+    resumeCheck->setChecked(config.resumePlayback);
+    resumeCheck->setToolTip("Remember position, audio and subtitle track and speed of each file");
+    connect(resumeCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::resumePlayback, state == Qt::Checked);
+    });
+
+    auto rememberVideoCheck = new QCheckBox;
+    rememberVideoCheck->setChecked(config.rememberVideoAdjustments);
+    rememberVideoCheck->setToolTip("Remember zoom, rotation, pan, crop and picture adjustments of each file");
+    connect(rememberVideoCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::rememberVideoAdjustments, state == Qt::Checked);
+    });
+
+    auto normalizeCheck = new QCheckBox;
+    normalizeCheck->setChecked(config.normalizeLoudness);
+    normalizeCheck->setToolTip("Measure the loudness of playlist items in the background and play each at the same level");
+    connect(normalizeCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::normalizeLoudness, state == Qt::Checked);
+    });
+    auto loudnessTargetSpin = new QSpinBox;
+    loudnessTargetSpin->setRange(-31, -5);
+    loudnessTargetSpin->setSuffix(" LUFS");
+    loudnessTargetSpin->setValue(config.loudnessTarget);
+    connect(loudnessTargetSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [&](int value) {
+        settings->set(&Config::loudnessTarget, value);
+    });
+
+    auto indexKeyframesCheck = new QCheckBox;
+    indexKeyframesCheck->setChecked(config.indexKeyframes);
+    indexKeyframesCheck->setToolTip("Scan MPEG-TS, AVI and Matroska files that come without a seek index for their keyframes");
+    connect(indexKeyframesCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::indexKeyframes, state == Qt::Checked);
+    });
+
+    auto detectScenesCheck = new QCheckBox;
+    detectScenesCheck->setChecked(config.detectScenes);
+    detectScenesCheck->setToolTip("Find scene cuts in the background and use them as chapters in files without any");
+    connect(detectScenesCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::detectScenes, state == Qt::Checked);
+    });
+
+    auto skipSilenceCheck = new QCheckBox;
+    skipSilenceCheck->setChecked(config.skipSilence);
+    skipSilenceCheck->setToolTip("Find silence in the background and jump over it while playing");
+    connect(skipSilenceCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::skipSilence, state == Qt::Checked);
+    });
+
+    auto silenceThresholdSpin = new QSpinBox;
+    silenceThresholdSpin->setRange(-90, -20);
+    silenceThresholdSpin->setSuffix(" dB");
+    silenceThresholdSpin->setToolTip("Audio at or below this level counts as silence");
+    silenceThresholdSpin->setValue(config.silenceThreshold);
+    connect(silenceThresholdSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [&](int value) {
+        settings->set(&Config::silenceThreshold, value);
+    });
+
+    auto silenceMinSpin = new QSpinBox;
+    silenceMinSpin->setRange(1, 60);
+    silenceMinSpin->setSuffix(" s");
+    silenceMinSpin->setToolTip("Shorter silences are played");
+    silenceMinSpin->setValue(config.silenceMinSecs);
+    connect(silenceMinSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [&](int value) {
+        settings->set(&Config::silenceMinSecs, value);
+    });
+
+    auto detectIntrosCheck = new QCheckBox;
+    detectIntrosCheck->setChecked(config.detectIntros);
+    detectIntrosCheck->setToolTip("Compare the audio of episodes in the same folder and offer to skip the intro and credits they share");
+    connect(detectIntrosCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::detectIntros, state == Qt::Checked);
+    });
+
+    auto autoCropCheck = new QCheckBox;
+    autoCropCheck->setChecked(config.autoCrop);
+    autoCropCheck->setToolTip("Sample frames of each file in the background and crop away black bars when it's loaded");
+    connect(autoCropCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::autoCrop, state == Qt::Checked);
+    });
+
+    auto frameCacheSpin = new QSpinBox;
+    frameCacheSpin->setRange(0, 4096);
+    frameCacheSpin->setSingleStep(64);
+    frameCacheSpin->setSuffix(" MiB");
+    frameCacheSpin->setSpecialValueText("Off");
+    frameCacheSpin->setToolTip("Memory for frames kept around so stepping backwards with , is instant");
+    frameCacheSpin->setValue(config.frameCacheMiB);
+    connect(frameCacheSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [&](int value) {
+        settings->set(&Config::frameCacheMiB, value);
+    });
+
+    auto logLevelCombo = new QComboBox;
+    logLevelCombo->addItems(LogCapture::levelNames());
+    logLevelCombo->setCurrentText(config.logLevel);
+    logLevelCombo->setToolTip("Messages mpv logs at this level or above are kept for the log viewer");
+    connect(logLevelCombo, &QComboBox::currentTextChanged, this, [=](const QString& text) {
+        settings->set(&Config::logLevel, text);
+    });
+    auto logToFileCheck = new QCheckBox;
+    logToFileCheck->setChecked(config.logToFile);
+    logToFileCheck->setToolTip(QString("Append mpv's log to %1").arg(QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/logs/mpv.log"));
+    connect(logToFileCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::logToFile, state == Qt::Checked);
+    });
+    auto logFileSpin = new QSpinBox;
+    logFileSpin->setRange(1, 1024);
+    logFileSpin->setSuffix(" MiB");
+    logFileSpin->setToolTip(QString("The log file is rotated at this size, %1 old ones are kept").arg(LogCapture::KeepFiles));
+    logFileSpin->setValue(config.logFileMiB);
+    connect(logFileSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [&](int value) {
+        settings->set(&Config::logFileMiB, value);
+    });
+    auto stallSpin = new QSpinBox;
+    stallSpin->setRange(0, 2000);
+    stallSpin->setSingleStep(10);
+    stallSpin->setSuffix(" ms");
+    stallSpin->setSpecialValueText("Off");
+    stallSpin->setToolTip(QString("Freezes of the interface longer than this are logged with stack samples to %1").arg(stallWatchdog->logPath()));
+    stallSpin->setValue(config.stallThresholdMs);
+    connect(stallSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [&](int value) {
+        settings->set(&Config::stallThresholdMs, value);
+    });
+
+    genForm->addRow("Resume Playback", resumeCheck);
+    genForm->addRow("Remember Video Adjustments", rememberVideoCheck);
+    genForm->addRow("Prefetch Next Item", prefetchCheck);
+    genForm->addRow("Normalize Loudness", normalizeCheck);
+    genForm->addRow("Loudness Target", loudnessTargetSpin);
+    genForm->addRow("Skip Silence", skipSilenceCheck);
+    genForm->addRow("Silence Threshold", silenceThresholdSpin);
+    genForm->addRow("Minimum Silence", silenceMinSpin);
+    genForm->addRow("Frame Step Cache", frameCacheSpin);
+    genForm->addRow("Index Keyframes", indexKeyframesCheck);
+    genForm->addRow("Detect Scenes", detectScenesCheck);
+    genForm->addRow("Detect Black Bars", autoCropCheck);
+    genForm->addRow("Detect Intros", detectIntrosCheck);
+    genForm->addRow("Control Socket", ipcServerEdit);
+    genForm->addRow("mpv Log Level", logLevelCombo);
+    genForm->addRow("Write Log File", logToFileCheck);
+    genForm->addRow("Log File Size", logFileSpin);
+    genForm->addRow("Stall Watchdog", stallSpin);
 
     // UI
     auto uiTab = new QWidget;
@@ -962,168 +2208,154 @@ void MainWindow::showConfigDialog()
     uiTab->setLayout(uiForm);
 
     auto showPlayPauseCheck = new QCheckBox;
-    showPlayPauseCheck->setChecked(showPlayPause);
+    showPlayPauseCheck->setChecked(config.showPlayPause);
     auto showSpeedCheck = new QCheckBox;
-    showSpeedCheck->setChecked(showSpeed);
+    showSpeedCheck->setChecked(config.showSpeed);
     auto showZoomCheck = new QCheckBox;
-    showZoomCheck->setChecked(showZoom);
+    showZoomCheck->setChecked(config.showZoom);
     auto showRotationCheck = new QCheckBox;
-    showRotationCheck->setChecked(showRotation);
+    showRotationCheck->setChecked(config.showRotation);
     auto showPanXCheck = new QCheckBox;
-    showPanXCheck->setChecked(showPanX);
+    showPanXCheck->setChecked(config.showPanX);
     auto showPanYCheck = new QCheckBox;
-    showPanYCheck->setChecked(showPanY);
+    showPanYCheck->setChecked(config.showPanY);
     auto showCropHCheck = new QCheckBox;
-    showCropHCheck->setChecked(showCropH);
+    showCropHCheck->setChecked(config.showCropH);
     auto showCropVCheck = new QCheckBox;
-    showCropVCheck->setChecked(showCropV);
+    showCropVCheck->setChecked(config.showCropV);
 
     auto showBrightnessCheck = new QCheckBox;
-    showBrightnessCheck->setChecked(showBrightness);
+    showBrightnessCheck->setChecked(config.showBrightness);
     auto showContrastCheck = new QCheckBox;
-    showContrastCheck->setChecked(showContrast);
+    showContrastCheck->setChecked(config.showContrast);
     auto showSaturationCheck = new QCheckBox;
-    showSaturationCheck->setChecked(showSaturation);
+    showSaturationCheck->setChecked(config.showSaturation);
     auto showGammaCheck = new QCheckBox;
-    showGammaCheck->setChecked(showGamma);
+    showGammaCheck->setChecked(config.showGamma);
     auto showHueCheck = new QCheckBox;
-    showHueCheck->setChecked(showHue);
+    showHueCheck->setChecked(config.showHue);
 
     auto showProgressCheck = new QCheckBox;
-    showProgressCheck->setChecked(showProgress);
+    showProgressCheck->setChecked(config.showProgress);
+    auto showWaveformCheck = new QCheckBox;
+    showWaveformCheck->setChecked(config.showWaveform);
+    showWaveformCheck->setToolTip("Draw the audio behind the progress, decoded once in the background");
     auto showMuteCheck = new QCheckBox;
-    showMuteCheck->setChecked(showMute);
+    showMuteCheck->setChecked(config.showMute);
     auto showVolumeCheck = new QCheckBox;
-    showVolumeCheck->setChecked(showVolume);
+    showVolumeCheck->setChecked(config.showVolume);
     auto showAudioCheck = new QCheckBox;
-    showAudioCheck->setChecked(showAudio);
+    showAudioCheck->setChecked(config.showAudio);
     auto showSubCheck = new QCheckBox;
-    showSubCheck->setChecked(showSub);
+    showSubCheck->setChecked(config.showSub);
     auto showSettingsCheck = new QCheckBox;
-    showSettingsCheck->setChecked(showSettings);
+    showSettingsCheck->setChecked(config.showSettings);
     auto showPlaylistButtonCheck = new QCheckBox;
-    showPlaylistButtonCheck->setChecked(showPlaylistButton);
+    showPlaylistButtonCheck->setChecked(config.showPlaylistButton);
 
     connect(showPlayPauseCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showPlayPause = checked;
         playButton->setVisible(checked);
-        settings.setValue("showPlayPause", checked);
+        settings->set(&Config::showPlayPause, checked);
     });
     connect(showSpeedCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showSpeed = checked;
         speedSpin->setVisible(checked);
-        settings.setValue("showSpeed", checked);
+        settings->set(&Config::showSpeed, checked);
     });
     connect(showZoomCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showZoom = checked;
         zoomSpin->setVisible(checked);
-        settings.setValue("showZoom", checked);
+        settings->set(&Config::showZoom, checked);
     });
     connect(showRotationCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showRotation = checked;
         rotationSpin->setVisible(checked);
-        settings.setValue("showRotation", checked);
+        settings->set(&Config::showRotation, checked);
     });
     connect(showPanXCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showPanX = checked;
         panXSpin->setVisible(checked);
-        settings.setValue("showPanX", checked);
+        settings->set(&Config::showPanX, checked);
     });
     connect(showPanYCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showPanY = checked;
         panYSpin->setVisible(checked);
-        settings.setValue("showPanY", checked);
+        settings->set(&Config::showPanY, checked);
     });
     connect(showCropHCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showCropH = checked;
         cropHSpin->setVisible(checked);
-        settings.setValue("showCropH", checked);
+        settings->set(&Config::showCropH, checked);
     });
     connect(showCropVCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showCropV = checked;
         cropVSpin->setVisible(checked);
-        settings.setValue("showCropV", checked);
+        settings->set(&Config::showCropV, checked);
     });
     connect(showBrightnessCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showBrightness = checked;
         brightnessSpin->setVisible(checked);
-        settings.setValue("showBrightness", checked);
+        settings->set(&Config::showBrightness, checked);
     });
     connect(showContrastCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showContrast = checked;
         contrastSpin->setVisible(checked);
-        settings.setValue("showContrast", checked);
+        settings->set(&Config::showContrast, checked);
     });
     connect(showSaturationCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showSaturation = checked;
         saturationSpin->setVisible(checked);
-        settings.setValue("showSaturation", checked);
+        settings->set(&Config::showSaturation, checked);
     });
     connect(showGammaCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showGamma = checked;
         gammaSpin->setVisible(checked);
-        settings.setValue("showGamma", checked);
+        settings->set(&Config::showGamma, checked);
     });
     connect(showHueCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showHue = checked;
         hueSpin->setVisible(checked);
-        settings.setValue("showHue", checked);
+        settings->set(&Config::showHue, checked);
     });
 
     connect(showProgressCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showProgress = checked;
         progressBar->setVisible(checked);
-        settings.setValue("showProgress", checked);
+        settings->set(&Config::showProgress, checked);
+    });
+    connect(showWaveformCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::showWaveform, state == Qt::Checked);
     });
     connect(showMuteCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showMute = checked;
         volumeButton->setVisible(checked);
-        settings.setValue("showMute", checked);
+        settings->set(&Config::showMute, checked);
     });
     connect(showVolumeCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showVolume = checked;
         volumeBar->setVisible(checked);
-        settings.setValue("showVolume", checked);
+        settings->set(&Config::showVolume, checked);
     });
     connect(showAudioCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showAudio = checked;
         audioButton->setVisible(checked);
-        settings.setValue("showAudio", checked);
+        settings->set(&Config::showAudio, checked);
     });
     connect(showSubCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showSub = checked;
         subButton->setVisible(checked);
-        settings.setValue("showSub", checked);
+        settings->set(&Config::showSub, checked);
     });
     connect(showSettingsCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showSettings = checked;
         configDialogButton->setVisible(checked);
-        settings.setValue("showSettings", checked);
+        settings->set(&Config::showSettings, checked);
     });
     connect(showPlaylistButtonCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
         bool checked = state == Qt::Checked;
-        showPlaylistButton = checked;
         playlistButton->setVisible(checked);
-        settings.setValue("showPlaylistButton", checked);
+        settings->set(&Config::showPlaylistButton, checked);
     });
 
     uiForm->addRow("Show Play Button", showPlayPauseCheck);
@@ -1140,6 +2372,7 @@ void MainWindow::showConfigDialog()
     uiForm->addRow("Show Gamma Selector", showGammaCheck);
     uiForm->addRow("Show Hue Selector", showHueCheck);
     uiForm->addRow("Show Progress Bar", showProgressCheck);
+    uiForm->addRow("Show Waveform", showWaveformCheck);
     uiForm->addRow("Show Mute Button", showMuteCheck);
     uiForm->addRow("Show Volume Bar", showVolumeCheck);
     uiForm->addRow("Show Audio Track Selector", showAudioCheck);
@@ -1153,55 +2386,45 @@ void MainWindow::showConfigDialog()
     subTab->setLayout(subForm);
     subForm->setFieldGrowthPolicy(QFormLayout::FieldsStayAtSizeHint);
     auto fontCombo = new QFontComboBox;
-    fontCombo->setCurrentFont(subFont);
+    fontCombo->setCurrentFont(config.subFont);
     connect(fontCombo, &QFontComboBox::currentFontChanged, d, [&](const QFont& f) {
-        subFont = f;
-        mpv::qt::set_option_variant(mpv, "sub-font", f.family());
-        settings.setValue("subFont", f);
+        settings->set(&Config::subFont, f);
     });
 
     auto fontSizeSpin = new QSpinBox;
     fontSizeSpin->setRange(10, 100);
     fontSizeSpin->setSingleStep(5);
-    fontSizeSpin->setValue(subFontSize);
+    fontSizeSpin->setValue(config.subFontSize);
     connect(fontSizeSpin, QOverload<int>::of(&QSpinBox::valueChanged), d, [&](int value) {
-        subFontSize = value;
-        mpv::qt::set_option_variant(mpv, "sub-font-size", value);
-        settings.setValue("subFontSize", value);
+        settings->set(&Config::subFontSize, value);
     });
 
     auto borderButton = new QPushButton("Pick");
-    borderButton->setIcon(getSquareIcon(subBorderColor));
+    borderButton->setIcon(getSquareIcon(config.subBorderColor));
     connect(borderButton, &QPushButton::clicked, this, [&] {
-        auto color = QColorDialog::getColor(subBorderColor, this, "Border Color", QColorDialog::ShowAlphaChannel);
+        auto color = QColorDialog::getColor(config.subBorderColor, this, "Border Color", QColorDialog::ShowAlphaChannel);
         if (color.isValid()) {
-            subBorderColor = color;
             auto btn = qobject_cast<QPushButton*>(sender());
             if (nullptr != btn) {
-                btn->setIcon(getSquareIcon(subBorderColor));
+                btn->setIcon(getSquareIcon(color));
             }
-            mpv::qt::set_option_variant(mpv, "sub-border-color", subBorderColor.name(QColor::HexArgb));
-            settings.setValue("subBorderColor", color);
+            settings->set(&Config::subBorderColor, color);
         }
     });
     auto borderSizeSpin = new QSpinBox;
     borderSizeSpin->setRange(0, 10);
-    borderSizeSpin->setValue(subBorderSize);
+    borderSizeSpin->setValue(config.subBorderSize);
     connect(borderSizeSpin, QOverload<int>::of(&QSpinBox::valueChanged), d, [&](int value) {
-        subBorderSize = value;
-        mpv::qt::set_option_variant(mpv, "sub-border-size", value);
-        settings.setValue("subBorderSize", value);
+        settings->set(&Config::subBorderSize, value);
     });
 
     subColorButton = new QPushButton("Pick");
-    subColorButton->setIcon(getSquareIcon(subColor));
+    subColorButton->setIcon(getSquareIcon(config.subColor));
     connect(subColorButton, &QPushButton::clicked, d, [&] {
-        auto color = QColorDialog::getColor(subColor, d, "Subtitle Color", QColorDialog::ShowAlphaChannel);
+        auto color = QColorDialog::getColor(config.subColor, d, "Subtitle Color", QColorDialog::ShowAlphaChannel);
         if (color.isValid()) {
-            subColor = color;
-            subColorButton->setIcon(getSquareIcon(subColor));
-            mpv::qt::set_option_variant(mpv, "sub-color", subColor.name(QColor::HexArgb));
-            settings.setValue("subColor", subColor);
+            subColorButton->setIcon(getSquareIcon(color));
+            settings->set(&Config::subColor, color);
         }
     });
 
@@ -1211,9 +2434,91 @@ void MainWindow::showConfigDialog()
     subForm->addRow("Border Size", borderSizeSpin);
     subForm->addRow("Color", subColorButton);
 
+    // Cache
+    auto cacheTab = new QWidget;
+    auto cacheForm = new QFormLayout(cacheTab);
+    cacheTab->setLayout(cacheForm);
+    cacheForm->setFieldGrowthPolicy(QFormLayout::FieldsStayAtSizeHint);
+    auto cacheModeCombo = new QComboBox;
+    cacheModeCombo->addItems(cacheModeNames());
+    cacheModeCombo->setCurrentIndex(config.cacheProfile);
+    cacheModeCombo->setToolTip("Auto sizes the cache and decoder threads from core count, free memory and source speed");
+    auto cacheCombo = new QComboBox;
+    cacheCombo->addItems({ "auto", "yes", "no" });
+    cacheCombo->setCurrentText(config.cache);
+    auto cacheMaxSpin = new QSpinBox;
+    cacheMaxSpin->setRange(1, 16384);
+    cacheMaxSpin->setSuffix(" MiB");
+    cacheMaxSpin->setValue(config.cacheMaxMiB);
+    auto cacheBackSpin = new QSpinBox;
+    cacheBackSpin->setRange(0, 16384);
+    cacheBackSpin->setSuffix(" MiB");
+    cacheBackSpin->setValue(config.cacheMaxBackMiB);
+    auto readaheadSpin = new QSpinBox;
+    readaheadSpin->setRange(0, 3600);
+    readaheadSpin->setSuffix("s");
+    readaheadSpin->setValue(config.cacheReadaheadSecs);
+    auto threadsSpin = new QSpinBox;
+    threadsSpin->setRange(0, 64);
+    threadsSpin->setSpecialValueText("Auto");
+    threadsSpin->setValue(config.decoderThreads);
+
+    auto updateCacheWidgets = [=] {
+        bool custom = config.cacheProfile == CacheCustom;
+        cacheCombo->setEnabled(custom);
+        cacheMaxSpin->setEnabled(custom);
+        cacheBackSpin->setEnabled(custom);
+        readaheadSpin->setEnabled(custom);
+        threadsSpin->setEnabled(custom);
+    };
+    updateCacheWidgets();
+    connect(cacheModeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), this, [=](int index) {
+        settings->set(&Config::cacheProfile, index);
+        updateCacheWidgets();
+    });
+    connect(cacheCombo, &QComboBox::currentTextChanged, this, [=](const QString& text) {
+        settings->set(&Config::cache, text);
+    });
+    connect(cacheMaxSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
+        settings->set(&Config::cacheMaxMiB, value);
+    });
+    connect(cacheBackSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
+        settings->set(&Config::cacheMaxBackMiB, value);
+    });
+    connect(readaheadSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
+        settings->set(&Config::cacheReadaheadSecs, value);
+    });
+    connect(threadsSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [=](int value) {
+        settings->set(&Config::decoderThreads, value);
+    });
+
+    auto warmCacheCheck = new QCheckBox;
+    warmCacheCheck->setChecked(config.warmCache);
+    warmCacheCheck->setToolTip("Read the start, end and index of the next playlist items into the page cache in the background");
+    connect(warmCacheCheck, &QCheckBox::checkStateChanged, this, [&](Qt::CheckState state) {
+        settings->set(&Config::warmCache, state == Qt::Checked);
+    });
+    auto warmCacheRateSpin = new QSpinBox;
+    warmCacheRateSpin->setRange(1, 1024);
+    warmCacheRateSpin->setSuffix(" MiB/s");
+    warmCacheRateSpin->setValue(config.warmCacheRate);
+    connect(warmCacheRateSpin, QOverload<int>::of(&QSpinBox::valueChanged), this, [&](int value) {
+        settings->set(&Config::warmCacheRate, value);
+    });
+
+    cacheForm->addRow("Profile", cacheModeCombo);
+    cacheForm->addRow("Cache", cacheCombo);
+    cacheForm->addRow("Demuxer Max Size", cacheMaxSpin);
+    cacheForm->addRow("Demuxer Max Back Size", cacheBackSpin);
+    cacheForm->addRow("Demuxer Readahead", readaheadSpin);
+    cacheForm->addRow("Decoder Threads", threadsSpin);
+    cacheForm->addRow("Warm Upcoming Files", warmCacheCheck);
+    cacheForm->addRow("Warming Rate Limit", warmCacheRateSpin);
+
     tab->addTab(genTab, "General");
     tab->addTab(uiTab, "UI");
     tab->addTab(subTab, "Subtitles");
+    tab->addTab(cacheTab, "Cache");
 
     auto buttonBox = new QHBoxLayout;
 
@@ -1230,6 +2535,346 @@ void MainWindow::showConfigDialog()
     d->exec();
 }
 
+void MainWindow::saveScreenshot()
+{
+    QImage frame = grabFrame(mpv);
+    if (frame.isNull()) {
+        return;
+    }
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::PicturesLocation);
+    QString name = QString("%1-%2.png").arg(QFileInfo(currentPath).completeBaseName(), timeStringFromInt(time, true).replace(':', '-'));
+    QString path = QDir(dir).filePath(name);
+    // encoding takes longer than grabbing, keep it off the GUI thread
+    QThreadPool::globalInstance()->start([=] {
+        frame.save(path);
+    });
+    LOG << "screenshot" << path;
+}
+
+void MainWindow::showExportDialog()
+{
+    auto d = new QDialog(this);
+    d->setAttribute(Qt::WA_DeleteOnClose);
+    d->setWindowTitle("Export Frames");
+    auto form = new QFormLayout(d);
+
+    QVariantList chapters = mpv::qt::get_property(mpv, "chapter-list").toList();
+    auto modeCombo = new QComboBox;
+    modeCombo->addItem("Every N Seconds");
+    if (!chapters.isEmpty()) {
+        modeCombo->addItem(sceneChapters ? "At Every Scene Cut" : "At Every Chapter");
+    }
+    auto intervalSpin = new QSpinBox;
+    intervalSpin->setRange(1, 3600);
+    intervalSpin->setValue(10);
+    intervalSpin->setSuffix("s");
+    auto fromEdit = new QTimeEdit;
+    fromEdit->setDisplayFormat("HH:mm:ss");
+    auto toEdit = new QTimeEdit;
+    toEdit->setDisplayFormat("HH:mm:ss");
+    toEdit->setTime(QTime(0, 0).addSecs(length));
+    auto formatCombo = new QComboBox;
+    formatCombo->addItems(FrameExporter::formats());
+    auto qualitySpin = new QSpinBox;
+    qualitySpin->setRange(1, 100);
+    qualitySpin->setValue(90);
+    auto dirEdit = new QLineEdit(QDir(QStandardPaths::writableLocation(QStandardPaths::PicturesLocation)).filePath(QFileInfo(currentPath).completeBaseName()));
+    auto dirButton = new QPushButton("Browse");
+    connect(dirButton, &QPushButton::clicked, d, [=] {
+        QString dir = QFileDialog::getExistingDirectory(d, "Export To", dirEdit->text());
+        if (!dir.isEmpty()) {
+            dirEdit->setText(dir);
+        }
+    });
+    connect(modeCombo, QOverload<int>::of(&QComboBox::currentIndexChanged), d, [=](int index) {
+        intervalSpin->setEnabled(index == 0);
+    });
+    auto dirBox = new QHBoxLayout;
+    dirBox->addWidget(dirEdit, 1);
+    dirBox->addWidget(dirButton);
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::rejected, d, &QDialog::reject);
+    connect(buttons, &QDialogButtonBox::accepted, d, &QDialog::accept);
+
+    form->addRow("Frames", modeCombo);
+    form->addRow("Interval", intervalSpin);
+    form->addRow("From", fromEdit);
+    form->addRow("To", toEdit);
+    form->addRow("Format", formatCombo);
+    form->addRow("Quality", qualitySpin);
+    form->addRow("Directory", dirBox);
+    form->addRow(buttons);
+
+    connect(d, &QDialog::accepted, this, [=] {
+        double from = QTime(0, 0).secsTo(fromEdit->time());
+        double to = QTime(0, 0).secsTo(toEdit->time());
+        FrameExporter::Job job;
+        job.file = currentPath;
+        job.directory = dirEdit->text();
+        job.baseName = QFileInfo(currentPath).completeBaseName();
+        job.format = formatCombo->currentText();
+        job.quality = qualitySpin->value();
+        if (modeCombo->currentIndex() == 0) {
+            job.times = FrameExporter::intervalTimes(from, to, intervalSpin->value());
+        }
+        else {
+            for (const QVariant& chapter : chapters) {
+                double t = chapter.toMap().value("time").toDouble();
+                if (t >= from && t <= to) {
+                    job.times << t;
+                }
+            }
+        }
+        if (job.times.isEmpty() || !frameExporter->exportFrames(job)) {
+            return;
+        }
+        auto progress = new QProgressDialog("Exporting frames", "Cancel", 0, job.times.count(), this);
+        progress->setAttribute(Qt::WA_DeleteOnClose);
+        progress->setMinimumDuration(0);
+        connect(frameExporter, &FrameExporter::progress, progress, &QProgressDialog::setValue);
+        connect(progress, &QProgressDialog::canceled, frameExporter, &FrameExporter::cancel);
+        connect(frameExporter, &FrameExporter::finished, progress, [=](int written, const QString& dir) {
+            LOG << "exported" << written << "frames to" << dir;
+            progress->close();
+        });
+        progress->show();
+    });
+    d->show();
+}
+
+void MainWindow::setClipPoint(bool end)
+{
+    if (currentPath.isEmpty() || currentPath.contains("://")) {
+        return;
+    }
+    const double now = mpv::qt::get_property(mpv, "time-pos").toDouble();
+    if (end) {
+        clipEnd = now;
+    }
+    else {
+        clipStart = now;
+    }
+    // a new point on the wrong side of the other one starts over
+    if (clipStart >= 0 && clipEnd >= 0 && clipEnd <= clipStart) {
+        if (end) {
+            clipStart = -1;
+        }
+        else {
+            clipEnd = -1;
+        }
+    }
+    progressBar->setSelection(clipStart, clipEnd);
+}
+
+void MainWindow::exportPlaybackLog()
+{
+    const QString name = QString("fastplayer-session-%1.csv").arg(QDateTime::currentDateTime().toString("yyyyMMdd-HHmmss"));
+    QString selectedFilter;
+    QString file = QFileDialog::getSaveFileName(this, tr("Export Session Log"),
+        QDir(QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation)).filePath(name),
+        tr("CSV (*.csv);;JSON (*.json)"), &selectedFilter);
+    if (file.isEmpty()) {
+        return;
+    }
+    const PlaybackStats& playback = mpvWidget->playbackStats();
+    bool json = file.endsWith(".json", Qt::CaseInsensitive);
+    if (!json && selectedFilter.contains("json")) {
+        file = QFileInfo(file).dir().filePath(QFileInfo(file).completeBaseName() + ".json");
+        json = true;
+    }
+    bool ok = json ? playback.exportJson(file) : playback.exportCsv(file);
+    LOG << (ok ? "exported session log to" : "failed to export session log to") << file;
+}
+
+void MainWindow::showClipDialog()
+{
+    auto d = new QDialog(this);
+    d->setAttribute(Qt::WA_DeleteOnClose);
+    d->setWindowTitle("Export Clip");
+    auto form = new QFormLayout(d);
+
+    auto fromEdit = new QTimeEdit;
+    fromEdit->setDisplayFormat("HH:mm:ss.zzz");
+    fromEdit->setTime(QTime(0, 0).addMSecs(qRound(qMax(0.0, clipStart) * 1000)));
+    auto toEdit = new QTimeEdit;
+    toEdit->setDisplayFormat("HH:mm:ss.zzz");
+    toEdit->setTime(QTime(0, 0).addMSecs(qRound((clipEnd >= 0 ? clipEnd : length) * 1000.0)));
+    auto modeCombo = new QComboBox;
+    modeCombo->addItem("Stream Copy");
+    modeCombo->addItem("Re-encode");
+    modeCombo->setToolTip("Stream copy is fast and lossless but starts at the keyframe before the start, re-encoding is exact");
+    const QFileInfo source(currentPath);
+    const QString name = QString("%1-%2.%3").arg(source.completeBaseName(), fromEdit->time().toString("HH.mm.ss"), source.suffix());
+    auto fileEdit = new QLineEdit(QDir(QStandardPaths::writableLocation(QStandardPaths::MoviesLocation)).filePath(name));
+    auto fileButton = new QPushButton("Browse");
+    connect(fileButton, &QPushButton::clicked, d, [=] {
+        // asked below, for typed names too
+        QString file = QFileDialog::getSaveFileName(d, "Export To", fileEdit->text(), QString(), nullptr, QFileDialog::DontConfirmOverwrite);
+        if (!file.isEmpty()) {
+            fileEdit->setText(file);
+        }
+    });
+    auto fileBox = new QHBoxLayout;
+    fileBox->addWidget(fileEdit, 1);
+    fileBox->addWidget(fileButton);
+    auto buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::rejected, d, &QDialog::reject);
+    connect(buttons, &QDialogButtonBox::accepted, d, [=] {
+        const QFileInfo output(fileEdit->text());
+        if (output.exists() && output.canonicalFilePath() == source.canonicalFilePath()) {
+            QMessageBox::warning(d, "Export Clip", "The clip can't be written over the file it is cut from.");
+            return;
+        }
+        if (output.exists()
+            && QMessageBox::question(d, "Export Clip", QString("%1 already exists. Replace it?").arg(output.fileName())) != QMessageBox::Yes) {
+            return;
+        }
+        d->accept();
+    });
+
+    form->addRow("From", fromEdit);
+    form->addRow("To", toEdit);
+    form->addRow("Mode", modeCombo);
+    form->addRow("File", fileBox);
+    form->addRow(buttons);
+
+    connect(d, &QDialog::accepted, this, [=] {
+        SegmentExporter::Job job;
+        job.file = currentPath;
+        job.start = QTime(0, 0).msecsTo(fromEdit->time()) / 1000.0;
+        job.end = QTime(0, 0).msecsTo(toEdit->time()) / 1000.0;
+        job.output = fileEdit->text();
+        job.reencode = modeCombo->currentIndex() == 1;
+        QDir().mkpath(QFileInfo(job.output).absolutePath());
+        if (!segmentExporter->exportSegment(job)) {
+            return;
+        }
+        auto progress = new QProgressDialog("Exporting clip", "Cancel", 0, 1000, this);
+        progress->setAttribute(Qt::WA_DeleteOnClose);
+        progress->setMinimumDuration(0);
+        connect(segmentExporter, &SegmentExporter::progress, progress, &QProgressDialog::setValue);
+        connect(progress, &QProgressDialog::canceled, segmentExporter, &SegmentExporter::cancel);
+        connect(segmentExporter, &SegmentExporter::finished, progress, [=](bool ok, const QString& output) {
+            LOG << (ok ? "exported clip to" : "failed to export clip to") << output;
+            progress->close();
+        });
+        progress->show();
+    });
+    d->show();
+}
+
+void MainWindow::showLogViewer()
+{
+    // built again each time, nothing reads the log while it's closed
+    if (nullptr == logDialog) {
+        logDialog = new QDialog(this);
+        logDialog->setAttribute(Qt::WA_DeleteOnClose);
+        logDialog->setWindowTitle("mpv Log");
+        logDialog->resize(760, 480);
+        auto vbox = new QVBoxLayout(logDialog);
+        auto filterBox = new QHBoxLayout;
+        auto levelCombo = new QComboBox;
+        // "no" has nothing to show
+        levelCombo->addItems(LogCapture::levelNames().mid(1));
+        levelCombo->setCurrentText("v");
+        auto edit = new QLineEdit;
+        edit->setPlaceholderText("Filter");
+        edit->setClearButtonEnabled(true);
+        filterBox->addWidget(levelCombo);
+        filterBox->addWidget(edit, 1);
+        auto text = new QPlainTextEdit;
+        text->setReadOnly(true);
+        text->setLineWrapMode(QPlainTextEdit::NoWrap);
+        text->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+        text->setMaximumBlockCount(LogCapture::Capacity);
+        vbox->addLayout(filterBox);
+        vbox->addWidget(text, 1);
+
+        auto shown = std::make_shared<quint64>(0);
+        auto append = [=](bool rebuild) {
+            if (rebuild) {
+                text->clear();
+                *shown = 0;
+            }
+            const int maxLevel = LogCapture::levelNames().indexOf(levelCombo->currentText()) * 10;
+            const QString filter = edit->text();
+            QStringList lines;
+            for (const LogCapture::Entry& entry : mpvWidget->mpvLog()->entries(*shown)) {
+                *shown = entry.sequence;
+                if (entry.level > maxLevel) {
+                    continue;
+                }
+                QString line = QString("%1 [%2] %3: %4")
+                                   .arg(QDateTime::fromMSecsSinceEpoch(entry.time).toString("HH:mm:ss.zzz"),
+                                       QString::fromUtf8(entry.prefix), LogCapture::levelName(entry.level), QString::fromUtf8(entry.text));
+                if (filter.isEmpty() || line.contains(filter, Qt::CaseInsensitive)) {
+                    lines << line;
+                }
+            }
+            if (!lines.isEmpty()) {
+                text->appendPlainText(lines.join('\n'));
+            }
+        };
+        connect(levelCombo, &QComboBox::currentTextChanged, logDialog, [=] {
+            append(true);
+        });
+        connect(edit, &QLineEdit::textChanged, logDialog, [=] {
+            append(true);
+        });
+        connect(mpvWidget->mpvLog(), &LogCapture::appended, logDialog, [=] {
+            append(false);
+        });
+        append(true);
+    }
+    logDialog->show();
+    logDialog->raise();
+    logDialog->activateWindow();
+}
+
+void MainWindow::showSubtitleSearch()
+{
+    if (nullptr == searchDialog) {
+        searchDialog = new QDialog(this);
+        searchDialog->setWindowTitle("Search Subtitles");
+        searchDialog->resize(520, 420);
+        auto vbox = new QVBoxLayout(searchDialog);
+        auto edit = new QLineEdit;
+        edit->setPlaceholderText("Words or phrase");
+        edit->setClearButtonEnabled(true);
+        auto results = new QListWidget;
+        auto status = new QLabel;
+        vbox->addWidget(edit);
+        vbox->addWidget(results, 1);
+        vbox->addWidget(status);
+
+        auto update = [=] {
+            results->clear();
+            for (const SubtitleSearch::Match& match : subtitleSearch->search(edit->text())) {
+                auto item = new QListWidgetItem(timeStringFromInt(match.time, match.time >= 60 * 60) + "  " + match.text);
+                item->setData(Qt::UserRole, match.time);
+                item->setToolTip(match.track);
+                results->addItem(item);
+            }
+        };
+        auto updateStatus = [=](int cues) {
+            status->setText(cues > 0 ? QString("%1 subtitle lines").arg(cues) : "No text subtitles indexed");
+        };
+        updateStatus(subtitleSearch->cueCount());
+        connect(edit, &QLineEdit::textChanged, searchDialog, update);
+        connect(subtitleSearch, &SubtitleSearch::indexed, searchDialog, [=](int cues) {
+            updateStatus(cues);
+            update();
+        });
+        connect(results, &QListWidget::itemActivated, this, [=](QListWidgetItem* item) {
+            frameStepper->release();
+            mpv::qt::command(mpv, QVariantList { "seek", item->data(Qt::UserRole).toDouble(), "absolute+exact" });
+        });
+    }
+    searchDialog->show();
+    searchDialog->raise();
+    searchDialog->activateWindow();
+}
+
 QString MainWindow::timeStringFromInt(int time, bool withHour)
 {
     if (withHour) {
@@ -1266,6 +2911,8 @@ QString MainWindow::getColorString(const QColor& color)
 
 void MainWindow::handle_mpv_event(mpv_event* event)
 {
+    TRACE_SPAN("handle_mpv_event", mpv_event_name(event->event_id));
+    STALL_SCOPE("handle_mpv_event", mpv_event_name(event->event_id));
     switch (event->event_id) {
     case MPV_EVENT_PROPERTY_CHANGE: {
         mpv_event_property* prop = (mpv_event_property*)event->data;
@@ -1273,9 +2920,51 @@ void MainWindow::handle_mpv_event(mpv_event* event)
 
         break;
     }
+    case MPV_EVENT_HOOK: {
+        auto hook = (mpv_event_hook*)event->data;
+        onLoadHook(hook->id);
+        break;
+    }
+    case MPV_EVENT_END_FILE: {
+        auto end = (mpv_event_end_file*)event->data;
+        if (end->reason == MPV_END_FILE_REASON_EOF) {
+            // watched to the end, start over next time
+            currentTime = 0;
+        }
+        saveResumePosition();
+        currentIdentity = 0;
+        break;
+    }
+    case MPV_EVENT_START_FILE: {
+        QString path = mpv::qt::get_property(mpv, "path").toString();
+        if (!path.isEmpty() && !path.contains("://")) {
+            cacheWarmer->measure(path);
+        }
+        break;
+    }
+    case MPV_EVENT_FILE_LOADED: {
+        onFileLoaded();
+        break;
+    }
+    case MPV_EVENT_COMMAND_REPLY: {
+        if (event->reply_userdata == PLAYLIST_BATCH_REPLY && --playlistBatch == 0) {
+            if (mpv::qt::get_property(mpv, "playlist-count").toInt() != playQueue.windowCount()) {
+                adoptPlaylist();
+            }
+            else {
+                playlistPositionChanged(mpv::qt::get_property(mpv, "playlist-pos").toInt());
+            }
+        }
+        break;
+    }
     case MPV_EVENT_SHUTDOWN: {
-        mpv_terminate_destroy(mpv);
+        // mpv_terminate_destroy() waits for every client handle, and the
+        // IPC one is only serviced on this thread. MpvWidget destroys the
+        // core once this returns, a player without one has nothing left to do.
+        delete ipcServer;
+        ipcServer = nullptr;
         mpv = NULL;
+        QMetaObject::invokeMethod(this, &QWidget::close, Qt::QueuedConnection);
         break;
     }
     default:
@@ -1287,16 +2976,22 @@ void MainWindow::handle_mpv_event(mpv_event* event)
 
 void MainWindow::updateSpeed(int speedPerc)
 {
-    playbackSpeed = speedPerc;
     double speed = (double)speedPerc / 100;
     mpv::qt::set_property_variant(mpv, "speed", speed);
-    settings.setValue("playbackSpeed", speedPerc);
+    settings->set(&Config::playbackSpeed, speedPerc);
 }
 
 void MainWindow::seek(bool forward)
 {
     if (length > 0) {
-        const int delta = forward ? seekStep : -seekStep;
+        const int delta = forward ? config.seekStep : -config.seekStep;
+        frameStepper->release();
+        if (!keyframeIndex.isEmpty()) {
+            double now = mpv::qt::get_property(mpv, "time-pos").toDouble();
+            if (seekIndexed(now + delta, forward ? now : -1)) {
+                return;
+            }
+        }
         // int newTime = qBound(0, time + delta, length + 1);
         // mpv::qt::set_property_variant(mpv, "playback-time", newTime);
         QVariantList args;
@@ -1309,7 +3004,14 @@ void MainWindow::seek(bool forward)
 void MainWindow::seekBar(bool forward)
 {
     if (length > 0) {
-        const int delta = forward ? seekBarStep : -seekBarStep;
+        const int delta = forward ? config.seekBarStep : -config.seekBarStep;
+        frameStepper->release();
+        if (!keyframeIndex.isEmpty()) {
+            double now = mpv::qt::get_property(mpv, "time-pos").toDouble();
+            if (seekIndexed(now + delta, forward ? now : -1)) {
+                return;
+            }
+        }
         // int newTime = qBound(0, time + delta, length + 1);
         // mpv::qt::set_property_variant(mpv, "playback-time", newTime);
         QVariantList args;
@@ -1320,6 +3022,7 @@ void MainWindow::seekBar(bool forward)
 
 void MainWindow::playPauseClicked()
 {
+    frameStepper->release();
     if (paused && length > 0 && mpv::qt::get_property_variant(mpv, "time-remaining").toInt() == 0) {
         int index = mpv::qt::get_property(mpv, "playlist-pos").toInt();
         if (index == -1) {
@@ -1342,6 +3045,90 @@ void MainWindow::showCustomMenu(const QPoint& pos)
     a->setToolTip(tr("Open a file"));
     a = menu->addAction(tr("&Settings"), this, &MainWindow::showConfigDialog);
     a->setToolTip(tr("View Settings"));
+    a = menu->addAction(tr("mpv &Log..."), this, &MainWindow::showLogViewer);
+    QMenu* screenshotMenu = menu->addMenu(tr("Scree&nshot"));
+    a = screenshotMenu->addAction(tr("&Copy Frame"), this, [=] {
+        QImage frame = grabFrame(mpv);
+        if (!frame.isNull()) {
+            QGuiApplication::clipboard()->setImage(frame);
+        }
+    });
+    a->setEnabled(!currentPath.isEmpty());
+    a = screenshotMenu->addAction(tr("&Save Frame"), this, &MainWindow::saveScreenshot);
+    a->setEnabled(!currentPath.isEmpty());
+    a = screenshotMenu->addAction(tr("&Export Frames..."), this, &MainWindow::showExportDialog);
+    a->setEnabled(!currentPath.isEmpty() && !currentPath.contains("://") && !frameExporter->isRunning());
+    QMenu* clipMenu = menu->addMenu(tr("C&lip"));
+    clipMenu->setEnabled(!currentPath.isEmpty() && !currentPath.contains("://"));
+    a = clipMenu->addAction(tr("Set &Start"), this, [=] {
+        setClipPoint(false);
+    });
+    a->setShortcut(Qt::Key_BracketLeft);
+    a = clipMenu->addAction(tr("Set &End"), this, [=] {
+        setClipPoint(true);
+    });
+    a->setShortcut(Qt::Key_BracketRight);
+    a = clipMenu->addAction(tr("E&xport Clip..."), this, &MainWindow::showClipDialog);
+    a->setEnabled(!segmentExporter->isRunning());
+    a = clipMenu->addAction(tr("&Clear"), this, [=] {
+        clipStart = -1;
+        clipEnd = -1;
+        progressBar->setSelection(clipStart, clipEnd);
+    });
+    a->setEnabled(clipStart >= 0 || clipEnd >= 0);
+    QMenu* statsMenu = menu->addMenu(tr("S&tatistics"));
+    a = statsMenu->addAction(tr("Show &Overlay"), this, [=](bool checked) {
+        mpvWidget->setStatsVisible(checked);
+    });
+    a->setCheckable(true);
+    a->setChecked(mpvWidget->statsVisible());
+    a->setShortcut(Qt::Key_I);
+    a = statsMenu->addAction(tr("&Record Frame Timing"), this, [=](bool checked) {
+        mpvWidget->setStatsRecording(checked);
+    });
+    a->setCheckable(true);
+    a->setChecked(mpvWidget->statsRecording());
+    statsMenu->addAction(tr("Export Session &Log..."), this, &MainWindow::exportPlaybackLog);
+    const bool hasChapters = mpv::qt::get_property(mpv, "chapter-list").toList().count() > 1;
+    a = menu->addAction(sceneChapters ? tr("Next Scene") : tr("Next Chapter"), this, [=] {
+        seekChapter(true);
+    });
+    a->setEnabled(hasChapters);
+    a = menu->addAction(sceneChapters ? tr("Previous Scene") : tr("Previous Chapter"), this, [=] {
+        seekChapter(false);
+    });
+    a->setEnabled(hasChapters);
+    a = menu->addAction(tr("Search S&ubtitles..."), this, &MainWindow::showSubtitleSearch);
+    a->setShortcut(QKeySequence::Find);
+    a->setToolTip(tr("Find where a phrase is spoken"));
+
+    QMenu* videoMenu = menu->addMenu(tr("&Video Presets"));
+    for (auto it = config.videoPresets.cbegin(); it != config.videoPresets.cend(); ++it) {
+        const VideoAdjustments preset = VideoAdjustments::fromMap(it.value().toMap());
+        a = videoMenu->addAction(it.key(), this, [=] {
+            setAdjustments(preset);
+        });
+        a->setCheckable(true);
+        a->setChecked(preset == adjustments);
+    }
+    if (!config.videoPresets.isEmpty()) {
+        videoMenu->addSeparator();
+    }
+    videoMenu->addAction(tr("&Save Current..."), this, &MainWindow::saveVideoPreset);
+    if (!config.videoPresets.isEmpty()) {
+        QMenu* deleteMenu = videoMenu->addMenu(tr("&Delete"));
+        for (const QString& name : config.videoPresets.keys()) {
+            deleteMenu->addAction(name, this, [=] {
+                QVariantMap presets = config.videoPresets;
+                presets.remove(name);
+                settings->set(&Config::videoPresets, presets);
+            });
+        }
+    }
+    a = videoMenu->addAction(tr("&Reset"), this, [=] {
+        setAdjustments(VideoAdjustments());
+    });
+    a->setEnabled(!adjustments.isDefault());
     menu->addSeparator();
     a = menu->addAction(tr("&Quit"), this, &MainWindow::close);
     a->setToolTip(tr("Quit Application"));
@@ -1390,9 +3177,8 @@ void MainWindow::playlistMove(int from, int to)
     }
     // }
 
-    QVariantList args;
-    args << QString("playlist-move") << from << to;
-    mpv::qt::command(mpv, args);
+    playlistModel->move({ from }, to);
+    syncPlaylist();
 }
 
 void MainWindow::playlistRemove(int i)
@@ -1415,9 +3201,115 @@ void MainWindow::playlistRemove(int i)
             selectedIndex = row - 1;
         }
     }
-    QVariantList args;
-    args << QString("playlist-remove") << i;
-    mpv::qt::command(mpv, args);
+    playlistModel->remove({ i });
+    syncPlaylist();
+}
+
+void MainWindow::sendPlaylistBatch(const QList<QVariantList>& commands)
+{
+    // queued back to back without waiting for replies, mpv runs them in order
+    for (const QVariantList& args : commands) {
+        mpv::qt::node_builder node(args);
+        if (mpv_command_node_async(mpv, PLAYLIST_BATCH_REPLY, node.node()) >= 0) {
+            playlistBatch++;
+        }
+    }
+}
+
+// after an edit of the queue
+void MainWindow::syncPlaylist()
+{
+    sendPlaylistBatch(playQueue.syncWindow());
+    updatePlaylist();
+}
+
+void MainWindow::playlistPositionChanged(int pos)
+{
+    int previous = playQueue.current();
+    if (!playQueue.setWindowPosition(pos) || playQueue.current() == previous) {
+        return;
+    }
+    // slide the window along, the view only moves its marker
+    sendPlaylistBatch(playQueue.syncWindow());
+    updatePlaylistCurrent(previous);
+    fingerprintEpisodes();
+}
+
+void MainWindow::adoptPlaylist()
+{
+    // someone else, an IPC client most likely, changed mpv's playlist. Files
+    // it added join the end of the queue and the window is put back around
+    // whatever plays now.
+    const QVariantList list = mpv::qt::get_property(mpv, "playlist").toList();
+    const int from = qMax(0, playQueue.current() - PlayQueue::WindowBefore);
+    QStringList added;
+    int playing = -1;
+    for (const QVariant& item : list) {
+        const QVariantMap entry = item.toMap();
+        const QString file = entry.value("filename").toString();
+        int row = playQueue.files().indexOf(file, from);
+        if (row < 0) {
+            row = playQueue.count() + added.count();
+            added << file;
+        }
+        if (entry.value("current").toBool()) {
+            playing = row;
+        }
+    }
+    LOG << "Playlist changed outside the queue," << added.count() << "entries added";
+    int previous = playQueue.current();
+    playlistModel->append(added);
+    // keeps the playing entry
+    QList<QVariantList> commands;
+    commands << QVariantList { QString("playlist-clear") };
+    playQueue.resetWindow(playing);
+    commands << playQueue.syncWindow();
+    sendPlaylistBatch(commands);
+    updatePlaylistCurrent(previous);
+    if (!added.isEmpty()) {
+        updatePlaylist();
+    }
+}
+
+void MainWindow::playlistPlay(int row)
+{
+    int previous = playQueue.current();
+    sendPlaylistBatch(playQueue.play(row));
+    updatePlaylistCurrent(previous);
+}
+
+void MainWindow::playlistMoveRows(QList<int> rows, int to)
+{
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    if (rows.isEmpty()) {
+        return;
+    }
+    if (rows.count() == 1) {
+        playlistMove(rows.first(), to);
+        return;
+    }
+    selectedIndex = to - int(std::lower_bound(rows.begin(), rows.end(), to) - rows.begin());
+    selectedCount = rows.count();
+    playlistModel->move(rows, to);
+    syncPlaylist();
+}
+
+void MainWindow::playlistRemoveRows(QList<int> rows)
+{
+    std::sort(rows.begin(), rows.end());
+    rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+    if (rows.isEmpty()) {
+        return;
+    }
+    if (rows.count() == 1) {
+        playlistRemove(rows.first());
+        return;
+    }
+    // the entry that moves up into the first gap
+    selectedIndex = qMax(0, qMin(rows.first(), playQueue.count() - rows.count() - 1));
+    playlistModel->remove(rows);
+    syncPlaylist();
 }
 
 void MainWindow::onFileOpen()
@@ -1430,6 +3322,22 @@ void MainWindow::onFileOpen()
 }
 
 void MainWindow::loadFiles(QList<QUrl> urls)
+{
+    TRACE_SPAN("loadFiles");
+    QStringList files;
+    queueFiles(urls, files);
+    if (!files.isEmpty()) {
+        playlistModel->append(files);
+        syncPlaylist();
+    }
+    if (paused && eofReached) {
+        mpv::qt::set_property_variant(mpv, "pause", !paused);
+        eofReached = false;
+    }
+}
+
+// media among urls and the folders in them, subtitles are added right away
+void MainWindow::queueFiles(const QList<QUrl>& urls, QStringList& files)
 {
     for (int i = 0; i < urls.count(); ++i) {
         QString file = urls.at(i).toLocalFile();
@@ -1443,30 +3351,35 @@ void MainWindow::loadFiles(QList<QUrl> urls)
         if (info.isDir()) {
             QDir dir(info.absoluteFilePath());
             auto infoList = dir.entryInfoList(QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot);
+            // subtitles in a dropped folder belong to the videos next to them,
+            // not to whatever is playing now
+            subtitleIndex.addDirectory(dir.absolutePath(), infoList);
             QList<QUrl> subDir;
             for (int i = 0; i < infoList.count(); ++i) {
+                if (supportedSubs.contains(infoList.at(i).suffix().toLower())) {
+                    continue;
+                }
                 QUrl url = QUrl::fromLocalFile(infoList.at(i).absoluteFilePath());
                 subDir.append(url);
             }
-            loadFiles(subDir);
+            queueFiles(subDir, files);
         }
         else if (supportedSubs.contains(ext)) {
             const char* args[] = { "sub-add", c_filename.data(), NULL };
+            TRACE_SPAN("mpv_command", "sub-add");
+            STALL_SCOPE("mpv_command", "sub-add");
             mpv_command(mpv, args);
         }
         else if (videoExt.contains(ext)) {
-            const QByteArray c_flag = "append-play";
-            const char* args[] = { "loadfile", c_filename.data(), c_flag.data(), NULL };
-            mpv_command(mpv, args);
+            files << file;
         }
     }
-    if (paused && eofReached) {
-        mpv::qt::set_property_variant(mpv, "pause", !paused);
-        eofReached = false;
-    }
 }
+
 Q_SCRIPTABLE void MainWindow::loadFiles(const QStringList& files)
 {
+    TRACE_SPAN("loadFiles");
+    QStringList media;
     for (const QString& file : files) {
         QFileInfo info(file);
         if (!info.exists() || info.isDir()) {
@@ -1477,14 +3390,18 @@ Q_SCRIPTABLE void MainWindow::loadFiles(const QStringList& files)
         QString ext = info.suffix().toLower();
         if (supportedSubs.contains(ext)) {
             const char* args[] = { "sub-add", c_filename.data(), NULL };
+            TRACE_SPAN("mpv_command", "sub-add");
+            STALL_SCOPE("mpv_command", "sub-add");
             mpv_command(mpv, args);
         }
         else if (videoExt.contains(ext)) {
-            const QByteArray c_flag = "append-play";
-            const char* args[] = { "loadfile", c_filename.data(), c_flag.data(), NULL };
-            mpv_command(mpv, args);
+            media << file;
         }
     }
+    if (!media.isEmpty()) {
+        playlistModel->append(media);
+        syncPlaylist();
+    }
     if (paused && eofReached) {
         mpv::qt::set_property_variant(mpv, "pause", !paused);
         eofReached = false;
@@ -1499,5 +3416,15 @@ void MainWindow::onNewWindow()
 MainWindow::~MainWindow()
 {
     bool unreg = QDBusConnection::sessionBus().unregisterService(SERVICE_NAME);
+    loadHookPool.waitForDone();
+    // client handles must go before the core, mpv_terminate_destroy() waits for them
+    delete ipcServer;
+    // the workers read the analysis cache until they are stopped
+    delete audioScanner;
+    delete keyframeIndexer;
+    delete sceneDetector;
+    delete cropDetector;
+    delete introDetector;
+    delete subtitleSearch;
     mpvWidget->deleteLater();
 }
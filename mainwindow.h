@@ -2,14 +2,18 @@
 
 #include <QComboBox>
 #include <QDoubleSpinBox>
+#include <QElapsedTimer>
 #include <QHBoxLayout>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
 #include <QListView>
 #include <QMainWindow>
+#include <QPointer>
 #include <QProgressBar>
 #include <QPushButton>
-#include <QSettings>
-#include <QStandardItemModel>
 #include <QString>
+#include <QThreadPool>
 #include <QToolBar>
 #include <QToolButton>
 #include <QUrl>
@@ -17,16 +21,42 @@
 
 #include <mpv/client.h>
 
+#include <memory>
+
 #include <QDebug>
 
+#include "cacheprofile.h"
+#include "introdetector.h"
+#include "keyframeindex.h"
+#include "playqueue.h"
+#include "settings.h"
+#include "subtitleindex.h"
+#include "videoadjustments.h"
+
 #define SERVICE_NAME "local.fastplayer"
 
 class QTextEdit;
+class QTimer;
 class PlaylistStyle;
 
 
 class ListView;
 class ListModel;
+class IpcServer;
+class ResumeStore;
+class CacheWarmer;
+class AnalysisCache;
+class AudioScanner;
+class KeyframeIndexer;
+class SceneDetector;
+class CropDetector;
+class SubtitleSearch;
+class FrameExporter;
+class SegmentExporter;
+class FrameStepper;
+class StallWatchdog;
+class QDialog;
+class ProgressBar;
 class QDBusServiceWatcher;
 class MpvWidget;
 
@@ -39,6 +69,8 @@ public:
     MainWindow(QWidget* parent = nullptr);
     ~MainWindow();
 
+    void startIpcServer(const QString& path);
+
 public Q_SLOTS:
     Q_SCRIPTABLE void loadFiles(const QStringList& files);
 
@@ -51,11 +83,21 @@ private slots:
     void seek(bool forward);
     void seekBar(bool forward);
     void playPauseClicked();
+    void skipSegment();
     void toggleFullscreen();
     void playlistMove(int from, int to);
     void playlistRemove(int index);
+    void playlistMoveRows(QList<int> rows, int to);
+    void playlistRemoveRows(QList<int> rows);
     void showCustomMenu(const QPoint& pos);
     void showConfigDialog();
+    void showSubtitleSearch();
+    void saveScreenshot();
+    void showExportDialog();
+    void setClipPoint(bool end);
+    void showClipDialog();
+    void exportPlaybackLog();
+    void showLogViewer();
 
 signals:
     void mpv_events();
@@ -68,12 +110,34 @@ protected:
     void dropEvent(QDropEvent*) override;
 
 private:
-    QSettings settings;
+    Settings* settings;
+    const Config& config;
     MpvWidget* mpvWidget;
     mpv_handle* mpv;
     QDBusServiceWatcher* watcher;
+    IpcServer* ipcServer;
+    CacheWarmer* cacheWarmer;
+    ResumeStore* resumeStore;
+    std::unique_ptr<AnalysisCache> analysisCache;
+    AudioScanner* audioScanner;
+    KeyframeIndexer* keyframeIndexer;
+    SceneDetector* sceneDetector;
+    CropDetector* cropDetector;
+    IntroDetector* introDetector;
+    SubtitleSearch* subtitleSearch;
+    FrameExporter* frameExporter;
+    SegmentExporter* segmentExporter;
+    FrameStepper* frameStepper;
+    StallWatchdog* stallWatchdog;
+    QDialog* searchDialog = nullptr;
+    QPointer<QDialog> logDialog;
 
     int selectedIndex = -1;
+    // rows from selectedIndex on to select after the next edit
+    int selectedCount = 1;
+    // async playlist commands mpv hasn't answered yet, its playlist position
+    // only means something once they all ran
+    int playlistBatch = 0;
     QString draggedFile;
     bool muted;
     bool paused;
@@ -81,42 +145,48 @@ private:
     int length;
     QStringList videoExt;
     QStringList supportedSubs;
+    SubtitleIndex subtitleIndex;
+    // mpv holds a loading file until its hook job is done, so these don't
+    // queue behind the long jobs on the global pool
+    QThreadPool loadHookPool;
     QList<int> boundKeys;
-    int cropH;
-    int cropV;
+    // of the playing file, empty unless its container lacks one
+    KeyframeIndex keyframeIndex;
+    // the chapters are detected scene cuts, not the file's own
+    bool sceneChapters = false;
+    VideoAdjustments adjustments;
+    // what mpv currently has, so only differences are sent
+    VideoAdjustments appliedAdjustments;
+    // the crop taken from detected black bars, dropped with its file
+    int autoCropH = 0;
+    int autoCropV = 0;
+    // of the playing file, with the margins taken off
+    QList<QPair<double, double>> silences;
+    QTimer* silenceTimer;
+    int silenceSkips = 0;
+    double silenceSkipped = 0;
+    // intro and credits shared with the other episodes in the folder
+    IntroDetector::Segments episodeSegments;
+    bool matchingSegments = false;
+    bool segmentsOutdated = false;
+    // A and B of the clip to export, negative while unset
+    double clipStart = -1;
+    double clipEnd = -1;
+    bool adjustmentsQueued;
+    int videoWidth;
+    int videoHeight;
+    QString currentPath;
+    quint64 currentIdentity;
+    double currentTime;
+    // since time-pos last ticked over to a new second
+    QElapsedTimer secondTick;
+    int currentAid;
+    int currentSid;
+    PlayQueue playQueue;
+    double sourceThroughput;
+    bool cacheStalled;
 
-    // settings
-    int seekStep;
-    int seekBarStep;
-    int volumeStep;
     int currentVolume;
-    QColor subColor;
-    QColor subBorderColor;
-    int subBorderSize;
-    QFont subFont;
-    int subFontSize;
-    int playbackSpeed;
-    bool showPlayPause;
-    bool showSpeed;
-    bool showZoom;
-    bool showRotation;
-    bool showPanX;
-    bool showPanY;
-    bool showCropH;
-    bool showCropV;
-    bool showBrightness;
-    bool showContrast;
-    bool showSaturation;
-    bool showGamma;
-    bool showHue;
-    bool showProgress;
-    bool showMute;
-    bool showVolume;
-    bool showAudio;
-    bool showSub;
-    bool showSettings;
-    bool showPlaylistButton;
-    bool playlistVisible;
     bool eofReached;
 
     // UI
@@ -146,7 +216,8 @@ private:
     QSpinBox* gammaSpin;
     QSpinBox* hueSpin;
 
-    QProgressBar* progressBar;
+    ProgressBar* progressBar;
+    QPushButton* skipButton;
     QPushButton* volumeButton;
     QProgressBar* volumeBar;
     QPushButton* audioButton;
@@ -164,22 +235,59 @@ private:
     //
     void configureMpv();
     void loadConfig();
+    void onSettingChanged(const QString& key);
     void onFileLoaded();
+    void onLoadHook(quint64 hookId);
+    void applyLoadHook(quint64 hookId, const QString& path, quint64 identity, const QStringList& subFiles);
+    void saveResumePosition();
+    void setAdjustments(const VideoAdjustments& a);
+    void scheduleAdjustments();
+    void applyAdjustments();
+    void syncAdjustmentWidgets();
+    void saveVideoPreset();
     void updateTracks(QVariantList list = QVariantList());
     void onPropertyChanged(mpv_event_property* prop);
     void updateProgress();
+    void updateCacheState(const QVariantMap& state);
+    void tuneCache();
     void progressClicked(int posX);
     void showProgressTooltip(QPoint globalPos, int posX);
     void updateVolume();
     void volumeBarClicked(int posX);
     void showVolumeTooltip(QPoint globalPos, int posX);
     void stepVolume(bool increase);
-    void updatePlaylist(QVariantList list);
+    void updatePlaylist();
+    void updateLogFile();
+    void updatePlaylistCurrent(int previous);
+    void sendPlaylistBatch(const QList<QVariantList>& commands);
+    void syncPlaylist();
+    void playlistPositionChanged(int pos);
+    void adoptPlaylist();
+    void playlistPlay(int row);
+    void queueFiles(const QList<QUrl>& urls, QStringList& files);
+    void prepareNext();
+    void warmUpcoming();
+    void analyzeUpcoming();
+    QStringList upcomingLocalFiles(int first, int count) const;
+    void updateWaveform();
+    void loadSilences();
+    void scheduleSilenceSkip();
+    void skipSilence();
+    void scanUpcoming();
+    void fingerprintEpisodes();
+    void updateSegments();
+    void updateSkipButton();
+    void applyAutoCrop(VideoAdjustments& a);
+    void applySceneChapters(const QJsonArray& cuts);
+    void seekChapter(bool forward);
+    bool seekIndexed(double target, double from);
+    QJsonObject stats();
 
     QString timeStringFromInt(int time, bool withHour);
     QIcon getSquareIcon(const QColor& color);
     QString getColorString(const QColor& color);
     void handle_mpv_event(mpv_event* event);
+    QJsonValue ipcCommand(const QJsonArray& args, QString& error);
 
 protected:
     void closeEvent(QCloseEvent* event) override;
@@ -1,6 +1,11 @@
 ﻿#include "mpvwidget.h"
+#include "stallwatchdog.h"
+#include "trace.h"
 #include <stdexcept>
 #include <QtGui/QOpenGLContext>
+#include <QtGui/QOpenGLFunctions>
+#include <QtGui/QFontDatabase>
+#include <QtGui/QPainter>
 #include <QtCore/QMetaObject>
 
 static void wakeup(void *ctx)
@@ -23,8 +28,8 @@ MpvWidget::MpvWidget(QWidget *parent, Qt::WindowFlags f)
     if (!mpv)
         throw std::runtime_error("could not create mpv context");
 
-    mpv_set_option_string(mpv, "terminal", "yes");
-    mpv_set_option_string(mpv, "msg-level", "all=v");
+    // the log goes through logCapture
+    mpv_set_option_string(mpv, "terminal", "no");
     mpv_set_option_string(mpv, "vo", "libmpv");
     mpv_set_option_string(mpv, "input-default-bindings", "no");
     mpv_set_option_string(mpv, "idle", "yes");
@@ -35,6 +40,8 @@ MpvWidget::MpvWidget(QWidget *parent, Qt::WindowFlags f)
 
     if (mpv_initialize(mpv) < 0)
         throw std::runtime_error("could not initialize mpv context");
+    logCapture = new LogCapture(mpv);
+    logCapture->start(QThread::LowPriority);
 
     // removing due to issues with glitchy videos, not the same issue but
     // probably related to https://github.com/mpv-player/mpv/issues/15019
@@ -47,34 +54,62 @@ MpvWidget::MpvWidget(QWidget *parent, Qt::WindowFlags f)
     mpv_observe_property(mpv, 0, "core-idle", MPV_FORMAT_FLAG);
     mpv_observe_property(mpv, 0, "pause", MPV_FORMAT_FLAG);
     mpv_observe_property(mpv, 0, "eof-reached", MPV_FORMAT_FLAG);
+    mpv_observe_property(mpv, 0, "paused-for-cache", MPV_FORMAT_FLAG);
+    mpv_observe_property(mpv, 0, "cache-speed", MPV_FORMAT_INT64);
+    mpv_observe_property(mpv, 0, "demuxer-cache-state", MPV_FORMAT_NODE);
 
     mpv_observe_property(mpv, 0, "track-list", MPV_FORMAT_NODE);
     mpv_observe_property(mpv, 0, "chapter-list", MPV_FORMAT_NODE);
+    mpv_observe_property(mpv, 0, "video-dec-params", MPV_FORMAT_NODE);
     mpv_observe_property(mpv, 0, "media-title", MPV_FORMAT_STRING);
-    mpv_observe_property(mpv, 0, "playlist", MPV_FORMAT_NODE);
+    // mpv's playlist is only a window of the queue, see PlayQueue
+    mpv_observe_property(mpv, 0, "playlist-pos", MPV_FORMAT_INT64);
+    mpv_observe_property(mpv, 0, "playlist-count", MPV_FORMAT_INT64);
+    PlaybackStats::observe(mpv);
 
     mpv_set_wakeup_callback(mpv, wakeup, this);
+    clock.start();
 }
 
 MpvWidget::~MpvWidget()
 {
-    if (mpv_gl)
+    // its client handle has to go before the core
+    delete logCapture;
+    releaseMpv();
+}
+
+void MpvWidget::releaseMpv()
+{
+    if (mpv_gl) {
+        makeCurrent();
         mpv_render_context_free(mpv_gl);
-    mpv_terminate_destroy(mpv);
+        doneCurrent();
+        mpv_gl = nullptr;
+    }
+    if (mpv) {
+        mpv_terminate_destroy(mpv);
+        mpv = nullptr;
+    }
 }
 
 void MpvWidget::command(const QVariant& params)
 {
+    if (!mpv)
+        return;
     mpv::qt::command_variant(mpv, params);
 }
 
 void MpvWidget::setProperty(const QString& name, const QVariant& value)
 {
+    if (!mpv)
+        return;
     mpv::qt::set_property_variant(mpv, name, value);
 }
 
 QVariant MpvWidget::getProperty(const QString &name) const
 {
+    if (!mpv)
+        return QVariant();
     return mpv::qt::get_property_variant(mpv, name);
 }
 
@@ -94,6 +129,10 @@ void MpvWidget::initializeGL()
 
 void MpvWidget::paintGL()
 {
+    TRACE_SPAN("paintGL");
+    if (!mpv_gl)
+        return;
+    qint64 paintStart = clock.nsecsElapsed();
     mpv_opengl_fbo mpfbo{static_cast<int>(defaultFramebufferObject()), width(), height(), 0};
     int flip_y{1};
 
@@ -104,19 +143,159 @@ void MpvWidget::paintGL()
     };
     // See render_gl.h on what OpenGL environment mpv expects, and
     // other API details.
-    mpv_render_context_render(mpv_gl, params);
+    {
+        TRACE_SPAN("mpv_render_context_render");
+        STALL_SCOPE("mpv_render_context_render");
+        mpv_render_context_render(mpv_gl, params);
+    }
+    if (capturing) {
+        captureFrame();
+    }
+    if (!held.isNull()) {
+        QPainter painter(this);
+        painter.drawImage(rect(), held);
+    }
+    if (showStats) {
+        QPainter painter(this);
+        drawStats(painter);
+    }
+
+    qint64 now = clock.nsecsElapsed();
+    playback.addPaint(now - paintStart);
+    // repaints of the same frame, for the overlay or a resize, don't count
+    const bool presented = newFrame;
+    newFrame = false;
+    if (!presented) {
+        return;
+    }
+    if (awaitingFirstFrame) {
+        awaitingFirstFrame = false;
+        double gapMs = (now - gapStartNs) / 1e6;
+        gapStartNs = -1;
+        transitions.count++;
+        transitions.lastGapMs = gapMs;
+        transitions.maxGapMs = qMax(transitions.maxGapMs, gapMs);
+        transitions.totalGapMs += gapMs;
+        Q_EMIT transitionMeasured(gapMs);
+    }
+    lastFrameNs = now;
+}
+
+void MpvWidget::setStatsVisible(bool visible)
+{
+    showStats = visible;
+    playback.observeFrameTiming(mpv, showStats || recordStats);
+    update();
+}
+
+void MpvWidget::setStatsRecording(bool recording)
+{
+    recordStats = recording;
+    playback.observeFrameTiming(mpv, showStats || recordStats);
+}
+
+void MpvWidget::drawStats(QPainter& painter)
+{
+    const QStringList lines = playback.overlayLines();
+    QFont font = QFontDatabase::systemFont(QFontDatabase::FixedFont);
+    painter.setFont(font);
+    QFontMetrics metrics(font);
+    int textWidth = 0;
+    for (const QString& line : lines) {
+        textWidth = qMax(textWidth, metrics.horizontalAdvance(line));
+    }
+    const int margin = metrics.height() / 2;
+    QRect box(margin, margin, textWidth + margin * 2, metrics.height() * lines.count() + margin * 2);
+    painter.fillRect(box, QColor(0, 0, 0, 160));
+    painter.setPen(Qt::white);
+    for (int i = 0; i < lines.count(); ++i) {
+        painter.drawText(box.left() + margin, box.top() + margin + metrics.ascent() + i * metrics.height(), lines.at(i));
+    }
+}
+
+void MpvWidget::setCaptureFrames(bool capture)
+{
+    capturing = capture;
+    if (!capture) {
+        captured = QImage();
+    }
+}
+
+void MpvWidget::holdFrame(const QImage& frame)
+{
+    held = frame;
+    update();
+}
+
+void MpvWidget::releaseFrame()
+{
+    if (!held.isNull()) {
+        held = QImage();
+        update();
+    }
+}
+
+void MpvWidget::captureFrame()
+{
+    // 3 bytes a pixel, QImage pads rows to 4 bytes just like GL_PACK_ALIGNMENT
+    QImage frame(width(), height(), QImage::Format_RGB888);
+    QOpenGLFunctions* gl = context()->functions();
+    gl->glBindFramebuffer(GL_FRAMEBUFFER, defaultFramebufferObject());
+    gl->glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    gl->glReadPixels(0, 0, frame.width(), frame.height(), GL_RGB, GL_UNSIGNED_BYTE, frame.bits());
+    // GL rows start at the bottom
+    captured = std::move(frame).mirrored();
+    Q_EMIT frameCaptured();
 }
 
 void MpvWidget::on_mpv_events()
 {
+    TRACE_SPAN("on_mpv_events");
     // Process all events, until the event queue is empty.
     while (mpv) {
         mpv_event *event = mpv_wait_event(mpv, 0);
         if (event->event_id == MPV_EVENT_NONE) {
             break;
         }
+        trackTransition(event);
+        // frames repaint the overlay while playing, only a still picture
+        // needs a nudge
+        if (event->event_id == MPV_EVENT_PROPERTY_CHANGE && playback.handleProperty((mpv_event_property*)event->data)
+            && showStats && clock.nsecsElapsed() - lastFrameNs > 500000000) {
+            update();
+        }
         emit mpvEvent(event);
         //handle_mpv_event(event);
+        if (event->event_id == MPV_EVENT_SHUTDOWN) {
+            // the core quit on its own, everyone else let go of it while
+            // the event was delivered
+            releaseMpv();
+        }
+    }
+}
+
+void MpvWidget::trackTransition(mpv_event* event)
+{
+    switch (event->event_id) {
+    case MPV_EVENT_END_FILE: {
+        auto end = (mpv_event_end_file*)event->data;
+        awaitingFirstFrame = false;
+        gapStartNs = end->reason == MPV_END_FILE_REASON_EOF ? lastFrameNs : -1;
+        break;
+    }
+    case MPV_EVENT_PLAYBACK_RESTART: {
+        // the next frame rendered is the first one of the new file
+        if (gapStartNs >= 0) {
+            awaitingFirstFrame = true;
+        }
+        break;
+    }
+    case MPV_EVENT_IDLE: {
+        gapStartNs = -1;
+        awaitingFirstFrame = false;
+        break;
+    }
+    default:;
     }
 }
 
@@ -146,6 +325,11 @@ void MpvWidget::handle_mpv_event(mpv_event *event)
 // Make Qt invoke mpv_render_context_render() to draw a new/updated video frame.
 void MpvWidget::maybeUpdate()
 {
+    if (!mpv_gl)
+        return;
+    if (mpv_render_context_update(mpv_gl) & MPV_RENDER_UPDATE_FRAME) {
+        newFrame = true;
+    }
     // If the Qt window is not visible, Qt's update() will just skip rendering.
     // This confuses mpv's render API, and may lead to small occasional
     // freezes due to video rendering timing out.
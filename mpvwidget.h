@@ -1,11 +1,25 @@
 #ifndef PLAYERWINDOW_H
 #define PLAYERWINDOW_H
 
+#include "logcapture.h"
+#include "playbackstats.h"
 #include "qthelper.hpp"
+#include <QElapsedTimer>
+#include <QImage>
 #include <QOpenGLWidget>
 #include <mpv/client.h>
 #include <mpv/render_gl.h>
 
+// Time between the last frame of one playlist item and the first frame of
+// the next, for transitions that happen on their own at end of file.
+struct TransitionStats {
+    int count = 0;
+    double lastGapMs = 0;
+    double maxGapMs = 0;
+    double totalGapMs = 0;
+    double averageGapMs() const { return count > 0 ? totalGapMs / count : 0; }
+};
+
 class MpvWidget Q_DECL_FINAL : public QOpenGLWidget
 {
     Q_OBJECT
@@ -16,10 +30,28 @@ public:
     void setProperty(const QString& name, const QVariant& value);
     QVariant getProperty(const QString& name) const;
     QSize sizeHint() const override { return QSize(480, 270); }
+    const TransitionStats& transitionStats() const { return transitions; }
+    const PlaybackStats& playbackStats() const { return playback; }
+    LogCapture* mpvLog() const { return logCapture; }
+    // draws playbackStats() over the video
+    void setStatsVisible(bool visible);
+    bool statsVisible() const { return showStats; }
+    // frame timing goes into the session log while on, as it does while
+    // the stats are shown
+    void setStatsRecording(bool recording);
+    bool statsRecording() const { return recordStats; }
+    // reads back every rendered frame while on
+    void setCaptureFrames(bool capture);
+    const QImage& capturedFrame() const { return captured; }
+    // shows frame in place of mpv's output until released
+    void holdFrame(const QImage& frame);
+    void releaseFrame();
 Q_SIGNALS:
     void durationChanged(int value);
     void positionChanged(int value);
     void mpvEvent(mpv_event* event);
+    void transitionMeasured(double gapMs);
+    void frameCaptured();
 
 protected:
     void initializeGL() Q_DECL_OVERRIDE;
@@ -30,11 +62,32 @@ private Q_SLOTS:
 
 private:
     void handle_mpv_event(mpv_event* event);
+    void trackTransition(mpv_event* event);
+    void captureFrame();
+    void drawStats(QPainter& painter);
+    // frees the render context and the core, both are null afterwards
+    void releaseMpv();
     static void on_update(void* ctx);
 
+    QElapsedTimer clock;
+    // when a frame mpv rendered last reached the screen
+    qint64 lastFrameNs = -1;
+    // mpv has a frame that wasn't rendered yet
+    bool newFrame = false;
+    qint64 gapStartNs = -1;
+    bool awaitingFirstFrame = false;
+    TransitionStats transitions;
+    PlaybackStats playback;
+    LogCapture* logCapture;
+    bool showStats = false;
+    bool recordStats = false;
+    bool capturing = false;
+    QImage captured;
+    QImage held;
+
 public:
     mpv_handle* mpv;
-    mpv_render_context* mpv_gl;
+    mpv_render_context* mpv_gl = nullptr;
 };
 
 #endif // PLAYERWINDOW_H
@@ -0,0 +1,251 @@
+#include "playbackstats.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QTextStream>
+
+#include <cstring>
+
+// about 10 hours of rows a second, the older half goes when it's full
+#define MAX_SAMPLES 36000
+#define FRAME_TIMING_REPLY 0x5054
+
+const double PlaybackStats::BucketLimits[PlaybackStats::Buckets - 1] = { 1, 2, 4, 8, 16, 33, 66 };
+
+static QJsonValue number(double value)
+{
+    return qIsNaN(value) ? QJsonValue() : QJsonValue(value);
+}
+
+static QString csvNumber(double value, int precision)
+{
+    return qIsNaN(value) ? QString() : QString::number(value, 'f', precision);
+}
+
+PlaybackStats::PlaybackStats()
+    : started(QDateTime::currentDateTime())
+{
+    clock.start();
+}
+
+void PlaybackStats::observe(mpv_handle* mpv)
+{
+    mpv_observe_property(mpv, 0, "frame-drop-count", MPV_FORMAT_INT64);
+    mpv_observe_property(mpv, 0, "decoder-frame-drop-count", MPV_FORMAT_INT64);
+    mpv_observe_property(mpv, 0, "vo-delayed-frame-count", MPV_FORMAT_INT64);
+    mpv_observe_property(mpv, 0, "container-fps", MPV_FORMAT_DOUBLE);
+    mpv_observe_property(mpv, 0, "demuxer-cache-duration", MPV_FORMAT_DOUBLE);
+    mpv_observe_property(mpv, 0, "cache-buffering-state", MPV_FORMAT_INT64);
+    mpv_observe_property(mpv, 0, "speed", MPV_FORMAT_DOUBLE);
+}
+
+void PlaybackStats::observeFrameTiming(mpv_handle* mpv, bool observe)
+{
+    if (observe == frameTiming) {
+        return;
+    }
+    frameTiming = observe;
+    if (observe) {
+        mpv_observe_property(mpv, FRAME_TIMING_REPLY, "estimated-vf-fps", MPV_FORMAT_DOUBLE);
+        mpv_observe_property(mpv, FRAME_TIMING_REPLY, "avsync", MPV_FORMAT_DOUBLE);
+    }
+    else {
+        mpv_unobserve_property(mpv, FRAME_TIMING_REPLY);
+        // rows from here on don't have them
+        now.vfFps = qQNaN();
+        now.avsync = qQNaN();
+    }
+}
+
+bool PlaybackStats::handleProperty(const mpv_event_property* prop)
+{
+    const bool isInt = prop->format == MPV_FORMAT_INT64;
+    const bool isDouble = prop->format == MPV_FORMAT_DOUBLE;
+    const qint64 intValue = isInt ? *(int64_t*)prop->data : -1;
+    const double doubleValue = isDouble ? *(double*)prop->data : qQNaN();
+
+    // a counter going up gets its own row, resets come with a new file
+    bool late = false;
+    if (strcmp(prop->name, "frame-drop-count") == 0) {
+        late = intValue > now.frameDrops;
+        now.frameDrops = qMax(Q_INT64_C(0), intValue);
+    }
+    else if (strcmp(prop->name, "decoder-frame-drop-count") == 0) {
+        late = intValue > now.decoderDrops;
+        now.decoderDrops = qMax(Q_INT64_C(0), intValue);
+    }
+    else if (strcmp(prop->name, "vo-delayed-frame-count") == 0) {
+        late = intValue > now.delayedFrames;
+        now.delayedFrames = qMax(Q_INT64_C(0), intValue);
+    }
+    else if (strcmp(prop->name, "estimated-vf-fps") == 0) {
+        now.vfFps = doubleValue;
+    }
+    else if (strcmp(prop->name, "container-fps") == 0) {
+        now.containerFps = doubleValue;
+    }
+    else if (strcmp(prop->name, "avsync") == 0) {
+        now.avsync = doubleValue;
+    }
+    else if (strcmp(prop->name, "demuxer-cache-duration") == 0) {
+        now.cacheSeconds = doubleValue;
+    }
+    else if (strcmp(prop->name, "cache-buffering-state") == 0) {
+        now.buffering = intValue;
+    }
+    else if (strcmp(prop->name, "speed") == 0) {
+        now.speed = isDouble ? doubleValue : 1;
+    }
+    else {
+        return false;
+    }
+    if (late || lastRecordMs < 0 || clock.elapsed() - lastRecordMs >= 1000) {
+        record();
+    }
+    return true;
+}
+
+void PlaybackStats::addPaint(qint64 ns)
+{
+    const double ms = ns / 1e6;
+    int bucket = 0;
+    while (bucket < Buckets - 1 && ms >= BucketLimits[bucket]) {
+        bucket++;
+    }
+    paintCounts[bucket]++;
+    paints++;
+    paintNs += ns;
+    maxPaintNs = qMax(maxPaintNs, ns);
+    intervalPaints++;
+    intervalPaintNs += ns;
+}
+
+void PlaybackStats::record()
+{
+    lastRecordMs = clock.elapsed();
+    now.ms = lastRecordMs;
+    now.paintMs = intervalPaints > 0 ? intervalPaintNs / 1e6 / intervalPaints : qQNaN();
+    intervalPaints = 0;
+    intervalPaintNs = 0;
+    if (samples.count() >= MAX_SAMPLES) {
+        samples.remove(0, MAX_SAMPLES / 2);
+    }
+    samples << now;
+}
+
+QStringList PlaybackStats::overlayLines() const
+{
+    QStringList lines;
+    lines << QString("Dropped %1, decoder %2, delayed %3").arg(now.frameDrops).arg(now.decoderDrops).arg(now.delayedFrames);
+    if (!qIsNaN(now.containerFps)) {
+        QString line = QString("FPS %1 / %2").arg(csvNumber(now.vfFps, 3), csvNumber(now.containerFps, 3));
+        if (!qIsNaN(now.vfFps)) {
+            line += QString(", decoding %1x").arg(now.decodeRatio(), 0, 'f', 2);
+        }
+        lines << line;
+    }
+    if (!qIsNaN(now.avsync)) {
+        lines << QString("A/V %1 ms").arg(now.avsync * 1000, 0, 'f', 1);
+    }
+    if (!qIsNaN(now.cacheSeconds)) {
+        QString line = QString("Cache %1 s").arg(now.cacheSeconds, 0, 'f', 1);
+        if (now.buffering >= 0) {
+            line += QString(", %1%").arg(now.buffering);
+        }
+        lines << line;
+    }
+    if (paints > 0) {
+        lines << QString("Paint %1 ms avg, %2 ms max").arg(paintNs / 1e6 / paints, 0, 'f', 2).arg(maxPaintNs / 1e6, 0, 'f', 2);
+        for (int i = 0; i < Buckets; ++i) {
+            if (paintCounts[i] == 0) {
+                continue;
+            }
+            QString range = i < Buckets - 1 ? QString("<%1 ms").arg(BucketLimits[i]) : QString(">=%1 ms").arg(BucketLimits[i - 1]);
+            lines << QString("  %1 %2 %3%").arg(range, -8).arg(paintCounts[i], 8).arg(100.0 * paintCounts[i] / paints, 5, 'f', 1);
+        }
+    }
+    return lines;
+}
+
+QJsonObject PlaybackStats::toJson() const
+{
+    QJsonArray histogram;
+    for (int i = 0; i < Buckets; ++i) {
+        histogram << QJsonObject {
+            { "below-ms", i < Buckets - 1 ? QJsonValue(BucketLimits[i]) : QJsonValue() },
+            { "count", paintCounts[i] },
+        };
+    }
+    return {
+        { "frame-drops", now.frameDrops },
+        { "decoder-frame-drops", now.decoderDrops },
+        { "delayed-frames", now.delayedFrames },
+        { "estimated-vf-fps", number(now.vfFps) },
+        { "container-fps", number(now.containerFps) },
+        { "decode-ratio", number(now.decodeRatio()) },
+        { "avsync-ms", number(now.avsync * 1000) },
+        { "cache-seconds", number(now.cacheSeconds) },
+        { "buffering", now.buffering },
+        { "paints", paints },
+        { "paint-average-ms", paints > 0 ? QJsonValue(paintNs / 1e6 / paints) : QJsonValue() },
+        { "paint-max-ms", maxPaintNs / 1e6 },
+        { "paint-histogram", histogram },
+    };
+}
+
+bool PlaybackStats::exportCsv(const QString& path) const
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+        return false;
+    }
+    QTextStream out(&file);
+    out << "time,elapsed-ms,frame-drops,decoder-frame-drops,delayed-frames,estimated-vf-fps,container-fps,avsync-ms,cache-seconds,buffering,speed,paint-ms\n";
+    for (const Sample& sample : samples) {
+        out << started.addMSecs(sample.ms).toString(Qt::ISODateWithMs) << ','
+            << sample.ms << ','
+            << sample.frameDrops << ','
+            << sample.decoderDrops << ','
+            << sample.delayedFrames << ','
+            << csvNumber(sample.vfFps, 3) << ','
+            << csvNumber(sample.containerFps, 3) << ','
+            << csvNumber(sample.avsync * 1000, 2) << ','
+            << csvNumber(sample.cacheSeconds, 2) << ','
+            << (sample.buffering >= 0 ? QString::number(sample.buffering) : QString()) << ','
+            << sample.speed << ','
+            << csvNumber(sample.paintMs, 3) << '\n';
+    }
+    out.flush();
+    return file.commit();
+}
+
+bool PlaybackStats::exportJson(const QString& path) const
+{
+    QJsonArray rows;
+    for (const Sample& sample : samples) {
+        rows << QJsonObject {
+            { "time", started.addMSecs(sample.ms).toString(Qt::ISODateWithMs) },
+            { "elapsed-ms", sample.ms },
+            { "frame-drops", sample.frameDrops },
+            { "decoder-frame-drops", sample.decoderDrops },
+            { "delayed-frames", sample.delayedFrames },
+            { "estimated-vf-fps", number(sample.vfFps) },
+            { "container-fps", number(sample.containerFps) },
+            { "avsync-ms", number(sample.avsync * 1000) },
+            { "cache-seconds", number(sample.cacheSeconds) },
+            { "buffering", sample.buffering >= 0 ? QJsonValue(sample.buffering) : QJsonValue() },
+            { "speed", sample.speed },
+            { "paint-ms", number(sample.paintMs) },
+        };
+    }
+    QJsonObject session = toJson();
+    session.insert("started", started.toString(Qt::ISODateWithMs));
+    session.insert("samples", rows);
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(session).toJson());
+    return file.commit();
+}
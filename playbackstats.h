@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QtGlobal>
+
+#include <mpv/client.h>
+
+// Playback quality as mpv reports it through observed properties, next to
+// how long our own paintGL takes. A timestamped log of the session is kept
+// for export, a row a second and one for every dropped or late frame.
+class PlaybackStats
+{
+public:
+    // upper bounds of the paintGL histogram buckets in ms, the last bucket
+    // is open ended
+    static const int Buckets = 8;
+    static const double BucketLimits[Buckets - 1];
+
+    // NaN where mpv has no value, like the fps of a file without video
+    struct Sample {
+        qint64 ms = 0;
+        qint64 frameDrops = 0;
+        qint64 decoderDrops = 0;
+        qint64 delayedFrames = 0;
+        double vfFps = qQNaN();
+        double containerFps = qQNaN();
+        double avsync = qQNaN();
+        double cacheSeconds = qQNaN();
+        int buffering = -1;
+        double speed = 1;
+        // mean paintGL time since the previous row
+        double paintMs = qQNaN();
+
+        // how fast frames leave the decoder relative to what playback needs
+        double decodeRatio() const { return vfFps / (containerFps * speed); }
+    };
+
+    PlaybackStats();
+
+    static void observe(mpv_handle* mpv);
+    // avsync and estimated-vf-fps change with every frame, they are only
+    // observed while someone looks at them
+    void observeFrameTiming(mpv_handle* mpv, bool observe);
+    // false for properties that aren't ours
+    bool handleProperty(const mpv_event_property* prop);
+    void addPaint(qint64 ns);
+
+    const Sample& current() const { return now; }
+    QStringList overlayLines() const;
+    QJsonObject toJson() const;
+    bool exportCsv(const QString& path) const;
+    bool exportJson(const QString& path) const;
+
+private:
+    Sample now;
+    QList<Sample> samples;
+    QDateTime started;
+    QElapsedTimer clock;
+    qint64 lastRecordMs = -1;
+    bool frameTiming = false;
+    qint64 paintCounts[Buckets] = {};
+    qint64 paints = 0;
+    qint64 paintNs = 0;
+    qint64 maxPaintNs = 0;
+    qint64 intervalPaints = 0;
+    qint64 intervalPaintNs = 0;
+
+    void record();
+};
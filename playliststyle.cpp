@@ -1,50 +1,67 @@
 #include "playliststyle.h"
 #include <QApplication>
+#include <QMouseEvent>
 #include <QPainter>
+#include <QStyleOptionButton>
 
 #include <QDebug>
 
+// between the title and the buttons, and around the remove one
+#define SPACING 5
+
 PlaylistStyle::PlaylistStyle(QObject* parent)
     : QStyledItemDelegate { parent }
+    , buttonIcons { QIcon::fromTheme("go-up"), QIcon::fromTheme("go-down"), QIcon::fromTheme("list-remove") }
+{
+}
+
+void PlaylistStyle::setPlayIcon(const QIcon& icon)
 {
+    playIcon = icon;
 }
 
-// void PlaylistStyle::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
-// {
-//     return QStyledItemDelegate::paint(painter, option, index);
-//     painter->save();
-//     QStyleOptionViewItem opt = option;
-//     opt.font.setBold(true);
-//     opt.features = opt.features | QStyleOptionViewItem::WrapText;
-//     QApplication::style()->drawPrimitive(QStyle::PE_PanelItemViewItem, &opt, painter);
-//     QApplication::style()->drawPrimitive(QStyle::PE_PanelItemViewRow, &opt, painter);
-//     QString text = index.data().toString();
-//     QString time = index.data(DATA_TIME).toString();
-//     bool current = index.data(DATA_CURRENT).toBool();
-//     QFontMetrics fm = option.fontMetrics;
-
-//     const QRect& r = option.rect;
-//     qDebug() << "Paint" << r << r.size();
-
-//     // QRect textRect = QRect(r.x(), r.y(), r.width(), r.height() / 2);
-//     // QRect timeRect = QRect(r.x(), textRect.y() + textRect.height(), r.width(), r.height() - textRect.height());
-//     // text = fm.elidedText(text, Qt::ElideRight, textRect.width());
-//     // auto fontBold = painter->font();
-//     // fontBold.setBold(true);
-//     // QTextOption o(Qt::AlignTop | Qt::AlignLeft);
-
-//     // o.setWrapMode(QTextOption::WrapAnywhere);
-//     // option.textElideMode = Qt::ElideRight;
-//     // painter->drawText(option.rect, Qt::TextWrapAnywhere | Qt::AlignLeft, text);
-
-//     QApplication::style()->drawItemText(painter, option.rect, Qt::AlignLeft | Qt::TextWordWrap, QApplication::palette(), true, text);
-//     // painter->setFont(fontBold);
-//     // QApplication::style()
-//     //     ->drawItemText(
-//     //         painter, timeRect, Qt::AlignRight, QApplication::palette(), true, time);
-
-//     painter->restore();
-// }
+void PlaylistStyle::paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const
+{
+    QStyleOptionViewItem opt = option;
+    initStyleOption(&opt, index);
+    const QWidget* widget = opt.widget;
+    QStyle* style = widget ? widget->style() : QApplication::style();
+    const QString title = opt.text;
+    // the panel with selection and hover, everything else goes on top
+    opt.text.clear();
+    style->drawControl(QStyle::CE_ItemViewItem, &opt, painter, widget);
+
+    const QRect& r = opt.rect;
+    const int iconHeight = opt.fontMetrics.height();
+    QRect iconRect(r.x() + SPACING, r.y() + (r.height() - iconHeight) / 2, iconHeight, iconHeight);
+    if (index.data(DATA_CURRENT).toBool()) {
+        playIcon.paint(painter, iconRect);
+    }
+
+    QRect titleRect = r;
+    titleRect.setLeft(iconRect.right() + SPACING);
+    titleRect.setRight(buttonRect(opt, UpButton).left() - SPACING);
+    const bool selected = opt.state & QStyle::State_Selected;
+    style->drawItemText(painter, titleRect, Qt::AlignLeft | Qt::AlignVCenter, opt.palette, opt.state & QStyle::State_Enabled,
+        opt.fontMetrics.elidedText(title, opt.textElideMode, titleRect.width()), selected ? QPalette::HighlightedText : QPalette::Text);
+
+    const int buttonIconSize = style->pixelMetric(QStyle::PM_ButtonIconSize, nullptr, widget);
+    for (int b = UpButton; b <= RemoveButton; ++b) {
+        QStyleOptionButton button;
+        button.rect = buttonRect(opt, b);
+        button.palette = opt.palette;
+        button.icon = buttonIcons[b];
+        button.iconSize = QSize(buttonIconSize, buttonIconSize);
+        button.state = QStyle::State_Raised;
+        if (buttonEnabled(index, b)) {
+            button.state |= QStyle::State_Enabled;
+        }
+        if (pressedButton == b && pressedIndex == index) {
+            button.state |= QStyle::State_Sunken;
+        }
+        style->drawControl(QStyle::CE_PushButton, &button, painter, widget);
+    }
+}
 
 QSize PlaylistStyle::sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const
 {
@@ -54,3 +71,84 @@ QSize PlaylistStyle::sizeHint(const QStyleOptionViewItem& option, const QModelIn
 
     return size;
 }
+
+bool PlaylistStyle::editorEvent(QEvent* event, QAbstractItemModel* model, const QStyleOptionViewItem& option, const QModelIndex& index)
+{
+    switch (event->type()) {
+    case QEvent::MouseButtonPress:
+    case QEvent::MouseButtonDblClick: {
+        auto mouseEvent = static_cast<QMouseEvent*>(event);
+        int button = mouseEvent->button() == Qt::LeftButton ? buttonAt(option, mouseEvent->position().toPoint()) : NoButton;
+        if (button == NoButton) {
+            break;
+        }
+        // neither selects nor starts a drag, a quick second click is
+        // another click and not a double click on the row
+        if (buttonEnabled(index, button)) {
+            pressedIndex = index;
+            pressedButton = button;
+        }
+        return true;
+    }
+    case QEvent::MouseButtonRelease: {
+        if (pressedButton == NoButton) {
+            break;
+        }
+        auto mouseEvent = static_cast<QMouseEvent*>(event);
+        const int button = pressedButton;
+        const bool clicked = pressedIndex == index && buttonAt(option, mouseEvent->position().toPoint()) == button;
+        pressedButton = NoButton;
+        pressedIndex = QPersistentModelIndex();
+        if (clicked) {
+            emit buttonClicked(index.row(), button);
+        }
+        return true;
+    }
+    default:
+        break;
+    }
+    return QStyledItemDelegate::editorEvent(event, model, option, index);
+}
+
+// right aligned, the remove button a little apart from the other two
+QRect PlaylistStyle::buttonRect(const QStyleOptionViewItem& option, int button) const
+{
+    const QWidget* widget = option.widget;
+    QStyle* style = widget ? widget->style() : QApplication::style();
+    const int iconSize = style->pixelMetric(QStyle::PM_ButtonIconSize, nullptr, widget);
+    QStyleOptionButton opt;
+    opt.iconSize = QSize(iconSize, iconSize);
+    QSize size = style->sizeFromContents(QStyle::CT_PushButton, &opt, QSize(iconSize + 4, qMax(iconSize, option.fontMetrics.height())), widget);
+    size = size.boundedTo(option.rect.size());
+
+    const QRect& r = option.rect;
+    int left = r.right() + 1 - SPACING - size.width();
+    if (button != RemoveButton) {
+        left -= SPACING + size.width();
+    }
+    if (button == UpButton) {
+        left -= size.width();
+    }
+    return QRect(QPoint(left, r.y() + (r.height() - size.height()) / 2), size);
+}
+
+int PlaylistStyle::buttonAt(const QStyleOptionViewItem& option, const QPoint& pos) const
+{
+    for (int b = UpButton; b <= RemoveButton; ++b) {
+        if (buttonRect(option, b).contains(pos)) {
+            return b;
+        }
+    }
+    return NoButton;
+}
+
+bool PlaylistStyle::buttonEnabled(const QModelIndex& index, int button) const
+{
+    if (button == UpButton) {
+        return index.row() > 0;
+    }
+    if (button == DownButton) {
+        return index.row() < index.model()->rowCount() - 1;
+    }
+    return true;
+}
@@ -1,20 +1,47 @@
 #pragma once
 
+#include <QIcon>
+#include <QPersistentModelIndex>
 #include <QStyledItemDelegate>
 
 #define DATA_TIME Qt::UserRole + 1
 #define DATA_PATH Qt::UserRole + 2
 #define DATA_CURRENT Qt::UserRole + 3
 
+// Paints a playlist row, the play marker, the title and the buttons to move
+// and remove it, without a widget per row. Clicks on the buttons are
+// reported with buttonClicked().
 class PlaylistStyle : public QStyledItemDelegate
 {
     Q_OBJECT
 public:
+    enum Button {
+        NoButton = -1,
+        UpButton,
+        DownButton,
+        RemoveButton,
+    };
+
     explicit PlaylistStyle(QObject* parent = nullptr);
 
-private:
-    // void paint(QPainter* painter,
-    //     const QStyleOptionViewItem& option,
-    //     const QModelIndex& index) const override;
+    void setPlayIcon(const QIcon& icon);
+
+signals:
+    void buttonClicked(int row, int button);
+
+protected:
+    void paint(QPainter* painter, const QStyleOptionViewItem& option, const QModelIndex& index) const override;
     QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const override;
+    bool editorEvent(QEvent* event, QAbstractItemModel* model, const QStyleOptionViewItem& option, const QModelIndex& index) override;
+
+private:
+    QIcon playIcon;
+    QIcon buttonIcons[3];
+    // the button a press went to, until its release
+    QPersistentModelIndex pressedIndex;
+    int pressedButton = NoButton;
+
+    QRect buttonRect(const QStyleOptionViewItem& option, int button) const;
+    int buttonAt(const QStyleOptionViewItem& option, const QPoint& pos) const;
+    bool buttonEnabled(const QModelIndex& index, int button) const;
 };
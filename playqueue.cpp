@@ -0,0 +1,176 @@
+#include "playqueue.h"
+
+#include <algorithm>
+
+void PlayQueue::append(const QStringList& files)
+{
+    for (const QString& file : files) {
+        entries << file;
+        ids << nextId++;
+    }
+}
+
+void PlayQueue::move(const QList<int>& rows, int to)
+{
+    Q_ASSERT(to >= 0 && to <= entries.count());
+    Q_ASSERT(rows.isEmpty() || (rows.first() >= 0 && rows.last() < entries.count()));
+    // rebuilt in one pass, the block goes in where the survivors reach `to`
+    QStringList moved;
+    QList<quint32> movedIds;
+    moved.reserve(entries.count());
+    movedIds.reserve(entries.count());
+    auto insertBlock = [&] {
+        for (int row : rows) {
+            moved << entries.at(row);
+            movedIds << ids.at(row);
+        }
+    };
+    int next = 0;
+    for (int row = 0; row < entries.count(); ++row) {
+        if (row == to) {
+            insertBlock();
+        }
+        if (next < rows.count() && rows.at(next) == row) {
+            next++;
+            continue;
+        }
+        moved << entries.at(row);
+        movedIds << ids.at(row);
+    }
+    if (to >= entries.count()) {
+        insertBlock();
+    }
+    entries = moved;
+    ids = movedIds;
+    if (currentRow >= 0) {
+        currentRow = rowOf(currentId);
+    }
+}
+
+void PlayQueue::remove(const QList<int>& rows)
+{
+    Q_ASSERT(rows.isEmpty() || (rows.first() >= 0 && rows.last() < entries.count()));
+    // one pass compacting the survivors, so removing thousands stays linear
+    int next = 0;
+    int write = 0;
+    int current = -1;
+    for (int read = 0; read < entries.count(); ++read) {
+        if (next < rows.count() && rows.at(next) == read) {
+            next++;
+            continue;
+        }
+        if (read == currentRow) {
+            current = write;
+        }
+        if (write != read) {
+            entries[write] = entries.at(read);
+            ids[write] = ids.at(read);
+        }
+        write++;
+    }
+    // a removed current entry hands over to the one that took its place,
+    // which is where mpv goes once it's dropped from the window
+    if (currentRow >= 0 && current < 0) {
+        current = qMin(currentRow - int(std::lower_bound(rows.begin(), rows.end(), currentRow) - rows.begin()), write - 1);
+    }
+    entries.resize(write);
+    ids.resize(write);
+    currentRow = current;
+    currentId = current >= 0 ? ids.at(current) : 0;
+}
+
+bool PlayQueue::setWindowPosition(int pos)
+{
+    if (pos < 0 || pos >= window.count()) {
+        return false;
+    }
+    int row = rowOf(window.at(pos));
+    if (row < 0) {
+        return false;
+    }
+    currentRow = row;
+    currentId = ids.at(row);
+    return true;
+}
+
+void PlayQueue::resetWindow(int row)
+{
+    window.clear();
+    if (row >= 0 && row < entries.count()) {
+        window << ids.at(row);
+        currentRow = row;
+        currentId = ids.at(row);
+    }
+}
+
+QList<QVariantList> PlayQueue::syncWindow()
+{
+    QList<QVariantList> commands;
+    int first = qMax(0, currentRow - WindowBefore);
+    int last = qMin(entries.count(), (currentRow < 0 ? 0 : currentRow + 1) + WindowAfter);
+    QList<quint32> wanted = ids.mid(first, last - first);
+
+    for (int i = window.count() - 1; i >= 0; --i) {
+        if (!wanted.contains(window.at(i))) {
+            commands << QVariantList { QString("playlist-remove"), i };
+            window.removeAt(i);
+        }
+    }
+    // what's left is in wanted, put it in order and fill the gaps
+    for (int i = 0; i < wanted.count(); ++i) {
+        if (i < window.count() && window.at(i) == wanted.at(i)) {
+            continue;
+        }
+        int from = window.indexOf(wanted.at(i));
+        if (from < 0) {
+            // only entries after the current one may start playback, when
+            // nothing plays yet
+            bool upcoming = first + i > currentRow;
+            commands << QVariantList { QString("loadfile"), entries.at(first + i), QString(upcoming ? "append-play" : "append") };
+            window << wanted.at(i);
+            from = window.count() - 1;
+        }
+        if (from != i) {
+            commands << QVariantList { QString("playlist-move"), from, i };
+            window.move(from, i);
+        }
+    }
+    return commands;
+}
+
+QList<QVariantList> PlayQueue::play(int row)
+{
+    QList<QVariantList> commands;
+    if (row < 0 || row >= entries.count()) {
+        return commands;
+    }
+    int pos = window.indexOf(ids.at(row));
+    if (pos >= 0) {
+        commands << QVariantList { QString("playlist-play-index"), pos };
+    }
+    else {
+        commands << QVariantList { QString("loadfile"), entries.at(row), QString("replace") };
+        window = { ids.at(row) };
+    }
+    currentRow = row;
+    currentId = ids.at(row);
+    commands << syncWindow();
+    return commands;
+}
+
+int PlayQueue::rowOf(quint32 id) const
+{
+    int start = qBound(0, currentRow, entries.count() - 1);
+    for (int d = 0; d < entries.count(); ++d) {
+        if (start + d < entries.count() && ids.at(start + d) == id) {
+            return start + d;
+        }
+        if (start - d >= 0 && ids.at(start - d) == id) {
+            return start - d;
+        }
+        if (start + d >= entries.count() && start - d < 0) {
+            break;
+        }
+    }
+    return -1;
+}
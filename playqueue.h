@@ -0,0 +1,56 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QVariantList>
+
+// The whole play queue, kept on our side. mpv's playlist only holds a window
+// of it around the current entry, so mpv never serializes more than a dozen
+// entries and the cost of a skip or an edit doesn't grow with the queue.
+// Entries carry ids that survive moves, which is how the window is matched
+// back to the queue.
+class PlayQueue
+{
+public:
+    // entries kept in mpv's playlist before and after the current one
+    static const int WindowBefore = 2;
+    static const int WindowAfter = 10;
+
+    int count() const { return entries.count(); }
+    const QStringList& files() const { return entries; }
+    const QString& at(int row) const { return entries.at(row); }
+    // -1 before anything played
+    int current() const { return currentRow; }
+    int windowCount() const { return window.count(); }
+
+    void append(const QStringList& files);
+    // rows sorted, unique and in range, moved as one block in front of row
+    // `to`, which may be count()
+    void move(const QList<int>& rows, int to);
+    // rows sorted, unique and in range
+    void remove(const QList<int>& rows);
+    // mpv is at `pos` in its playlist, false if that isn't an entry we put there
+    bool setWindowPosition(int pos);
+    // mpv's playlist was cleared down to `row`, which plays, or to nothing
+    void resetWindow(int row);
+
+    // Commands that bring mpv's playlist to the window around the current
+    // entry. They are counted as sent, so run them all and in order.
+    QList<QVariantList> syncWindow();
+    // commands that start playing `row`
+    QList<QVariantList> play(int row);
+
+private:
+    QStringList entries;
+    QList<quint32> ids;
+    quint32 nextId = 0;
+    int currentRow = -1;
+    quint32 currentId = 0;
+    // ids in mpv's playlist, as it will be once all commands sent ran
+    QList<quint32> window;
+
+    // searches outwards from the current row, the ids in the window are
+    // always close to it
+    int rowOf(quint32 id) const;
+};
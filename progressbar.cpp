@@ -0,0 +1,163 @@
+#include "progressbar.h"
+
+#include <QPainter>
+#include <QStyle>
+#include <QStyleOptionProgressBar>
+
+ProgressBar::ProgressBar(QWidget* parent)
+    : QProgressBar(parent)
+{
+}
+
+ProgressBar::~ProgressBar() { }
+
+void ProgressBar::setCacheRanges(const QList<QPair<double, double>>& ranges)
+{
+    if (ranges == cacheRanges) {
+        return;
+    }
+    cacheRanges = ranges;
+    update();
+}
+
+void ProgressBar::setIndexProgress(double fraction)
+{
+    if (fraction == indexProgress) {
+        return;
+    }
+    indexProgress = fraction;
+    update();
+}
+
+void ProgressBar::setMarkers(const QList<double>& times)
+{
+    if (times == markers) {
+        return;
+    }
+    markers = times;
+    update();
+}
+
+void ProgressBar::setWaveform(const QString& path)
+{
+    if (path.isEmpty()) {
+        waveform.close();
+    }
+    else {
+        waveform.open(path);
+    }
+    update();
+}
+
+void ProgressBar::setSelection(double start, double end)
+{
+    if (start == selectionStart && end == selectionEnd) {
+        return;
+    }
+    selectionStart = start;
+    selectionEnd = end;
+    update();
+}
+
+int ProgressBar::xForTime(double time) const
+{
+    if (maximum() <= 0) {
+        return 0;
+    }
+    return qBound(0, qRound(time / maximum() * width()), width());
+}
+
+// min to max as a faint envelope, the RMS level stronger inside it
+void ProgressBar::drawWaveform(QPainter& p, const QRect& rect, const QColor& color)
+{
+    const QList<Waveform::Peak> peaks = waveform.peaks(0, maximum(), rect.width());
+    QColor envelope = color;
+    envelope.setAlpha(color.alpha() / 2);
+    const double middle = rect.top() + rect.height() / 2.0;
+    const double scale = rect.height() / 2.0;
+    for (int i = 0; i < peaks.count(); ++i) {
+        const Waveform::Peak& peak = peaks.at(i);
+        const int x = rect.left() + i;
+        const int top = qRound(middle - peak.max * scale / 127);
+        const int bottom = qRound(middle - peak.min * scale / 127);
+        p.fillRect(QRect(x, top, 1, qMax(1, bottom - top)), envelope);
+        const int rms = qRound(peak.rms * scale / 255);
+        if (rms > 0) {
+            p.fillRect(QRect(x, qRound(middle) - rms, 1, 2 * rms), color);
+        }
+    }
+}
+
+void ProgressBar::paintEvent(QPaintEvent* event)
+{
+    if (waveform.isNull() || maximum() <= 0) {
+        QProgressBar::paintEvent(event);
+    }
+    else {
+        // what the style does for the whole bar, with the waveform slipped
+        // in between the groove and the progress
+        QPainter p(this);
+        QStyleOptionProgressBar option;
+        initStyleOption(&option);
+        QStyleOptionProgressBar part = option;
+        part.rect = style()->subElementRect(QStyle::SE_ProgressBarGroove, &option, this);
+        style()->drawControl(QStyle::CE_ProgressBarGroove, &part, &p, this);
+        QColor color = palette().color(QPalette::Text);
+        color.setAlpha(110);
+        drawWaveform(p, rect(), color);
+        part.rect = style()->subElementRect(QStyle::SE_ProgressBarContents, &option, this);
+        style()->drawControl(QStyle::CE_ProgressBarContents, &part, &p, this);
+        // and again over the played part, which the progress covered
+        p.save();
+        p.setClipRect(QRect(0, 0, xForTime(value()), height()));
+        color = palette().color(QPalette::HighlightedText);
+        color.setAlpha(110);
+        drawWaveform(p, rect(), color);
+        p.restore();
+        if (option.textVisible) {
+            part.rect = style()->subElementRect(QStyle::SE_ProgressBarLabel, &option, this);
+            style()->drawControl(QStyle::CE_ProgressBarLabel, &part, &p, this);
+        }
+    }
+    QPainter p(this);
+    int stripHeight = qMax(2, height() / 8);
+
+    // a strip along the top edge shows how far keyframe indexing got
+    if (indexProgress >= 0) {
+        QColor indexColor = palette().color(QPalette::Link);
+        indexColor.setAlpha(200);
+        p.fillRect(QRect(0, 0, qRound(indexProgress * width()), stripHeight), indexColor);
+    }
+    if (maximum() <= 0) {
+        return;
+    }
+    // the clip as a band, or a line at whichever end is set
+    QColor selectionColor = palette().color(QPalette::Highlight);
+    if (selectionStart >= 0 && selectionEnd > selectionStart) {
+        selectionColor.setAlpha(90);
+        const int x1 = xForTime(selectionStart);
+        p.fillRect(QRect(x1, 0, qMax(1, xForTime(selectionEnd) - x1), height()), selectionColor);
+    }
+    else {
+        for (double time : { selectionStart, selectionEnd }) {
+            if (time >= 0) {
+                p.fillRect(QRect(xForTime(time), 0, 2, height()), selectionColor);
+            }
+        }
+    }
+    // chapter starts, found scenes included, as thin lines across
+    QColor markerColor = palette().color(QPalette::Text);
+    markerColor.setAlpha(120);
+    for (double time : markers) {
+        p.fillRect(QRect(xForTime(time), 0, 1, height()), markerColor);
+    }
+
+    // a strip along the bottom edge marks where seeks are served from cache
+    QColor color = palette().color(QPalette::Highlight).lighter(130);
+    color.setAlpha(200);
+    for (const auto& range : cacheRanges) {
+        int x1 = xForTime(range.first);
+        int x2 = xForTime(range.second);
+        p.fillRect(QRect(x1, height() - stripHeight, qMax(1, x2 - x1), stripHeight), color);
+    }
+}
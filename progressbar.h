@@ -0,0 +1,44 @@
+#pragma once
+
+#include <QList>
+#include <QPair>
+#include <QProgressBar>
+
+#include "waveform.h"
+
+class QPainter;
+
+// Time progress bar that can also show what is around the playhead,
+// like the demuxer cache, and the audio's waveform behind the progress.
+class ProgressBar : public QProgressBar
+{
+    Q_OBJECT
+public:
+    ProgressBar(QWidget* parent = nullptr);
+    ~ProgressBar();
+
+    // seekable ranges in seconds, as in demuxer-cache-state
+    void setCacheRanges(const QList<QPair<double, double>>& ranges);
+    // share of the file scanned for keyframes so far, negative hides it
+    void setIndexProgress(double fraction);
+    // chapter starts in seconds, drawn as ticks
+    void setMarkers(const QList<double>& times);
+    // peak file of the playing file's audio, empty hides the waveform
+    void setWaveform(const QString& path);
+    // the range picked for a clip in seconds, negative ends are unset
+    void setSelection(double start, double end);
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+
+private:
+    QList<QPair<double, double>> cacheRanges;
+    double indexProgress = -1;
+    QList<double> markers;
+    Waveform waveform;
+    double selectionStart = -1;
+    double selectionEnd = -1;
+
+    int xForTime(double time) const;
+    void drawWaveform(QPainter& p, const QRect& rect, const QColor& color);
+};
@@ -11,6 +11,9 @@
 #include <QString>
 #include <QVariant>
 
+#include "stallwatchdog.h"
+#include "trace.h"
+
 namespace mpv {
 namespace qt {
 
@@ -235,6 +238,8 @@ namespace qt {
      */
     static inline QVariant get_property_variant(mpv_handle* ctx, const QString& name)
     {
+        TRACE_SPAN("mpv_get_property", [&] { return name.toUtf8(); });
+        STALL_SCOPE("mpv_get_property", name);
         mpv_node node;
         if (mpv_get_property(ctx, name.toUtf8().data(), MPV_FORMAT_NODE, &node) < 0) {
             return QVariant();
@@ -251,6 +256,8 @@ namespace qt {
     static inline int set_property_variant(mpv_handle* ctx, const QString& name,
         const QVariant& v)
     {
+        TRACE_SPAN("mpv_set_property", [&] { return name.toUtf8(); });
+        STALL_SCOPE("mpv_set_property", name);
         node_builder node(v);
         return mpv_set_property(ctx, name.toUtf8().data(), MPV_FORMAT_NODE, node.node());
     }
@@ -275,6 +282,9 @@ namespace qt {
      */
     static inline QVariant command_variant(mpv_handle* ctx, const QVariant& args)
     {
+        TRACE_SPAN("mpv_command_node", [&] { return args.toList().value(0).toString().toUtf8(); });
+        const QString commandName = args.toList().value(0).toString();
+        STALL_SCOPE("mpv_command_node", commandName);
         node_builder node(args);
         mpv_node res;
         if (mpv_command_node(ctx, node.node(), &res) < 0) {
@@ -338,6 +348,8 @@ namespace qt {
      */
     static inline QVariant get_property(mpv_handle* ctx, const QString& name)
     {
+        TRACE_SPAN("mpv_get_property", [&] { return name.toUtf8(); });
+        STALL_SCOPE("mpv_get_property", name);
         mpv_node node;
         int err = mpv_get_property(ctx, name.toUtf8().data(), MPV_FORMAT_NODE, &node);
         if (err < 0) {
@@ -355,6 +367,8 @@ namespace qt {
     static inline int set_property(mpv_handle* ctx, const QString& name,
         const QVariant& v)
     {
+        TRACE_SPAN("mpv_set_property", [&] { return name.toUtf8(); });
+        STALL_SCOPE("mpv_set_property", name);
         node_builder node(v);
         return mpv_set_property(ctx, name.toUtf8().data(), MPV_FORMAT_NODE, node.node());
     }
@@ -367,6 +381,9 @@ namespace qt {
      */
     static inline QVariant command(mpv_handle* ctx, const QVariant& args)
     {
+        TRACE_SPAN("mpv_command_node", [&] { return args.toList().value(0).toString().toUtf8(); });
+        const QString commandName = args.toList().value(0).toString();
+        STALL_SCOPE("mpv_command_node", commandName);
         node_builder node(args);
         mpv_node res;
         int err = mpv_command_node(ctx, node.node(), &res);
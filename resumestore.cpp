@@ -0,0 +1,286 @@
+#include "resumestore.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAGIC "FPRS"
+#define VERSION 1
+#define INITIAL_CAPACITY (64 * 1024)
+#define FLUSH_INTERVAL 5000
+
+// key 0 marks an empty slot and 1 a removed one, real keys are moved out of
+// the way so probing never confuses them
+#define EMPTY_KEY 0
+#define REMOVED_KEY 1
+#define FLAG_REMOVED 0x80000000u
+
+static inline quint64 slotKey(quint64 key)
+{
+    return key <= REMOVED_KEY ? key + 2 : key;
+}
+
+static_assert(sizeof(ResumeStore::Record) == 64, "Record is a fixed 64 byte slot");
+
+ResumeStore::ResumeStore(QObject* parent)
+    : QObject(parent)
+{
+    flushTimer.setInterval(FLUSH_INTERVAL);
+    connect(&flushTimer, &QTimer::timeout, this, &ResumeStore::flush);
+}
+
+ResumeStore::~ResumeStore()
+{
+    close();
+}
+
+bool ResumeStore::open(const QString& path)
+{
+    close();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    int file = ::open(QFile::encodeName(path).constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (file < 0) {
+        qWarning() << "Could not open resume store" << path;
+        return false;
+    }
+    struct stat st;
+    fstat(file, &st);
+    bool create = st.st_size < (off_t)sizeof(Header);
+    quint64 capacity = INITIAL_CAPACITY;
+    if (!create) {
+        Header existing;
+        if (pread(file, &existing, sizeof(existing), 0) != sizeof(existing)
+            || memcmp(existing.magic, MAGIC, 4) != 0 || existing.version != VERSION
+            || (quint64)st.st_size != sizeof(Header) + existing.capacity * sizeof(Record)) {
+            qWarning() << "Resume store" << path << "is not usable, starting over";
+            create = true;
+        }
+        else {
+            capacity = existing.capacity;
+        }
+    }
+    if (!mapFile(file, capacity, create)) {
+        ::close(file);
+        return false;
+    }
+    filePath = path;
+    flushTimer.start();
+    return true;
+}
+
+bool ResumeStore::mapFile(int file, quint64 capacity, bool create)
+{
+    size_t size = sizeof(Header) + capacity * sizeof(Record);
+    if (create && ftruncate(file, 0) != 0) {
+        return false;
+    }
+    if (create && ftruncate(file, size) != 0) {
+        return false;
+    }
+    void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    fd = file;
+    map = address;
+    mapSize = size;
+    header = static_cast<Header*>(map);
+    slots = reinterpret_cast<Record*>(static_cast<char*>(map) + sizeof(Header));
+    if (create) {
+        memcpy(header->magic, MAGIC, 4);
+        header->version = VERSION;
+        header->capacity = capacity;
+        header->count = 0;
+        header->removed = 0;
+    }
+    return true;
+}
+
+void ResumeStore::unmap()
+{
+    if (map) {
+        munmap(map, mapSize);
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    map = nullptr;
+    header = nullptr;
+    slots = nullptr;
+    mapSize = 0;
+    fd = -1;
+}
+
+void ResumeStore::close()
+{
+    if (!map) {
+        return;
+    }
+    flushTimer.stop();
+    flush();
+    msync(map, mapSize, MS_SYNC);
+    unmap();
+}
+
+int ResumeStore::count() const
+{
+    return header ? header->count : 0;
+}
+
+const ResumeStore::Record* ResumeStore::find(quint64 key) const
+{
+    quint64 mask = header->capacity - 1;
+    for (quint64 i = key & mask, probes = 0; probes < header->capacity; i = (i + 1) & mask, ++probes) {
+        const Record* slot = &slots[i];
+        if (slot->key == key) {
+            return slot;
+        }
+        if (slot->key == EMPTY_KEY) {
+            return nullptr;
+        }
+    }
+    return nullptr;
+}
+
+bool ResumeStore::lookup(quint64 key, Record* record) const
+{
+    key = slotKey(key);
+    auto it = pending.constFind(key);
+    if (it != pending.cend()) {
+        if (it->flags & FLAG_REMOVED) {
+            return false;
+        }
+        *record = *it;
+        return true;
+    }
+    if (!map) {
+        return false;
+    }
+    const Record* slot = find(key);
+    if (nullptr == slot) {
+        return false;
+    }
+    *record = *slot;
+    return true;
+}
+
+void ResumeStore::store(const Record& record)
+{
+    Record r = record;
+    r.key = slotKey(r.key);
+    r.flags &= ~FLAG_REMOVED;
+    r.updated = QDateTime::currentSecsSinceEpoch();
+    pending.insert(r.key, r);
+}
+
+void ResumeStore::remove(quint64 key)
+{
+    Record r;
+    r.key = slotKey(key);
+    r.flags = FLAG_REMOVED;
+    pending.insert(r.key, r);
+}
+
+void ResumeStore::insert(const Record& record)
+{
+    quint64 mask = header->capacity - 1;
+    Record* reuse = nullptr;
+    for (quint64 i = record.key & mask, probes = 0; probes < header->capacity; i = (i + 1) & mask, ++probes) {
+        Record* slot = &slots[i];
+        if (slot->key == record.key) {
+            if (record.flags & FLAG_REMOVED) {
+                // a tombstone keeps later entries of the probe chain reachable
+                memset(slot, 0, sizeof(Record));
+                slot->key = REMOVED_KEY;
+                header->count--;
+                header->removed++;
+            }
+            else {
+                *slot = record;
+            }
+            return;
+        }
+        if (slot->key == REMOVED_KEY && nullptr == reuse) {
+            reuse = slot;
+        }
+        if (slot->key == EMPTY_KEY) {
+            if (nullptr == reuse) {
+                reuse = slot;
+            }
+            break;
+        }
+    }
+    if (record.flags & FLAG_REMOVED || nullptr == reuse) {
+        return;
+    }
+    // stores from before tombstones were counted start at 0
+    if (reuse->key == REMOVED_KEY && header->removed > 0) {
+        header->removed--;
+    }
+    *reuse = record;
+    header->count++;
+}
+
+bool ResumeStore::rehash()
+{
+    // Rehash into a new file and swap it in, so a crash halfway leaves the
+    // old table intact. The size doubles unless it's mostly tombstones that
+    // filled it up.
+    QString tmpPath = filePath + ".new";
+    int file = ::open(QFile::encodeName(tmpPath).constData(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file < 0) {
+        return false;
+    }
+    void* oldMap = map;
+    size_t oldSize = mapSize;
+    int oldFd = fd;
+    Record* oldSlots = slots;
+    quint64 oldCapacity = header->capacity;
+    quint64 capacity = (header->count + 1) * 10 > oldCapacity * 7 / 2 ? oldCapacity * 2 : oldCapacity;
+
+    if (!mapFile(file, capacity, true)) {
+        ::close(file);
+        fd = oldFd;
+        map = oldMap;
+        mapSize = oldSize;
+        header = static_cast<Header*>(map);
+        slots = oldSlots;
+        return false;
+    }
+    for (quint64 i = 0; i < oldCapacity; ++i) {
+        if (oldSlots[i].key > REMOVED_KEY) {
+            insert(oldSlots[i]);
+        }
+    }
+    munmap(oldMap, oldSize);
+    ::close(oldFd);
+    msync(map, mapSize, MS_SYNC);
+    rename(QFile::encodeName(tmpPath).constData(), QFile::encodeName(filePath).constData());
+    return true;
+}
+
+void ResumeStore::flush()
+{
+    if (!map || pending.isEmpty()) {
+        return;
+    }
+    for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+        // keep live slots and tombstones under 70% so probe chains stay short
+        // and always end at an empty slot
+        if ((header->count + header->removed + 1) * 10 > header->capacity * 7 && !rehash()) {
+            qWarning() << "Resume store is full";
+            break;
+        }
+        insert(*it);
+    }
+    pending.clear();
+    msync(map, mapSize, MS_ASYNC);
+}
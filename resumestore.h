@@ -0,0 +1,72 @@
+#pragma once
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+#include <cstdint>
+
+// Remembers where each file was left, in a memory mapped open addressing
+// hash table keyed by fileIdentity(). Lookups touch one or two pages of the
+// mapping no matter how many files are stored. Updates are collected in
+// memory and written to the table every few seconds and on close.
+class ResumeStore : public QObject
+{
+    Q_OBJECT
+public:
+    enum Flags {
+        HasVideoAdjustments = 0x1,
+    };
+
+    // 64 bytes, the on-disk layout of a slot
+    struct Record {
+        quint64 key = 0;
+        double position = 0;
+        float speed = 1;
+        qint32 aid = -1;
+        qint32 sid = -1;
+        quint32 flags = 0;
+        qint64 updated = 0;
+        // VideoAdjustments::pack() when HasVideoAdjustments is set
+        uint8_t video[16] = {};
+        uint8_t reserved[8] = {};
+    };
+
+    ResumeStore(QObject* parent = nullptr);
+    ~ResumeStore();
+
+    bool open(const QString& path);
+    void close();
+    bool lookup(quint64 key, Record* record) const;
+    void store(const Record& record);
+    void remove(quint64 key);
+    void flush();
+    int count() const;
+
+private:
+    struct Header {
+        char magic[4];
+        quint32 version;
+        quint64 capacity;
+        quint64 count;
+        // tombstones, they lengthen probe chains like live slots do
+        quint64 removed;
+        uint8_t reserved[32];
+    };
+
+    QString filePath;
+    int fd = -1;
+    void* map = nullptr;
+    size_t mapSize = 0;
+    Header* header = nullptr;
+    Record* slots = nullptr;
+    QHash<quint64, Record> pending;
+    QTimer flushTimer;
+
+    bool mapFile(int file, quint64 capacity, bool create);
+    void unmap();
+    const Record* find(quint64 key) const;
+    void insert(const Record& record);
+    bool rehash();
+};
@@ -0,0 +1,134 @@
+#include "scenecut.h"
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// cell width in pixels is a multiple of this
+#define CHUNK 16
+#define MAX_COLUMNS 64
+// a scene lasts at least this long, a flash doesn't make two cuts
+#define MIN_SCENE_SECS 1.0
+// levels a cut has to exceed no matter how busy the footage is
+#define MIN_DIFFERENCE 12.0
+#define MIN_HISTOGRAM 0.25
+#define DIFFERENCE_FACTOR 3.0
+#define HISTOGRAM_FACTOR 2.0
+// weight of the newest frame in the running averages
+#define AVERAGE_WEIGHT 0.1
+
+// adds the sum of every 16 pixel chunk of a row to sums
+static void addChunkSums(const uchar* row, int chunks, quint32* sums)
+{
+#ifdef __SSE2__
+    // psadbw against zero sums each 8 byte half into a 64 bit lane
+    const __m128i zero = _mm_setzero_si128();
+    for (int i = 0; i < chunks; ++i) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i * CHUNK));
+        __m128i sad = _mm_sad_epu8(pixels, zero);
+        sums[i] += _mm_cvtsi128_si32(sad) + _mm_extract_epi16(sad, 4);
+    }
+#else
+    for (int i = 0; i < chunks; ++i) {
+        quint32 sum = 0;
+        for (int j = 0; j < CHUNK; ++j) {
+            sum += row[i * CHUNK + j];
+        }
+        sums[i] += sum;
+    }
+#endif
+}
+
+// sum of absolute differences, length a multiple of 16
+static quint64 absoluteDifference(const uchar* a, const uchar* b, size_t length)
+{
+#ifdef __SSE2__
+    __m128i total = _mm_setzero_si128();
+    for (size_t i = 0; i < length; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+        total = _mm_add_epi64(total, _mm_sad_epu8(x, y));
+    }
+    return (quint64)_mm_cvtsi128_si64(total) + (quint64)_mm_cvtsi128_si64(_mm_unpackhi_epi64(total, total));
+#else
+    quint64 total = 0;
+    for (size_t i = 0; i < length; ++i) {
+        total += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+    }
+    return total;
+#endif
+}
+
+void SceneCutter::downscale(const uchar* luma, int width, int height, int stride)
+{
+    const int chunks = width / CHUNK;
+    const int chunksPerColumn = (chunks + MAX_COLUMNS - 1) / MAX_COLUMNS;
+    const int newColumns = chunks / chunksPerColumn;
+    if (newColumns != columns) {
+        // a new size, nothing to compare with
+        columns = newColumns;
+        grid.assign(((columns * GridRows + 15) / 16) * 16, 0);
+        previous = grid;
+        hasPrevious = false;
+    }
+    chunkSums.resize(chunks);
+    memset(histogram, 0, sizeof(histogram));
+
+    for (int band = 0; band < GridRows; ++band) {
+        const int top = band * height / GridRows;
+        const int bottom = (band + 1) * height / GridRows;
+        std::fill(chunkSums.begin(), chunkSums.end(), 0);
+        // every other row is plenty for a box filter this coarse
+        int rows = 0;
+        for (int y = top; y < bottom; y += 2) {
+            addChunkSums(luma + (qint64)y * stride, chunks, chunkSums.data());
+            rows++;
+        }
+        const quint32 pixels = qMax(1, rows * CHUNK * chunksPerColumn);
+        uchar* cells = grid.data() + band * columns;
+        for (int column = 0; column < columns; ++column) {
+            quint32 sum = 0;
+            for (int i = 0; i < chunksPerColumn; ++i) {
+                sum += chunkSums[column * chunksPerColumn + i];
+            }
+            cells[column] = sum / pixels;
+            histogram[cells[column] * Bins / 256]++;
+        }
+    }
+}
+
+void SceneCutter::process(const uchar* luma, int width, int height, int stride, double time)
+{
+    if (width < CHUNK || height < GridRows) {
+        return;
+    }
+    downscale(luma, width, height, stride);
+    const int cells = columns * GridRows;
+
+    if (hasPrevious) {
+        const double difference = (double)absoluteDifference(grid.data(), previous.data(), grid.size()) / cells;
+        int histogramDistance = 0;
+        for (int i = 0; i < Bins; ++i) {
+            histogramDistance += qAbs(histogram[i] - previousHistogram[i]);
+        }
+        // 0 for the same histogram, 1 for ones that don't overlap at all
+        const double histogramChange = histogramDistance / (2.0 * cells);
+
+        const bool cut = difference > qMax(MIN_DIFFERENCE, DIFFERENCE_FACTOR * averageDifference)
+            && histogramChange > qMax(MIN_HISTOGRAM, HISTOGRAM_FACTOR * averageHistogram);
+        if (cut && time - lastCut >= MIN_SCENE_SECS) {
+            found.append(time);
+            lastCut = time;
+        }
+        else {
+            // cuts would lift the level the next one is measured against
+            averageDifference += AVERAGE_WEIGHT * (difference - averageDifference);
+            averageHistogram += AVERAGE_WEIGHT * (histogramChange - averageHistogram);
+        }
+    }
+    grid.swap(previous);
+    memcpy(previousHistogram, histogram, sizeof(histogram));
+    hasPrevious = true;
+}
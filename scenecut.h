@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QList>
+#include <QtGlobal>
+
+#include <vector>
+
+// Finds hard cuts in a stream of 8 bit luma planes. Each frame is box
+// filtered down to a grid of at most 64x36 cells, then compared with the
+// previous one by mean absolute difference and by the distance of their
+// histograms. A cut needs both to jump well above their recent level.
+class SceneCutter
+{
+public:
+    // times of the frames that start a new scene
+    void process(const uchar* luma, int width, int height, int stride, double time);
+    const QList<double>& cuts() const { return found; }
+
+private:
+    static const int GridRows = 36;
+    static const int Bins = 32;
+
+    int columns = 0;
+    std::vector<quint32> chunkSums;
+    // padded to 16 bytes, the padding stays zero
+    std::vector<uchar> grid;
+    std::vector<uchar> previous;
+    int histogram[Bins] = {};
+    int previousHistogram[Bins] = {};
+    bool hasPrevious = false;
+    double averageDifference = 0;
+    double averageHistogram = 0;
+    double lastCut = 0;
+    QList<double> found;
+
+    void downscale(const uchar* luma, int width, int height, int stride);
+};
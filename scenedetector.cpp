@@ -0,0 +1,159 @@
+#include "scenedetector.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonObject>
+#include <QMutexLocker>
+
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+#include "analysiscache.h"
+#include "fileidentity.h"
+#include "lumaplane.h"
+#include "scenecut.h"
+
+#define KIND "scenes"
+
+SceneDetector::SceneDetector(AnalysisCache* cache, QObject* parent)
+    : BackgroundWorker(parent)
+    , cache(cache)
+{
+}
+
+SceneDetector::~SceneDetector()
+{
+    stop();
+}
+
+QJsonArray SceneDetector::load(quint64 identity) const
+{
+    if (identity == 0) {
+        return QJsonArray();
+    }
+    return cache->load(identity, KIND).value("cuts").toArray();
+}
+
+SceneDetector::Stats SceneDetector::stats() const
+{
+    QMutexLocker locker(&mutex);
+    return counters;
+}
+
+void SceneDetector::process(const QString& file)
+{
+    quint64 identity = fileIdentity(file);
+    if (identity == 0 || cache->contains(identity, KIND)) {
+        return;
+    }
+    AVFormatContext* format = nullptr;
+    if (avformat_open_input(&format, QFile::encodeName(file).constData(), nullptr, nullptr) < 0) {
+        return;
+    }
+    const AVCodec* codec = nullptr;
+    int streamIndex = -1;
+    if (avformat_find_stream_info(format, nullptr) >= 0) {
+        streamIndex = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    }
+    // cover art isn't a video
+    if (streamIndex < 0 || (format->streams[streamIndex]->disposition & AV_DISPOSITION_ATTACHED_PIC)) {
+        avformat_close_input(&format);
+        return;
+    }
+    for (unsigned i = 0; i < format->nb_streams; ++i) {
+        format->streams[i]->discard = (int)i == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+    AVStream* stream = format->streams[streamIndex];
+    AVCodecContext* decoder = avcodec_alloc_context3(codec);
+    avcodec_parameters_to_context(decoder, stream->codecpar);
+    // one core, and every shortcut the decoder offers: only the frames other
+    // frames refer to, no loop filter, reduced resolution where supported.
+    // Cuts land on the first decoded frame of a scene, at most a couple of
+    // frames late.
+    decoder->thread_count = 1;
+    decoder->skip_frame = AVDISCARD_NONREF;
+    decoder->skip_loop_filter = AVDISCARD_ALL;
+    decoder->flags2 |= AV_CODEC_FLAG2_FAST;
+    decoder->lowres = qMin(2, (int)codec->max_lowres);
+    if (avcodec_open2(decoder, codec, nullptr) < 0) {
+        avcodec_free_context(&decoder);
+        avformat_close_input(&format);
+        return;
+    }
+
+    // mpv counts time from the start of the file
+    const double startTime = format->start_time != AV_NOPTS_VALUE ? (double)format->start_time / AV_TIME_BASE : 0;
+    const double timeBase = av_q2d(stream->time_base);
+    SceneCutter cutter;
+    std::vector<uchar> scratch;
+    qint64 frames = 0;
+    double lastTime = 0;
+    QElapsedTimer timer;
+    timer.start();
+
+    auto analyze = [&](AVFrame* frame) {
+        if (frame->best_effort_timestamp == AV_NOPTS_VALUE) {
+            return;
+        }
+        int stride;
+        const uchar* luma = lumaPlane(frame, scratch, &stride);
+        if (!luma) {
+            return;
+        }
+        const double time = frame->best_effort_timestamp * timeBase - startTime;
+        cutter.process(luma, frame->width, frame->height, stride, time);
+        frames++;
+        lastTime = qMax(lastTime, time);
+    };
+
+    AVPacket* packet = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    bool ok = true;
+    while (av_read_frame(format, packet) >= 0) {
+        if (!keepGoing()) {
+            ok = false;
+            av_packet_unref(packet);
+            break;
+        }
+        if (packet->stream_index == streamIndex && avcodec_send_packet(decoder, packet) >= 0) {
+            while (avcodec_receive_frame(decoder, frame) >= 0) {
+                analyze(frame);
+                av_frame_unref(frame);
+            }
+        }
+        av_packet_unref(packet);
+    }
+    if (ok) {
+        // the frames still held back for reordering
+        avcodec_send_packet(decoder, nullptr);
+        while (avcodec_receive_frame(decoder, frame) >= 0) {
+            analyze(frame);
+            av_frame_unref(frame);
+        }
+    }
+    av_frame_free(&frame);
+    av_packet_free(&packet);
+    avcodec_free_context(&decoder);
+    avformat_close_input(&format);
+    if (!ok || frames == 0) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&mutex);
+        counters.filesAnalyzed++;
+        counters.framesAnalyzed += frames;
+        counters.secondsAnalyzed += lastTime;
+        counters.secondsSpent += timer.nsecsElapsed() / 1e9;
+    }
+    QJsonArray cuts;
+    for (double time : cutter.cuts()) {
+        cuts.append(qRound(time * 1000) / 1000.0);
+    }
+    cache->store(identity, KIND, QJsonObject { { "cuts", cuts }, { "frames", frames } });
+    emit detected(file, identity, cuts);
+}
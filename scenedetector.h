@@ -0,0 +1,41 @@
+#pragma once
+
+#include <QJsonArray>
+
+#include "backgroundworker.h"
+
+class AnalysisCache;
+
+// Decodes the video of queued files on an idle priority thread, as cheaply
+// as the decoder allows, and finds their scene cuts. Results are kept in the
+// analysis cache as a list of times.
+class SceneDetector : public BackgroundWorker
+{
+    Q_OBJECT
+public:
+    struct Stats {
+        int filesAnalyzed = 0;
+        qint64 framesAnalyzed = 0;
+        double secondsAnalyzed = 0;
+        double secondsSpent = 0;
+        // how much faster than playback the detector runs
+        double speed() const { return secondsSpent > 0 ? secondsAnalyzed / secondsSpent : 0; }
+    };
+
+    SceneDetector(AnalysisCache* cache, QObject* parent = nullptr);
+    ~SceneDetector();
+
+    // empty when the file wasn't analyzed yet
+    QJsonArray load(quint64 identity) const;
+    Stats stats() const;
+
+signals:
+    void detected(const QString& file, quint64 identity, const QJsonArray& cuts);
+
+protected:
+    void process(const QString& file) override;
+
+private:
+    AnalysisCache* cache;
+    Stats counters;
+};
@@ -0,0 +1,61 @@
+#include "screenshot.h"
+
+#include <cstring>
+
+#include "stallwatchdog.h"
+#include "trace.h"
+
+static void freeScreenshot(void* info)
+{
+    mpv_node* node = static_cast<mpv_node*>(info);
+    mpv_free_node_contents(node);
+    delete node;
+}
+
+static const mpv_node* mapValue(const mpv_node* map, const char* key)
+{
+    if (map->format != MPV_FORMAT_NODE_MAP) {
+        return nullptr;
+    }
+    for (int i = 0; i < map->u.list->num; ++i) {
+        if (strcmp(map->u.list->keys[i], key) == 0) {
+            return &map->u.list->values[i];
+        }
+    }
+    return nullptr;
+}
+
+QImage grabFrame(mpv_handle* mpv, const char* flags)
+{
+    TRACE_SPAN("mpv_command_ret", "screenshot-raw");
+    STALL_SCOPE("mpv_command_ret", "screenshot-raw");
+    const char* args[] = { "screenshot-raw", flags, nullptr };
+    mpv_node* result = new mpv_node;
+    if (mpv_command_ret(mpv, args, result) < 0) {
+        delete result;
+        return QImage();
+    }
+    const mpv_node* w = mapValue(result, "w");
+    const mpv_node* h = mapValue(result, "h");
+    const mpv_node* stride = mapValue(result, "stride");
+    const mpv_node* format = mapValue(result, "format");
+    const mpv_node* data = mapValue(result, "data");
+    if (!w || !h || !stride || !format || !data || data->format != MPV_FORMAT_BYTE_ARRAY) {
+        freeScreenshot(result);
+        return QImage();
+    }
+
+    // the byte order mpv names matches Qt's 32 bit formats on little endian
+    QImage::Format imageFormat = QImage::Format_RGB32;
+    const char* name = format->u.string;
+    if (strcmp(name, "bgra") == 0) {
+        imageFormat = QImage::Format_ARGB32_Premultiplied;
+    }
+    else if (strcmp(name, "rgba") == 0) {
+        imageFormat = QImage::Format_RGBA8888_Premultiplied;
+    }
+    else if (strcmp(name, "rgb0") == 0) {
+        imageFormat = QImage::Format_RGBX8888;
+    }
+    return QImage(static_cast<uchar*>(data->u.ba->data), w->u.int64, h->u.int64, stride->u.int64, imageFormat, freeScreenshot, result);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <QImage>
+
+#include <mpv/client.h>
+
+// Runs screenshot-raw and returns the frame as a QImage over mpv's own
+// buffer, which is freed when the last copy of the image goes away.
+// `flags` is "video", "subtitles" or "window", as for the command.
+QImage grabFrame(mpv_handle* mpv, const char* flags = "subtitles");
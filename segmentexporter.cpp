@@ -0,0 +1,227 @@
+#include "segmentexporter.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
+
+#include <cstdio>
+#include <vector>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include "backgroundworker.h"
+#include "headlessdecoder.h"
+
+// written under this name and renamed once complete
+#define PART_SUFFIX ".part"
+
+SegmentExporter::SegmentExporter(QObject* parent)
+    : QThread(parent)
+    , cancelled(false)
+{
+}
+
+SegmentExporter::~SegmentExporter()
+{
+    cancel();
+    wait();
+}
+
+bool SegmentExporter::exportSegment(const Job& newJob)
+{
+    if (isRunning() || newJob.end <= newJob.start) {
+        return false;
+    }
+    // the source is read while the output is written
+    const QString source = QFileInfo(newJob.file).canonicalFilePath();
+    if (source.isEmpty() || source == QFileInfo(newJob.output).canonicalFilePath()) {
+        return false;
+    }
+    job = newJob;
+    cancelled = false;
+    lastProgress = -1;
+    start(QThread::IdlePriority);
+    return true;
+}
+
+void SegmentExporter::cancel()
+{
+    QMutexLocker locker(&mutex);
+    cancelled = true;
+    if (decoder) {
+        decoder->abort();
+    }
+}
+
+void SegmentExporter::reportProgress(double fraction)
+{
+    int done = qBound(0, qRound(fraction * 1000), 1000);
+    if (done != lastProgress) {
+        lastProgress = done;
+        emit progress(done);
+    }
+}
+
+void SegmentExporter::run()
+{
+    setIdleIoPriority();
+
+    // the part file hides the extension, the muxer goes by the real name
+    const AVOutputFormat* outputFormat = av_guess_format(nullptr, QFile::encodeName(job.output).constData(), nullptr);
+    if (!outputFormat) {
+        emit finished(false, job.output);
+        return;
+    }
+    format = QString::fromUtf8(outputFormat->name);
+    partPath = job.output + PART_SUFFIX;
+
+    bool ok = false;
+    if (job.reencode) {
+        HeadlessDecoder encoder;
+        {
+            QMutexLocker locker(&mutex);
+            if (cancelled) {
+                emit finished(false, job.output);
+                return;
+            }
+            decoder = &encoder;
+        }
+        ok = encoder.encodeSegment(job.file, job.start, job.end, partPath, format, [&](double fraction) {
+            reportProgress(fraction);
+        });
+        QMutexLocker locker(&mutex);
+        decoder = nullptr;
+    }
+    else {
+        ok = remux();
+    }
+    ok = ok && !cancelled;
+    // the file it replaces stays until the new one is whole
+    if (ok) {
+        ok = ::rename(QFile::encodeName(partPath).constData(), QFile::encodeName(job.output).constData()) == 0;
+    }
+    if (!ok) {
+        // nothing half written is left behind
+        QFile::remove(partPath);
+    }
+    emit finished(ok, job.output);
+}
+
+bool SegmentExporter::remux()
+{
+    AVFormatContext* in = nullptr;
+    if (avformat_open_input(&in, QFile::encodeName(job.file).constData(), nullptr, nullptr) < 0) {
+        return false;
+    }
+    if (avformat_find_stream_info(in, nullptr) < 0) {
+        avformat_close_input(&in);
+        return false;
+    }
+    const QByteArray outputPath = QFile::encodeName(partPath);
+    AVFormatContext* out = nullptr;
+    if (avformat_alloc_output_context2(&out, nullptr, format.toUtf8().constData(), outputPath.constData()) < 0) {
+        avformat_close_input(&in);
+        return false;
+    }
+    // video, audio and subtitles go along, whatever the output format takes
+    std::vector<int> mapping(in->nb_streams, -1);
+    int videoIndex = -1;
+    for (unsigned i = 0; i < in->nb_streams; ++i) {
+        AVStream* stream = in->streams[i];
+        const AVMediaType type = stream->codecpar->codec_type;
+        if ((type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO && type != AVMEDIA_TYPE_SUBTITLE)
+            || (stream->disposition & AV_DISPOSITION_ATTACHED_PIC)
+            || avformat_query_codec(out->oformat, stream->codecpar->codec_id, FF_COMPLIANCE_NORMAL) == 0) {
+            continue;
+        }
+        AVStream* copy = avformat_new_stream(out, nullptr);
+        if (!copy || avcodec_parameters_copy(copy->codecpar, stream->codecpar) < 0) {
+            continue;
+        }
+        // the input container's tag may mean nothing in the output one
+        copy->codecpar->codec_tag = 0;
+        copy->time_base = stream->time_base;
+        av_dict_copy(&copy->metadata, stream->metadata, 0);
+        mapping[i] = copy->index;
+        if (type == AVMEDIA_TYPE_VIDEO && videoIndex < 0) {
+            videoIndex = i;
+        }
+    }
+    av_dict_copy(&out->metadata, in->metadata, 0);
+    // B-frames before the first keyframe decode earlier than they show
+    out->avoid_negative_ts = AVFMT_AVOID_NEG_TS_MAKE_ZERO;
+
+    bool ok = out->nb_streams > 0;
+    if (ok && !(out->oformat->flags & AVFMT_NOFILE)) {
+        ok = avio_open(&out->pb, outputPath.constData(), AVIO_FLAG_WRITE) >= 0;
+    }
+    ok = ok && avformat_write_header(out, nullptr) >= 0;
+
+    // mpv counts time from the start of the file
+    const qint64 startTime = in->start_time != AV_NOPTS_VALUE ? in->start_time : 0;
+    if (ok) {
+        av_seek_frame(in, -1, startTime + (qint64)(job.start * AV_TIME_BASE), AVSEEK_FLAG_BACKWARD);
+    }
+    // microseconds of the first packet written, everything is moved back by it
+    qint64 cut = AV_NOPTS_VALUE;
+    const qint64 end = startTime + (qint64)(job.end * AV_TIME_BASE);
+    AVPacket* packet = av_packet_alloc();
+    while (ok && !cancelled && av_read_frame(in, packet) >= 0) {
+        const int index = packet->stream_index;
+        const qint64 ts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+        if (mapping[index] < 0 || ts == AV_NOPTS_VALUE) {
+            av_packet_unref(packet);
+            continue;
+        }
+        AVStream* stream = in->streams[index];
+        const qint64 time = av_rescale_q(ts, stream->time_base, AV_TIME_BASE_Q);
+        const bool isVideo = index == videoIndex || videoIndex < 0;
+        if (cut == AV_NOPTS_VALUE) {
+            // the clip starts on the keyframe the seek found
+            if (!isVideo || (videoIndex >= 0 && !(packet->flags & AV_PKT_FLAG_KEY))) {
+                av_packet_unref(packet);
+                continue;
+            }
+            cut = time;
+        }
+        if (isVideo && packet->dts != AV_NOPTS_VALUE && av_rescale_q(packet->dts, stream->time_base, AV_TIME_BASE_Q) > end) {
+            av_packet_unref(packet);
+            break;
+        }
+        if (time < cut || time > end) {
+            av_packet_unref(packet);
+            continue;
+        }
+        AVStream* copy = out->streams[mapping[index]];
+        const qint64 shift = av_rescale_q(cut, AV_TIME_BASE_Q, stream->time_base);
+        if (packet->pts != AV_NOPTS_VALUE) {
+            packet->pts -= shift;
+        }
+        if (packet->dts != AV_NOPTS_VALUE) {
+            packet->dts -= shift;
+        }
+        av_packet_rescale_ts(packet, stream->time_base, copy->time_base);
+        packet->stream_index = copy->index;
+        packet->pos = -1;
+        if (isVideo) {
+            reportProgress((double)(time - cut) / qMax<qint64>(1, end - cut));
+        }
+        ok = av_interleaved_write_frame(out, packet) >= 0;
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    if (ok && cut != AV_NOPTS_VALUE) {
+        ok = av_write_trailer(out) == 0;
+    }
+    else {
+        ok = false;
+    }
+    if (out->pb && !(out->oformat->flags & AVFMT_NOFILE)) {
+        avio_closep(&out->pb);
+    }
+    avformat_free_context(out);
+    avformat_close_input(&in);
+    return ok;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QThread>
+
+#include <atomic>
+
+class HeadlessDecoder;
+
+// Cuts a range out of a file into a new one on an idle priority thread. The
+// output is only replaced once the new file is complete.
+// Stream copy remuxes the packets as they are, starting at the keyframe at
+// or before the start, and takes about as long as reading them. The exact
+// mode re-encodes the range with a private mpv in encoding mode.
+class SegmentExporter : public QThread
+{
+    Q_OBJECT
+public:
+    struct Job {
+        QString file;
+        // seconds
+        double start = 0;
+        double end = 0;
+        QString output;
+        bool reencode = false;
+    };
+
+    SegmentExporter(QObject* parent = nullptr);
+    ~SegmentExporter();
+
+    // false while another export is running or when the output is the file
+    // itself
+    bool exportSegment(const Job& job);
+    void cancel();
+
+signals:
+    // in thousandths of the range
+    void progress(int done);
+    void finished(bool ok, const QString& output);
+
+protected:
+    void run() override;
+
+private:
+    Job job;
+    // the muxer for the output's extension, and where it writes until done
+    QString format;
+    QString partPath;
+    QMutex mutex;
+    HeadlessDecoder* decoder = nullptr;
+    std::atomic_bool cancelled;
+    int lastProgress = -1;
+
+    bool remux();
+    void reportProgress(double fraction);
+};
@@ -0,0 +1,128 @@
+#include "settings.h"
+
+#include <QSettings>
+
+#define WRITE_DELAY 2000
+
+template <typename T>
+void Settings::bind(QSettings& settings, const QString& key, T Config::*field)
+{
+    keys.insert(&(c.*field), key);
+    if (settings.contains(key)) {
+        c.*field = settings.value(key).template value<T>();
+    }
+}
+
+Settings::Settings(QObject* parent)
+    : QObject(parent)
+{
+    QSettings settings;
+    bind(settings, "seekStep", &Config::seekStep);
+    bind(settings, "seekBarStep", &Config::seekBarStep);
+    bind(settings, "volumeStep", &Config::volumeStep);
+    bind(settings, "volume", &Config::volume);
+    bind(settings, "subFont", &Config::subFont);
+    bind(settings, "subFontSize", &Config::subFontSize);
+    bind(settings, "subBorderColor", &Config::subBorderColor);
+    bind(settings, "subBorderSize", &Config::subBorderSize);
+    bind(settings, "subColor", &Config::subColor);
+    bind(settings, "playbackSpeed", &Config::playbackSpeed);
+
+    bind(settings, "showPlayPause", &Config::showPlayPause);
+    bind(settings, "showSpeed", &Config::showSpeed);
+    bind(settings, "showZoom", &Config::showZoom);
+    bind(settings, "showRotation", &Config::showRotation);
+    bind(settings, "showPanX", &Config::showPanX);
+    bind(settings, "showPanY", &Config::showPanY);
+    bind(settings, "showCropH", &Config::showCropH);
+    bind(settings, "showCropV", &Config::showCropV);
+    bind(settings, "showBrightness", &Config::showBrightness);
+    bind(settings, "showContrast", &Config::showContrast);
+    bind(settings, "showSaturation", &Config::showSaturation);
+    bind(settings, "showGamma", &Config::showGamma);
+    bind(settings, "showHue", &Config::showHue);
+    bind(settings, "showProgress", &Config::showProgress);
+    bind(settings, "showWaveform", &Config::showWaveform);
+    bind(settings, "showMute", &Config::showMute);
+    bind(settings, "showVolume", &Config::showVolume);
+    bind(settings, "showAudio", &Config::showAudio);
+    bind(settings, "showSub", &Config::showSub);
+    bind(settings, "showSettings", &Config::showSettings);
+    bind(settings, "showPlaylistButton", &Config::showPlaylistButton);
+    bind(settings, "playlistVisible", &Config::playlistVisible);
+
+    bind(settings, "ipcServer", &Config::ipcServer);
+    bind(settings, "resumePlayback", &Config::resumePlayback);
+    bind(settings, "rememberVideoAdjustments", &Config::rememberVideoAdjustments);
+    bind(settings, "videoPresets", &Config::videoPresets);
+    bind(settings, "normalizeLoudness", &Config::normalizeLoudness);
+    bind(settings, "loudnessTarget", &Config::loudnessTarget);
+    bind(settings, "frameCacheMiB", &Config::frameCacheMiB);
+    bind(settings, "indexKeyframes", &Config::indexKeyframes);
+    bind(settings, "detectScenes", &Config::detectScenes);
+    bind(settings, "autoCrop", &Config::autoCrop);
+    bind(settings, "detectIntros", &Config::detectIntros);
+    bind(settings, "skipSilence", &Config::skipSilence);
+    bind(settings, "silenceThreshold", &Config::silenceThreshold);
+    bind(settings, "silenceMinSecs", &Config::silenceMinSecs);
+    bind(settings, "prefetchPlaylist", &Config::prefetchPlaylist);
+    bind(settings, "cacheProfile", &Config::cacheProfile);
+    bind(settings, "cache", &Config::cache);
+    bind(settings, "cacheMaxMiB", &Config::cacheMaxMiB);
+    bind(settings, "cacheMaxBackMiB", &Config::cacheMaxBackMiB);
+    bind(settings, "cacheReadaheadSecs", &Config::cacheReadaheadSecs);
+    bind(settings, "decoderThreads", &Config::decoderThreads);
+    bind(settings, "warmCache", &Config::warmCache);
+    bind(settings, "warmCacheRate", &Config::warmCacheRate);
+    bind(settings, "logLevel", &Config::logLevel);
+    bind(settings, "logToFile", &Config::logToFile);
+    bind(settings, "logFileMiB", &Config::logFileMiB);
+    bind(settings, "stallThresholdMs", &Config::stallThresholdMs);
+
+    bind(settings, "geometry", &Config::geometry);
+    bind(settings, "windowState", &Config::windowState);
+
+    // one writer thread keeps batches in order
+    writer.setMaxThreadCount(1);
+    writeTimer.setSingleShot(true);
+    writeTimer.setInterval(WRITE_DELAY);
+    connect(&writeTimer, &QTimer::timeout, this, &Settings::write);
+}
+
+Settings::~Settings()
+{
+    flush();
+}
+
+void Settings::markDirty(const QString& key, const QVariant& value)
+{
+    dirty.insert(key, value);
+    // not restarted on every change, so a stream of changes is still
+    // written at most WRITE_DELAY after the first one
+    if (!writeTimer.isActive()) {
+        writeTimer.start();
+    }
+}
+
+void Settings::write()
+{
+    if (dirty.isEmpty()) {
+        return;
+    }
+    QVariantHash batch;
+    batch.swap(dirty);
+    writer.start([batch] {
+        QSettings settings;
+        for (auto it = batch.cbegin(); it != batch.cend(); ++it) {
+            settings.setValue(it.key(), it.value());
+        }
+        settings.sync();
+    });
+}
+
+void Settings::flush()
+{
+    writeTimer.stop();
+    write();
+    writer.waitForDone();
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <QByteArray>
+#include <QColor>
+#include <QFont>
+#include <QHash>
+#include <QMutex>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVariant>
+
+#include "cacheprofile.h"
+
+class QSettings;
+
+// Every persisted setting, with its default.
+struct Config {
+    int seekStep = 10;
+    int seekBarStep = 30;
+    int volumeStep = 5;
+    int volume = 70;
+    QFont subFont = QFont("sans-serif");
+    int subFontSize = 55;
+    QColor subBorderColor = QColor(Qt::black);
+    int subBorderSize = 3;
+    QColor subColor = QColor(Qt::yellow);
+    int playbackSpeed = 100;
+
+    bool showPlayPause = true;
+    bool showSpeed = true;
+    bool showZoom = true;
+    bool showRotation = true;
+    bool showPanX = false;
+    bool showPanY = false;
+    bool showCropH = true;
+    bool showCropV = true;
+    bool showBrightness = true;
+    bool showContrast = true;
+    bool showSaturation = false;
+    bool showGamma = false;
+    bool showHue = false;
+    bool showProgress = true;
+    bool showWaveform = false;
+    bool showMute = true;
+    bool showVolume = true;
+    bool showAudio = true;
+    bool showSub = true;
+    bool showSettings = true;
+    bool showPlaylistButton = true;
+    bool playlistVisible = true;
+
+    QString ipcServer;
+    bool resumePlayback = true;
+    bool rememberVideoAdjustments = false;
+    bool normalizeLoudness = false;
+    // LUFS, the ReplayGain 2 reference by default
+    int loudnessTarget = -18;
+    // frames kept for stepping backwards, 0 leaves it to mpv
+    int frameCacheMiB = 256;
+    bool indexKeyframes = true;
+    bool detectScenes = true;
+    bool autoCrop = true;
+    bool detectIntros = true;
+    bool skipSilence = false;
+    // dBFS
+    int silenceThreshold = -50;
+    int silenceMinSecs = 2;
+    // name -> VideoAdjustments::toMap()
+    QVariantMap videoPresets;
+    bool prefetchPlaylist = true;
+    int cacheProfile = CacheAuto;
+    QString cache = "auto";
+    int cacheMaxMiB = 150;
+    int cacheMaxBackMiB = 50;
+    int cacheReadaheadSecs = 1;
+    int decoderThreads = 0;
+    bool warmCache = true;
+    int warmCacheRate = 8;
+    // one of LogCapture::levelNames()
+    QString logLevel = "info";
+    bool logToFile = false;
+    int logFileMiB = 10;
+    // 0 turns the watchdog off
+    int stallThresholdMs = 50;
+
+    QByteArray geometry;
+    QByteArray windowState;
+};
+
+// Loads the config once and keeps it in memory. Changes only touch the
+// struct and are written out in batches, off the GUI thread, a couple of
+// seconds later or when flush() is called on exit.
+class Settings : public QObject
+{
+    Q_OBJECT
+public:
+    Settings(QObject* parent = nullptr);
+    ~Settings();
+
+    const Config& config() const { return c; }
+
+    template <typename T>
+    void set(T Config::*field, const T& value)
+    {
+        T& current = c.*field;
+        if (current == value) {
+            return;
+        }
+        current = value;
+        const QString key = keys.value(&current);
+        markDirty(key, QVariant::fromValue(value));
+        emit changed(key);
+    }
+
+    void flush();
+
+signals:
+    void changed(const QString& key);
+
+private:
+    Config c;
+    QHash<const void*, QString> keys;
+    QVariantHash dirty;
+    QTimer writeTimer;
+    QThreadPool writer;
+
+    template <typename T>
+    void bind(QSettings& settings, const QString& key, T Config::*field);
+    void markDirty(const QString& key, const QVariant& value);
+    void write();
+};
@@ -0,0 +1,118 @@
+#include "silence.h"
+
+#include <QtMath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// quieter than this is all the same
+#define FLOOR_DB 120
+
+// sum of squares of count samples
+static double energy(const float* samples, qint64 count)
+{
+    double total = 0;
+    qint64 i = 0;
+#ifdef __SSE2__
+    __m128 sum = _mm_setzero_ps();
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(samples + i);
+        sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+    }
+    float sums[4];
+    _mm_storeu_ps(sums, sum);
+    total = (double)sums[0] + sums[1] + sums[2] + sums[3];
+#endif
+    for (; i < count; ++i) {
+        total += samples[i] * samples[i];
+    }
+    return total;
+}
+
+SilenceMeter::SilenceMeter(int sampleRate, int channels)
+    : channels(channels)
+    , windowFrames((qint64)sampleRate * WindowMs / 1000)
+{
+}
+
+void SilenceMeter::process(const float* samples, qint64 frames)
+{
+    while (frames > 0) {
+        const qint64 take = qMin(frames, windowFrames - filled);
+        squares += energy(samples, take * channels);
+        samples += take * channels;
+        frames -= take;
+        filled += take;
+        if (filled == windowFrames) {
+            flush();
+        }
+    }
+}
+
+void SilenceMeter::flush()
+{
+    if (filled == 0) {
+        return;
+    }
+    const double power = squares / (filled * channels);
+    const int db = power > 0 ? qRound(-10 * std::log10(power)) : FLOOR_DB;
+    levels.append((char)qBound(0, db, FLOOR_DB));
+    filled = 0;
+    squares = 0;
+}
+
+QJsonObject SilenceMeter::result()
+{
+    flush();
+    return { { "windows", levels.size() }, { "window-ms", WindowMs } };
+}
+
+QByteArray SilenceMeter::data()
+{
+    flush();
+    return levels;
+}
+
+QList<QPair<double, double>> SilenceMeter::find(const QByteArray& levels, int thresholdDb, double minSecs)
+{
+    QList<QPair<double, double>> found;
+    const uchar* level = reinterpret_cast<const uchar*>(levels.constData());
+    const int count = levels.size();
+    // levels are dB below full scale, silence is at or above the limit
+    const uchar limit = qBound(0, -thresholdDb, FLOOR_DB);
+    int start = -1;
+    auto step = [&](int i, bool quiet) {
+        if (quiet && start < 0) {
+            start = i;
+        }
+        else if (!quiet && start >= 0) {
+            if ((i - start) * WindowMs >= minSecs * 1000) {
+                found.append({ start * WindowMs / 1000.0, i * WindowMs / 1000.0 });
+            }
+            start = -1;
+        }
+    };
+    int i = 0;
+#ifdef __SSE2__
+    // 16 windows at a time, most chunks are all loud or all quiet and
+    // leave the current stretch as it is
+    const __m128i limits = _mm_set1_epi8((char)limit);
+    for (; i + 16 <= count; i += 16) {
+        __m128i values = _mm_loadu_si128(reinterpret_cast<const __m128i*>(level + i));
+        // unsigned values >= limit
+        const int quiet = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(values, limits), values));
+        if ((quiet == 0xffff && start >= 0) || (quiet == 0 && start < 0)) {
+            continue;
+        }
+        for (int j = 0; j < 16; ++j) {
+            step(i + j, quiet >> j & 1);
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        step(i, level[i] >= limit);
+    }
+    step(count, false);
+    return found;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QByteArray>
+#include <QList>
+#include <QPair>
+
+#include "audioscanner.h"
+
+// The level of a file's audio in 50 ms windows, one byte each in dB below
+// full scale. Kept as the analysis' data so silence can be found for any
+// threshold and length without decoding the file again.
+class SilenceMeter : public AudioSink
+{
+public:
+    static const int WindowMs = 50;
+
+    SilenceMeter(int sampleRate, int channels);
+
+    void process(const float* samples, qint64 frames) override;
+    QJsonObject result() override;
+    QByteArray data() override;
+
+    // start and end in seconds of every stretch at or below thresholdDb
+    // lasting at least minSecs
+    static QList<QPair<double, double>> find(const QByteArray& levels, int thresholdDb, double minSecs);
+
+private:
+    int channels;
+    qint64 windowFrames;
+    qint64 filled = 0;
+    double squares = 0;
+    QByteArray levels;
+
+    void flush();
+};
@@ -0,0 +1,309 @@
+#include "stallwatchdog.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QDeadlineTimer>
+#include <QMutexLocker>
+#include <QtDebug>
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <pthread.h>
+
+#define HEARTBEAT_MS 20
+#define IDLE_HEARTBEAT_MS 250
+#define SAMPLE_INTERVAL_MS 100
+#define SAMPLE_WAIT_MS 20
+#define MAX_SAMPLES 20
+#define MAX_FRAMES 48
+#define MAX_SCOPES 8
+#define ACTIVITY_SIZE 256
+// the handler and the kernel's signal return
+#define SKIP_FRAMES 2
+#define SIGNATURE_FRAMES 8
+#define MAX_LOG_BYTES (4 * 1024 * 1024)
+#define SAMPLE_SIGNAL SIGPROF
+
+thread_local StallWatchdog::Scope* StallWatchdog::Scope::current = nullptr;
+
+struct StallWatchdog::Sample {
+    // ms into the stall
+    qint64 at = 0;
+    // consecutive samples that came out the same
+    int count = 1;
+    QByteArray activity;
+    QStringList stack;
+};
+
+// written by the GUI thread inside the handler, read once `sampled` is set
+static struct {
+    void* frames[MAX_FRAMES];
+    int depth;
+    char activity[ACTIVITY_SIZE];
+} pending;
+static std::atomic_bool sampled(false);
+static pthread_t guiThread;
+
+static qint64 monotonicNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// nothing in here may allocate, it runs inside the signal handler
+static int append(const char* text, int at)
+{
+    while (text && *text && at < ACTIVITY_SIZE - 1) {
+        pending.activity[at++] = *text++;
+    }
+    return at;
+}
+
+static QString frameName(void* address)
+{
+    Dl_info info;
+    if (!dladdr(address, &info) || !info.dli_fname) {
+        return QString("0x%1").arg((quintptr)address, 0, 16);
+    }
+    const QString module = QFileInfo(QString::fromLocal8Bit(info.dli_fname)).fileName();
+    if (info.dli_sname) {
+        return QString("%1!%2+0x%3").arg(module, info.dli_sname).arg((quintptr)address - (quintptr)info.dli_saddr, 0, 16);
+    }
+    // relative to the module, for addr2line
+    return QString("%1+0x%2").arg(module).arg((quintptr)address - (quintptr)info.dli_fbase, 0, 16);
+}
+
+// the innermost frames, with symbol offsets dropped so the same freeze
+// matches across builds of a library that keep their symbols
+static QString signature(const QStringList& stack)
+{
+    QByteArray key;
+    for (int i = 0; i < qMin<int>(SIGNATURE_FRAMES, stack.count()); ++i) {
+        const QString& frame = stack.at(i);
+        key += (frame.contains('!') ? frame.left(frame.lastIndexOf('+')) : frame).toUtf8() + '\n';
+    }
+    return QCryptographicHash::hash(key, QCryptographicHash::Md5).toHex().left(16);
+}
+
+StallWatchdog::StallWatchdog(const QString& logPath, QObject* parent)
+    : QThread(parent)
+    , path(logPath)
+    , threshold(0)
+    , stopping(false)
+    , beat(0)
+    , idle(false)
+{
+    guiThread = pthread_self();
+    // the first backtrace() loads libgcc, which mustn't happen in the handler
+    void* frame;
+    backtrace(&frame, 1);
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    sigaction(SAMPLE_SIGNAL, &action, nullptr);
+}
+
+StallWatchdog::~StallWatchdog()
+{
+    stop();
+}
+
+void StallWatchdog::setThreshold(int ms)
+{
+    QMutexLocker locker(&waitMutex);
+    threshold = ms;
+    wakeup.wakeAll();
+}
+
+void StallWatchdog::setIdle(bool isIdle)
+{
+    idle = isIdle;
+}
+
+StallWatchdog::Stats StallWatchdog::stats() const
+{
+    QMutexLocker locker(&mutex);
+    return totals;
+}
+
+void StallWatchdog::stop()
+{
+    {
+        QMutexLocker locker(&waitMutex);
+        stopping = true;
+        wakeup.wakeAll();
+    }
+    wait();
+}
+
+void StallWatchdog::onSignal(int)
+{
+    const int savedErrno = errno;
+    pending.depth = backtrace(pending.frames, MAX_FRAMES);
+    std::atomic_signal_fence(std::memory_order_acquire);
+    const Scope* scopes[MAX_SCOPES];
+    int count = 0;
+    for (const Scope* scope = Scope::current; scope && count < MAX_SCOPES; scope = scope->parent) {
+        scopes[count++] = scope;
+    }
+    // outermost first
+    int at = 0;
+    for (int i = count - 1; i >= 0; --i) {
+        if (i != count - 1) {
+            at = append(" > ", at);
+        }
+        at = append(scopes[i]->name, at);
+        if (scopes[i]->detail) {
+            at = append(" ", at);
+            at = append(scopes[i]->detail, at);
+        }
+        else if (scopes[i]->text) {
+            at = append(" ", at);
+            const QChar* text = scopes[i]->text->constData();
+            for (qsizetype j = 0; j < scopes[i]->text->size() && at < ACTIVITY_SIZE - 1; ++j) {
+                const char16_t c = text[j].unicode();
+                pending.activity[at++] = c < 0x80 ? c : '?';
+            }
+        }
+    }
+    pending.activity[at] = 0;
+    sampled.store(true, std::memory_order_release);
+    errno = savedErrno;
+}
+
+bool StallWatchdog::sample(Sample& out)
+{
+    // the last signal is still on its way, a second one would write over it
+    if (signalPending && !sampled) {
+        return false;
+    }
+    sampled = false;
+    signalPending = true;
+    if (pthread_kill(guiThread, SAMPLE_SIGNAL) != 0) {
+        signalPending = false;
+        return false;
+    }
+    for (int waited = 0; !sampled.load(std::memory_order_acquire); ++waited) {
+        if (waited >= SAMPLE_WAIT_MS) {
+            return false;
+        }
+        msleep(1);
+    }
+    signalPending = false;
+    out.activity = QByteArray(pending.activity);
+    for (int i = SKIP_FRAMES; i < pending.depth; ++i) {
+        out.stack << frameName(pending.frames[i]);
+    }
+    return true;
+}
+
+void StallWatchdog::run()
+{
+    QMutexLocker locker(&waitMutex);
+    while (!stopping) {
+        const int limit = threshold;
+        if (limit <= 0) {
+            // until a threshold is set
+            wakeup.wait(&waitMutex);
+            continue;
+        }
+        const qint64 startMs = QDateTime::currentMSecsSinceEpoch();
+        const qint64 sent = monotonicNs();
+        beat = 0;
+        QMetaObject::invokeMethod(this, [this] {
+            QMutexLocker locker(&waitMutex);
+            beat = monotonicNs();
+            wakeup.wakeAll();
+        }, Qt::QueuedConnection);
+
+        QList<Sample> samples;
+        int taken = 0;
+        qint64 nextSample = sent + (qint64)limit * 1000000;
+        while (!stopping && beat == 0) {
+            const qint64 now = monotonicNs();
+            if (now < nextSample || taken >= MAX_SAMPLES) {
+                // the heartbeat wakes it, it's a stall once the sample is due
+                wakeup.wait(&waitMutex, taken >= MAX_SAMPLES ? QDeadlineTimer(QDeadlineTimer::Forever) : QDeadlineTimer((nextSample - now) / 1000000 + 1));
+                continue;
+            }
+            Sample next;
+            next.at = (now - sent) / 1000000;
+            // the GUI thread may be blocked on the heartbeat's lock
+            locker.unlock();
+            const bool ok = sample(next);
+            locker.relock();
+            if (ok) {
+                taken++;
+                if (!samples.isEmpty() && samples.last().activity == next.activity && samples.last().stack == next.stack) {
+                    samples.last().count++;
+                }
+                else {
+                    samples << next;
+                }
+            }
+            nextSample = now + (qint64)SAMPLE_INTERVAL_MS * 1000000;
+        }
+        // quitting, the heartbeat is never coming
+        if (stopping) {
+            break;
+        }
+        const double ms = (beat - sent) / 1e6;
+        if (ms >= limit) {
+            locker.unlock();
+            write(startMs, ms, samples);
+            locker.relock();
+        }
+        wakeup.wait(&waitMutex, QDeadlineTimer(idle ? IDLE_HEARTBEAT_MS : HEARTBEAT_MS));
+    }
+}
+
+void StallWatchdog::write(qint64 startMs, double ms, const QList<Sample>& samples)
+{
+    QJsonArray list;
+    for (const Sample& sample : samples) {
+        list.append(QJsonObject {
+            { "at-ms", sample.at },
+            { "count", sample.count },
+            { "activity", QString::fromUtf8(sample.activity) },
+            { "stack", QJsonArray::fromStringList(sample.stack) },
+        });
+    }
+    const QString activity = samples.isEmpty() ? QString() : QString::fromUtf8(samples.first().activity);
+    const QJsonObject record {
+        { "time", QDateTime::fromMSecsSinceEpoch(startMs).toString(Qt::ISODateWithMs) },
+        { "ms", qRound(ms * 10) / 10.0 },
+        { "signature", samples.isEmpty() ? QString() : signature(samples.first().stack) },
+        { "activity", activity },
+        { "samples", list },
+    };
+    {
+        QMutexLocker locker(&mutex);
+        totals.stalls++;
+        totals.longestMs = qMax(totals.longestMs, ms);
+        totals.totalMs += ms;
+        totals.lastActivity = activity;
+    }
+    qInfo() << "GUI thread stalled for" << qRound(ms) << "ms" << (activity.isEmpty() ? "" : "in") << activity;
+    if (path.isEmpty()) {
+        return;
+    }
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QFile file(path);
+    // one old log is kept
+    if (file.size() > MAX_LOG_BYTES) {
+        QFile::remove(path + ".1");
+        QFile::rename(path, path + ".1");
+    }
+    if (file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        file.write(QJsonDocument(record).toJson(QJsonDocument::Compact) + '\n');
+    }
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+
+// Notices when the GUI thread stops getting back to its event loop. A thread
+// of its own posts a heartbeat to it every few ms, spaced out while nothing
+// plays, and once one has waited
+// past the threshold the GUI thread is interrupted with a signal to record
+// its own stack and the scopes it is in, a few times while the stall lasts.
+// Each stall becomes a line of JSON in the log, frames as module offsets and
+// symbols so freezes from different installations can be ranked together.
+class StallWatchdog : public QThread
+{
+    Q_OBJECT
+public:
+    // marks what the thread is busy with, for the samples; only pointers
+    // are stored, the detail is copied if a sample is taken
+    class Scope
+    {
+    public:
+        explicit Scope(const char* name, const char* detail = nullptr)
+            : name(name)
+            , detail(detail)
+        {
+            push();
+        }
+        Scope(const char* name, const QString& detail)
+            : name(name)
+            , text(&detail)
+        {
+            push();
+        }
+        ~Scope()
+        {
+            std::atomic_signal_fence(std::memory_order_release);
+            current = parent;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        friend class StallWatchdog;
+        static thread_local Scope* current;
+        const char* name;
+        const char* detail = nullptr;
+        const QString* text = nullptr;
+        Scope* parent;
+
+        void push()
+        {
+            parent = current;
+            std::atomic_signal_fence(std::memory_order_release);
+            current = this;
+        }
+    };
+
+    struct Stats {
+        int stalls = 0;
+        double longestMs = 0;
+        double totalMs = 0;
+        QString lastActivity;
+    };
+
+    // has to be created on the GUI thread
+    StallWatchdog(const QString& logPath, QObject* parent = nullptr);
+    ~StallWatchdog();
+
+    // 0 stops watching
+    void setThreshold(int ms);
+    // nothing plays, heartbeats are sent less often
+    void setIdle(bool idle);
+    QString logPath() const { return path; }
+    Stats stats() const;
+    void stop();
+
+protected:
+    void run() override;
+
+private:
+    struct Sample;
+    QString path;
+    std::atomic_int threshold;
+    std::atomic_bool stopping;
+    // monotonic ns the last heartbeat was handled at
+    std::atomic<qint64> beat;
+    std::atomic_bool idle;
+    // the thread waits on it for the heartbeat, the next sample or the next
+    // heartbeat to send, whichever comes first
+    QMutex waitMutex;
+    QWaitCondition wakeup;
+    mutable QMutex mutex;
+    Stats totals;
+    // a signal went out and wasn't handled in time
+    bool signalPending = false;
+
+    static void onSignal(int);
+    bool sample(Sample& out);
+    void write(qint64 startMs, double ms, const QList<Sample>& samples);
+};
+
+#define STALL_CONCAT_(a, b) a##b
+#define STALL_CONCAT(a, b) STALL_CONCAT_(a, b)
+// name must be a string literal, the detail has to outlive the scope
+#define STALL_SCOPE(...) StallWatchdog::Scope STALL_CONCAT(stallScope, __LINE__)(__VA_ARGS__)
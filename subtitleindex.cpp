@@ -0,0 +1,82 @@
+#include "subtitleindex.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRegularExpression>
+
+static bool isLanguageTag(const QString& part)
+{
+    // en, eng, pt-BR, zh_Hans
+    static const QRegularExpression tag("^[a-z]{2,3}([-_][a-z0-9]{2,4})?$", QRegularExpression::CaseInsensitiveOption);
+    return tag.match(part).hasMatch();
+}
+
+static bool isFlag(const QString& part)
+{
+    static const QStringList flags = { "forced", "sdh", "cc", "hi", "default", "full" };
+    return flags.contains(part.toLower());
+}
+
+SubtitleIndex::SubtitleIndex(const QStringList& extensions)
+    : extensions(extensions)
+{
+}
+
+void SubtitleIndex::addDirectory(const QString& dir, const QFileInfoList& entries)
+{
+    Directory directory = index(entries);
+    directory.modified = QFileInfo(dir).lastModified();
+    QMutexLocker locker(&mutex);
+    directories.insert(QDir::cleanPath(dir), directory);
+}
+
+SubtitleIndex::Directory SubtitleIndex::index(const QFileInfoList& entries) const
+{
+    Directory directory;
+    for (const QFileInfo& info : entries) {
+        if (!extensions.contains(info.suffix().toLower()) || !info.isFile()) {
+            continue;
+        }
+        const QString path = info.absoluteFilePath();
+        // movie.en.forced.srt is reachable as movie.en.forced, movie.en and
+        // movie, so a media file named like any of them finds it
+        QStringList parts = info.completeBaseName().split('.');
+        directory.byName[parts.join('.').toLower()].append(path);
+        bool tagged = false;
+        while (parts.count() > 1) {
+            // flags in any number, one language tag
+            const QString last = parts.last();
+            if (!isFlag(last)) {
+                if (tagged || !isLanguageTag(last)) {
+                    break;
+                }
+                tagged = true;
+            }
+            parts.removeLast();
+            directory.byName[parts.join('.').toLower()].append(path);
+        }
+    }
+    return directory;
+}
+
+QStringList SubtitleIndex::lookup(const QString& mediaPath)
+{
+    QFileInfo media(mediaPath);
+    const QString dir = QDir::cleanPath(media.absolutePath());
+    const QDateTime modified = QFileInfo(dir).lastModified();
+    const QString name = media.completeBaseName().toLower();
+    {
+        QMutexLocker locker(&mutex);
+        auto it = directories.constFind(dir);
+        if (it != directories.cend() && it->modified == modified) {
+            return it->byName.value(name);
+        }
+    }
+    Directory directory = index(QDir(dir).entryInfoList(QDir::Files | QDir::NoDotAndDotDot));
+    directory.modified = modified;
+    const QStringList files = directory.byName.value(name);
+    QMutexLocker locker(&mutex);
+    directories.insert(dir, directory);
+    return files;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QDateTime>
+#include <QFileInfoList>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+// Maps media files to the subtitle files next to them. Every directory is
+// listed once into a hash from normalized base name to its subtitles, so
+// finding the subtitles of an item is two hash lookups and a stat, however
+// many files the folder has. Safe to use from several threads, listings
+// happen outside the lock.
+class SubtitleIndex
+{
+public:
+    SubtitleIndex(const QStringList& extensions);
+
+    // index from a listing the caller already has
+    void addDirectory(const QString& dir, const QFileInfoList& entries);
+    // Lists the directory the first time and again only when it changed.
+    // mpv guesses language and forced flags from the names itself.
+    QStringList lookup(const QString& mediaPath);
+
+private:
+    struct Directory {
+        QDateTime modified;
+        QHash<QString, QStringList> byName;
+    };
+
+    QStringList extensions;
+    QMutex mutex;
+    QHash<QString, Directory> directories;
+
+    Directory index(const QFileInfoList& entries) const;
+};
@@ -0,0 +1,473 @@
+#include "subtitlesearch.h"
+
+#include <QDataStream>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QStringDecoder>
+
+#include <algorithm>
+#include <queue>
+
+#include "analysiscache.h"
+#include "backgroundworker.h"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+// shorter prefixes only match whole words, a single letter would pull in
+// most of the vocabulary
+#define MIN_PREFIX 2
+
+static const QStringList textCodecs = { "subrip", "ass", "ssa", "webvtt", "mov_text", "text" };
+
+static QString cleanText(QString text)
+{
+    static const QRegularExpression tags("<[^>]*>|\\{[^}]*\\}");
+    text.replace("\\N", " ").replace("\\n", " ").replace('\n', ' ');
+    return text.remove(tags).simplified();
+}
+
+// 01:02:03,456 or 02:03.456 in SRT/VTT, 1:02:03.45 in ASS
+static qint64 parseTime(QStringView time)
+{
+    const auto parts = time.trimmed().split(QRegularExpression("[:.,]"));
+    if (parts.count() < 3) {
+        return -1;
+    }
+    qint64 ms = 0;
+    const QStringView fraction = parts.last();
+    // centiseconds in ASS
+    ms = fraction.toInt() * (fraction.length() == 2 ? 10 : 1);
+    qint64 seconds = 0;
+    for (int i = 0; i < parts.count() - 1; ++i) {
+        seconds = seconds * 60 + parts.at(i).toInt();
+    }
+    return seconds * 1000 + ms;
+}
+
+QStringList SubtitleCues::words(const QString& text)
+{
+    QStringList list;
+    const QString folded = text.toCaseFolded();
+    int start = -1;
+    for (int i = 0; i <= folded.length(); ++i) {
+        bool letter = i < folded.length() && folded.at(i).isLetterOrNumber();
+        if (letter && start < 0) {
+            start = i;
+        }
+        else if (!letter && start >= 0) {
+            list << folded.mid(start, i - start);
+            start = -1;
+        }
+    }
+    return list;
+}
+
+bool SubtitleCues::containsPhrase(const QStringList& words, const QStringList& phrase, bool lastIsPrefix)
+{
+    for (int i = 0; i + phrase.count() <= words.count(); ++i) {
+        int j = 0;
+        for (; j < phrase.count(); ++j) {
+            const QString& word = words.at(i + j);
+            const bool prefix = lastIsPrefix && j == phrase.count() - 1;
+            if (prefix ? !word.startsWith(phrase.at(j)) : word != phrase.at(j)) {
+                break;
+            }
+        }
+        if (j == phrase.count()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SubtitleCues::add(qint64 startMs, qint64 endMs, const QString& text)
+{
+    const QString clean = cleanText(text);
+    if (clean.isEmpty() || startMs < 0) {
+        return;
+    }
+    cues.push_back({ (qint32)startMs, (qint32)qMax(startMs, endMs), (quint32)pool.length(), (quint32)clean.length() });
+    pool += clean;
+}
+
+QString SubtitleCues::text(int i) const
+{
+    return pool.mid(cues[i].offset, cues[i].length);
+}
+
+void SubtitleCues::finish()
+{
+    std::stable_sort(cues.begin(), cues.end(), [](const Cue& a, const Cue& b) {
+        return a.start < b.start;
+    });
+    index.clear();
+    for (int i = 0; i < count(); ++i) {
+        for (const QString& word : words(text(i))) {
+            std::vector<qint32>& ids = index[word];
+            if (ids.empty() || ids.back() != i) {
+                ids.push_back(i);
+            }
+        }
+    }
+    vocabulary = index.keys();
+    vocabulary.sort();
+}
+
+QByteArray SubtitleCues::save() const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << (quint32)cues.size();
+    for (int i = 0; i < count(); ++i) {
+        out << cues[i].start << cues[i].end << text(i);
+    }
+    return data;
+}
+
+bool SubtitleCues::load(const QByteArray& data)
+{
+    QDataStream in(data);
+    quint32 n = 0;
+    in >> n;
+    for (quint32 i = 0; i < n && in.status() == QDataStream::Ok; ++i) {
+        Cue cue;
+        QString text;
+        in >> cue.start >> cue.end >> text;
+        // cleaned when it was first parsed
+        cue.offset = pool.length();
+        cue.length = text.length();
+        cues.push_back(cue);
+        pool += text;
+    }
+    if (in.status() != QDataStream::Ok) {
+        cues.clear();
+        pool.clear();
+        return false;
+    }
+    finish();
+    return count() > 0;
+}
+
+std::vector<qint32> SubtitleCues::find(const QStringList& query, bool lastIsPrefix) const
+{
+    std::vector<qint32> result;
+    for (int w = 0; w < query.count(); ++w) {
+        std::vector<qint32> ids;
+        if (lastIsPrefix && w == query.count() - 1 && query.at(w).length() >= MIN_PREFIX) {
+            // one k-way merge over the id lists of every word with the prefix
+            const QString& prefix = query.at(w);
+            using Head = std::pair<const qint32*, const qint32*>;
+            auto later = [](const Head& a, const Head& b) {
+                return *a.first > *b.first;
+            };
+            std::priority_queue<Head, std::vector<Head>, decltype(later)> heads(later);
+            auto it = std::lower_bound(vocabulary.cbegin(), vocabulary.cend(), prefix);
+            for (; it != vocabulary.cend() && it->startsWith(prefix); ++it) {
+                const std::vector<qint32>& list = *index.constFind(*it);
+                heads.push({ list.data(), list.data() + list.size() });
+            }
+            while (!heads.empty()) {
+                Head head = heads.top();
+                heads.pop();
+                if (ids.empty() || ids.back() != *head.first) {
+                    ids.push_back(*head.first);
+                }
+                if (++head.first != head.second) {
+                    heads.push(head);
+                }
+            }
+        }
+        else {
+            ids = index.value(query.at(w));
+        }
+        if (w == 0) {
+            result.swap(ids);
+        }
+        else {
+            std::vector<qint32> both;
+            std::set_intersection(result.begin(), result.end(), ids.begin(), ids.end(), std::back_inserter(both));
+            result.swap(both);
+        }
+        if (result.empty()) {
+            break;
+        }
+    }
+    return result;
+}
+
+bool SubtitleCues::parseFile(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+        return false;
+    }
+    // mapped, so the raw file never has to sit in memory next to the text
+    uchar* data = file.map(0, file.size());
+    if (!data) {
+        return false;
+    }
+    QByteArrayView bytes(reinterpret_cast<const char*>(data), file.size());
+    QStringDecoder decoder(QStringDecoder::Utf8, QStringDecoder::Flag::Stateless);
+    QString text = decoder.decode(bytes);
+    if (decoder.hasError()) {
+        // old subtitles are often in a legacy 8 bit encoding
+        text = QString::fromLatin1(bytes);
+    }
+    file.unmap(data);
+
+    const QString suffix = QFileInfo(path).suffix().toLower();
+    if (suffix == "ass" || suffix == "ssa") {
+        parseAss(text);
+    }
+    else {
+        parseSrt(text);
+    }
+    finish();
+    return count() > 0;
+}
+
+// also covers WebVTT, the cue blocks look the same
+void SubtitleCues::parseSrt(const QString& data)
+{
+    qint64 start = -1;
+    qint64 end = -1;
+    QString text;
+    for (QStringView line : QStringView(data).split('\n')) {
+        line = line.trimmed();
+        int arrow = line.indexOf(u"-->");
+        if (arrow > 0) {
+            add(start, end, text);
+            text.clear();
+            start = parseTime(line.left(arrow));
+            // VTT may put cue settings after the end time
+            QStringView rest = line.mid(arrow + 3).trimmed();
+            int space = rest.indexOf(' ');
+            end = parseTime(space > 0 ? rest.left(space) : rest);
+        }
+        else if (line.isEmpty()) {
+            add(start, end, text);
+            text.clear();
+            start = -1;
+        }
+        else if (start >= 0) {
+            if (!text.isEmpty()) {
+                text += ' ';
+            }
+            text += line;
+        }
+    }
+    add(start, end, text);
+}
+
+void SubtitleCues::parseAss(const QString& data)
+{
+    int startField = 1;
+    int endField = 2;
+    int textField = 9;
+    for (QStringView line : QStringView(data).split('\n')) {
+        line = line.trimmed();
+        if (line.startsWith(u"Format:") && line.contains(u"Text")) {
+            const auto fields = line.mid(7).split(',');
+            for (int i = 0; i < fields.count(); ++i) {
+                QStringView field = fields.at(i).trimmed();
+                if (field == u"Start") {
+                    startField = i;
+                }
+                else if (field == u"End") {
+                    endField = i;
+                }
+                else if (field == u"Text") {
+                    textField = i;
+                }
+            }
+        }
+        else if (line.startsWith(u"Dialogue:")) {
+            // the text is last and may contain commas itself
+            const auto fields = line.mid(9).split(',');
+            if (fields.count() <= textField) {
+                continue;
+            }
+            QStringList rest;
+            for (int i = textField; i < fields.count(); ++i) {
+                rest << fields.at(i).toString();
+            }
+            add(parseTime(fields.at(startField)), parseTime(fields.at(endField)), rest.join(','));
+        }
+    }
+}
+
+bool SubtitleCues::parseEmbedded(const QString& path, int streamIndex, const std::atomic_bool& cancelled)
+{
+    AVFormatContext* format = nullptr;
+    if (avformat_open_input(&format, QFile::encodeName(path).constData(), nullptr, nullptr) < 0) {
+        return false;
+    }
+    if (streamIndex < 0 || streamIndex >= (int)format->nb_streams) {
+        avformat_close_input(&format);
+        return false;
+    }
+    // only the subtitle packets are wanted, the demuxer can skip the rest
+    for (unsigned i = 0; i < format->nb_streams; ++i) {
+        format->streams[i]->discard = (int)i == streamIndex ? AVDISCARD_DEFAULT : AVDISCARD_ALL;
+    }
+    AVStream* stream = format->streams[streamIndex];
+    const AVCodecID codec = stream->codecpar->codec_id;
+    const double timeBase = av_q2d(stream->time_base) * 1000;
+
+    AVPacket* packet = av_packet_alloc();
+    while (!cancelled && av_read_frame(format, packet) >= 0) {
+        if (packet->stream_index == streamIndex && packet->pts != AV_NOPTS_VALUE) {
+            QByteArray bytes(reinterpret_cast<const char*>(packet->data), packet->size);
+            if (codec == AV_CODEC_ID_MOV_TEXT) {
+                // 16 bit length, then the text
+                int length = bytes.size() >= 2 ? ((uchar)bytes[0] << 8 | (uchar)bytes[1]) : 0;
+                bytes = bytes.mid(2, length);
+            }
+            QString text = QString::fromUtf8(bytes);
+            if (codec == AV_CODEC_ID_ASS) {
+                // ReadOrder, Layer, Style, Name, MarginL, MarginR, MarginV, Effect, Text
+                text = text.section(',', 8);
+            }
+            qint64 start = packet->pts * timeBase;
+            add(start, start + packet->duration * timeBase, text);
+        }
+        av_packet_unref(packet);
+    }
+    av_packet_free(&packet);
+    avformat_close_input(&format);
+    finish();
+    return !cancelled && count() > 0;
+}
+
+SubtitleSearch::SubtitleSearch(AnalysisCache* cache, QObject* parent)
+    : QObject(parent)
+    , cache(cache)
+{
+    worker.setMaxThreadCount(1);
+    worker.setThreadPriority(QThread::IdlePriority);
+}
+
+SubtitleSearch::~SubtitleSearch()
+{
+    if (cancelled) {
+        *cancelled = true;
+    }
+    worker.waitForDone();
+}
+
+void SubtitleSearch::setTracks(const QString& path, quint64 identity, const QVariantList& trackList)
+{
+    // the track list changes several times while a file loads, only
+    // reparse when the text tracks themselves changed
+    QList<QVariantMap> textTracks;
+    QString newKey = path;
+    for (const QVariant& item : trackList) {
+        QVariantMap track = item.toMap();
+        if (track.value("type").toString() != "sub" || !textCodecs.contains(track.value("codec").toString())) {
+            continue;
+        }
+        textTracks << track;
+        newKey += QString("|%1:%2:%3").arg(track.value("id").toInt()).arg(track.value("ff-index").toInt()).arg(track.value("external-filename").toString());
+    }
+    if (newKey == key) {
+        return;
+    }
+    key = newKey;
+    if (cancelled) {
+        *cancelled = true;
+    }
+    tracks.clear();
+    emit indexed(0);
+    if (textTracks.isEmpty() || path.contains("://")) {
+        return;
+    }
+
+    auto cancel = std::make_shared<std::atomic_bool>(false);
+    cancelled = cancel;
+    AnalysisCache* analysisCache = cache;
+    worker.start([=] {
+        setIdleIoPriority();
+        QList<Track> parsed;
+        for (const QVariantMap& track : textTracks) {
+            if (*cancel) {
+                return;
+            }
+            auto cues = std::make_shared<SubtitleCues>();
+            const QString external = track.value("external-filename").toString();
+            bool ok;
+            if (!external.isEmpty()) {
+                ok = cues->parseFile(external);
+            }
+            else {
+                const int streamIndex = track.value("ff-index").toInt();
+                const QString kind = QString("subtitles-%1").arg(streamIndex);
+                QFile cached(identity != 0 ? analysisCache->dataPath(identity, kind) : QString());
+                ok = cached.open(QIODevice::ReadOnly) && cues->load(cached.readAll());
+                if (!ok) {
+                    cues = std::make_shared<SubtitleCues>();
+                    ok = cues->parseEmbedded(path, streamIndex, *cancel);
+                    if (ok && identity != 0) {
+                        analysisCache->storeData(identity, kind, cues->save());
+                    }
+                }
+            }
+            if (ok) {
+                QString lang = track.value("lang").toString();
+                QString label = lang.isEmpty() ? QString("id: %1").arg(track.value("id").toInt()) : lang;
+                parsed.append({ label, cues });
+            }
+        }
+        // the worker is waited for in the destructor, this is still alive
+        QMetaObject::invokeMethod(this, [=] {
+            if (*cancel) {
+                return;
+            }
+            tracks = parsed;
+            emit indexed(cueCount());
+        });
+    });
+}
+
+int SubtitleSearch::cueCount() const
+{
+    int count = 0;
+    for (const Track& track : tracks) {
+        count += track.second->count();
+    }
+    return count;
+}
+
+QList<SubtitleSearch::Match> SubtitleSearch::search(const QString& query, int limit) const
+{
+    QList<Match> phrase;
+    QList<Match> others;
+    const QStringList words = SubtitleCues::words(query);
+    if (words.isEmpty()) {
+        return phrase;
+    }
+    // still typing the last word
+    const bool prefix = !query.isEmpty() && query.back().isLetterOrNumber();
+    for (const Track& track : tracks) {
+        for (qint32 id : track.second->find(words, prefix)) {
+            Match match { track.second->cue(id).start / 1000.0, track.second->text(id), track.first };
+            // whole phrase matches first
+            if (SubtitleCues::containsPhrase(SubtitleCues::words(match.text), words, prefix)) {
+                phrase << match;
+            }
+            else {
+                others << match;
+            }
+        }
+    }
+    auto byTime = [](const Match& a, const Match& b) {
+        return a.time < b.time;
+    };
+    std::sort(phrase.begin(), phrase.end(), byTime);
+    std::sort(others.begin(), others.end(), byTime);
+    phrase += others;
+    return phrase.mid(0, limit);
+}
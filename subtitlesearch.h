@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVariantList>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class AnalysisCache;
+
+// One text subtitle track. Cues live in a flat array pointing into a single
+// text buffer, and every word maps to the sorted ids of the cues using it.
+class SubtitleCues
+{
+public:
+    struct Cue {
+        // milliseconds
+        qint32 start;
+        qint32 end;
+        quint32 offset;
+        quint32 length;
+    };
+
+    bool parseFile(const QString& path);
+    // an embedded track, by libavformat stream index
+    bool parseEmbedded(const QString& path, int streamIndex, const std::atomic_bool& cancelled);
+
+    void add(qint64 startMs, qint64 endMs, const QString& text);
+    // sorts the cues and builds the word index, call once after adding
+    void finish();
+
+    // the cues as parsed, to keep embedded tracks in the analysis cache
+    QByteArray save() const;
+    bool load(const QByteArray& data);
+
+    int count() const { return (int)cues.size(); }
+    const Cue& cue(int i) const { return cues[i]; }
+    QString text(int i) const;
+    // ids of the cues containing all words, the last one may be a prefix
+    std::vector<qint32> find(const QStringList& words, bool lastIsPrefix) const;
+
+    static QStringList words(const QString& text);
+    // the phrase's words next to each other in `words`
+    static bool containsPhrase(const QStringList& words, const QStringList& phrase, bool lastIsPrefix);
+
+private:
+    std::vector<Cue> cues;
+    QString pool;
+    QHash<QString, std::vector<qint32>> index;
+    // sorted, for prefix lookups
+    QStringList vocabulary;
+
+    void parseSrt(const QString& data);
+    void parseAss(const QString& data);
+};
+
+// Keeps the text subtitle tracks of the current file parsed and indexed,
+// parsing on an idle priority thread whenever the track list changes.
+// Embedded tracks take a pass over the whole container, so their cues are
+// kept in the analysis cache and demuxed once per file.
+class SubtitleSearch : public QObject
+{
+    Q_OBJECT
+public:
+    struct Match {
+        double time;
+        QString text;
+        QString track;
+    };
+
+    SubtitleSearch(AnalysisCache* cache, QObject* parent = nullptr);
+    ~SubtitleSearch();
+
+    // identity is the file's fileIdentity(), 0 when it has none
+    void setTracks(const QString& path, quint64 identity, const QVariantList& trackList);
+    QList<Match> search(const QString& query, int limit = 200) const;
+    int cueCount() const;
+
+signals:
+    void indexed(int cues);
+
+private:
+    using Track = QPair<QString, std::shared_ptr<SubtitleCues>>;
+
+    AnalysisCache* cache;
+    QString key;
+    QList<Track> tracks;
+    std::shared_ptr<std::atomic_bool> cancelled;
+    QThreadPool worker;
+};
@@ -0,0 +1,204 @@
+#include "trace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <chrono>
+#include <cstring>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+// 64 bytes an event, a chunk is 256 KiB
+#define CHUNK_EVENTS 4096
+// 1 GiB a thread at most, later spans are counted and dropped
+#define MAX_CHUNKS 4096
+
+namespace {
+
+struct Event {
+    qint64 start;
+    qint64 end;
+    const char* name;
+    char detail[40];
+};
+
+struct Chunk {
+    Event events[CHUNK_EVENTS];
+    std::atomic_int count { 0 };
+    std::atomic<Chunk*> next { nullptr };
+};
+
+// appended to by its thread only, read by whoever writes the trace
+struct ThreadBuffer {
+    Chunk* first;
+    Chunk* last;
+    int chunks = 1;
+    qint64 tid;
+    QByteArray threadName;
+    std::atomic<qint64> dropped { 0 };
+};
+
+QMutex buffersMutex;
+// never freed, spans of threads that are gone still go into the trace
+std::vector<ThreadBuffer*> buffers;
+QString tracePath;
+qint64 origin = 0;
+thread_local ThreadBuffer* threadBuffer = nullptr;
+
+ThreadBuffer* createBuffer()
+{
+    auto buffer = new ThreadBuffer;
+    buffer->first = buffer->last = new Chunk;
+    buffer->tid = syscall(SYS_gettid);
+    QThread* thread = QThread::currentThread();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+        buffer->threadName = "main";
+    }
+    else if (thread && !thread->objectName().isEmpty()) {
+        buffer->threadName = thread->objectName().toUtf8();
+    }
+    else if (thread) {
+        buffer->threadName = thread->metaObject()->className();
+    }
+    QMutexLocker locker(&buffersMutex);
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+QByteArray escape(const char* text)
+{
+    QByteArray escaped;
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') {
+            escaped += '\\';
+            escaped += *c;
+        }
+        else if (static_cast<unsigned char>(*c) < 0x20) {
+            escaped += QByteArray("\\u00") + QByteArray::number(*c, 16).rightJustified(2, '0');
+        }
+        else {
+            escaped += *c;
+        }
+    }
+    return escaped;
+}
+
+}
+
+std::atomic_bool Trace::active(false);
+
+void Trace::start(const QString& path)
+{
+    {
+        QMutexLocker locker(&buffersMutex);
+        tracePath = path;
+        origin = now();
+    }
+    active = true;
+}
+
+void Trace::stop()
+{
+    if (!active.exchange(false)) {
+        return;
+    }
+    write(path());
+}
+
+QString Trace::path()
+{
+    QMutexLocker locker(&buffersMutex);
+    return tracePath;
+}
+
+qint64 Trace::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::record(const char* name, const char* detail, qint64 start, qint64 end)
+{
+    ThreadBuffer* buffer = threadBuffer;
+    if (Q_UNLIKELY(!buffer)) {
+        buffer = threadBuffer = createBuffer();
+    }
+    Chunk* chunk = buffer->last;
+    int count = chunk->count.load(std::memory_order_relaxed);
+    if (count == CHUNK_EVENTS) {
+        if (buffer->chunks == MAX_CHUNKS) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        Chunk* next = new Chunk;
+        chunk->next.store(next, std::memory_order_release);
+        buffer->last = chunk = next;
+        buffer->chunks++;
+        count = 0;
+    }
+    Event& event = chunk->events[count];
+    event.start = start;
+    event.end = end;
+    event.name = name;
+    strncpy(event.detail, detail, sizeof(event.detail) - 1);
+    event.detail[sizeof(event.detail) - 1] = 0;
+    chunk->count.store(count + 1, std::memory_order_release);
+}
+
+bool Trace::write(const QString& path)
+{
+    QFile file(path);
+    if (path.isEmpty() || !file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        return false;
+    }
+    const qint64 pid = getpid();
+    QMutexLocker locker(&buffersMutex);
+    file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    auto line = [&](const QByteArray& json) {
+        file.write(first ? "" : ",\n");
+        file.write(json);
+        first = false;
+    };
+    for (const ThreadBuffer* buffer : buffers) {
+        const QByteArray ids = QByteArray(",\"pid\":") + QByteArray::number(pid) + ",\"tid\":" + QByteArray::number(buffer->tid);
+        line("{\"name\":\"thread_name\",\"ph\":\"M\"" + ids + ",\"args\":{\"name\":\"" + escape(buffer->threadName.constData()) + "\"}}");
+        for (const Chunk* chunk = buffer->first; chunk; chunk = chunk->next.load(std::memory_order_acquire)) {
+            const int count = chunk->count.load(std::memory_order_acquire);
+            for (int i = 0; i < count; ++i) {
+                const Event& event = chunk->events[i];
+                // microseconds, fractions keep nanosecond spans apart
+                QByteArray json = "{\"name\":\"" + escape(event.name) + "\",\"cat\":\"fastplayer\",\"ph\":\"X\""
+                    + ",\"ts\":" + QByteArray::number((event.start - origin) / 1000.0, 'f', 3)
+                    + ",\"dur\":" + QByteArray::number((event.end - event.start) / 1000.0, 'f', 3) + ids;
+                if (event.detail[0]) {
+                    json += ",\"args\":{\"detail\":\"" + escape(event.detail) + "\"}";
+                }
+                json += '}';
+                line(json);
+            }
+        }
+        qint64 dropped = buffer->dropped.load(std::memory_order_relaxed);
+        if (dropped > 0) {
+            line("{\"name\":\"dropped spans\",\"ph\":\"C\",\"ts\":0" + ids + ",\"args\":{\"count\":" + QByteArray::number(dropped) + "}}");
+        }
+    }
+    file.write("\n]}\n");
+    return file.error() == QFileDevice::NoError;
+}
+
+void TraceSpan::begin(const char* name, const char* detail)
+{
+    spanName = name;
+    if (detail) {
+        strncpy(spanDetail, detail, DetailSize - 1);
+        spanDetail[DetailSize - 1] = 0;
+    }
+    else {
+        spanDetail[0] = 0;
+    }
+    start = Trace::now();
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QtGlobal>
+
+#include <atomic>
+
+// Scoped spans written as Chrome trace events, for chrome://tracing or
+// ui.perfetto.dev. Every thread appends to its own buffer without locking,
+// the buffers are only walked when the trace is written. Started by
+// --trace=<path> or FASTPLAYER_TRACE=<path> and written on exit. While off a
+// span costs one load and a branch that is always predicted right.
+class Trace
+{
+public:
+    static bool enabled() { return active.load(std::memory_order_relaxed); }
+    static void start(const QString& path);
+    // stops and writes the trace to the path it was started with
+    static void stop();
+    // everything recorded so far, tracing carries on
+    static bool write(const QString& path);
+    static QString path();
+
+    static qint64 now();
+    static void record(const char* name, const char* detail, qint64 start, qint64 end);
+
+private:
+    static std::atomic_bool active;
+};
+
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char* name)
+    {
+        if (Q_UNLIKELY(Trace::enabled())) {
+            begin(name, nullptr);
+        }
+    }
+    TraceSpan(const char* name, const char* detail)
+    {
+        if (Q_UNLIKELY(Trace::enabled())) {
+            begin(name, detail);
+        }
+    }
+    // detail() returns a QByteArray and only runs while tracing
+    template <typename Detail>
+    TraceSpan(const char* name, Detail detail)
+    {
+        if (Q_UNLIKELY(Trace::enabled())) {
+            const QByteArray value = detail();
+            begin(name, value.constData());
+        }
+    }
+    ~TraceSpan()
+    {
+        if (Q_UNLIKELY(spanName)) {
+            Trace::record(spanName, spanDetail, start, Trace::now());
+        }
+    }
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    static const int DetailSize = 40;
+    const char* spanName = nullptr;
+    char spanDetail[DetailSize];
+    qint64 start;
+
+    void begin(const char* name, const char* detail);
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+// name must be a string literal, the detail is copied
+#define TRACE_SPAN(...) TraceSpan TRACE_CONCAT(traceSpan, __LINE__)(__VA_ARGS__)
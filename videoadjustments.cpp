@@ -0,0 +1,131 @@
+#include "videoadjustments.h"
+
+#include "qthelper.hpp"
+
+#include <cmath>
+#include <cstring>
+
+bool VideoAdjustments::operator==(const VideoAdjustments& other) const
+{
+    return zoom == other.zoom && rotation == other.rotation && panX == other.panX && panY == other.panY
+        && cropH == other.cropH && cropV == other.cropV && brightness == other.brightness
+        && contrast == other.contrast && saturation == other.saturation && gamma == other.gamma
+        && hue == other.hue;
+}
+
+QVariantMap VideoAdjustments::toMap() const
+{
+    return {
+        { "zoom", zoom },
+        { "rotation", rotation },
+        { "panX", panX },
+        { "panY", panY },
+        { "cropH", cropH },
+        { "cropV", cropV },
+        { "brightness", brightness },
+        { "contrast", contrast },
+        { "saturation", saturation },
+        { "gamma", gamma },
+        { "hue", hue },
+    };
+}
+
+VideoAdjustments VideoAdjustments::fromMap(const QVariantMap& map)
+{
+    VideoAdjustments a;
+    a.zoom = map.value("zoom", a.zoom).toInt();
+    a.rotation = map.value("rotation", a.rotation).toInt();
+    a.panX = map.value("panX", a.panX).toInt();
+    a.panY = map.value("panY", a.panY).toInt();
+    a.cropH = map.value("cropH", a.cropH).toInt();
+    a.cropV = map.value("cropV", a.cropV).toInt();
+    a.brightness = map.value("brightness", a.brightness).toInt();
+    a.contrast = map.value("contrast", a.contrast).toInt();
+    a.saturation = map.value("saturation", a.saturation).toInt();
+    a.gamma = map.value("gamma", a.gamma).toInt();
+    a.hue = map.value("hue", a.hue).toInt();
+    return a;
+}
+
+// zoom, rotation and crop need 16 bits, the rest fit in a signed byte
+void VideoAdjustments::pack(uint8_t* data) const
+{
+    qint16 wide[4] = { (qint16)zoom, (qint16)rotation, (qint16)cropH, (qint16)cropV };
+    qint8 narrow[7] = { (qint8)panX, (qint8)panY, (qint8)brightness, (qint8)contrast, (qint8)saturation, (qint8)gamma, (qint8)hue };
+    memset(data, 0, 16);
+    memcpy(data, wide, sizeof(wide));
+    memcpy(data + sizeof(wide), narrow, sizeof(narrow));
+}
+
+VideoAdjustments VideoAdjustments::unpack(const uint8_t* data)
+{
+    qint16 wide[4];
+    qint8 narrow[7];
+    memcpy(wide, data, sizeof(wide));
+    memcpy(narrow, data + sizeof(wide), sizeof(narrow));
+    VideoAdjustments a;
+    a.zoom = wide[0];
+    a.rotation = wide[1];
+    a.cropH = wide[2];
+    a.cropV = wide[3];
+    a.panX = narrow[0];
+    a.panY = narrow[1];
+    a.brightness = narrow[2];
+    a.contrast = narrow[3];
+    a.saturation = narrow[4];
+    a.gamma = narrow[5];
+    a.hue = narrow[6];
+    return a;
+}
+
+QVariantMap videoAdjustmentChanges(const VideoAdjustments& a, const VideoAdjustments& previous, int width, int height)
+{
+    QVariantMap changes;
+    if (a.zoom != previous.zoom) {
+        changes.insert("video-zoom", log2((double)a.zoom / 100));
+    }
+    if (a.rotation != previous.rotation) {
+        changes.insert("video-rotate", a.rotation);
+    }
+    if (a.panX != previous.panX) {
+        changes.insert("video-pan-x", (double)a.panX / 100);
+    }
+    if (a.panY != previous.panY) {
+        changes.insert("video-pan-y", (double)a.panY / 100);
+    }
+    if ((a.cropH != previous.cropH || a.cropV != previous.cropV) && width > 0 && height > 0) {
+        if (a.cropH == 0 && a.cropV == 0) {
+            changes.insert("video-crop", QString());
+        }
+        else {
+            int x = qBound(0, a.cropH, width / 2);
+            int y = qBound(0, a.cropV, height / 2);
+            changes.insert("video-crop", QString("%1x%2+%3+%4").arg(width - 2 * x).arg(height - 2 * y).arg(x).arg(y));
+        }
+    }
+    if (a.brightness != previous.brightness) {
+        changes.insert("brightness", a.brightness);
+    }
+    if (a.contrast != previous.contrast) {
+        changes.insert("contrast", a.contrast);
+    }
+    if (a.saturation != previous.saturation) {
+        changes.insert("saturation", a.saturation);
+    }
+    if (a.gamma != previous.gamma) {
+        changes.insert("gamma", a.gamma);
+    }
+    if (a.hue != previous.hue) {
+        changes.insert("hue", a.hue);
+    }
+    return changes;
+}
+
+void applyVideoAdjustments(mpv_handle* mpv, const QVariantMap& changes)
+{
+    for (auto it = changes.cbegin(); it != changes.cend(); ++it) {
+        mpv::qt::node_builder node(it.value());
+        // the node is copied before this returns
+        mpv_set_property_async(mpv, 0, it.key().toUtf8().constData(), MPV_FORMAT_NODE, node.node());
+    }
+}
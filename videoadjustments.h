@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QString>
+#include <QVariantMap>
+
+#include <mpv/client.h>
+
+#include <cstdint>
+
+// Everything the zoom, rotation, pan, crop and equalizer spin boxes control.
+struct VideoAdjustments {
+    int zoom = 100;
+    int rotation = 0;
+    int panX = 0;
+    int panY = 0;
+    // pixels removed from each side of the decoded frame
+    int cropH = 0;
+    int cropV = 0;
+    int brightness = 0;
+    int contrast = 0;
+    int saturation = 0;
+    int gamma = 0;
+    int hue = 0;
+
+    bool operator==(const VideoAdjustments& other) const;
+    bool operator!=(const VideoAdjustments& other) const { return !(*this == other); }
+    bool isDefault() const { return *this == VideoAdjustments(); }
+
+    QVariantMap toMap() const;
+    static VideoAdjustments fromMap(const QVariantMap& map);
+
+    // 16 byte form kept in ResumeStore records
+    void pack(uint8_t* data) const;
+    static VideoAdjustments unpack(const uint8_t* data);
+};
+
+// The property changes that take mpv from `previous` to `adjustments`. The
+// crop needs the decoded size and is left out while it isn't known.
+QVariantMap videoAdjustmentChanges(const VideoAdjustments& adjustments, const VideoAdjustments& previous, int width, int height);
+
+// Sends the changes back to back as async requests without waiting for
+// replies. mpv still applies each property on its own, there is no way to
+// set several as one transaction; what this saves is a round trip per
+// property on the GUI thread.
+void applyVideoAdjustments(mpv_handle* mpv, const QVariantMap& changes);
@@ -0,0 +1,220 @@
+#include "waveform.h"
+
+#include <QtMath>
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define MAGIC "FPWF"
+// about 21 ms at 48 kHz
+#define BLOCK_FRAMES 1024
+
+// folds count samples into a running minimum, maximum and sum of squares
+static void reduce(const float* samples, qint64 count, float& min, float& max, double& squares)
+{
+    qint64 i = 0;
+#ifdef __SSE2__
+    if (count >= 4) {
+        __m128 vmin = _mm_set1_ps(min);
+        __m128 vmax = _mm_set1_ps(max);
+        __m128 vsum = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(samples + i);
+            vmin = _mm_min_ps(vmin, x);
+            vmax = _mm_max_ps(vmax, x);
+            vsum = _mm_add_ps(vsum, _mm_mul_ps(x, x));
+        }
+        float mins[4], maxs[4], sums[4];
+        _mm_storeu_ps(mins, vmin);
+        _mm_storeu_ps(maxs, vmax);
+        _mm_storeu_ps(sums, vsum);
+        for (int j = 0; j < 4; ++j) {
+            min = qMin(min, mins[j]);
+            max = qMax(max, maxs[j]);
+            squares += sums[j];
+        }
+    }
+#endif
+    for (; i < count; ++i) {
+        min = qMin(min, samples[i]);
+        max = qMax(max, samples[i]);
+        squares += samples[i] * samples[i];
+    }
+}
+
+bool Waveform::open(const QString& path)
+{
+    close();
+    file.setFileName(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < (qint64)sizeof(Header)) {
+        close();
+        return false;
+    }
+    mapped = file.map(0, file.size());
+    if (!mapped) {
+        close();
+        return false;
+    }
+    Header header;
+    memcpy(&header, mapped, sizeof(header));
+    if (memcmp(header.magic, MAGIC, 4) != 0 || header.sampleRate == 0 || header.blockFrames == 0 || header.levels == 0 || header.levels > MaxLevels) {
+        close();
+        return false;
+    }
+    qint64 offset = sizeof(Header);
+    for (quint32 i = 0; i < header.levels; ++i) {
+        level[i] = reinterpret_cast<const Peak*>(mapped + offset);
+        counts[i] = header.counts[i];
+        offset += (qint64)header.counts[i] * sizeof(Peak);
+    }
+    if (offset > file.size()) {
+        close();
+        return false;
+    }
+    sampleRate = header.sampleRate;
+    blockFrames = header.blockFrames;
+    levels = header.levels;
+    return true;
+}
+
+void Waveform::close()
+{
+    // closing unmaps
+    file.close();
+    mapped = nullptr;
+    levels = 0;
+}
+
+double Waveform::duration() const
+{
+    return isNull() ? 0 : (double)counts[0] * blockFrames / sampleRate;
+}
+
+QList<Waveform::Peak> Waveform::peaks(double from, double to, int columns) const
+{
+    QList<Peak> result;
+    if (isNull() || columns <= 0 || to <= from) {
+        return result;
+    }
+    result.resize(columns);
+    const double columnSecs = (to - from) / columns;
+    // the coarsest level that still has a peak for every column, so each
+    // column combines fewer than Factor of them
+    int l = 0;
+    double peakSecs = (double)blockFrames / sampleRate;
+    while (l + 1 < levels && peakSecs * Factor <= columnSecs) {
+        peakSecs *= Factor;
+        l++;
+    }
+    const Peak* row = level[l];
+    const int count = counts[l];
+    for (int c = 0; c < columns; ++c) {
+        const int first = qMax(0, (int)((from + c * columnSecs) / peakSecs));
+        const int last = qMin(count, qMax(first + 1, (int)((from + (c + 1) * columnSecs) / peakSecs)));
+        if (first >= last) {
+            continue;
+        }
+        Peak& out = result[c];
+        int power = 0;
+        for (int i = first; i < last; ++i) {
+            out.min = qMin(out.min, row[i].min);
+            out.max = qMax(out.max, row[i].max);
+            power += row[i].rms * row[i].rms;
+        }
+        out.rms = qSqrt((double)power / (last - first));
+    }
+    return result;
+}
+
+WaveformBuilder::WaveformBuilder(int sampleRate, int channels)
+    : sampleRate(sampleRate)
+    , channels(channels)
+    , blockFrames(BLOCK_FRAMES)
+{
+}
+
+void WaveformBuilder::process(const float* samples, qint64 frames)
+{
+    while (frames > 0) {
+        const qint64 take = qMin(frames, blockFrames - filled);
+        reduce(samples, take * channels, min, max, squares);
+        samples += take * channels;
+        frames -= take;
+        filled += take;
+        if (filled == blockFrames) {
+            flush();
+        }
+    }
+}
+
+void WaveformBuilder::flush()
+{
+    if (filled == 0) {
+        return;
+    }
+    blocks.push_back({ min, max, (float)(squares / (filled * channels)) });
+    filled = 0;
+    // a block that stays above or below zero keeps its true peaks
+    min = std::numeric_limits<float>::infinity();
+    max = -std::numeric_limits<float>::infinity();
+    squares = 0;
+}
+
+QJsonObject WaveformBuilder::result()
+{
+    flush();
+    return { { "peaks", (qint64)blocks.size() }, { "block-frames", blockFrames }, { "sample-rate", sampleRate } };
+}
+
+QByteArray WaveformBuilder::data()
+{
+    flush();
+    if (blocks.empty()) {
+        return QByteArray();
+    }
+    std::vector<std::vector<Block>> pyramid { blocks };
+    while (pyramid.back().size() > 1 && pyramid.size() < (size_t)Waveform::MaxLevels) {
+        const std::vector<Block>& below = pyramid.back();
+        std::vector<Block> above((below.size() + Waveform::Factor - 1) / Waveform::Factor);
+        for (size_t i = 0; i < above.size(); ++i) {
+            const size_t first = i * Waveform::Factor;
+            const size_t last = qMin(below.size(), first + Waveform::Factor);
+            Block block = below[first];
+            for (size_t j = first + 1; j < last; ++j) {
+                block.min = qMin(block.min, below[j].min);
+                block.max = qMax(block.max, below[j].max);
+                block.power += below[j].power;
+            }
+            block.power /= last - first;
+            above[i] = block;
+        }
+        pyramid.push_back(std::move(above));
+    }
+
+    Waveform::Header header = {};
+    memcpy(header.magic, MAGIC, 4);
+    header.sampleRate = sampleRate;
+    header.blockFrames = blockFrames;
+    header.levels = pyramid.size();
+    qint64 size = sizeof(header);
+    for (size_t i = 0; i < pyramid.size(); ++i) {
+        header.counts[i] = pyramid[i].size();
+        size += pyramid[i].size() * sizeof(Waveform::Peak);
+    }
+    QByteArray out(size, Qt::Uninitialized);
+    memcpy(out.data(), &header, sizeof(header));
+    Waveform::Peak* peak = reinterpret_cast<Waveform::Peak*>(out.data() + sizeof(header));
+    for (const std::vector<Block>& blocksOfLevel : pyramid) {
+        for (const Block& block : blocksOfLevel) {
+            peak->min = qBound(-127, qRound(block.min * 127), 127);
+            peak->max = qBound(-127, qRound(block.max * 127), 127);
+            peak->rms = qBound(0, qRound(qSqrt(block.power) * 255), 255);
+            peak->reserved = 0;
+            peak++;
+        }
+    }
+    return out;
+}
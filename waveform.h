@@ -0,0 +1,92 @@
+#pragma once
+
+#include <QFile>
+#include <QList>
+#include <QString>
+
+#include <limits>
+#include <vector>
+
+#include "audioscanner.h"
+
+// Peaks of a file's audio at several zoom levels, each level a quarter the
+// size of the one below. Kept as a flat file that is mapped rather than
+// read, and a view only touches the level that has about one peak per
+// pixel, so drawing costs the same for a minute or a day of audio.
+class Waveform
+{
+public:
+    struct Peak {
+        // -127 to 127
+        qint8 min = 0;
+        qint8 max = 0;
+        // 0 to 255
+        quint8 rms = 0;
+        quint8 reserved = 0;
+    };
+
+    Waveform() = default;
+    Waveform(const Waveform&) = delete;
+    Waveform& operator=(const Waveform&) = delete;
+
+    bool open(const QString& path);
+    void close();
+    bool isNull() const { return levels == 0; }
+    double duration() const;
+    // one peak per column from `from` to `to`, in seconds
+    QList<Peak> peaks(double from, double to, int columns) const;
+
+private:
+    friend class WaveformBuilder;
+
+    static const int MaxLevels = 16;
+    static const int Factor = 4;
+    struct Header {
+        char magic[4];
+        quint32 sampleRate;
+        // frames per peak of the finest level
+        quint32 blockFrames;
+        quint32 levels;
+        quint32 counts[MaxLevels];
+    };
+
+    QFile file;
+    uchar* mapped = nullptr;
+    int sampleRate = 0;
+    int blockFrames = 0;
+    int levels = 0;
+    int counts[MaxLevels] = {};
+    const Peak* level[MaxLevels] = {};
+};
+
+// Reduces the decoded audio to the finest level of peaks as it streams by,
+// and builds the coarser ones and the file's contents at the end.
+class WaveformBuilder : public AudioSink
+{
+public:
+    WaveformBuilder(int sampleRate, int channels);
+
+    void process(const float* samples, qint64 frames) override;
+    QJsonObject result() override;
+    QByteArray data() override;
+
+private:
+    struct Block {
+        float min;
+        float max;
+        // mean of the squares
+        float power;
+    };
+
+    int sampleRate;
+    int channels;
+    int blockFrames;
+    std::vector<Block> blocks;
+    // the block still being filled
+    qint64 filled = 0;
+    float min = std::numeric_limits<float>::infinity();
+    float max = -std::numeric_limits<float>::infinity();
+    double squares = 0;
+
+    void flush();
+};